@@ -202,10 +202,12 @@ struct AbcdSeq : Module,QuantizeUtils {
 
 		json_object_set_new(rootJ, "text", json_stringn(text.c_str(), text.size()));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *runningJ = json_object_get(rootJ, "running");
 		if (runningJ)
 			running = json_is_true(runningJ);
@@ -1151,6 +1153,12 @@ void AbcdSeqWidget::appendContextMenu(Menu *menu) {
 	velocityAsProbabilityItem->abcdSeq = abcdSeq;
 	velocityAsProbabilityItem->text = "Velocity as Probability";
 	menu->addChild(velocityAsProbabilityItem);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = abcdSeq;
+	menu->addChild(userScalesItem);
 }
 
 
@@ -0,0 +1,393 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////// BIT GRID //////////////////////////////////////////////
+
+// Lowest set bit of a non-zero word
+inline int lowestBit(uint32_t bits) {
+	return __builtin_ctz(bits);
+}
+
+inline uint32_t reverseBits(uint32_t bits) {
+	bits = ((bits >> 1) & 0x55555555u) | ((bits & 0x55555555u) << 1);
+	bits = ((bits >> 2) & 0x33333333u) | ((bits & 0x33333333u) << 2);
+	bits = ((bits >> 4) & 0x0F0F0F0Fu) | ((bits & 0x0F0F0F0Fu) << 4);
+	bits = ((bits >> 8) & 0x00FF00FFu) | ((bits & 0x00FF00FFu) << 8);
+	return (bits >> 16) | (bits << 16);
+}
+
+// A Life-like rule in B/S notation. Bit n of born is set when a dead cell with n live
+// neighbours comes alive, bit n of survive when a live one with n neighbours stays alive.
+struct LifeRule {
+	uint16_t born = 1 << 3;
+	uint16_t survive = (1 << 2) | (1 << 3);
+
+	bool operator==(const LifeRule &other) const {
+		return born == other.born && survive == other.survive;
+	}
+	bool operator!=(const LifeRule &other) const {
+		return !(*this == other);
+	}
+
+	std::string toString() const {
+		std::string text = "B";
+		for (int n = 0; n <= 8; n++)
+			if (born & (1 << n)) text += (char)('0' + n);
+		text += "/S";
+		for (int n = 0; n <= 8; n++)
+			if (survive & (1 << n)) text += (char)('0' + n);
+		return text;
+	}
+
+	// Accepts "B36/S23" in either order and any case, or the older digits only "23/36" (S/B)
+	static bool parse(const std::string &text, LifeRule &out) {
+		LifeRule rule;
+		rule.born = rule.survive = 0;
+		uint16_t *target = nullptr;
+		bool lettered = false;
+		int part = 0;
+		for (char c : text) {
+			if (c == 'B' || c == 'b') { target = &rule.born; lettered = true; }
+			else if (c == 'S' || c == 's') { target = &rule.survive; lettered = true; }
+			else if (c == '/') { part++; target = nullptr; }
+			else if (c >= '0' && c <= '8') {
+				if (!target) {
+					if (lettered || part > 1) return false;
+					target = part == 0 ? &rule.survive : &rule.born;
+				}
+				*target |= 1 << (c - '0');
+			}
+			else if (c != ' ') return false;
+		}
+		if (part > 1 || (!lettered && part == 0)) return false;
+		out = rule;
+		return true;
+	}
+};
+
+// Byte stream where a zero byte is followed by how many zero bytes it stands for (1 to 255)
+// and any other byte is itself. Mostly empty grids pack to a few bytes.
+inline void packZeroRuns(const uint8_t *data, size_t len, std::vector<uint8_t> &out) {
+	for (size_t i = 0; i < len;) {
+		if (data[i]) {
+			out.push_back(data[i++]);
+			continue;
+		}
+		size_t run = 1;
+		while (i + run < len && run < 255 && !data[i + run]) run++;
+		out.push_back(0);
+		out.push_back((uint8_t)run);
+		i += run;
+	}
+}
+
+// False unless data unpacks to exactly outLen bytes
+inline bool unpackZeroRuns(const uint8_t *data, size_t len, uint8_t *out, size_t outLen) {
+	size_t o = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (data[i]) {
+			if (o >= outLen) return false;
+			out[o++] = data[i];
+			continue;
+		}
+		if (++i >= len || data[i] == 0 || o + data[i] > outLen) return false;
+		memset(out + o, 0, data[i]);
+		o += data[i];
+	}
+	return o == outLen;
+}
+
+struct LifeRulePreset {
+	const char *name;
+	const char *rule;
+};
+
+static const LifeRulePreset LIFE_RULE_PRESETS[] = {
+	{"Life", "B3/S23"},
+	{"HighLife", "B36/S23"},
+	{"Seeds", "B2/S"},
+	{"Day & Night", "B3678/S34678"},
+	{"Life without Death", "B3/S012345678"},
+	{"2x2", "B36/S125"},
+	{"Maze", "B3/S12345"},
+	{"Move", "B368/S245"},
+	{"Diamoeba", "B35678/S5678"},
+	{"Replicator", "B1357/S1357"},
+};
+
+// Sequencer cells stored a column at a time: one word per column (step), with bit y set when
+// the cell in row y, counted from the top, is on. A step's notes are a single load, and Life
+// and the transforms work on whole columns with shifts and masks instead of cell by cell.
+template <int NUM_COLS, int NUM_ROWS>
+struct BitGrid {
+	static_assert(NUM_ROWS <= 32, "a column has to fit in one word");
+	static const uint32_t COL_MASK = NUM_ROWS == 32 ? 0xFFFFFFFFu : (1u << (NUM_ROWS % 32)) - 1;
+
+	uint32_t cols[NUM_COLS] = {};
+
+	bool operator==(const BitGrid &other) const {
+		return memcmp(cols, other.cols, sizeof(cols)) == 0;
+	}
+	bool operator!=(const BitGrid &other) const {
+		return !(*this == other);
+	}
+
+	bool get(int x, int y) const {
+		return (cols[x] >> y) & 1;
+	}
+
+	void set(int x, int y, bool on) {
+		uint32_t bit = 1u << y;
+		cols[x] = on ? (cols[x] | bit) : (cols[x] & ~bit);
+	}
+
+	uint32_t column(int x) const {
+		return cols[x];
+	}
+
+	// The same column with bit 0 for the bottom row, the order notes are handed out in
+	uint32_t columnFromBottom(int x) const {
+		return reverseRows(cols[x]);
+	}
+
+	void clear() {
+		memset(cols, 0, sizeof(cols));
+	}
+
+	// Bytes per column in pack(), low byte first
+	static const int COL_BYTES = (NUM_ROWS + 7) / 8;
+
+	// Column words as bytes, squeezed with packZeroRuns
+	std::vector<uint8_t> pack() const {
+		uint8_t raw[NUM_COLS * COL_BYTES];
+		for (int x = 0; x < NUM_COLS; x++)
+			for (int b = 0; b < COL_BYTES; b++)
+				raw[x * COL_BYTES + b] = (uint8_t)(cols[x] >> (8 * b));
+		std::vector<uint8_t> out;
+		packZeroRuns(raw, sizeof(raw), out);
+		return out;
+	}
+
+	// Leaves the grid untouched and returns false if data isn't a packed grid of this size
+	bool unpack(const uint8_t *data, size_t len) {
+		uint8_t raw[NUM_COLS * COL_BYTES];
+		if (!unpackZeroRuns(data, len, raw, sizeof(raw))) return false;
+		for (int x = 0; x < NUM_COLS; x++) {
+			uint32_t col = 0;
+			for (int b = 0; b < COL_BYTES; b++)
+				col |= (uint32_t)raw[x * COL_BYTES + b] << (8 * b);
+			cols[x] = col & COL_MASK;
+		}
+		return true;
+	}
+
+	// 64-bit fingerprint of the cells, for spotting a state that has been seen before
+	uint64_t hash() const {
+		uint64_t h = NUM_COLS;
+		for (int x = 0; x < NUM_COLS; x++) {
+			h = (h ^ cols[x]) * 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 31;
+		}
+		return h;
+	}
+
+	void flipHoriz() {
+		for (int x = 0, x2 = NUM_COLS - 1; x < x2; x++, x2--)
+			std::swap(cols[x], cols[x2]);
+	}
+
+	void flipVert() {
+		for (int x = 0; x < NUM_COLS; x++)
+			cols[x] = reverseRows(cols[x]);
+	}
+
+	// Every row takes the row amount below it, wrapping at the bottom (negative amounts move down)
+	void rotateRows(int amount) {
+		int a = amount % NUM_ROWS;
+		if (a < 0) a += NUM_ROWS;
+		if (a == 0) return;
+		for (int x = 0; x < NUM_COLS; x++)
+			cols[x] = ((cols[x] >> a) | (cols[x] << (NUM_ROWS - a))) & COL_MASK;
+	}
+
+	// Turns each square of NUM_ROWS columns a quarter turn in place
+	void rotateSquares(bool clockwise) {
+		for (int start = 0; start + NUM_ROWS <= NUM_COLS; start += NUM_ROWS) {
+			uint32_t *square = cols + start;
+			transposeSquare(square);
+			if (clockwise) {
+				for (int x = 0, x2 = NUM_ROWS - 1; x < x2; x++, x2--)
+					std::swap(square[x], square[x2]);
+			}
+			else {
+				for (int x = 0; x < NUM_ROWS; x++)
+					square[x] = reverseRows(square[x]);
+			}
+		}
+	}
+
+	// One generation of a Life-like rule. Without wrap, cells beyond the edges are dead; with
+	// it the grid is a torus. Each column's eight neighbour bits are summed in parallel with a
+	// bit-sliced adder and the rule is applied to every count at once, so a generation costs
+	// the same few dozen word operations per column for any rule and any number of live cells.
+	void stepLife(const LifeRule &rule = LifeRule(), bool wrap = false) {
+		// Per neighbour count, all ones if the rule births or keeps a cell with that many
+		uint32_t born[9], survive[9];
+		for (int n = 0; n <= 8; n++) {
+			born[n] = (rule.born >> n) & 1 ? 0xFFFFFFFFu : 0;
+			survive[n] = (rule.survive >> n) & 1 ? 0xFFFFFFFFu : 0;
+		}
+		uint32_t first = cols[0];
+		uint32_t left = wrap ? cols[NUM_COLS - 1] : 0, center = first;
+		for (int x = 0; x < NUM_COLS; x++) {
+			uint32_t right = x + 1 < NUM_COLS ? cols[x + 1] : (wrap ? first : 0);
+			uint32_t ones, twos, fours, eights;
+			countNeighbors(left, center, right, wrap, ones, twos, fours, eights);
+			uint32_t low[4] = {~ones & ~twos, ones & ~twos, ~ones & twos, ones & twos};
+			uint32_t high[3] = {~fours & ~eights, fours, eights};
+			uint32_t birth = 0, stay = 0;
+			for (int n = 0; n <= 8; n++) {
+				uint32_t count = low[n & 3] & high[n >> 2];
+				birth |= count & born[n];
+				stay |= count & survive[n];
+			}
+			cols[x] = ((center & stay) | (~center & birth)) & COL_MASK;
+			left = center;
+			center = right;
+		}
+	}
+
+private:
+	static uint32_t reverseRows(uint32_t bits) {
+		return reverseBits(bits) >> (32 - NUM_ROWS);
+	}
+
+	static void fullAdd(uint32_t a, uint32_t b, uint32_t c, uint32_t &sum, uint32_t &carry) {
+		uint32_t ab = a ^ b;
+		sum = ab ^ c;
+		carry = (a & b) | (ab & c);
+	}
+
+	// Bit y takes the row above / below it
+	static uint32_t fromAbove(uint32_t bits, bool wrap) {
+		return ((bits << 1) | (wrap ? bits >> (NUM_ROWS - 1) : 0)) & COL_MASK;
+	}
+	static uint32_t fromBelow(uint32_t bits, bool wrap) {
+		return (bits >> 1) | (wrap ? (bits << (NUM_ROWS - 1)) & COL_MASK : 0);
+	}
+
+	// Per row, the neighbour count (0 to 8) as four bit planes
+	static void countNeighbors(uint32_t left, uint32_t center, uint32_t right, bool wrap,
+			uint32_t &ones, uint32_t &twos, uint32_t &fours, uint32_t &eights) {
+		uint32_t s0, c0, s1, c1, s2, c2, c3, t, c4;
+		fullAdd(fromAbove(left, wrap), left, fromBelow(left, wrap), s0, c0);
+		fullAdd(fromAbove(right, wrap), right, fromBelow(right, wrap), s1, c1);
+		uint32_t up = fromAbove(center, wrap), down = fromBelow(center, wrap);
+		s2 = up ^ down;
+		c2 = up & down;
+		fullAdd(s0, s1, s2, ones, c3);
+		fullAdd(c0, c1, c2, t, c4);
+		twos = t ^ c3;
+		fours = c4 ^ (t & c3);
+		eights = c4 & t & c3;
+	}
+
+	// Bit r of word c swaps with bit c of word r, by swapping ever smaller off-diagonal blocks
+	static void transposeSquare(uint32_t *square) {
+		uint32_t m = COL_MASK >> (NUM_ROWS / 2);
+		for (int j = NUM_ROWS / 2; j != 0; j >>= 1, m ^= (m << j)) {
+			for (int k = 0; k < NUM_ROWS; k = ((k | j) + 1) & ~j) {
+				uint32_t t = ((square[k] >> j) ^ square[k | j]) & m;
+				square[k] ^= t << j;
+				square[k | j] ^= t;
+			}
+		}
+	}
+};
+
+// Remembers the fingerprints of the last HISTORY generations of a Life grid to spot it coming
+// back to an earlier state. That catches still lifes and blinkers, and also gliders on a torus
+// and longer oscillators. A ring holds the fingerprints in generation order, and a hash table
+// with twice as many slots as HISTORY finds them, so every one of them always fits; the one
+// that falls out of the ring is deleted from the table. Nothing is allocated.
+struct LifeCycleDetector {
+	static const int HISTORY = 256;
+
+	void reset() {
+		memset(slots, 0, sizeof(slots));
+		generation = 0;
+	}
+
+	// True until the first add, when the state Life starts from still has to be recorded
+	bool empty() const {
+		return generation == 0;
+	}
+
+	// Records the next generation. Returns its period, the number of generations since the same
+	// state was last seen (1 for a still life), or 0 if it hasn't been seen within HISTORY.
+	int add(uint64_t hash) {
+		generation++;
+		int found = find(hash);
+		int period = found >= 0 ? (int)(generation - slots[found].generation) : 0;
+		// The generation HISTORY back can't be a match from the next one on
+		if (generation > (uint32_t)HISTORY) {
+			uint32_t old = generation - HISTORY;
+			int i = find(ring[old % HISTORY]);
+			// Unless the state came back since, when its slot already moved on to a later generation
+			if (i >= 0 && slots[i].generation == old) {
+				erase(i);
+				if (found == i) found = -1;
+				else if (found >= 0) found = find(hash);
+			}
+		}
+		if (found < 0) {
+			found = home(hash);
+			while (slots[found].used) found = (found + 1) & (SLOTS - 1);
+			slots[found].used = true;
+			slots[found].hash = hash;
+		}
+		slots[found].generation = generation;
+		ring[generation % HISTORY] = hash;
+		return period;
+	}
+
+private:
+	// At most HISTORY in use, so probes stay short
+	static const int SLOTS = 2 * HISTORY;
+	struct Slot {
+		uint64_t hash;
+		uint32_t generation;
+		bool used;
+	};
+	Slot slots[SLOTS] = {};
+	uint64_t ring[HISTORY] = {};
+	uint32_t generation = 0;
+
+	static int home(uint64_t hash) {
+		return (int)((hash ^ (hash >> 32)) & (SLOTS - 1));
+	}
+
+	int find(uint64_t hash) const {
+		for (int i = home(hash); slots[i].used; i = (i + 1) & (SLOTS - 1)) {
+			if (slots[i].hash == hash) return i;
+		}
+		return -1;
+	}
+
+	// Linear probing delete: later slots of the same run move back into the gap if that
+	// doesn't put them before their home slot
+	void erase(int i) {
+		for (int j = (i + 1) & (SLOTS - 1); slots[j].used; j = (j + 1) & (SLOTS - 1)) {
+			int h = home(slots[j].hash);
+			if (((j - h) & (SLOTS - 1)) >= ((j - i) & (SLOTS - 1))) {
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].used = false;
+	}
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include "BitGrid.hpp"
+#include <jansson.h>
+
+////////////////////////////////////////////// BIT GRID JSON //////////////////////////////////////////////
+
+// The "cells" array patches saved before cellsPacked: one integer per cell, non-zero for on,
+// row by row. An array of whole rows of fewer columns, from when the grid was narrower, fills
+// the left of the grid. Any other length leaves the grid cleared.
+template <int NUM_COLS, int NUM_ROWS>
+void bitGridFromCellsArray(json_t *cellsJ, BitGrid<NUM_COLS, NUM_ROWS> &grid) {
+	grid.clear();
+	size_t len = json_array_size(cellsJ);
+	if (len == 0 || len % NUM_ROWS != 0) return;
+	int oldCols = (int)(len / NUM_ROWS);
+	int cols = std::min(oldCols, NUM_COLS);
+	for (int y = 0; y < NUM_ROWS; y++) {
+		for (int x = 0; x < cols; x++) {
+			json_t *cellJ = json_array_get(cellsJ, (size_t)y * oldCols + x);
+			if (cellJ && json_integer_value(cellJ))
+				grid.set(x, y, true);
+		}
+	}
+}
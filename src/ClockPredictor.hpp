@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+
+////////////////////////////////////////////// CLOCK PREDICTOR //////////////////////////////////////////////
+
+// Estimates the length of the next clock interval from the ones before it, for spacing events
+// inside a step. An alpha-beta filter follows the period and how much it changes per clock, so
+// jitter is averaged out and a tempo ramp is followed without lag. An interval far from the
+// prediction (a dropped clock, a stop and start) is ignored, unless the next one agrees with it,
+// in which case the tempo really changed and the filter starts over from there. Two short ones
+// that add up to the prediction look like a stray edge splitting one interval, so it takes a
+// third to confirm a change of tempo then.
+struct ClockPredictor {
+	// How far from the prediction an interval may be, as a fraction of it
+	static constexpr float TOLERANCE = 0.3f;
+	// How close two rejected intervals have to add up to the prediction to count as one split
+	static constexpr float SPLIT_TOLERANCE = 0.1f;
+	static constexpr float ALPHA = 0.5f;
+	static constexpr float BETA = 0.1f;
+
+	// Samples per clock, 0 until the first interval
+	float period = 0.f;
+	// Change in period from one clock to the next
+	float drift = 0.f;
+	float rejected = 0.f;
+	int rejectedCount = 0;
+	bool split = false;
+
+	void reset() {
+		period = 0.f;
+		drift = 0.f;
+		rejected = 0.f;
+		rejectedCount = 0;
+		split = false;
+	}
+
+	bool valid() const {
+		return period > 0.f;
+	}
+
+	// Length of the next interval in samples, or fallback before there is one to go by
+	float next(float fallback) const {
+		return valid() ? std::fmax(1.f, period + drift) : fallback;
+	}
+
+	void addInterval(float samples) {
+		if (!valid()) {
+			period = samples;
+			return;
+		}
+		float predicted = period + drift;
+		float error = samples - predicted;
+		if (std::fabs(error) > TOLERANCE * predicted) {
+			// Two that make up the prediction: held back once more, as a stray edge is followed by
+			// a normal interval while a doubled tempo keeps coming short
+			if (rejectedCount == 1 && !split && std::fabs(rejected + samples - predicted) <= SPLIT_TOLERANCE * predicted) {
+				rejected = samples;
+				split = true;
+				return;
+			}
+			bool agrees = rejectedCount > 0 && std::fabs(samples - rejected) <= TOLERANCE * rejected;
+			if (!agrees && rejectedCount < 2) {
+				rejected = samples;
+				rejectedCount++;
+				return;
+			}
+			// Two alike in a row, or three misses: a new tempo
+			period = agrees ? 0.5f * (samples + rejected) : samples;
+			drift = 0.f;
+			rejectedCount = 0;
+			split = false;
+			return;
+		}
+		rejectedCount = 0;
+		split = false;
+		period = predicted + ALPHA * error;
+		drift += BETA * error;
+	}
+};
@@ -305,10 +305,12 @@ struct Crawl : Module, QuantizeUtils {
 		json_object_set_new(rootJ, "pitchQuantizeEnabled", json_boolean(pitchQuantizeEnabled));
 		json_object_set_new(rootJ, "pitchQuantizeRoot",    json_integer(pitchQuantizeRoot));
 		json_object_set_new(rootJ, "pitchQuantizeScale",   json_integer(pitchQuantizeScale));
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *pointsJ = json_object_get(rootJ, "points");
 		if (pointsJ) {
 			int n = (int)json_array_size(pointsJ);
@@ -679,6 +681,12 @@ struct CrawlWidget : ModuleWidget {
 		scaleItem->rightText = m->scaleName(m->pitchQuantizeScale) + " " + RIGHT_ARROW;
 		scaleItem->module = m;
 		menu->addChild(scaleItem);
+
+		UserScalesItem *userScalesItem = new UserScalesItem();
+		userScalesItem->text = "User Scales (Scala)";
+		userScalesItem->rightText = RIGHT_ARROW;
+		userScalesItem->quantizeUtils = m;
+		menu->addChild(userScalesItem);
 	}
 };
 
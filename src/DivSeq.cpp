@@ -136,10 +136,12 @@ struct DivSeq : Module,QuantizeUtils {
 		// max division for randomization and param limits
 		json_object_set_new(rootJ, "divMax", json_integer(divMax));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *runningJ = json_object_get(rootJ, "running");
 		if (runningJ)
 			running = json_is_true(runningJ);
@@ -559,6 +561,12 @@ void DivSeqWidget::appendContextMenu(Menu *menu) {
 	maxDivItem->rightText = string::f("%d", divSeq->divMax) + " " + RIGHT_ARROW;
 	maxDivItem->module = divSeq;
 	menu->addChild(maxDivItem);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = divSeq;
+	menu->addChild(userScalesItem);
 }
 
 Model *modelDivSeq = createModel<DivSeq, DivSeqWidget>("DivSeq");
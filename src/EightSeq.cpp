@@ -137,10 +137,12 @@ struct EightSeq : Module,QuantizeUtils {
 		// pattern mode
 		json_object_set_new(rootJ, "patternMode", json_integer((int)patternMode));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *runningJ = json_object_get(rootJ, "running");
 		if (runningJ)
 			running = json_is_true(runningJ);
@@ -576,6 +578,12 @@ void EightSeqWidget::appendContextMenu(Menu *menu) {
 	}
 	gateSlider->box.size.x = 175.0f;
 	menu->addChild(gateSlider);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = eightSeq;
+	menu->addChild(userScalesItem);
 }
 
 Model *modelEightSeq = createModel<EightSeq, EightSeqWidget>("8Seq");
@@ -747,10 +747,12 @@ struct FM16Seq : Module, QuantizeUtils {
 			json_array_append_new(stepsJ, stepJ);
 		}
 		json_object_set_new(rootJ, "steps", stepsJ);
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t* selectedStepJ = json_object_get(rootJ, "selectedStep");
 		if (selectedStepJ) {
 			   selectedStep = clampijw((int)json_integer_value(selectedStepJ), 0, sequenceLength - 1);
@@ -1357,6 +1359,12 @@ struct FM16SeqWidget : ModuleWidget {
 		   scaleItem->rightText = m->scaleName(m->pitchQuantizeScale) + " " + RIGHT_ARROW;
 		   scaleItem->module = m;
 		   menu->addChild(scaleItem);
+
+		   UserScalesItem* userScalesItem = new UserScalesItem();
+		   userScalesItem->text = "User Scales (Scala)";
+		   userScalesItem->rightText = RIGHT_ARROW;
+		   userScalesItem->quantizeUtils = m;
+		   menu->addChild(userScalesItem);
 	   }
    }
 
@@ -1,8 +1,65 @@
 // #include <string.h>
 #include "JWModules.hpp"
 #include "JWResizableHandle.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+
+#define DEFAULT_BUFFER_SIZE 512
+#define MIN_BUFFER_SIZE 512
+#define MAX_BUFFER_SIZE 65536
+#define SCOPE_CHANNELS PORT_MAX_CHANNELS
+#define ALL_CHANNELS_MASK 0xFFFF
+
+struct FullScopeStats {
+	float vrms = 0, vpp = 0, vmin = 0, vmax = 0;
+	double sumSquares = 0;
+	// Samples, not buckets, so the RMS covers every one
+	int64_t count = 0;
+
+	void reset() {
+		vmin = INFINITY;
+		vmax = -INFINITY;
+		sumSquares = 0;
+		count = 0;
+	}
+	// One bucket of frames samples whose squares add up to squares
+	void add(float min, float max, float squares, int frames) {
+		vmin = fminf(vmin, min);
+		vmax = fmaxf(vmax, max);
+		sumSquares += squares;
+		count += frames;
+	}
+	void finish() {
+		vrms = count ? (float)sqrt(sumSquares / count) : 0.f;
+		vpp = count ? vmax - vmin : 0.f;
+	}
+};
 
-#define BUFFER_SIZE 512
+// One capture of min/max/mean buckets. Channel-major: channel c occupies
+// [c * size, (c + 1) * size) of each array.
+struct FullScopeCapture {
+	int size = 0;
+	// Channels the arrays have room for
+	int capacity = 0;
+	// Channels captured from each input
+	int channelsX = 0;
+	int channelsY = 0;
+	std::vector<float> minX, maxX, meanX;
+	std::vector<float> minY, maxY, meanY;
+	// Channel 0, gathered as the buckets were written
+	FullScopeStats statsX, statsY;
+
+	void allocate(int size, int capacity) {
+		this->size = size;
+		this->capacity = capacity;
+		size_t n = (size_t)size * capacity;
+		minX.assign(n, 0.f); maxX.assign(n, 0.f); meanX.assign(n, 0.f);
+		minY.assign(n, 0.f); maxY.assign(n, 0.f); meanY.assign(n, 0.f);
+	}
+};
+
+typedef TripleBuffer<FullScopeCapture> FullScopeFrames;
 
 struct FullScope : Module {
 	enum ParamIds {
@@ -30,9 +87,27 @@ struct FullScope : Module {
 		NUM_OUTPUTS
 	};
 
-	float bufferX[BUFFER_SIZE] = {};
-	float bufferY[BUFFER_SIZE] = {};
+	// The engine fills frames->back() and publishes each finished capture for the display.
+	// Frames of a new length or channel count are allocated off the audio thread and handed
+	// over through pendingFrames; the engine swaps them in between captures and hands the old
+	// ones back through retiredFrames to be freed by the UI.
+	std::atomic<FullScopeFrames*> frames{nullptr};
+	std::atomic<FullScopeFrames*> pendingFrames{nullptr};
+	std::atomic<FullScopeFrames*> retiredFrames{nullptr};
+	// Set by the engine when a capture has more channels than the frames have room for
+	std::atomic<int> neededChannels{1};
+	int framesChannels = 1;
+	int bufferSize = DEFAULT_BUFFER_SIZE;
 	int bufferIndex = 0;
+	// Running bucket, per channel
+	float bucketMinX[SCOPE_CHANNELS], bucketMaxX[SCOPE_CHANNELS], bucketSumX[SCOPE_CHANNELS];
+	float bucketMinY[SCOPE_CHANNELS], bucketMaxY[SCOPE_CHANNELS], bucketSumY[SCOPE_CHANNELS];
+	// Channel 0's, for the stats
+	float bucketSquaresX = 0.f, bucketSquaresY = 0.f;
+	int bucketFrames = 0;
+	float samplesPerBucket = 1.f;
+	dsp::ClockDivider controlDivider;
+	int channelMask = ALL_CHANNELS_MASK;
 	float frameIndex = 0;
 	float width = RACK_GRID_WIDTH*17;
 
@@ -40,6 +115,9 @@ struct FullScope : Module {
 	dsp::SchmittTrigger extTrigger;
 	bool lissajous = true;
 	bool external = false;
+	bool persistence = false;
+	// Fraction of the persistence image faded out per UI frame
+	float persistenceDecay = 0.1f;
 	float lights[4] = {};
 	dsp::SchmittTrigger resetTrigger;
 
@@ -56,14 +134,66 @@ struct FullScope : Module {
 		configInput(COLOR_INPUT, "Color");
 		configInput(TIME_INPUT, "Time");
 		configInput(ROTATION_INPUT, "Rotation");
+		frames = createFrames(DEFAULT_BUFFER_SIZE, framesChannels);
+		controlDivider.setDivision(16);
+		resetBucket();
+		frames.load()->back().statsX.reset();
+		frames.load()->back().statsY.reset();
+	}
+
+	~FullScope() {
+		delete frames.load();
+		delete pendingFrames.load();
+		delete retiredFrames.load();
 	}
+
 	void process(const ProcessArgs &args) override;
+	void restartCapture();
+
+	void resetBucket() {
+		for (int c = 0; c < SCOPE_CHANNELS; c++) {
+			bucketMinX[c] = bucketMinY[c] = INFINITY;
+			bucketMaxX[c] = bucketMaxY[c] = -INFINITY;
+			bucketSumX[c] = bucketSumY[c] = 0.f;
+		}
+		bucketSquaresX = bucketSquaresY = 0.f;
+		bucketFrames = 0;
+	}
+
+	static FullScopeFrames *createFrames(int size, int channels) {
+		FullScopeFrames *f = new FullScopeFrames();
+		for (int i = 0; i < 3; i++)
+			f->slot(i).allocate(size, channels);
+		return f;
+	}
+
+	// Not on the audio thread. The new frames take effect at the start of the next capture.
+	void setBufferSize(int size) {
+		bufferSize = size;
+		delete retiredFrames.exchange(nullptr);
+		delete pendingFrames.exchange(createFrames(bufferSize, framesChannels));
+	}
+
+	// Not on the audio thread: frees frames the engine is done with, and grows the frames when
+	// the engine has seen more channels than they hold
+	void collectRetiredFrames() {
+		delete retiredFrames.exchange(nullptr);
+		int needed = neededChannels.load();
+		if (needed > framesChannels) {
+			framesChannels = needed;
+			setBufferSize(bufferSize);
+		}
+	}
 
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "lissajous", json_integer((int) lissajous));
 		json_object_set_new(rootJ, "external", json_integer((int) external));
 		json_object_set_new(rootJ, "width", json_real(width));
+		json_object_set_new(rootJ, "channelMask", json_integer(channelMask));
+		json_object_set_new(rootJ, "bufferSize", json_integer(bufferSize));
+		json_object_set_new(rootJ, "persistence", json_boolean(persistence));
+		json_object_set_new(rootJ, "persistenceDecay", json_real(persistenceDecay));
 		return rootJ;
 	}
 
@@ -79,11 +209,38 @@ struct FullScope : Module {
 		json_t *widthJ = json_object_get(rootJ, "width");
 		if (widthJ)
 			width = json_number_value(widthJ);
+
+		json_t *channelMaskJ = json_object_get(rootJ, "channelMask");
+		if (channelMaskJ)
+			channelMask = json_integer_value(channelMaskJ) & ALL_CHANNELS_MASK;
+
+		json_t *bufferSizeJ = json_object_get(rootJ, "bufferSize");
+		if (bufferSizeJ) {
+			int size = MIN_BUFFER_SIZE;
+			while (size < json_integer_value(bufferSizeJ) && size < MAX_BUFFER_SIZE)
+				size *= 2;
+			if (size != bufferSize)
+				setBufferSize(size);
+		}
+
+		json_t *persistenceJ = json_object_get(rootJ, "persistence");
+		if (persistenceJ)
+			persistence = json_is_true(persistenceJ);
+
+		json_t *persistenceDecayJ = json_object_get(rootJ, "persistenceDecay");
+		if (persistenceDecayJ)
+			persistenceDecay = clampfjw(json_number_value(persistenceDecayJ), 0.01, 1.0);
+	}
+
+	bool isChannelShown(int c) {
+		return (channelMask >> c) & 1;
 	}
 
 	void onReset() override {
 		lissajous = true;
 		external = false;
+		persistence = false;
+		channelMask = ALL_CHANNELS_MASK;
 	}
 };
 
@@ -97,26 +254,76 @@ void FullScope::process(const ProcessArgs &args) {
 	lights[2] = external ? 0.0 : 1.0;
 	lights[3] = external ? 1.0 : 0.0;
 
-	// Compute time
-	float deltaTime = powf(2.0, params[TIME_PARAM].getValue() + inputs[TIME_INPUT].getVoltage());
-	int frameCount = (int)ceilf(deltaTime * args.sampleRate);
+	FullScopeFrames *fr = frames.load(std::memory_order_relaxed);
+	FullScopeCapture &cap = fr->back();
+
+	// Compute time at control rate. Speed sets the time across DEFAULT_BUFFER_SIZE points
+	// whatever the capture length, so longer captures only add detail.
+	if (controlDivider.process()) {
+		float deltaTime = powf(2.0, params[TIME_PARAM].getValue() + inputs[TIME_INPUT].getVoltage());
+		samplesPerBucket = std::max(1.f, deltaTime * args.sampleRate * DEFAULT_BUFFER_SIZE / cap.size);
+	}
 
-	// Add frame to buffer
-	if (bufferIndex < BUFFER_SIZE) {
-		if (++frameIndex > frameCount) {
-			frameIndex = 0;
-			bufferX[bufferIndex] = inputs[X_INPUT].getVoltage();
-			bufferY[bufferIndex] = inputs[Y_INPUT].getVoltage();
+	// Accumulate every frame into the current bucket so no peak falls between points
+	if (bufferIndex < cap.size) {
+		int inX = inputs[X_INPUT].getChannels();
+		int inY = inputs[Y_INPUT].getChannels();
+		// A mono input is spread across every channel of the other one
+		int channels = std::max(inX, inY);
+		if (channels > cap.capacity) {
+			if (neededChannels.load(std::memory_order_relaxed) < channels)
+				neededChannels.store(channels);
+			channels = cap.capacity;
+		}
+		cap.channelsX = std::min(inX, channels);
+		cap.channelsY = std::min(inY, channels);
+		for (int c = 0; c < channels; c++) {
+			float x = inputs[X_INPUT].getPolyVoltage(c);
+			float y = inputs[Y_INPUT].getPolyVoltage(c);
+			bucketMinX[c] = std::min(bucketMinX[c], x);
+			bucketMaxX[c] = std::max(bucketMaxX[c], x);
+			bucketSumX[c] += x;
+			bucketMinY[c] = std::min(bucketMinY[c], y);
+			bucketMaxY[c] = std::max(bucketMaxY[c], y);
+			bucketSumY[c] += y;
+		}
+		if (channels > 0) {
+			float x = inputs[X_INPUT].getPolyVoltage(0);
+			float y = inputs[Y_INPUT].getPolyVoltage(0);
+			bucketSquaresX += x * x;
+			bucketSquaresY += y * y;
+		}
+		if (++bucketFrames >= samplesPerBucket) {
+			for (int c = 0; c < channels; c++) {
+				int i = c * cap.size + bufferIndex;
+				cap.minX[i] = bucketMinX[c];
+				cap.maxX[i] = bucketMaxX[c];
+				cap.meanX[i] = bucketSumX[c] / bucketFrames;
+				cap.minY[i] = bucketMinY[c];
+				cap.maxY[i] = bucketMaxY[c];
+				cap.meanY[i] = bucketSumY[c] / bucketFrames;
+			}
+			if (channels > 0) {
+				cap.statsX.add(cap.minX[bufferIndex], cap.maxX[bufferIndex], bucketSquaresX, bucketFrames);
+				cap.statsY.add(cap.minY[bufferIndex], cap.maxY[bufferIndex], bucketSquaresY, bucketFrames);
+			}
+			resetBucket();
 			bufferIndex++;
+
+			// Hand the finished capture to the display
+			if (bufferIndex >= cap.size) {
+				cap.statsX.finish();
+				cap.statsY.finish();
+				fr->publish();
+			}
 		}
 	}
 
 	// Are we waiting on the next trigger?
-	if (bufferIndex >= BUFFER_SIZE) {
+	if (bufferIndex >= cap.size) {
 		// Trigger immediately if external but nothing plugged in, or in Lissajous mode
 		if (lissajous || (external && !inputs[TRIG_INPUT].isConnected())) {
-			bufferIndex = 0;
-			frameIndex = 0;
+			restartCapture();
 			return;
 		}
 
@@ -133,46 +340,137 @@ void FullScope::process(const ProcessArgs &args) {
 		// Reset if triggered
 		float holdTime = 0.1;
 		if (resetTrigger.process(gate) || (frameIndex >= args.sampleRate * holdTime)) {
-			bufferIndex = 0; frameIndex = 0; return;
+			restartCapture(); return;
 		}
 
 		// Reset if we've waited too long
 		if (frameIndex >= args.sampleRate * holdTime) {
-			bufferIndex = 0; frameIndex = 0; return;
+			restartCapture(); return;
 		}
 	}
 }
 
+void FullScope::restartCapture() {
+	bufferIndex = 0;
+	frameIndex = 0;
+	resetBucket();
+	// Swap in new frames, but only once the UI has freed the last ones we retired
+	if (pendingFrames.load() && !retiredFrames.load()) {
+		retiredFrames.store(frames.load());
+		frames.store(pendingFrames.exchange(nullptr));
+	}
+	FullScopeCapture &cap = frames.load(std::memory_order_relaxed)->back();
+	cap.statsX.reset();
+	cap.statsY.reset();
+}
+
 struct FullScopeDisplay : LightWidget {
 	FullScope *module;
-	int frame = 0;
 	float rot = 0;
 	std::shared_ptr<Font> font;
-
-	struct Stats {
-		float vrms, vpp, vmin, vmax;
-		void calculate(float *values) {
-			vrms = 0.0;
-			vmax = -INFINITY;
-			vmin = INFINITY;
-			for (int i = 0; i < BUFFER_SIZE; i++) {
-				float v = values[i];
-				vrms += v*v;
-				vmax = fmaxf(vmax, v);
-				vmin = fminf(vmin, v);
-			}
-			vrms = sqrtf(vrms / BUFFER_SIZE);
-			vpp = vmax - vmin;
+	// Of the capture on screen, computed by the engine as it was recorded
+	FullScopeStats statsX, statsY;
+
+	// Visible traces decimated for drawing, packed trace-major with `points` values per trace.
+	// Time traces hold each pixel column's low and high; X/Y traces hold x and y.
+	struct PackedTraces {
+		std::vector<float> a, b;
+		// Input channel of each trace
+		int channel[SCOPE_CHANNELS];
+		int traces = 0;
+		int points = 0;
+	};
+	// Everything the packed traces were made from besides the capture itself
+	struct PackKey {
+		const FullScopeCapture *cap = NULL;
+		int size = 0;
+		int points = 0;
+		bool lissajous = false;
+		int channelsX = 0, channelsY = 0;
+		int channelMask = 0;
+		float gainX = 0.f, gainY = 0.f, offsetX = 0.f, offsetY = 0.f;
+
+		bool operator==(const PackKey &o) const {
+			return cap == o.cap && size == o.size && points == o.points && lissajous == o.lissajous
+				&& channelsX == o.channelsX && channelsY == o.channelsY && channelMask == o.channelMask
+				&& gainX == o.gainX && gainY == o.gainY && offsetX == o.offsetX && offsetY == o.offsetY;
 		}
 	};
-	Stats statsX, statsY;
+	// Repacked only when a capture arrives or the key changes, so a display waiting on a
+	// trigger or a slow sweep redraws from what it already has. X/Y figures go in packedY.
+	PackedTraces packedY, packedX;
+	PackKey packedKey;
+	bool packedValid = false;
+
+#ifndef METAMODULE
+	// Persistence image. Each capture is drawn into it once, it fades a little every frame,
+	// and the display just blits it, so a frame costs one quad unless a capture arrived.
+	NVGLUframebuffer *fb = NULL;
+	int fbWidth = 0;
+	int fbHeight = 0;
+#endif
 
 	FullScopeDisplay() {
 	}
 
-	void drawWaveform(const DrawArgs &args, float *valuesX, float *valuesY) {
-		if (!valuesX)
+#ifndef METAMODULE
+	~FullScopeDisplay() {
+		deleteFramebuffer();
+	}
+
+	void onContextDestroy(const ContextDestroyEvent &e) override {
+		deleteFramebuffer();
+		LightWidget::onContextDestroy(e);
+	}
+
+	void deleteFramebuffer() {
+		if (fb) {
+			nvgluDeleteFramebuffer(fb);
+			fb = NULL;
+		}
+	}
+#endif
+
+	void step() override {
+		if (module)
+			module->collectRetiredFrames();
+		LightWidget::step();
+	}
+
+	// Color of channel c out of channels. Channel 0 keeps the single-trace color; the rest are
+	// spread around the hue circle, or follow a polyphonic color input channel for channel.
+	NVGcolor traceColor(int c, int channels, NVGcolor first) {
+		Input &colorInput = module->inputs[FullScope::COLOR_INPUT];
+		if (colorInput.getChannels() > 1) {
+			float hue = rescalefjw(colorInput.getPolyVoltage(c), 0.0, 6.0, 0, 1.0);
+			return nvgHSLA(hue, 0.5, 0.5, 0xc0);
+		}
+		if (c == 0)
+			return first;
+		if (colorInput.isConnected()) {
+			float hue = rescalefjw(colorInput.getVoltage(), 0.0, 6.0, 0, 1.0);
+			return nvgHSLA(hue + (float)c / channels, 0.5, 0.5, 0xc0);
+		}
+		return nvgHSLA(0.575 + (float)c / channels, 0.9, 0.55, 0xc0);
+	}
+
+	static bool sameColor(const NVGcolor &a, const NVGcolor &b) {
+		return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+	}
+
+	// Strokes the packed traces. Scissor, transform and stroke state are set once for all
+	// traces, and neighbouring traces of the same color share one path, so a 16 voice patch
+	// costs little more than a mono one. Time traces zig-zag between each column's low and
+	// high so peaks narrower than a pixel still show.
+	void drawWaveforms(const DrawArgs &args, bool timeMode, const PackedTraces &packed, int channels, NVGcolor first) {
+		int traces = packed.traces;
+		int points = packed.points;
+		if (traces <= 0 || points < 2)
 			return;
+		// Colors follow the color input live, so they are not part of the packing
+		NVGcolor colors[SCOPE_CHANNELS];
+		for (int t = 0; t < traces; t++)
+			colors[t] = traceColor(packed.channel[t], channels, first);
 		nvgSave(args.vg);
 		Rect b = Rect(Vec(0, 0), box.size);
 		nvgScissor(args.vg, b.pos.x, b.pos.y, b.size.x, b.size.y);
@@ -186,91 +484,250 @@ struct FullScopeDisplay : LightWidget {
 			nvgRotate(args.vg, 0);
 		}
 
-		nvgBeginPath(args.vg);
-		// Draw maximum display left to right
-		for (int i = 0; i < BUFFER_SIZE; i++) {
-			float x, y;
-			if (valuesY) {
-				x = valuesX[i] / 2.0 + 0.5;
-				y = valuesY[i] / 2.0 + 0.5;
-			}
-			else {
-				x = (float)i / (BUFFER_SIZE - 1);
-				y = valuesX[i] / 2.0 + 0.5;
-			}
-			Vec p;
-			p.x = b.pos.x + b.size.x * x;
-			p.y = b.pos.y + b.size.y * (1.0 - y);
-			if (i == 0)
-				nvgMoveTo(args.vg, p.x, p.y);
-			else
-				nvgLineTo(args.vg, p.x, p.y);
-		}
 		nvgLineCap(args.vg, NVG_ROUND);
 		nvgMiterLimit(args.vg, 2.0);
 		nvgStrokeWidth(args.vg, 1.5);
 		nvgGlobalCompositeOperation(args.vg, NVG_LIGHTER);
-		nvgStroke(args.vg);
+
+		nvgBeginPath(args.vg);
+		for (int t = 0; t < traces; t++) {
+			const float *a = packed.a.data() + t * points;
+			const float *bv = packed.b.data() + t * points;
+			// Draw maximum display left to right
+			for (int i = 0; i < points; i++) {
+				if (timeMode) {
+					float x = b.pos.x + b.size.x * (float)i / (points - 1);
+					float lo = b.pos.y + b.size.y * (1.0 - (a[i] / 2.0 + 0.5));
+					float hi = b.pos.y + b.size.y * (1.0 - (bv[i] / 2.0 + 0.5));
+					if (i == 0)
+						nvgMoveTo(args.vg, x, lo);
+					else
+						nvgLineTo(args.vg, x, lo);
+					if (hi != lo)
+						nvgLineTo(args.vg, x, hi);
+				}
+				else {
+					float x = b.pos.x + b.size.x * (a[i] / 2.0 + 0.5);
+					float y = b.pos.y + b.size.y * (1.0 - (bv[i] / 2.0 + 0.5));
+					if (i == 0)
+						nvgMoveTo(args.vg, x, y);
+					else
+						nvgLineTo(args.vg, x, y);
+				}
+			}
+			bool last = t == traces - 1;
+			if (last || !sameColor(colors[t], colors[t + 1])) {
+				nvgStrokeColor(args.vg, colors[t]);
+				nvgStroke(args.vg);
+				if (!last)
+					nvgBeginPath(args.vg);
+			}
+		}
 		nvgResetScissor(args.vg);
 		nvgRestore(args.vg);
 	}
 
-	void drawLayer(const DrawArgs &args, int layer) override {
-		if(module == NULL) return;
-
-		if(layer == 1){
-
+	// Makes room for every channel at `points` values per trace
+	static void resizePacked(PackedTraces &out, int points) {
+		size_t needed = (size_t)points * SCOPE_CHANNELS;
+		if (out.a.size() < needed) {
+			out.a.resize(needed);
+			out.b.resize(needed);
+		}
+		out.points = points;
+		out.traces = 0;
+	}
 
-			float gainX = powf(2.0, roundf(module->params[FullScope::X_SCALE_PARAM].getValue()));
-			float gainY = powf(2.0, roundf(module->params[FullScope::Y_SCALE_PARAM].getValue()));
-			float offsetX = module->params[FullScope::X_POS_PARAM].getValue();
-			float offsetY = module->params[FullScope::Y_POS_PARAM].getValue();
-
-			float valuesX[BUFFER_SIZE];
-			float valuesY[BUFFER_SIZE];
-			for (int i = 0; i < BUFFER_SIZE; i++) {
-				int j = i;
-				// Lock display to buffer if buffer update deltaTime <= 2^-11
-				if (module->lissajous)
-					j = (i + module->bufferIndex) % BUFFER_SIZE;
-				valuesX[i] = (module->bufferX[j] + offsetX) * gainX / 10.0;
-				valuesY[i] = (module->bufferY[j] + offsetY) * gainY / 10.0;
+	// Packs the shown channels below channels, decimated to one column per pixel: the lowest
+	// min and highest max of the buckets under each column, with offset and gain applied.
+	void packTimeTraces(const FullScopeCapture &cap, int channels, bool useX, float gain, float offset, int points, PackedTraces &out) {
+		const std::vector<float> &mins = useX ? cap.minX : cap.minY;
+		const std::vector<float> &maxs = useX ? cap.maxX : cap.maxY;
+		resizePacked(out, points);
+		for (int c = 0; c < channels; c++) {
+			if (!module->isChannelShown(c))
+				continue;
+			const float *mn = mins.data() + c * cap.size;
+			const float *mx = maxs.data() + c * cap.size;
+			float *lo = out.a.data() + out.traces * points;
+			float *hi = out.b.data() + out.traces * points;
+			for (int i = 0; i < points; i++) {
+				int start = (int)((int64_t)i * cap.size / points);
+				int end = (int)((int64_t)(i + 1) * cap.size / points);
+				float vmin = mn[start], vmax = mx[start];
+				for (int j = start + 1; j < end; j++) {
+					vmin = fminf(vmin, mn[j]);
+					vmax = fmaxf(vmax, mx[j]);
+				}
+				lo[i] = (vmin + offset) * gain / 10.0;
+				hi[i] = (vmax + offset) * gain / 10.0;
 			}
+			out.channel[out.traces++] = c;
+		}
+	}
 
-			//color
-			if(module->inputs[FullScope::COLOR_INPUT].isConnected()){
-				float hue = rescalefjw(module->inputs[FullScope::COLOR_INPUT].getVoltage(), 0.0, 6.0, 0, 1.0);
-				nvgStrokeColor(args.vg, nvgHSLA(hue, 0.5, 0.5, 0xc0));
-			} else {
-				nvgStrokeColor(args.vg, nvgRGBA(25, 150, 252, 0xc0));
+	// Packs the shown channels as X/Y figures from the bucket means, averaging runs of buckets
+	// down to `points`
+	void packXYTraces(const FullScopeCapture &cap, int channels, const PackKey &key, PackedTraces &out) {
+		int points = key.points;
+		resizePacked(out, points);
+		for (int c = 0; c < channels; c++) {
+			if (!module->isChannelShown(c))
+				continue;
+			const float *mx = cap.meanX.data() + c * cap.size;
+			const float *my = cap.meanY.data() + c * cap.size;
+			float *vx = out.a.data() + out.traces * points;
+			float *vy = out.b.data() + out.traces * points;
+			for (int i = 0; i < points; i++) {
+				int start = (int)((int64_t)i * cap.size / points);
+				int end = (int)((int64_t)(i + 1) * cap.size / points);
+				float sumX = 0.f, sumY = 0.f;
+				for (int j = start; j < end; j++) {
+					sumX += mx[j];
+					sumY += my[j];
+				}
+				vx[i] = (sumX / (end - start) + key.offsetX) * key.gainX / 10.0;
+				vy[i] = (sumY / (end - start) + key.offsetY) * key.gainY / 10.0;
 			}
+			out.channel[out.traces++] = c;
+		}
+	}
 
-			// Draw waveforms
-			if (module->lissajous) {
-				// X x Y
-				if (module->inputs[FullScope::X_INPUT].isConnected() || module->inputs[FullScope::Y_INPUT].isConnected()) {
-					drawWaveform(args, valuesX, valuesY);
-				}
+	// fresh: cap has not been drawn before
+	void drawCapture(const DrawArgs &args, const FullScopeCapture &cap, bool fresh) {
+		PackKey key;
+		key.cap = &cap;
+		key.size = cap.size;
+		key.lissajous = module->lissajous;
+		// One point per pixel column is all a time trace can show. X/Y figures keep at least
+		// the default resolution since their points do not map to columns.
+		key.points = key.lissajous
+			? std::min(cap.size, std::max(DEFAULT_BUFFER_SIZE, 2 * (int)box.size.x))
+			: clampijw((int)box.size.x, 2, cap.size);
+		key.channelsX = module->inputs[FullScope::X_INPUT].isConnected() ? cap.channelsX : 0;
+		key.channelsY = module->inputs[FullScope::Y_INPUT].isConnected() ? cap.channelsY : 0;
+		key.channelMask = module->channelMask;
+		key.gainX = powf(2.0, roundf(module->params[FullScope::X_SCALE_PARAM].getValue()));
+		key.gainY = powf(2.0, roundf(module->params[FullScope::Y_SCALE_PARAM].getValue()));
+		key.offsetX = module->params[FullScope::X_POS_PARAM].getValue();
+		key.offsetY = module->params[FullScope::Y_POS_PARAM].getValue();
+
+		int channelsXY = std::max(key.channelsX, key.channelsY);
+		if (fresh || !packedValid || !(key == packedKey)) {
+			if (key.lissajous) {
+				if (channelsXY > 0)
+					packXYTraces(cap, channelsXY, key, packedY);
 			}
 			else {
-				// Y
-				if (module->inputs[FullScope::Y_INPUT].isConnected()) {
-					drawWaveform(args, valuesY, NULL);
-				}
+				if (key.channelsY > 0)
+					packTimeTraces(cap, key.channelsY, false, key.gainY, key.offsetY, key.points, packedY);
+				if (key.channelsX > 0)
+					packTimeTraces(cap, key.channelsX, true, key.gainX, key.offsetX, key.points, packedX);
+			}
+			packedKey = key;
+			packedValid = true;
+		}
 
-				// X
-				if (module->inputs[FullScope::X_INPUT].isConnected()) {
-					nvgStrokeColor(args.vg, nvgRGBA(0x28, 0xb0, 0xf3, 0xc0));
-					drawWaveform(args, valuesX, NULL);
-				}
+		//color
+		NVGcolor color;
+		if(module->inputs[FullScope::COLOR_INPUT].isConnected()){
+			float hue = rescalefjw(module->inputs[FullScope::COLOR_INPUT].getVoltage(), 0.0, 6.0, 0, 1.0);
+			color = nvgHSLA(hue, 0.5, 0.5, 0xc0);
+		} else {
+			color = nvgRGBA(25, 150, 252, 0xc0);
+		}
+
+		// Draw waveforms
+		if (key.lissajous) {
+			// X x Y
+			if (channelsXY > 0)
+				drawWaveforms(args, false, packedY, channelsXY, color);
+		}
+		else {
+			// Y
+			if (key.channelsY > 0)
+				drawWaveforms(args, true, packedY, key.channelsY, color);
+
+			// X
+			if (key.channelsX > 0)
+				drawWaveforms(args, true, packedX, key.channelsX, nvgRGBA(0x28, 0xb0, 0xf3, 0xc0));
+		}
+	}
+
+#ifndef METAMODULE
+	void drawPersistence(const DrawArgs &args, const FullScopeCapture &cap, bool fresh) {
+		float scale = getAbsoluteZoom() * APP->window->pixelRatio;
+		int width = (int)ceilf(box.size.x * scale);
+		int height = (int)ceilf(box.size.y * scale);
+		if (width <= 0 || height <= 0)
+			return;
+		bool created = false;
+		if (!fb || width != fbWidth || height != fbHeight) {
+			deleteFramebuffer();
+			fb = nvgluCreateFramebuffer(args.vg, width, height, 0);
+			if (!fb)
+				return;
+			fbWidth = width;
+			fbHeight = height;
+			created = true;
+		}
+
+		NVGcontext *fbVg = APP->window->fbVg;
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		nvgluBindFramebuffer(fb);
+		glViewport(0, 0, width, height);
+		glClearColor(0.0, 0.0, 0.0, 0.0);
+		glClear(created ? (GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT) : GL_STENCIL_BUFFER_BIT);
+		nvgBeginFrame(fbVg, box.size.x, box.size.y, scale);
+
+		// Fade what is already there toward transparent
+		nvgBeginPath(fbVg);
+		nvgRect(fbVg, 0, 0, box.size.x, box.size.y);
+		nvgGlobalCompositeOperation(fbVg, NVG_DESTINATION_OUT);
+		nvgFillColor(fbVg, nvgRGBAf(0, 0, 0, module->persistenceDecay));
+		nvgFill(fbVg);
+		nvgGlobalCompositeOperation(fbVg, NVG_SOURCE_OVER);
+
+		if (fresh || created) {
+			DrawArgs fbArgs = args;
+			fbArgs.vg = fbVg;
+			fbArgs.fb = fb;
+			drawCapture(fbArgs, cap, fresh);
+		}
+		nvgEndFrame(fbVg);
+		nvgluBindFramebuffer(args.fb);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+		nvgFillPaint(args.vg, nvgImagePattern(args.vg, 0, 0, box.size.x, box.size.y, 0, fb->image, 1.0));
+		nvgFill(args.vg);
+	}
+#endif
+
+	void drawLayer(const DrawArgs &args, int layer) override {
+		if(module == NULL) return;
+
+		if(layer == 1){
+			// Only whole captures are drawn, so the figure never tears mid-update
+			FullScopeFrames *fr = module->frames.load();
+			bool fresh = fr->update();
+			if (fresh) {
+				statsX = fr->front().statsX;
+				statsY = fr->front().statsY;
 			}
+			const FullScopeCapture &cap = fr->front();
 
-			// Calculate stats
-			if (++frame >= 4) {
-				frame = 0;
-				statsX.calculate(module->bufferX);
-				statsY.calculate(module->bufferY);
+#ifndef METAMODULE
+			if (module->persistence) {
+				drawPersistence(args, cap, fresh);
+				Widget::drawLayer(args, layer);
+				return;
 			}
+			deleteFramebuffer();
+#endif
+			drawCapture(args, cap, fresh);
 		}
 		Widget::drawLayer(args, layer);
 	}
@@ -363,6 +820,115 @@ struct FullScopeLissajousModeMenuItem : MenuItem {
 	}
 };
 
+struct FullScopeChannelItem : MenuItem {
+	FullScope *fullScope;
+	int channel;
+	void onAction(const event::Action &e) override {
+		fullScope->channelMask ^= 1 << channel;
+	}
+	void step() override {
+		rightText = CHECKMARK(fullScope->isChannelShown(channel));
+		MenuItem::step();
+	}
+};
+
+struct FullScopeAllChannelsItem : MenuItem {
+	FullScope *fullScope;
+	void onAction(const event::Action &e) override {
+		fullScope->channelMask = ALL_CHANNELS_MASK;
+	}
+	void step() override {
+		rightText = CHECKMARK(fullScope->channelMask == ALL_CHANNELS_MASK);
+		MenuItem::step();
+	}
+};
+
+struct FullScopeChannelsItem : MenuItem {
+	FullScope *fullScope;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		FullScopeAllChannelsItem *allItem = new FullScopeAllChannelsItem;
+		allItem->text = "All";
+		allItem->fullScope = fullScope;
+		menu->addChild(allItem);
+		for (int c = 0; c < SCOPE_CHANNELS; c++) {
+			FullScopeChannelItem *item = new FullScopeChannelItem;
+			item->text = string::f("Channel %d", c + 1);
+			item->fullScope = fullScope;
+			item->channel = c;
+			menu->addChild(item);
+		}
+		return menu;
+	}
+};
+
+struct FullScopeBufferSizeValueItem : MenuItem {
+	FullScope *fullScope;
+	int size;
+	void onAction(const event::Action &e) override {
+		fullScope->setBufferSize(size);
+	}
+	void step() override {
+		rightText = CHECKMARK(fullScope->bufferSize == size);
+		MenuItem::step();
+	}
+};
+
+struct FullScopeBufferSizeItem : MenuItem {
+	FullScope *fullScope;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		for (int size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size *= 2) {
+			FullScopeBufferSizeValueItem *item = new FullScopeBufferSizeValueItem;
+			item->text = string::f("%d points", size);
+			item->fullScope = fullScope;
+			item->size = size;
+			menu->addChild(item);
+		}
+		return menu;
+	}
+};
+
+struct FullScopePersistenceItem : MenuItem {
+	FullScope *fullScope;
+	void onAction(const event::Action &e) override {
+		fullScope->persistence = !fullScope->persistence;
+	}
+	void step() override {
+		rightText = CHECKMARK(fullScope->persistence);
+		MenuItem::step();
+	}
+};
+
+struct FullScopePersistenceDecayValueItem : MenuItem {
+	FullScope *fullScope;
+	float decay;
+	void onAction(const event::Action &e) override {
+		fullScope->persistenceDecay = decay;
+	}
+	void step() override {
+		rightText = CHECKMARK(fullScope->persistenceDecay == decay);
+		MenuItem::step();
+	}
+};
+
+struct FullScopePersistenceDecayItem : MenuItem {
+	FullScope *fullScope;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		// Below ~5% the 8-bit image can no longer fade its dimmest pixels out completely
+		float decays[] = {0.05f, 0.1f, 0.2f, 0.4f};
+		for (float decay : decays) {
+			FullScopePersistenceDecayValueItem *item = new FullScopePersistenceDecayValueItem;
+			item->text = string::f("%.0f%% per frame", decay * 100);
+			item->fullScope = fullScope;
+			item->decay = decay;
+			menu->addChild(item);
+		}
+		return menu;
+	}
+};
+
 void FullScopeWidget::appendContextMenu(Menu *menu) {
 	menu->addChild(new MenuSeparator());
 
@@ -373,6 +939,29 @@ void FullScopeWidget::appendContextMenu(Menu *menu) {
 	lissMenuItem->text = "Lissajous Mode";
 	lissMenuItem->fullScope = fullScope;
 	menu->addChild(lissMenuItem);
+
+	FullScopeChannelsItem *channelsItem = new FullScopeChannelsItem();
+	channelsItem->text = "Channels";
+	channelsItem->rightText = RIGHT_ARROW;
+	channelsItem->fullScope = fullScope;
+	menu->addChild(channelsItem);
+
+	FullScopeBufferSizeItem *sizeItem = new FullScopeBufferSizeItem();
+	sizeItem->text = "Buffer Length";
+	sizeItem->rightText = string::f("%d", fullScope->bufferSize) + " " + RIGHT_ARROW;
+	sizeItem->fullScope = fullScope;
+	menu->addChild(sizeItem);
+
+	FullScopePersistenceItem *persistenceItem = new FullScopePersistenceItem();
+	persistenceItem->text = "Persistence";
+	persistenceItem->fullScope = fullScope;
+	menu->addChild(persistenceItem);
+
+	FullScopePersistenceDecayItem *decayItem = new FullScopePersistenceDecayItem();
+	decayItem->text = "Persistence Decay";
+	decayItem->rightText = string::f("%.0f%%", fullScope->persistenceDecay * 100) + " " + RIGHT_ARROW;
+	decayItem->fullScope = fullScope;
+	menu->addChild(decayItem);
 }
 
 Model *modelFullScope = createModel<FullScope, FullScopeWidget>("FullScope");
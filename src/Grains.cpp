@@ -1,4 +1,9 @@
 #include "JWModules.hpp"
+#include "SamplePool.hpp"
+#include "SampleWorker.hpp"
+#include "SampleIndex.hpp"
+#include "WavWriter.hpp"
+#include "TripleBuffer.hpp"
 
 #include <string>
 #include <vector>
@@ -8,17 +13,73 @@
 #include <atomic>
 #include <cmath>
 #include <cstring>
-#include <dirent.h>
-#include <sys/stat.h>
-#ifdef _WIN32
-#include <windows.h>
-#endif
+#include <ctime>
 #include "osdialog.h"
 #include "system.hpp"
 #ifdef METAMODULE_BUILTIN
 #include "../../../metamodule-plugin-sdk/core-interface/filesystem/async_filebrowser.hh"
 #endif
 
+// Recording to disk: the ring covers the worker opening the file and disk stalls at up to
+// 192 kHz, and the buffer keeps a fixed-length preview of the take
+#define GRAINS_DISK_RING_FRAMES (2 * 192000)
+#define GRAINS_DISK_PREVIEW_SEC 60.0
+
+// UI thread or engine -> worker
+struct GrainsJob {
+	enum Type { NONE, LOAD_PATH, LOAD_RANDOM_SIBLING, REMOVE_SILENCE, NORMALIZE, DISPOSE, START_DISK_RECORDING, STOP_DISK_RECORDING, BUFFERS, SAVE_WAV };
+	Type type = NONE;
+	std::string path;
+	int sampleRate = 0;
+	// Edits: the buffers to work on and the engine generation they were taken from
+	// DISPOSE: audio the engine let go of, freed on the worker
+	// BUFFERS: the engine's buffers as they are now, kept by the worker for saving
+	SampleChannel left;
+	SampleChannel right;
+	float threshold = 0.f;
+	uint32_t generation = 0;
+	uint32_t ticket = 0; // SAVE_WAV: stored in savesDone once written
+};
+
+// UI thread -> engine, for edits that need the engine's current buffers
+struct GrainsCommand {
+	enum Type { NONE, REMOVE_SILENCE, NORMALIZE };
+	Type type = NONE;
+	float threshold = 0.f;
+};
+
+// Worker -> engine: decoded or edited audio ready to swap in
+struct GrainsLoad {
+	bool isEdit = false;
+	uint32_t generation = 0;
+	SampleChannel left;
+	SampleChannel right;
+	WaveOverview overviewL;
+	WaveOverview overviewR;
+	int sampleRate = 44100;
+	std::string path;
+};
+
+// Engine -> UI: everything the waveform display shows, so the UI never reads the buffers
+struct GrainsView {
+	static const int MAX_DOTS = 128;
+	WaveOverview left;
+	WaveOverview right;
+	int sampleRate = 44100;
+	bool recording = false;
+	double playPos = 0.0;
+	// Mean of the recording so far, taken off while it is drawn
+	double dcL = 0.0;
+	double dcR = 0.0;
+	char name[128] = "";
+	// Active grains: position in frames and the samples under it
+	int numDots = 0;
+	bool dotsStereo = false;
+	double dotPos[MAX_DOTS];
+	float dotL[MAX_DOTS];
+	float dotR[MAX_DOTS];
+};
+
 struct Grains : Module {
 	enum ParamIds {
 		GRAIN_SIZE_MS,
@@ -63,13 +124,18 @@ struct Grains : Module {
 		NUM_LIGHTS
 	};
 
-	// Sample data
+	// Sample data (file loads alias the shared sample pool; recordings and edits own their buffers)
 	std::string samplePath;
-	std::vector<float> sampleL;
-	std::vector<float> sampleR;
+	SampleChannel sampleL;
+	SampleChannel sampleR;
 	int fileSampleRate = 44100;
 	double playPos = 0.0; // fractional position in sample frames
+	// Written by the UI and worker threads; read it with getStatus()
 	std::string statusMsg = "Load WAV from context menu";
+	std::string lastFilePath; // folder source for random sibling loads, guarded by statusMutex
+	std::mutex statusMutex;
+	// Status from the audio thread; always a string literal, copied over in the widget step
+	std::atomic<const char*> engineStatus{nullptr};
 	float silenceThreshold = 0.02f;
 	bool embedInPatch = false;
 	bool bufferDirty = false;
@@ -82,8 +148,34 @@ struct Grains : Module {
 	dsp::SchmittTrigger clockTrig;
 	// Button param triggers processed in process()
 	dsp::SchmittTrigger randomBtnTrigger;
-	// UI-requested actions (executed on UI thread in widget step)
-	bool reqLoadRandomSibling = false;
+	// Disk I/O, decoding and edits run on the worker; the engine only swaps in ready buffers
+	SpscQueue<GrainsCommand, 8> uiCommands;
+	SpscQueue<GrainsJob, 8> uiJobs;
+	SpscQueue<GrainsJob, 16> engineJobs;
+	SpscQueue<GrainsLoad, 4> loadedSamples;
+	// Bumped whenever the engine buffers are replaced so stale edits are dropped
+	uint32_t bufferGeneration = 0;
+	// Optionally stream each recording to a WAV in the user folder. Only the first
+	// GRAINS_DISK_PREVIEW_SEC of a disk take is kept in the buffer for playback.
+	std::atomic<bool> recordToDisk{false};
+	WavStreamWriter diskWriter;
+	bool diskRecordRequested = false; // engine only
+	size_t diskPreviewFrames = 0; // engine only
+	std::string diskRecordingPath; // worker thread only
+	// Outlines of sampleL/sampleR, kept in step with them by the engine
+	WaveOverview overviewL;
+	WaveOverview overviewR;
+	TripleBuffer<GrainsView> views;
+	int viewCountdown = 0;
+	// The worker's copy of the buffers, written out by SAVE_WAV
+	SampleChannel savedL;
+	SampleChannel savedR;
+	int savedSampleRate = 44100;
+	// Whether there is anything for onSave to write
+	std::atomic<bool> hasAudio{false};
+	std::atomic<uint32_t> savesRequested{0};
+	std::atomic<uint32_t> savesDone{0};
+	SampleWorker worker;
 	// Live recording baseline tracking to minimize post-record visual shift
 	double recSumL = 0.0;
 	double recSumR = 0.0;
@@ -130,12 +222,30 @@ struct Grains : Module {
 
 	// Helpers
 	bool loadSampleFromPath(const std::string &path);
-	bool loadRandomSiblingSample();
-	bool removeSilence(float threshold);
+	void loadSampleAsync(const std::string &path);
+	bool pickRandomSiblingPath(const std::string &current, std::string &picked);
+	void removeSilence(float threshold);
 	// bool trimSilenceEdges(float threshold); // removed
 	// bool suppressSilence(float threshold); // removed
-	bool normalizeSample();
+	void normalizeSample();
+	void saveWavAsync(const std::string &path, bool wait);
 	bool saveBufferToWav(const std::string &path);
+	std::string getStatus();
+	void setStatus(const std::string &msg);
+	// Worker side
+	void workerStep();
+	void runJob(GrainsJob &job);
+	bool decodeSample(const std::string &path, GrainsLoad &out);
+	bool removeSilenceJob(GrainsJob &job, GrainsLoad &out);
+	bool normalizeJob(GrainsJob &job, GrainsLoad &out);
+	void startDiskRecording(int sampleRate);
+	void stopDiskRecording();
+	// Audio thread side
+	void applySample(GrainsLoad &load);
+	void sendBuffersToWorker();
+	void publishView();
+	void applyQueued();
+	void disposeBuffers();
 	// Base64 helpers for embedding samples in patch JSON
 	static std::string b64Encode(const uint8_t* data, size_t len);
 	static std::vector<uint8_t> b64Decode(const std::string& str);
@@ -176,6 +286,12 @@ struct Grains : Module {
 		configButton(RANDOM_BUTTON, "Random sample");
 		configSwitch(REC_SWITCH, 0.f, 1.f, 0.f, "Record");
 		grains.resize(128);
+		worker.start([this]() { workerStep(); });
+	}
+
+	~Grains() {
+		worker.stop();
+		diskWriter.close();
 	}
 
 	void process(const ProcessArgs &args) override;
@@ -191,6 +307,7 @@ struct Grains : Module {
 		json_object_set_new(rootJ, "playPos", json_real(playPos));
 		json_object_set_new(rootJ, "normalPlayback", json_boolean(normalPlayback));
 		json_object_set_new(rootJ, "syncGrains", json_boolean(syncGrains));
+		json_object_set_new(rootJ, "recordToDisk", json_boolean(recordToDisk));
 
 		return rootJ;
 	}
@@ -207,7 +324,7 @@ struct Grains : Module {
 		if (pathJ && json_is_string(pathJ)) {
 			samplePath = json_string_value(pathJ);
 			if (!loadSampleFromPath(samplePath)) {
-				statusMsg = "Unsupported or unreadable WAV";
+				setStatus("Unsupported or unreadable WAV");
 			}
 			else if (savedPlayPos >= 0.0) {
 				// Clamp to loaded buffer length
@@ -225,15 +342,25 @@ struct Grains : Module {
 		if (autoAdvJ && json_is_boolean(autoAdvJ)) autoAdvance = json_boolean_value(autoAdvJ);
 		if (normalJ && json_is_boolean(normalJ)) normalPlayback = json_boolean_value(normalJ);
 		if (syncJ && json_is_boolean(syncJ)) syncGrains = json_boolean_value(syncJ);
+		json_t *recordToDiskJ = json_object_get(rootJ, "recordToDisk");
+		if (recordToDiskJ && json_is_boolean(recordToDiskJ)) recordToDisk = json_boolean_value(recordToDiskJ);
 	}
 
 
 	void onReset() override {
 		sampleL.clear();
 		sampleR.clear();
+		overviewL.clear();
+		overviewR.clear();
+		sendBuffersToWorker();
 		samplePath.clear();
 		playPos = 0.0;
-		statusMsg = "Load WAV from context menu";
+		bufferGeneration++;
+		{
+			std::lock_guard<std::mutex> lock(statusMutex);
+			lastFilePath.clear();
+		}
+		setStatus("Load WAV from context menu");
 		for (auto &g : grains) g.active = false;
 		spawnAccum = 0.0;
 	}
@@ -280,10 +407,13 @@ std::vector<uint8_t> Grains::b64Decode(const std::string& str) {
 // STEP
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void Grains::process(const ProcessArgs &args) {
-	// Handle button params via triggers; defer heavy I/O to UI via flags
+	// Swap in anything the worker has finished since the last sample
+	applyQueued();
+	// Handle button params via triggers; the folder scan and decode run on the worker
 	if (randomBtnTrigger.process(params[RANDOM_BUTTON].getValue())) {
-		// Request UI to perform random sibling load (avoids blocking audio thread)
-		reqLoadRandomSibling = true;
+		GrainsJob job;
+		job.type = GrainsJob::LOAD_RANDOM_SIBLING;
+		engineJobs.push(std::move(job));
 	}
 	// Handle recording toggle and capture first
 	bool recOn = params[REC_SWITCH].getValue() > 0.5f
@@ -296,8 +426,7 @@ void Grains::process(const ProcessArgs &args) {
 		playTransHold = (int)std::round(0.01 * args.sampleRate); // ~10ms hold at 0
 		playTransAtkRemain = 0;
 		isRecording = true;
-		sampleL.clear();
-		sampleR.clear();
+		disposeBuffers();
 		fileSampleRate = (int)args.sampleRate;
 		samplePath.clear();
 				// Reset DC blocker state to avoid pops when switching to monitor
@@ -306,15 +435,27 @@ void Grains::process(const ProcessArgs &args) {
 		recSumL = 0.0; recSumR = 0.0; recCount = 0;
 		// Pre-reserve buffer to minimize reallocations during recording (reduces pops)
 		{
-			size_t reserveFrames = (size_t)std::max(1.0, std::round(args.sampleRate * 60.0)); // ~60s
+			size_t reserveFrames = (size_t)std::max(1.0, std::round(args.sampleRate * GRAINS_DISK_PREVIEW_SEC)); // ~60s
 			sampleL.reserve(reserveFrames);
 			sampleR.reserve(reserveFrames);
+			diskPreviewFrames = reserveFrames;
 		}
 		playPos = 0.0;
 		for (auto &g : grains) g.active = false;
 		spawnAccum = 0.0;
 		bufferDirty = false;
-		statusMsg = "Recording...";
+		engineStatus = "Recording...";
+		// The take starts here; frames wait in the writer's ring until the worker has the file open
+		diskRecordRequested = recordToDisk && diskWriter.start();
+		if (diskRecordRequested) {
+			GrainsJob job;
+			job.type = GrainsJob::START_DISK_RECORDING;
+			job.sampleRate = (int)args.sampleRate;
+			engineJobs.push(std::move(job));
+		}
+		else if (recordToDisk) {
+			engineStatus = "Disk recorder not ready, recording to memory";
+		}
 	}
 	else if (!recOn && isRecording) {
 		// Stop recording
@@ -325,6 +466,13 @@ void Grains::process(const ProcessArgs &args) {
 		playTransAtkRemain = 0;
 		isRecording = false;
 		bufferDirty = true;
+		if (diskRecordRequested) {
+			diskRecordRequested = false;
+			diskWriter.stop();
+			GrainsJob job;
+			job.type = GrainsJob::STOP_DISK_RECORDING;
+			engineJobs.push(std::move(job));
+		}
 		for (auto &g : grains) g.active = false;
 		spawnAccum = 0.0;
 		// Remove DC bias from recorded buffers and align playhead to a near zero-cross
@@ -334,7 +482,11 @@ void Grains::process(const ProcessArgs &args) {
 				double sumL = 0.0, sumR = 0.0; size_t N = sampleL.size();
 				for (size_t i = 0; i < N; ++i) { sumL += sampleL[i]; sumR += sampleR[i]; }
 				double meanL = sumL / (double)N; double meanR = sumR / (double)N;
-				for (size_t i = 0; i < N; ++i) { sampleL[i] = (float)(sampleL[i] - meanL); sampleR[i] = (float)(sampleR[i] - meanR); }
+				std::vector<float> &recL = sampleL.edit();
+				std::vector<float> &recR = sampleR.edit();
+				for (size_t i = 0; i < N; ++i) { recL[i] = (float)(recL[i] - meanL); recR[i] = (float)(recR[i] - meanR); }
+				overviewL.offset((float)-meanL);
+				overviewR.offset((float)-meanR);
 				// Find a zero-cross near the start to avoid an initial pop
 				int bestIdx = 0; float bestAbs = std::abs(sampleL[0]);
 				int scan = std::min<int>(2048, (int)N - 1);
@@ -355,7 +507,8 @@ void Grains::process(const ProcessArgs &args) {
 		}
 		// Reset DC blocker state to avoid pops when switching to playback
 		dcYL = dcYR = 0.f; dcPrevXL = dcPrevXR = 0.f;
-		statusMsg = "Recording stopped";
+		sendBuffersToWorker();
+		engineStatus = "Recording stopped";
 	}
 
 	if (isRecording && inputs[REC_INPUT].isConnected()) {
@@ -363,14 +516,31 @@ void Grains::process(const ProcessArgs &args) {
 		float v = inputs[REC_INPUT].getVoltage();
 		// Normalize from ±5V to ±1. If users send ±10V, the clamp still protects.
 		float s = std::max(-1.f, std::min(1.f, v / 5.f));
-		sampleL.push_back(s);
-		sampleR.push_back(s);
+		if (!diskRecordRequested) {
+			sampleL.push_back(s);
+			sampleR.push_back(s);
+			overviewL.add(s);
+			overviewR.add(s);
+		}
+		else {
+			diskWriter.push(&s);
+			// Within the reservation, so the preview never reallocates
+			if (sampleL.size() < diskPreviewFrames) {
+				sampleL.push_back(s);
+				sampleR.push_back(s);
+				overviewL.add(s);
+				overviewR.add(s);
+				if (sampleL.size() == diskPreviewFrames) engineStatus = "Recording to disk, preview buffer full";
+			}
+		}
 		// Update live baseline trackers
 		recSumL += (double)s;
 		recSumR += (double)s;
 		recCount++;
 	}
 
+	if (--viewCountdown <= 0) publishView();
+
 	// During recording, monitor switch enables direct REC_INPUT passthrough.
 	// If monitor is off, continue into granular processing of the recording buffer.
 	if (isRecording) {
@@ -739,354 +909,362 @@ void Grains::process(const ProcessArgs &args) {
 	lights[REC_LIGHT].setBrightness(isRecording ? 1.0f : 0.0f);
 };
 
-// Minimal WAV loader: supports PCM16 and Float32, mono/stereo (mixed to mono)
-static uint32_t readU32(FILE *in) {
-	uint8_t b[4];
-	if (fread(b, 1, 4, in) != 4) return 0;
-	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
-}
-static uint16_t readU16(FILE *in) {
-	uint8_t b[2];
-	if (fread(b, 1, 2, in) != 2) return 0;
-	return (uint16_t)b[0] | ((uint16_t)b[1] << 8);
+static std::string baseName(const std::string &path) {
+	size_t p = path.find_last_of("/\\");
+	return (p == std::string::npos) ? path : path.substr(p + 1);
 }
 
-static void writeU32(FILE *out, uint32_t v) {
-	char b[4];
-	b[0] = (char)(v & 0xFF);
-	b[1] = (char)((v >> 8) & 0xFF);
-	b[2] = (char)((v >> 16) & 0xFF);
-	b[3] = (char)((v >> 24) & 0xFF);
-	fwrite(b, 1, 4, out);
+std::string Grains::getStatus() {
+	std::lock_guard<std::mutex> lock(statusMutex);
+	return statusMsg;
 }
-static void writeU16(FILE *out, uint16_t v) {
-	char b[2];
-	b[0] = (char)(v & 0xFF);
-	b[1] = (char)((v >> 8) & 0xFF);
-	fwrite(b, 1, 2, out);
+
+void Grains::setStatus(const std::string &msg) {
+	std::lock_guard<std::mutex> lock(statusMutex);
+	statusMsg = msg;
 }
 
+// Synchronous load for patch restore (dataFromJson/onAdd), where the engine is not running this module
 bool Grains::loadSampleFromPath(const std::string &path) {
-	FILE *in = fopen(path.c_str(), "rb");
-	if (!in) { statusMsg = "Could not open file"; return false; }
+	GrainsLoad load;
+	if (!decodeSample(path, load)) return false;
+	applySample(load);
+	return true;
+}
 
-	char riff[4];
-	if (fread(riff, 1, 4, in) != 4 || std::string(riff, 4) != "RIFF") {
-		statusMsg = "Not a WAV/RIFF file";
-		fclose(in);
-		return false;
-	}
-	(void)readU32(in); // file size
-	char wave[4];
-	if (fread(wave, 1, 4, in) != 4 || std::string(wave, 4) != "WAVE") {
-		statusMsg = "Missing WAVE header";
-		fclose(in);
-		return false;
-	}
+// UI thread: decode on the worker and swap in on the audio thread
+void Grains::loadSampleAsync(const std::string &path) {
+	GrainsJob job;
+	job.type = GrainsJob::LOAD_PATH;
+	job.path = path;
+	if (uiJobs.push(std::move(job))) worker.wake();
+}
 
-	// Read chunks
-	uint16_t audioFormat = 1; // 1=PCM, 3=FLOAT
-	uint16_t numChannels = 1;
-	uint32_t sRate = 44100;
-	uint16_t bitsPerSample = 16;
-	uint32_t dataSize = 0;
-	long dataPos = 0;
-	long fileSize = 0;
-	fseek(in, 0, SEEK_END);
-	fileSize = ftell(in);
-	fseek(in, 12, SEEK_SET); // position after RIFF/size/WAVE
-
-	// Safely parse chunks - avoid infinite loops on malformed files
-	while (ftell(in) + 8 <= fileSize) {  // Need at least 8 bytes for id + size
-		char id[4];
-		if (fread(id, 1, 4, in) != 4) break;
-		uint32_t chunkSize = readU32(in);
-		
-		// Safety check: chunk size shouldn't be more than remaining file
-		long currentPos = ftell(in);
-		if (currentPos + (long)chunkSize > fileSize) {
-			// Malformed chunk, stop parsing
-			break;
-		}
-		
-		std::string cid(id, 4);
-		if (cid == "fmt ") {
-			long start = ftell(in);
-			audioFormat = readU16(in);
-			numChannels = readU16(in);
-			sRate = readU32(in);
-			(void)readU32(in); // byteRate
-			(void)readU16(in); // blockAlign
-			bitsPerSample = readU16(in);
-			// Skip any extra fmt bytes
-			fseek(in, start + (long)chunkSize, SEEK_SET);
-		}
-		else if (cid == "data") {
-			dataPos = ftell(in);
-			dataSize = chunkSize;
-			fseek(in, dataPos + (long)dataSize, SEEK_SET);
-		}
-		else {
-			// Skip unknown chunk - seek to next chunk
-			fseek(in, currentPos + (long)chunkSize, SEEK_SET);
-		}
-	}
+// Edits go through the engine so the worker gets a consistent handle on the current buffers
+void Grains::removeSilence(float threshold) {
+	GrainsCommand cmd;
+	cmd.type = GrainsCommand::REMOVE_SILENCE;
+	cmd.threshold = threshold;
+	uiCommands.push(std::move(cmd));
+}
 
-	if (dataSize == 0 || dataPos == 0) {
-		statusMsg = "No data chunk";
-		fclose(in);
-		return false;
-	}
-	// Load samples
-	fseek(in, dataPos, SEEK_SET);
-	std::vector<float> left;
-	std::vector<float> right;
-	left.reserve(dataSize / (bitsPerSample / 8));
-	right.reserve(dataSize / (bitsPerSample / 8));
-	if (audioFormat == 1 && bitsPerSample == 16) {
-		// PCM16
-		const size_t frames = dataSize / (numChannels * 2);
-		for (size_t i = 0; i < frames; ++i) {
-			if (numChannels == 1) {
-				int16_t s16 = (int16_t)readU16(in);
-				float v = (float)s16 / 32768.f;
-				left.push_back(v);
-				right.push_back(v);
-			} else {
-				int16_t l16 = (int16_t)readU16(in);
-				int16_t r16 = (int16_t)readU16(in);
-				float vl = (float)l16 / 32768.f;
-				float vr = (float)r16 / 32768.f;
-				left.push_back(vl);
-				right.push_back(vr);
-				// Skip extra channels if >2
-				for (int ch = 2; ch < (int)numChannels; ++ch) {
-					(void)readU16(in);
-				}
-			}
-		}
-	}
-	else if (audioFormat == 1 && bitsPerSample == 24) {
-		// PCM24
-		const size_t frames = dataSize / (numChannels * 3);
-		for (size_t i = 0; i < frames; ++i) {
-			auto read24 = [&in]() {
-				uint8_t b[3];
-				fread(b, 1, 3, in);
-				int32_t v = (int32_t)(b[0] | (b[1] << 8) | (b[2] << 16));
-				if (v & 0x800000) v |= 0xFF000000; // sign-extend
-				return (float)v / 8388608.f;
-			};
-			if (numChannels == 1) {
-				float v = read24();
-				left.push_back(v);
-				right.push_back(v);
-			} else {
-				float vl = read24();
-				float vr = read24();
-				left.push_back(vl);
-				right.push_back(vr);
-				for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read24(); }
-			}
-		}
-	}
-	else if (audioFormat == 1 && bitsPerSample == 32) {
-		// PCM32 int
-		const size_t frames = dataSize / (numChannels * 4);
-		for (size_t i = 0; i < frames; ++i) {
-			auto read32 = [&in]() {
-				uint32_t u = readU32(in);
-				int32_t s = (int32_t)u;
-				return (float)s / 2147483648.f;
-			};
-			if (numChannels == 1) {
-				float v = read32();
-				left.push_back(v);
-				right.push_back(v);
-			} else {
-				float vl = read32();
-				float vr = read32();
-				left.push_back(vl);
-				right.push_back(vr);
-				for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read32(); }
-			}
-		}
-	}
-	else if (audioFormat == 3 && bitsPerSample == 32) {
-		// Float32
-		const size_t frames = dataSize / (numChannels * 4);
-		for (size_t i = 0; i < frames; ++i) {
-			auto readf = [&in]() {
-				float sf;
-				fread(&sf, 1, 4, in);
-				return sf;
-			};
-			if (numChannels == 1) {
-				float v = readf();
-				left.push_back(v);
-				right.push_back(v);
-			} else {
-				float vl = readf();
-				float vr = readf();
-				left.push_back(vl);
-				right.push_back(vr);
-				for (int ch = 2; ch < (int)numChannels; ++ch) { (void)readf(); }
-			}
-		}
-	}
-	else {
-		statusMsg = "Unsupported WAV format";
-		return false; // unsupported format
-	}
+// Normalize buffers by peak amplitude across both channels
+void Grains::normalizeSample() {
+	GrainsCommand cmd;
+	cmd.type = GrainsCommand::NORMALIZE;
+	uiCommands.push(std::move(cmd));
+}
 
-	fclose(in);
-	if (left.empty()) { statusMsg = "No audio frames"; return false; }
-	// Normalize softly to avoid clipping
-	float maxAbs = 0.f;
-	for (float v : left) maxAbs = std::max(maxAbs, std::abs(v));
-	for (float v : right) maxAbs = std::max(maxAbs, std::abs(v));
-	if (maxAbs > 0.f) {
-		float gain = 1.f / maxAbs;
-		for (float &v : left) v *= gain;
-		for (float &v : right) v *= gain;
-	}
+////////////////////////////////////////////// WORKER THREAD //////////////////////////////////////////////
 
-	sampleL = std::move(left);
-	sampleR = std::move(right);
-	fileSampleRate = (int)sRate;
-	samplePath = path;
-	playPos = 0.0;
-    // Reset grains to avoid referencing old positions after a load
-    for (auto &g : grains) g.active = false;
-    spawnAccum = 0.0;
-	bufferDirty = false;
-	// Status
-	std::string base = path;
-	{
-		size_t p = base.find_last_of("/\\");
-		if (p != std::string::npos) base = base.substr(p + 1);
-	}
-	statusMsg = "Loaded: " + base;
-	return true;
+void Grains::workerStep() {
+	random::init(); // the RNG is thread-local; no-op once seeded
+	// The engine can only start a disk take once the ring exists
+	if (recordToDisk && !diskWriter.isPrepared()) diskWriter.prepare(1, GRAINS_DISK_RING_FRAMES);
+	GrainsJob job;
+	// Engine jobs first, so a save sees the buffers the engine sent before the UI asked
+	while (engineJobs.pop(job)) runJob(job);
+	while (uiJobs.pop(job)) runJob(job);
 }
 
-// Remove frames where both channels are below a threshold (absolute amplitude)
+void Grains::runJob(GrainsJob &job) {
+	GrainsLoad load;
+	bool ok = false;
+	switch (job.type) {
+		case GrainsJob::LOAD_PATH: {
+			ok = decodeSample(job.path, load);
+		} break;
+		case GrainsJob::LOAD_RANDOM_SIBLING: {
+			std::string current, picked;
+			{
+				std::lock_guard<std::mutex> lock(statusMutex);
+				current = lastFilePath;
+			}
+			ok = pickRandomSiblingPath(current, picked) && decodeSample(picked, load);
+		} break;
+		case GrainsJob::REMOVE_SILENCE: {
+			ok = removeSilenceJob(job, load);
+		} break;
+		case GrainsJob::NORMALIZE: {
+			ok = normalizeJob(job, load);
+		} break;
+		case GrainsJob::START_DISK_RECORDING: {
+			startDiskRecording(job.sampleRate);
+		} break;
+		case GrainsJob::STOP_DISK_RECORDING: {
+			stopDiskRecording();
+		} break;
+		case GrainsJob::BUFFERS: {
+			// The copy this replaces is released here
+			savedL = std::move(job.left);
+			savedR = std::move(job.right);
+			savedSampleRate = job.sampleRate;
+		} break;
+		case GrainsJob::SAVE_WAV: {
+			saveBufferToWav(job.path);
+			if (job.ticket) savesDone = job.ticket;
+		} break;
+		default: break;
+	}
+	// Release whatever the job held (including DISPOSE buffers) here rather than on the audio thread
+	job.left.clear();
+	job.right.clear();
+	if (ok && !loadedSamples.push(std::move(load))) setStatus("Busy, try again");
+}
 
+// Decoded audio is shared with any other instance that has the same file loaded
+bool Grains::decodeSample(const std::string &path, GrainsLoad &out) {
+	std::string error;
+	std::shared_ptr<const SampleBuffer> buf = SamplePool::instance().acquire(path, SamplePool::STEREO, &error);
+	if (!buf) { setStatus(error); return false; }
+	out.left = SampleChannel(buf, false);
+	out.right = SampleChannel(buf, true);
+	out.overviewL.build(out.left);
+	out.overviewR.build(out.right);
+	out.sampleRate = buf->sampleRate;
+	out.path = path;
+	std::lock_guard<std::mutex> lock(statusMutex);
+	lastFilePath = path;
+	statusMsg = "Loaded: " + baseName(path);
+	return true;
+}
 
 // Remove frames across the entire sample where both channels are below threshold
-bool Grains::removeSilence(float threshold) {
-	if (sampleL.empty()) { statusMsg = "No sample loaded"; return false; }
+bool Grains::removeSilenceJob(GrainsJob &job, GrainsLoad &out) {
+	const SampleChannel &sampleL = job.left;
+	const SampleChannel &sampleR = job.right;
+	if (sampleL.empty()) { setStatus("No sample loaded"); return false; }
 	// Remove low-amplitude frames across the entire sample
 	std::vector<float> newL; newL.reserve(sampleL.size());
 	std::vector<float> newR; newR.reserve(sampleR.size());
 	for (size_t i = 0; i < sampleL.size(); ++i) {
 		float vl = std::abs(sampleL[i]);
 		float vr = (i < sampleR.size()) ? std::abs(sampleR[i]) : vl;
-		if (vl >= threshold || vr >= threshold) {
+		if (vl >= job.threshold || vr >= job.threshold) {
 			newL.push_back(sampleL[i]);
 			newR.push_back((i < sampleR.size()) ? sampleR[i] : sampleL[i]);
 		}
 	}
 	if (newL.empty()) {
 		// Keep at least one zero sample to avoid edge cases
-		sampleL.assign(1, 0.f);
-		sampleR.assign(1, 0.f);
-		statusMsg = "All silence removed";
+		out.left.assign(1, 0.f);
+		out.right.assign(1, 0.f);
+		setStatus("All silence removed");
 	} else {
-		sampleL = std::move(newL);
-		sampleR = std::move(newR);
-		statusMsg = "Silence removed";
-	}
-	// Reset playback/grains after destructive edit
-	playPos = 0.0;
-	for (auto &g : grains) g.active = false;
-	spawnAccum = 0.0;
-	// If embedding in patch, clear file path so next save re-embeds updated buffers
-	if (embedInPatch) {
-		samplePath.clear();
+		out.left = std::move(newL);
+		out.right = std::move(newR);
+		setStatus("Silence removed");
 	}
-	bufferDirty = true;
+	out.overviewL.build(out.left);
+	out.overviewR.build(out.right);
+	out.isEdit = true;
+	out.generation = job.generation;
 	return true;
-	isRecording = false;
 }
 
-// Zero out frames below threshold across entire sample to preserve length/pitch
-
-
-// Normalize buffers by peak amplitude across both channels
-bool Grains::normalizeSample() {
-	if (sampleL.empty()) { statusMsg = "No sample loaded"; return false; }
+bool Grains::normalizeJob(GrainsJob &job, GrainsLoad &out) {
+	if (job.left.empty()) { setStatus("No sample loaded"); return false; }
 	float maxAbs = 0.f;
-	for (float v : sampleL) maxAbs = std::max(maxAbs, std::abs(v));
-	for (float v : sampleR) maxAbs = std::max(maxAbs, std::abs(v));
-	if (maxAbs <= 0.f) { statusMsg = "Already flat"; return false; }
+	for (size_t i = 0; i < job.left.size(); ++i) maxAbs = std::max(maxAbs, std::abs(job.left[i]));
+	for (size_t i = 0; i < job.right.size(); ++i) maxAbs = std::max(maxAbs, std::abs(job.right[i]));
+	if (maxAbs <= 0.f) { setStatus("Already flat"); return false; }
 	float gain = 1.f / maxAbs;
-	for (float &v : sampleL) v *= gain;
-	for (float &v : sampleR) v *= gain;
-	statusMsg = "Normalized";
-	// Reset playback/grains after destructive edit
+	// Detaches from the shared pool copy before scaling
+	out.left = std::move(job.left);
+	out.right = std::move(job.right);
+	for (float &v : out.left.edit()) v *= gain;
+	for (float &v : out.right.edit()) v *= gain;
+	out.overviewL.build(out.left);
+	out.overviewR.build(out.right);
+	setStatus("Normalized");
+	out.isEdit = true;
+	out.generation = job.generation;
+	return true;
+}
+
+// The engine has already started the take; this gives it a file
+void Grains::startDiskRecording(int sampleRate) {
+	std::string dir = asset::user("JW-Modules/Grains Recordings");
+	system::createDirectories(dir);
+	char name[64];
+	time_t now = time(nullptr);
+	strftime(name, sizeof(name), "grains_%Y%m%d_%H%M%S.wav", localtime(&now));
+	std::string path = system::join(dir, name);
+	std::string error;
+	// Mono float: the recorder feeds the same signal to both channels
+	if (!diskWriter.open(path, sampleRate, WavFile::FLOAT32, &error)) {
+		diskWriter.close();
+		setStatus(error);
+		return;
+	}
+	diskRecordingPath = path;
+	setStatus("Recording to disk: " + baseName(path));
+}
+
+void Grains::stopDiskRecording() {
+	// Also ends a take whose file could not be opened
+	bool ok = diskWriter.close();
+	if (diskRecordingPath.empty()) return;
+	uint64_t dropped = diskWriter.droppedFrames();
+	std::string msg = ok ? "Saved: " + baseName(diskRecordingPath) : std::string("Write error");
+	if (ok && dropped > 0) msg += string::f(" (%llu frames dropped)", (unsigned long long)dropped);
+	setStatus(msg);
+	diskRecordingPath.clear();
+}
+
+////////////////////////////////////////////// AUDIO THREAD //////////////////////////////////////////////
+
+// Swaps the load's buffers in; the previous buffers are left in load for the caller to dispose
+void Grains::applySample(GrainsLoad &load) {
+	std::swap(sampleL, load.left);
+	std::swap(sampleR, load.right);
+	std::swap(overviewL, load.overviewL);
+	std::swap(overviewR, load.overviewR);
+	bufferGeneration++;
 	playPos = 0.0;
+	// Reset grains to avoid referencing old positions after a load or destructive edit
 	for (auto &g : grains) g.active = false;
 	spawnAccum = 0.0;
-	if (embedInPatch) samplePath.clear();
-	bufferDirty = true;
-	return true;
+	if (load.isEdit) {
+		// If embedding in patch, clear file path so next save re-embeds updated buffers
+		if (embedInPatch) samplePath.clear();
+		bufferDirty = true;
+	}
+	else {
+		fileSampleRate = load.sampleRate;
+		std::swap(samplePath, load.path);
+		bufferDirty = false;
+	}
+	sendBuffersToWorker();
+}
+
+// Engine, or the UI thread while the engine is locked (patch load, reset). The copies only
+// bump reference counts.
+void Grains::sendBuffersToWorker() {
+	hasAudio = !sampleL.empty();
+	GrainsJob job;
+	job.type = GrainsJob::BUFFERS;
+	job.left = sampleL;
+	job.right = sampleR;
+	job.sampleRate = fileSampleRate;
+	engineJobs.push(std::move(job));
+}
+
+void Grains::publishView() {
+	viewCountdown = 512;
+	GrainsView &view = views.back();
+	view.left = overviewL;
+	view.right = overviewR;
+	view.sampleRate = fileSampleRate;
+	view.recording = isRecording;
+	view.playPos = playPos;
+	view.dcL = recCount > 0 ? recSumL / (double)recCount : 0.0;
+	view.dcR = recCount > 0 ? recSumR / (double)recCount : 0.0;
+	const char *name = isRecording ? "recording" : "patch storage";
+	if (!samplePath.empty()) {
+		size_t p = samplePath.find_last_of("/\\");
+		name = samplePath.c_str() + (p == std::string::npos ? 0 : p + 1);
+	}
+	snprintf(view.name, sizeof(view.name), "%s", name);
+	// The samples under each grain, interpolated like the grains read them
+	const size_t NL = sampleL.size();
+	view.dotsStereo = sampleR.size() == NL;
+	view.numDots = 0;
+	for (const auto &g : grains) {
+		if (!g.active || view.numDots >= GrainsView::MAX_DOTS) continue;
+		int i0 = (int)g.pos;
+		if (i0 < 0 || i0 >= (int)NL) continue;
+		int i1 = std::min(i0 + 1, (int)NL - 1);
+		double frac = g.pos - (double)i0;
+		int k = view.numDots++;
+		view.dotPos[k] = g.pos;
+		view.dotL[k] = (float)((1.0 - frac) * (double)sampleL[i0] + frac * (double)sampleL[i1]);
+		view.dotR[k] = view.dotsStereo ? (float)((1.0 - frac) * (double)sampleR[i0] + frac * (double)sampleR[i1]) : 0.f;
+	}
+	views.publish();
+}
+
+void Grains::applyQueued() {
+	GrainsCommand cmd;
+	while (uiCommands.pop(cmd)) {
+		if (isRecording) continue;
+		// Copies of the channels only bump reference counts
+		GrainsJob job;
+		job.type = (cmd.type == GrainsCommand::NORMALIZE) ? GrainsJob::NORMALIZE : GrainsJob::REMOVE_SILENCE;
+		job.left = sampleL;
+		job.right = sampleR;
+		job.threshold = cmd.threshold;
+		job.generation = bufferGeneration;
+		engineJobs.push(std::move(job));
+	}
+	GrainsLoad load;
+	while (loadedSamples.pop(load)) {
+		// Drop edits of buffers that were replaced or recorded over while the worker ran
+		if (!isRecording && !(load.isEdit && load.generation != bufferGeneration)) applySample(load);
+		// Either the previous buffers or the dropped ones; freed on the worker
+		GrainsJob job;
+		job.type = GrainsJob::DISPOSE;
+		job.left = std::move(load.left);
+		job.right = std::move(load.right);
+		std::swap(job.path, load.path);
+		engineJobs.push(std::move(job));
+	}
 }
 
-// Save current buffer to a stereo PCM16 WAV file
+// Hand the current buffers to the worker to free, leaving the module empty
+void Grains::disposeBuffers() {
+	GrainsJob job;
+	job.type = GrainsJob::DISPOSE;
+	job.left = std::move(sampleL);
+	job.right = std::move(sampleR);
+	std::swap(job.path, samplePath);
+	engineJobs.push(std::move(job)); // if full, job is released here as a last resort
+	bufferGeneration++;
+	overviewL.clear();
+	overviewR.clear();
+	sendBuffersToWorker();
+}
+
+// UI thread: the worker writes the file from its copy of the buffers
+void Grains::saveWavAsync(const std::string &path, bool wait) {
+	GrainsJob job;
+	job.type = GrainsJob::SAVE_WAV;
+	job.path = path;
+	job.ticket = ++savesRequested;
+	uint32_t ticket = job.ticket;
+	if (!uiJobs.push(std::move(job))) { setStatus("Busy, try again"); return; }
+	worker.wake();
+	for (int ms = 0; wait && ms < 10000 && savesDone.load() != ticket; ++ms) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Worker thread: save the buffers to a stereo PCM16 WAV file
 bool Grains::saveBufferToWav(const std::string &path) {
-	if (sampleL.empty()) { statusMsg = "No sample loaded"; return false; }
+	const SampleChannel &sampleL = savedL;
+	const SampleChannel &sampleR = savedR;
+	if (sampleL.empty()) { setStatus("No sample loaded"); return false; }
 	size_t frames = std::min(sampleL.size(), sampleR.size());
-	if (frames == 0) { statusMsg = "No audio frames"; return false; }
-	uint16_t numChannels = 2;
-	uint16_t bitsPerSample = 16;
-	uint32_t sRate = (fileSampleRate > 0) ? (uint32_t)fileSampleRate : 44100u;
-	uint16_t bytesPerSample = bitsPerSample / 8; // 2
-	uint16_t blockAlign = numChannels * bytesPerSample; // 4
-	uint32_t byteRate = sRate * blockAlign;
-	uint32_t dataSize = (uint32_t)(frames * blockAlign);
-
-	FILE *out = fopen(path.c_str(), "wb");
-	if (!out) { statusMsg = "Could not write file"; return false; }
-
-	// RIFF header
-	fwrite("RIFF", 1, 4, out);
-	writeU32(out, 36u + dataSize); // file size minus 8
-	fwrite("WAVE", 1, 4, out);
-	// fmt chunk
-	fwrite("fmt ", 1, 4, out);
-	writeU32(out, 16u); // PCM fmt chunk size
-	writeU16(out, 1u); // PCM
-	writeU16(out, numChannels);
-	writeU32(out, sRate);
-	writeU32(out, byteRate);
-	writeU16(out, blockAlign);
-	writeU16(out, bitsPerSample);
-	// data chunk
-	fwrite("data", 1, 4, out);
-	writeU32(out, dataSize);
-	// samples
-	for (size_t i = 0; i < frames; ++i) {
-		float fl = std::max(-1.f, std::min(1.f, sampleL[i]));
-		float fr = std::max(-1.f, std::min(1.f, sampleR[i]));
-		int sl = (int)std::lround(fl * 32767.0f);
-		int sr = (int)std::lround(fr * 32767.0f);
-		if (sl < -32768) sl = -32768; if (sl > 32767) sl = 32767;
-		if (sr < -32768) sr = -32768; if (sr > 32767) sr = 32767;
-		writeU16(out, (uint16_t)(uint16_t)(sl & 0xFFFF));
-		writeU16(out, (uint16_t)(uint16_t)(sr & 0xFFFF));
+	if (frames == 0) { setStatus("No audio frames"); return false; }
+	WavFile out;
+	std::string error;
+	if (!out.open(path, 2, (savedSampleRate > 0) ? savedSampleRate : 44100, WavFile::PCM16, &error)) {
+		setStatus(error);
+		return false;
 	}
-	int ok = fflush(out) == 0 && ferror(out) == 0;
-	fclose(out);
-	if (ok) {
-		// Update status
-		std::string base = path;
-		size_t p = base.find_last_of("/\\");
-		if (p != std::string::npos) base = base.substr(p + 1);
-		statusMsg = "Saved: " + base;
-	} else {
-		statusMsg = "Write error";
+	// Interleave a chunk at a time; WavFile batches the disk writes
+	float chunk[2 * 1024];
+	for (size_t i = 0; i < frames;) {
+		size_t n = std::min(frames - i, (size_t)1024);
+		for (size_t k = 0; k < n; ++k) {
+			chunk[2 * k] = sampleL[i + k];
+			chunk[2 * k + 1] = sampleR[i + k];
+		}
+		out.write(chunk, n);
+		i += n;
 	}
+	bool ok = out.close();
+	setStatus(ok ? "Saved: " + baseName(path) : "Write error");
 	return ok;
 }
 
@@ -1105,6 +1283,8 @@ void Grains::onAdd(const AddEvent& e) {
 			if (loadSampleFromPath(path)) {
 				// Avoid persisting the absolute path of patch-storage audio in JSON
 				samplePath.clear();
+				std::lock_guard<std::mutex> lock(statusMutex);
+				lastFilePath.clear();
 				if (pendingPlayPos >= 0.0) {
 					double maxPos = (!sampleL.empty()) ? (double)sampleL.size() - 1.0 : 0.0;
 					playPos = std::min(std::max(0.0, pendingPlayPos), maxPos);
@@ -1115,100 +1295,32 @@ void Grains::onAdd(const AddEvent& e) {
 	restoreFromPatchStorageOnAdd = false;
 }
 
-// Save current buffer as WAV into the patch storage directory
+// Save current buffer as WAV into the patch storage directory. The patch is archived as soon
+// as this returns, so wait for the worker to write it.
 void Grains::onSave(const SaveEvent& e) {
 	Module::onSave(e);
-	if (!sampleL.empty()) {
+	if (hasAudio) {
 		std::string dir = createPatchStorageDirectory();
 		if (!dir.empty()) {
 			std::string path = rack::system::join(dir, "recording.wav");
-			saveBufferToWav(path);
+			saveWavAsync(path, true);
 		}
 	}
 }
 
-// Load a random .wav from the same directory as the current samplePath
-bool Grains::loadRandomSiblingSample() {
-	if (samplePath.empty()) { statusMsg = "No current file"; return false; }
+// Pick a random .wav from the same directory as the current file (worker thread)
+bool Grains::pickRandomSiblingPath(const std::string &current, std::string &picked) {
+	if (current.empty()) { setStatus("No current file"); return false; }
 	// Determine directory from current path (handle both '/' and '\\')
-	std::string dir;
-	{
-		size_t p = samplePath.find_last_of("/\\");
-		if (p == std::string::npos) { statusMsg = "Folder not found"; return false; }
-		dir = samplePath.substr(0, p);
-	}
-	std::vector<std::string> wavs;
-#ifdef _WIN32
-	// Build pattern: dir\\*.wav
-	std::string pattern = dir;
-	if (!pattern.empty()) {
-		char last = pattern.back();
-		if (last != '/' && last != '\\') pattern += '\\';
-	}
-	pattern += "*.wav";
-	WIN32_FIND_DATAA ffd;
-	HANDLE hFind = FindFirstFileA(pattern.c_str(), &ffd);
-	if (hFind == INVALID_HANDLE_VALUE) {
-		statusMsg = "No WAVs in folder";
-		return false;
-	}
-	do {
-		if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
-		std::string name = ffd.cFileName;
-		// Full path
-		std::string full = dir;
-		char last = full.empty() ? '\\' : full.back();
-		if (last != '/' && last != '\\') full += '\\';
-		full += name;
-		wavs.push_back(full);
-	} while (FindNextFileA(hFind, &ffd));
-	FindClose(hFind);
-#else
-	DIR *dp = opendir(dir.c_str());
-	if (!dp) { statusMsg = "Folder not found"; return false; }
-	struct dirent *de;
-	while ((de = readdir(dp)) != nullptr) {
-		// d_name is a fixed array in dirent; only check leading '.'
-		if (de->d_name[0] == '.') continue;
-		std::string name = de->d_name;
-		// Build full path
-		std::string full = dir + "/" + name;
-		// Check if regular file when d_type is unknown
-		bool isFile = false;
-#ifdef DT_REG
-		if (de->d_type == DT_REG) isFile = true;
-		else
-#endif
-		{
-			struct stat st; if (stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) isFile = true;
-		}
-		if (!isFile) continue;
-		// Check extension case-insensitive
-		size_t dot = name.find_last_of('.');
-		if (dot != std::string::npos) {
-			std::string ext = name.substr(dot);
-			std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-			if (ext == ".wav") wavs.push_back(full);
-		}
-	}
-	closedir(dp);
-#endif
-	if (wavs.empty()) { statusMsg = "No WAVs in folder"; return false; }
-	// Pick random index; try to avoid reloading the same file
-	size_t idx = (size_t) std::floor(random::uniform() * wavs.size());
-	if (wavs.size() > 1) {
-		// Extract current filename (handle both separators)
-		size_t p = samplePath.find_last_of("/\\");
-		std::string curName = (p == std::string::npos) ? samplePath : samplePath.substr(p + 1);
-		int guard = 8;
-		while (guard-- > 0) {
-			size_t q = wavs[idx].find_last_of("/\\");
-			std::string pickName = (q == std::string::npos) ? wavs[idx] : wavs[idx].substr(q + 1);
-			if (pickName != curName) break;
-			idx = (size_t) std::floor(random::uniform() * wavs.size());
-		}
-	}
-	return loadSampleFromPath(wavs[idx]);
+	size_t p = current.find_last_of("/\\");
+	if (p == std::string::npos) { setStatus("Folder not found"); return false; }
+	std::shared_ptr<const SampleDirIndex> index = SampleIndex::instance().get(current.substr(0, p));
+	if (!index) { setStatus("Folder not found"); return false; }
+	// Try to avoid reloading the same file
+	const SampleIndexEntry *entry = SampleIndex::instance().pickRandom(index, 0.f, current);
+	if (!entry) { setStatus("No WAVs in folder"); return false; }
+	picked = entry->path;
+	return true;
 }
 
 // Waveform display
@@ -1223,18 +1335,26 @@ struct GrainsWaveformDisplay : TransparentWidget {
 	bool prevRec = false; // kept for potential future use
 	double dcMeanL = 0.0;
 	double dcMeanR = 0.0;
+	// The engine's latest view; the sample buffers themselves belong to the audio thread
+	const GrainsView &view() const {
+		return module->views.front();
+	}
+	void step() override {
+		if (module) module->views.update();
+		TransparentWidget::step();
+	}
 	// Compute once per recording session to avoid baseline drift
 	void setPosFromX(float x) {
-		if (!module || module->sampleL.empty()) return;
+		if (!module || view().left.frames == 0) return;
 		float w = box.size.x;
 		if (w <= 0.f) return;
 		if (x < 0.f) x = 0.f; if (x > w) x = w;
 		// Map drag across the full visible buffer (excluding guard during recording)
-		int fs = module->fileSampleRate > 0 ? module->fileSampleRate : 44100;
+		int fs = view().sampleRate > 0 ? view().sampleRate : 44100;
 		int guard = std::max(1, (int)std::round(0.01 * (double)fs));
-		double Nfull = (double)module->sampleL.size();
+		double Nfull = (double)view().left.frames;
 		double Ndraw = Nfull;
-		if (module->isRecording && Nfull > (double)guard) Ndraw = Nfull - (double)guard;
+		if (view().recording && Nfull > (double)guard) Ndraw = Nfull - (double)guard;
 		double denom = std::max(1.0, Ndraw - 1.0);
 		module->playPos = (double)x / (double)w * denom;
 	}
@@ -1253,8 +1373,8 @@ struct GrainsWaveformDisplay : TransparentWidget {
 			else if (e.action == GLFW_RELEASE) {
 				dragging = false;
 				// Update the knob to match the dragged position so it sticks
-				if (module && !module->sampleL.empty()) {
-					double Nfull = (double)module->sampleL.size();
+				if (module && view().left.frames > 0) {
+					double Nfull = (double)view().left.frames;
 					double f = Nfull > 1.0 ? module->playPos / (Nfull - 1.0) : 0.0;
 					f = std::max(0.0, std::min(1.0, f));
 					module->params[Grains::POSITION_KNOB].setValue((float)f);
@@ -1265,7 +1385,7 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		}
 	}
 	void onDragMove(const event::DragMove &e) override {
-		if (!dragging || !module || module->sampleL.empty()) return;
+		if (!dragging || !module || view().left.frames == 0) return;
 		
 		float w = box.size.x;
 		if (w <= 0.f) return;
@@ -1280,11 +1400,11 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		float currentLocalX = (mouseSceneX - dragWidgetLeftX) / zoom;
 		
 		// Map pixel to sample WITHOUT clamping pixels first
-		int fs = module->fileSampleRate > 0 ? module->fileSampleRate : 44100;
+		int fs = view().sampleRate > 0 ? view().sampleRate : 44100;
 		int guard = std::max(1, (int)std::round(0.01 * (double)fs));
-		double Nfull = (double)module->sampleL.size();
+		double Nfull = (double)view().left.frames;
 		double Ndraw = Nfull;
-		if (module->isRecording && Nfull > (double)guard) Ndraw = Nfull - (double)guard;
+		if (view().recording && Nfull > (double)guard) Ndraw = Nfull - (double)guard;
 		double denom = std::max(1.0, Ndraw - 1.0);
 		
 		// Map pixel to sample
@@ -1308,7 +1428,7 @@ struct GrainsWaveformDisplay : TransparentWidget {
 				std::string ext = path.substr(path.length() - 4);
 				std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 				if (ext == ".wav") {
-					module->loadSampleFromPath(path);
+					module->loadSampleAsync(path);
 					e.consume(this);
 					return;
 				}
@@ -1331,56 +1451,48 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		nvgStrokeWidth(vg, 1.f);
 		nvgStroke(vg);
 
-		if (!module || module->sampleL.empty()) {
+		if (!module || view().left.frames == 0) {
 			// Placeholder text
 			nvgFontSize(vg, 16.f);
 			nvgTextAlign(vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
 			nvgFillColor(vg, nvgRGBA(200, 200, 200, 180));
-			nvgText(vg, w * 0.5f, h * 0.5f, module ? module->statusMsg.c_str() : "", NULL);
+			nvgText(vg, w * 0.5f, h * 0.5f, module ? module->getStatus().c_str() : "", NULL);
 			return;
 		}
+		const GrainsView &v = view();
 		// Waveform
 		// Determine lengths; in recording, exclude tail-guard and draw the full visible buffer
-		size_t NLfull = module->sampleL.size();
-		int fs = module->fileSampleRate > 0 ? module->fileSampleRate : 44100;
+		size_t NLfull = v.left.frames;
+		int fs = v.sampleRate > 0 ? v.sampleRate : 44100;
 		int guard = std::max(1, (int)std::round(0.01 * (double)fs)); // ~10ms
 		size_t NLdraw = NLfull;
-		if (module->isRecording && NLfull > (size_t)guard) NLdraw = NLfull - (size_t)guard;
+		if (v.recording && NLfull > (size_t)guard) NLdraw = NLfull - (size_t)guard;
 		// Full segment indices
 		size_t winStart = 0;
 		size_t winEnd = NLdraw;
 
-		// Compute DC baseline from live accumulators during recording (cheap, stable)
-		if (module->isRecording) {
-			if (module->recCount > 0) {
-				dcMeanL = module->recSumL / (double)module->recCount;
-				dcMeanR = module->recSumR / (double)module->recCount;
-			}
+		// DC baseline from the engine's live accumulators during recording (cheap, stable)
+		if (v.recording) {
+			dcMeanL = v.dcL;
+			dcMeanR = v.dcR;
 		}
 		else {
 			dcMeanL = 0.0; dcMeanR = 0.0;
 		}
 
-		// Left channel (bucketed min/max per pixel with clamping) over window
+		// Left channel (min/max per pixel from the outline, with clamping) over window
 		nvgBeginPath(vg);
 		nvgStrokeColor(vg, nvgRGB(25, 150, 252));
 		nvgStrokeWidth(vg, 1.5f);
 		const size_t NL = NLdraw;
 		const size_t wpxL = (size_t)std::max(1.0f, std::floor(w));
-		const size_t bucketL = std::max<size_t>(1, (size_t)std::floor((double)NL / (double)std::max<size_t>(1, wpxL)));
 		for (size_t xpix = 0; xpix < wpxL; ++xpix) {
 			size_t i0 = (size_t)std::floor((double)xpix * (double)NL / (double)wpxL);
-			if (i0 >= NL) i0 = NL - 1;
-			size_t iEnd = std::min(NL, i0 + bucketL);
-			float minV = 1.f, maxV = -1.f;
-			for (size_t i = i0; i < iEnd; ++i) {
-				float v = module->sampleL[winStart + i];
-				if (module->isRecording) v -= (float)dcMeanL;
-				// Clamp to display range symmetrically
-				if (v < -1.f) v = -1.f; if (v > 1.f) v = 1.f;
-				minV = std::min(minV, v);
-				maxV = std::max(maxV, v);
-			}
+			size_t iEnd = (size_t)std::floor((double)(xpix + 1) * (double)NL / (double)wpxL);
+			float minV, maxV;
+			v.left.range(winStart + i0, winStart + iEnd, minV, maxV);
+			minV -= (float)dcMeanL;
+			maxV -= (float)dcMeanL;
 			minV = std::max(-1.f, std::min(1.f, minV));
 			maxV = std::max(-1.f, std::min(1.f, maxV));
 			if (maxV - minV < 1e-6f) { maxV += 0.01f; minV -= 0.01f; }
@@ -1394,26 +1506,16 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		nvgBeginPath(vg);
 		nvgStrokeColor(vg, nvgRGB(25, 150, 252));
 		nvgStrokeWidth(vg, 1.0f);
-		const size_t NRfull = module->sampleR.size();
+		const size_t NRfull = v.right.frames;
 		size_t NR = (winEnd <= NRfull) ? NLdraw : std::min(NLdraw, NRfull);
-		// Use stable DC baseline for R during recording
 		const size_t wpxR = (size_t)std::max(1.0f, std::floor(w));
-		const size_t bucketR = std::max<size_t>(1, (size_t)std::floor((double)NR / (double)std::max<size_t>(1, wpxR)));
-		for (size_t xpix = 0; xpix < wpxR; ++xpix) {
+		for (size_t xpix = 0; NR > 0 && xpix < wpxR; ++xpix) {
 			size_t i0 = (size_t)std::floor((double)xpix * (double)NR / (double)wpxR);
-			if (i0 >= NR) i0 = NR - 1;
-			size_t iEnd = std::min(NR, i0 + bucketR);
-			float minV = 1.f, maxV = -1.f;
-			for (size_t i = i0; i < iEnd; ++i) {
-				size_t idx = winStart + i;
-				if (idx >= NRfull) idx = NRfull - 1;
-				float v = module->sampleR[idx];
-				if (module->isRecording) v -= (float)dcMeanR;
-				// Clamp to display range symmetrically
-				if (v < -1.f) v = -1.f; if (v > 1.f) v = 1.f;
-				minV = std::min(minV, v);
-				maxV = std::max(maxV, v);
-			}
+			size_t iEnd = (size_t)std::floor((double)(xpix + 1) * (double)NR / (double)wpxR);
+			float minV, maxV;
+			v.right.range(winStart + i0, winStart + iEnd, minV, maxV);
+			minV -= (float)dcMeanR;
+			maxV -= (float)dcMeanR;
 			minV = std::max(-1.f, std::min(1.f, minV));
 			maxV = std::max(-1.f, std::min(1.f, maxV));
 			if (maxV - minV < 1e-6f) { maxV += 0.01f; minV -= 0.01f; }
@@ -1427,7 +1529,7 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		// Playback position line (mapped within the full visible buffer)
 		nvgBeginPath(vg);
 		double denom = (NLdraw >= 2) ? ((double)NLdraw - 1.0) : 1.0;
-		double clampedPos = (double)module->playPos;
+		double clampedPos = v.playPos;
 		if (clampedPos < (double)winStart) clampedPos = (double)winStart;
 		if (clampedPos > (double)(winEnd - 1)) clampedPos = (double)(winEnd - 1);
 		double rel = (NLdraw > 1) ? ((clampedPos - (double)winStart) / denom) : 0.0;
@@ -1439,7 +1541,7 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		nvgStrokeWidth(vg, 2.0f);
 		nvgStroke(vg);
 		// Indicate the hidden tail-guard during recording so the end doesn't look chopped
-		if (module->isRecording && NLfull > (size_t)guard) {
+		if (v.recording && NLfull > (size_t)guard) {
 			// Shade a fraction of the right edge proportional to guard/total length
 			double guardFrac = (double)guard / (double)NLfull;
 			float shadeW = (float)(guardFrac * (double)w);
@@ -1451,60 +1553,42 @@ struct GrainsWaveformDisplay : TransparentWidget {
 		}
 
 		// Grain dots overlay (cloud of dots); show during recording too so grains are visible
-		if (module && !module->normalPlayback) {
-			bool recording = module->isRecording;
+		if (!module->normalPlayback) {
+			bool recording = v.recording;
 			// Use full buffer for overlay mapping to align with display
-			const size_t NL = module->sampleL.size();
-			const size_t NR = module->sampleR.size();
-			if (NL > 0) {
-				for (const auto &g : module->grains) {
-					if (!g.active) continue;
-					// X from grain position
-					float gx = (float)(g.pos / (double)NL * w);
-					if (gx < 0.f || gx > w) continue;
-					// Y from current sample value (map like waveform)
-					int i0 = (int)g.pos;
-					int i1 = std::min(i0 + 1, (int)NL - 1);
-		                if (i0 < 0 || i0 >= (int)NL) continue;
-					double frac = g.pos - (double)i0;
-					double sL = (1.0 - frac) * (double)module->sampleL[i0] + frac * (double)module->sampleL[i1];
-					float gyL = h * (0.5f - 0.45f * (float)sL);
-					// Draw left dot (white)
+			const size_t NL = v.left.frames;
+			for (int k = 0; k < v.numDots; ++k) {
+				// X from grain position
+				float gx = (float)(v.dotPos[k] / (double)NL * w);
+				if (gx < 0.f || gx > w) continue;
+				// Y from the sample under the grain (map like waveform)
+				float gyL = h * (0.5f - 0.45f * v.dotL[k]);
+				// Draw left dot (white)
+				nvgBeginPath(vg);
+				nvgCircle(vg, gx, gyL, 3.0f);
+				nvgFillColor(vg, recording ? nvgRGBA(255, 255, 255, 180) : nvgRGBA(255, 255, 255, 220));
+				nvgFill(vg);
+				// Draw right dot (white) if R exists
+				if (v.dotsStereo) {
+					float gyR = h * (0.5f - 0.45f * v.dotR[k]);
 					nvgBeginPath(vg);
-					nvgCircle(vg, gx, gyL, 3.0f);
+					nvgCircle(vg, gx, gyR, 3.0f);
 					nvgFillColor(vg, recording ? nvgRGBA(255, 255, 255, 180) : nvgRGBA(255, 255, 255, 220));
 					nvgFill(vg);
-					// Draw right dot (white) if R exists
-					if (NR == NL) {
-						int j1 = std::min(i0 + 1, (int)NR - 1);
-						double sR = (1.0 - frac) * (double)module->sampleR[i0] + frac * (double)module->sampleR[j1];
-						float gyR = h * (0.5f - 0.45f * (float)sR);
-						nvgBeginPath(vg);
-						nvgCircle(vg, gx, gyR, 3.0f);
-						nvgFillColor(vg, recording ? nvgRGBA(255, 255, 255, 180) : nvgRGBA(255, 255, 255, 220));
-						nvgFill(vg);
-					}
 				}
 			}
 		}
 
 		// Info overlay: sample name, frames, length
 		{
-			// Compute name
-			std::string name;
-			if (module->samplePath.empty()) {
-				name = module->isRecording ? "recording" : "patch storage";
-			} else {
-				name = module->samplePath;
-				size_t p = name.find_last_of("/\\");
-				if (p != std::string::npos) name = name.substr(p + 1);
-			}
-			size_t frames = module->sampleL.size();
-			double secs = (module->fileSampleRate > 0) ? (double)frames / (double)module->fileSampleRate : 0.0;
+			// File name, or where the audio came from
+			const char *name = v.name;
+			size_t frames = v.left.frames;
+			double secs = (v.sampleRate > 0) ? (double)frames / (double)v.sampleRate : 0.0;
 			double mb = (double)(frames * 2ull * sizeof(float)) / 1048576.0;
 			char buf[256];
 			snprintf(buf, sizeof(buf), "%s  |  %.2f s @ %d Hz  |  %.2f MB",
-				name.c_str(), secs, module->fileSampleRate, mb);
+				name, secs, v.sampleRate, mb);
 			// Draw at bottom-left
 			nvgFontSize(vg, 12.f);
 			nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
@@ -1594,7 +1678,7 @@ static void loadWavPath(Grains *grains, char *path) {
         if (path) {
                 std::string p = path;
                 free(path);
-                grains->loadSampleFromPath(p);
+                grains->loadSampleAsync(p);
         }
 }
 static void saveWavPath(Grains *grains, char *path) {
@@ -1604,7 +1688,7 @@ static void saveWavPath(Grains *grains, char *path) {
 		// Ensure .wav extension
 		auto hasExt = [](const std::string &s){ if (s.size() < 4) return false; std::string ext = s.substr(s.size()-4); std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower); return ext == ".wav"; };
 		if (!hasExt(p)) p += ".wav";
-		grains->saveBufferToWav(p);
+		grains->saveWavAsync(p, false);
 	}
 }
 
@@ -1612,6 +1696,7 @@ void GrainsWidget::appendContextMenu(Menu *menu) {
 	menu->addChild(new MenuSeparator());
 
 	Grains *grains = dynamic_cast<Grains*>(module);
+	menu->addChild(new SamplePoolMemoryLabel());
 	struct NormalPlaybackItem : MenuItem {
 		Grains *grains;
 		void onAction(const event::Action &e) override { if (grains) grains->normalPlayback = !grains->normalPlayback; }
@@ -1736,18 +1821,25 @@ void GrainsWidget::appendContextMenu(Menu *menu) {
 	save->text = "Save Buffer as WAV...";
 	save->grains = grains;
 	menu->addChild(save);
+
+	struct RecordToDiskItem : MenuItem {
+		Grains *grains;
+		void onAction(const event::Action &e) override { if (grains) grains->recordToDisk = !grains->recordToDisk; }
+		void step() override { rightText = (grains && grains->recordToDisk) ? "✔" : ""; MenuItem::step(); }
+	};
+	RecordToDiskItem *recDisk = new RecordToDiskItem();
+	recDisk->text = "Also Record to Disk (user folder)";
+	recDisk->grains = grains;
+	menu->addChild(recDisk);
 }
 
 void GrainsWidget::step() {
     ModuleWidget::step();
     Grains *m = dynamic_cast<Grains*>(module);
     if (!m) return;
-	// Consume UI-requested actions set from process() triggers
-	if (m->reqLoadRandomSibling) {
-		m->reqLoadRandomSibling = false;
-		m->loadRandomSiblingSample();
-		m->params[Grains::RANDOM_BUTTON].setValue(0.f);
-	}
+	// Pick up status changes made on the audio thread
+	const char *status = m->engineStatus.exchange(nullptr);
+	if (status) m->setStatus(status);
 }
 
 
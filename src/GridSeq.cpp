@@ -172,10 +172,12 @@ struct GridSeq : Module,QuantizeUtils {
 
 		// snake state (not critical to persist; omit for simplicity)
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *runningJ = json_object_get(rootJ, "running");
 		if (runningJ)
 			running = json_is_true(runningJ);
@@ -741,6 +743,12 @@ void GridSeqWidget::appendContextMenu(Menu *menu) {
 	}
 	gateSlider->box.size.x = 175.0f;
 	menu->addChild(gateSlider);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = gridSeq;
+	menu->addChild(userScalesItem);
 }
 
 Model *modelGridSeq = createModel<GridSeq, GridSeqWidget>("GridSeq");
@@ -1,6 +1,7 @@
 #pragma once
 #include "rack.hpp"
 #include "QuantizeUtils.cpp"
+#include "BitGrid.hpp"
 #include <cstdlib>
 #include <functional>
 #include <algorithm>
@@ -66,6 +67,116 @@ struct InputsOverrideItem : MenuItem {
 	}
 };
 
+// Submenu putting Scala (.scl, optionally with .kbm) scales in place of built-in ones
+struct UserScalesItem : MenuItem {
+	QuantizeUtils *quantizeUtils;
+
+	struct SlotItem : MenuItem {
+		QuantizeUtils *quantizeUtils;
+		int slot;
+		Menu *createChildMenu() override {
+			Menu *menu = new Menu;
+			QuantizeUtils *q = quantizeUtils;
+			int s = slot;
+			menu->addChild(createMenuItem("Load Scala Scale (.scl)...", "", [=]() {
+				pickScalaFile(false, [=](const std::string &path) { q->userScales.assign(s, path); });
+			}));
+			if (!q->userScales.sclPath(s).empty()) {
+				menu->addChild(createMenuItem("Load Keyboard Mapping (.kbm)...", "", [=]() {
+					pickScalaFile(true, [=](const std::string &path) { q->userScales.assign(s, q->userScales.sclPath(s), path); });
+				}));
+				if (!q->userScales.kbmPath(s).empty()) {
+					menu->addChild(createMenuItem("Clear Keyboard Mapping", "", [=]() {
+						q->userScales.assign(s, q->userScales.sclPath(s));
+					}));
+				}
+				menu->addChild(createMenuItem("Back to " + q->builtInScaleName(s), "", [=]() {
+					q->userScales.assign(s, "");
+				}));
+				std::string status = q->userScales.status(s);
+				if (!status.empty()) menu->addChild(createMenuLabel(status));
+			}
+			return menu;
+		}
+	};
+
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		for (int i = 0; i < QuantizeUtils::NUM_SCALES; i++) {
+			if (i == QuantizeUtils::NONE || i == QuantizeUtils::NONE2) continue;
+			SlotItem *item = new SlotItem();
+			item->quantizeUtils = quantizeUtils;
+			item->slot = i;
+			item->text = quantizeUtils->builtInScaleName(i);
+			std::string user = quantizeUtils->userScale(i) ? quantizeUtils->userScale(i)->name : "";
+			item->rightText = user + " " + RIGHT_ARROW;
+			menu->addChild(item);
+		}
+		return menu;
+	}
+};
+
+// Submenu picking the Life rule, from presets or typed in B/S notation, and whether the grid wraps
+struct LifeRuleItem : MenuItem {
+	LifeRule *rule;
+	bool *wrap;
+	// Optional: the reseed on cycle option and the period of the cycle Life is in (0 for none)
+	bool *reseedOnCycle = nullptr;
+	const int *period = nullptr;
+	// Called after the rule or wrap changes
+	std::function<void()> changed;
+
+	struct RuleField : ui::TextField {
+		LifeRule *rule;
+		std::function<void()> changed;
+		void onChange(const ChangeEvent &e) override {
+			LifeRule parsed;
+			if (LifeRule::parse(text, parsed) && parsed != *rule) {
+				*rule = parsed;
+				if (changed) changed();
+			}
+		}
+	};
+
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		LifeRule *r = rule;
+		bool *w = wrap;
+		std::function<void()> done = changed;
+		for (const LifeRulePreset &preset : LIFE_RULE_PRESETS) {
+			LifeRule presetRule;
+			LifeRule::parse(preset.rule, presetRule);
+			menu->addChild(createMenuItem(preset.name, std::string(preset.rule) + " " + CHECKMARK(*r == presetRule), [=]() {
+				*r = presetRule;
+				if (done) done();
+			}));
+		}
+		menu->addChild(createMenuLabel("Custom (B/S, e.g. B36/S23)"));
+		RuleField *field = new RuleField();
+		field->rule = r;
+		field->changed = done;
+		field->text = r->toString();
+		field->box.size.x = 150.f;
+		menu->addChild(field);
+		menu->addChild(new MenuSeparator());
+		menu->addChild(createBoolMenuItem("Wrap Edges (Torus)", "",
+			[=]() { return *w; },
+			[=](bool on) { *w = on; if (done) done(); }
+		));
+		if (reseedOnCycle) {
+			bool *reseed = reseedOnCycle;
+			menu->addChild(createBoolMenuItem("Reseed on Cycle", "",
+				[=]() { return *reseed; },
+				[=](bool on) { *reseed = on; }
+			));
+		}
+		if (period) {
+			menu->addChild(createMenuLabel(*period > 0 ? string::f("Repeating every %d generations", *period) : "Not repeating"));
+		}
+		return menu;
+	}
+};
+
 ////////////////////////////////////////////// PANELS //////////////////////////////////////////////
 
 struct BGPanel : Widget {
@@ -1,8 +1,205 @@
 #include <string.h>
+#include <vector>
 #include "JWModules.hpp"
+#include "TripleBuffer.hpp"
+
+
+#define DISPLAY_INTERVAL 512
+#define MIN_WINDOW_SECONDS 0.001f
+#define MAX_WINDOW_SECONDS 10.f
+#define MINMAX_CHANNELS PORT_MAX_CHANNELS
+
+// Time knob: window seconds = DISPLAY_INTERVAL * 2^value, the span the old 512 point block
+// covered, so saved patches keep their time
+static const float MIN_WINDOW_PARAM = log2f(MIN_WINDOW_SECONDS / DISPLAY_INTERVAL);
+static const float MAX_WINDOW_PARAM = log2f(MAX_WINDOW_SECONDS / DISPLAY_INTERVAL);
+
+// Squares are clamped at 100 V and kept with 24 fractional bits, so a window of 10 s at
+// 192 kHz still fits the uint64 running sum
+static const float MAX_SQUARE = 10000.f;
+static const float SQUARE_SCALE = 16777216.f;
+
+// Windows up to EXACT_WINDOW samples are exact to the sample. Longer ones are made of whole
+// BLOCK_SIZE blocks plus the block in progress, so they run up to BLOCK_SIZE - 1 samples long;
+// keeping blocks rather than samples is what lets a 10 s window fit in a few hundred KB.
+static const uint32_t EXACT_WINDOW = 2048;
+static const uint32_t BLOCK_SIZE = 64;
+
+static uint32_t ringSize(uint32_t n) {
+	uint32_t cap = 1;
+	while (cap < n) cap <<= 1;
+	return cap;
+}
+
+// Monotonic deque of (position, value) for a sliding minimum; push negated values for a maximum.
+// The newest entry is never expired, so front() always has a value.
+struct ExtremeQueue {
+	void allocate(uint32_t capacity) {
+		entries.assign(ringSize(capacity), Entry());
+		mask = (uint32_t)entries.size() - 1;
+		// One entry at position 0 with value 0
+		head = 0;
+		tail = 1;
+	}
+
+	void push(uint32_t pos, float v) {
+		while (tail != head && entries[(tail - 1) & mask].v >= v) tail--;
+		entries[tail++ & mask] = Entry{pos, v};
+	}
+
+	// Drops entries before oldest
+	void expire(uint32_t oldest) {
+		while (tail - head > 1 && (int32_t)(entries[head & mask].pos - oldest) < 0) head++;
+	}
+
+	float front() const {
+		return entries[head & mask].v;
+	}
+
+private:
+	struct Entry {
+		uint32_t pos;
+		float v;
+	};
+	std::vector<Entry> entries;
+	uint32_t mask = 0;
+	uint32_t head = 0, tail = 0;
+};
+
+// Sliding-window min, max and RMS of one signal, O(1) amortized per sample whatever the window
+// length. Min and max come from monotonic deques, RMS from prefix sums of fixed-point squares,
+// so a sum over any window is exact and never drifts. Both run at the sample level for short
+// windows and at the block level for long ones, and both levels are always kept up to date so
+// turning the Time knob across EXACT_WINDOW is seamless. When the window grows, RMS covers it
+// at once while min and max fill in as new samples arrive.
+struct SlidingWindow {
+	void allocate(uint32_t maxWindow) {
+		uint32_t cap = ringSize(EXACT_WINDOW + 1);
+		prefix.assign(cap, 0);
+		mask = cap - 1;
+		minQueue.allocate(cap);
+		maxQueue.allocate(cap);
+		maxBlocks = (maxWindow + BLOCK_SIZE - 1) / BLOCK_SIZE + 1;
+		cap = ringSize(maxBlocks + 2);
+		blockPrefix.assign(cap, 0);
+		blockMask = cap - 1;
+		blockMinQueue.allocate(cap);
+		blockMaxQueue.allocate(cap);
+		// Start out as if the signal had been at 0 V all along
+		n = 0;
+		blocks = 0;
+		partialCount = 0;
+		partialMin = partialMax = 0.f;
+		partialSum = 0;
+	}
+
+	// window is in samples, 1 to the maxWindow given to allocate()
+	void push(float v, uint32_t window) {
+		if (!std::isfinite(v)) v = 0.f;
+		uint64_t square = (uint64_t)(fminf(v * v, MAX_SQUARE) * SQUARE_SCALE);
+
+		uint32_t last = n++;
+		prefix[n & mask] = prefix[last & mask] + square;
+		minQueue.push(n, v);
+		maxQueue.push(n, -v);
+		uint32_t exactWindow = std::min(window, EXACT_WINDOW);
+		minQueue.expire(n - exactWindow + 1);
+		maxQueue.expire(n - exactWindow + 1);
+
+		if (partialCount == 0) {
+			partialMin = partialMax = v;
+		}
+		else {
+			partialMin = fminf(partialMin, v);
+			partialMax = fmaxf(partialMax, v);
+		}
+		partialSum += square;
+		if (++partialCount == BLOCK_SIZE) {
+			uint32_t lastBlock = blocks++;
+			blockPrefix[blocks & blockMask] = blockPrefix[lastBlock & blockMask] + partialSum;
+			blockMinQueue.push(blocks, partialMin);
+			blockMaxQueue.push(blocks, -partialMax);
+			partialCount = 0;
+			partialSum = 0;
+		}
+		// Short windows still expire the blocks, just against the longest window
+		uint32_t oldestBlock = blocks - windowBlocks(window > EXACT_WINDOW ? window : maxBlocks * BLOCK_SIZE) + 1;
+		blockMinQueue.expire(oldestBlock);
+		blockMaxQueue.expire(oldestBlock);
+		isExact = window <= EXACT_WINDOW;
+	}
+
+	float min() const {
+		if (isExact) return minQueue.front();
+		float v = blockMinQueue.front();
+		return partialCount ? fminf(v, partialMin) : v;
+	}
+
+	float max() const {
+		if (isExact) return -maxQueue.front();
+		float v = -blockMaxQueue.front();
+		return partialCount ? fmaxf(v, partialMax) : v;
+	}
+
+	float rms(uint32_t window) const {
+		uint64_t sum;
+		uint32_t count;
+		if (window <= EXACT_WINDOW) {
+			sum = prefix[n & mask] - prefix[(n - window) & mask];
+			count = window;
+		}
+		else {
+			uint32_t k = windowBlocks(window);
+			sum = blockPrefix[blocks & blockMask] - blockPrefix[(blocks - k) & blockMask] + partialSum;
+			count = k * BLOCK_SIZE + partialCount;
+		}
+		return (float)std::sqrt((double)sum / ((double)SQUARE_SCALE * count));
+	}
+
+private:
+	// Sample level, for windows up to EXACT_WINDOW
+	std::vector<uint64_t> prefix;
+	ExtremeQueue minQueue, maxQueue;
+	uint32_t mask = 0;
+	uint32_t n = 0;
+	bool isExact = true;
+
+	// Block level: finished blocks plus the one being filled
+	std::vector<uint64_t> blockPrefix;
+	ExtremeQueue blockMinQueue, blockMaxQueue;
+	uint32_t blockMask = 0;
+	uint32_t blocks = 0;
+	uint32_t maxBlocks = 1;
+	uint32_t partialCount = 0;
+	float partialMin = 0.f, partialMax = 0.f;
+	uint64_t partialSum = 0;
+
+	// Finished blocks that, with the block in progress, cover at least window samples
+	uint32_t windowBlocks(uint32_t window) const {
+		uint32_t k = (window - std::min(window, partialCount) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		return std::max(1u, std::min(k, maxBlocks));
+	}
+};
 
+// One SlidingWindow per channel, replaced as a whole when more channels are needed
+struct MinMaxWindows {
+	std::vector<SlidingWindow> channels;
+	uint32_t maxWindow;
 
-#define BUFFER_SIZE 512
+	MinMaxWindows(int count, uint32_t maxWindow) : channels(count), maxWindow(maxWindow) {
+		for (SlidingWindow &w : channels)
+			w.allocate(maxWindow);
+	}
+};
+
+// Channel 0 stats for the display
+struct MinMaxStats {
+	float vrms = 0, vpp = 0, vmin = 0, vmax = 0;
+};
+
+struct MinMaxFrame {
+	MinMaxStats x;
+};
 
 struct MinMax : Module {
 	enum ParamIds {
@@ -17,119 +214,140 @@ struct MinMax : Module {
 		NUM_INPUTS
 	};
 	enum OutputIds {
+		MIN_OUTPUT,
+		MAX_OUTPUT,
+		PP_OUTPUT,
+		RMS_OUTPUT,
 		NUM_OUTPUTS
 	};
 
-	float bufferX[BUFFER_SIZE] = {};
-	float bufferY[BUFFER_SIZE] = {};
-	int bufferIndex = 0;
-	float frameIndex = 0;
-
-	dsp::SchmittTrigger sumTrigger;
-	dsp::SchmittTrigger extTrigger;
-	bool lissajous = false;
-	dsp::SchmittTrigger resetTrigger;
+	// The engine owns windows. Room for more channels is allocated off the audio thread and
+	// handed over through pendingWindows; the engine swaps it in, keeping the running state of
+	// the channels it already had, and hands the old one back through retiredWindows for the
+	// UI to free.
+	MinMaxWindows *windows = nullptr;
+	std::atomic<MinMaxWindows*> pendingWindows{nullptr};
+	std::atomic<MinMaxWindows*> retiredWindows{nullptr};
+	// Set by the engine when the input has more channels than the windows have room for
+	std::atomic<int> neededChannels{1};
+	int windowsChannels = 1;
+	uint32_t windowSamples = 1;
+	dsp::ClockDivider controlDivider;
+
+	// Stats are published for the display every DISPLAY_INTERVAL samples
+	TripleBuffer<MinMaxFrame> frames;
+	int displayIndex = 0;
 
 	MinMax() : Module() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
-		configParam(TIME_PARAM, -6.0, -16.0, -14.0, "Time");
+		configParam(TIME_PARAM, MIN_WINDOW_PARAM, MAX_WINDOW_PARAM, -14.0, "Window", " s", 2.f, DISPLAY_INTERVAL);
 		configInput(X_INPUT, "X");
+		configOutput(MIN_OUTPUT, "Min");
+		configOutput(MAX_OUTPUT, "Max");
+		configOutput(PP_OUTPUT, "Peak-to-peak");
+		configOutput(RMS_OUTPUT, "RMS");
+		controlDivider.setDivision(16);
+		windows = new MinMaxWindows(windowsChannels, maxWindowSamples(APP->engine->getSampleRate()));
 	}
-	void process(const ProcessArgs &args) override;
 
-	json_t *dataToJson() override {
-		json_t *rootJ = json_object();
-		json_object_set_new(rootJ, "lissajous", json_integer((int) lissajous));
-		return rootJ;
+	~MinMax() {
+		delete windows;
+		delete pendingWindows.load();
+		delete retiredWindows.load();
 	}
 
-	void dataFromJson(json_t *rootJ) override {
-		json_t *sumJ = json_object_get(rootJ, "lissajous");
-		if (sumJ)
-			lissajous = json_integer_value(sumJ);
+	void process(const ProcessArgs &args) override;
+
+	static uint32_t maxWindowSamples(float sampleRate) {
+		return (uint32_t)std::ceil(MAX_WINDOW_SECONDS * sampleRate);
+	}
 
+	// Not on the audio thread: frees windows the engine is done with, and allocates more
+	// channels when the engine has seen more than the windows hold
+	void collectRetiredWindows() {
+		delete retiredWindows.exchange(nullptr);
+		int needed = neededChannels.load();
+		if (needed > windowsChannels && !pendingWindows.load()) {
+			windowsChannels = needed;
+			pendingWindows.store(new MinMaxWindows(windowsChannels, maxWindowSamples(APP->engine->getSampleRate())));
+		}
 	}
 
-	void onReset() override {
-		lissajous = false;
+	void onSampleRateChange() override {
+		// The engine is not processing here, so the windows are replaced directly
+		delete pendingWindows.exchange(nullptr);
+		delete windows;
+		windows = new MinMaxWindows(windowsChannels, maxWindowSamples(APP->engine->getSampleRate()));
 	}
 };
 
 
 void MinMax::process(const ProcessArgs &args) {
-	// Compute time
-	float deltaTime = powf(2.0, params[TIME_PARAM].getValue());
-	int frameCount = (int)ceilf(deltaTime * args.sampleRate);
-
-	// Add frame to buffer
-	if (bufferIndex < BUFFER_SIZE) {
-		if (++frameIndex > frameCount) {
-			frameIndex = 0;
-			bufferX[bufferIndex] = inputs[X_INPUT].getVoltage();
-			bufferY[bufferIndex] = inputs[Y_INPUT].getVoltage();
-			bufferIndex++;
+	// Take over new windows, carrying the running channels across, once the UI has freed the last ones
+	if (pendingWindows.load(std::memory_order_relaxed) && !retiredWindows.load()) {
+		MinMaxWindows *next = pendingWindows.exchange(nullptr);
+		if (next->maxWindow == windows->maxWindow) {
+			for (size_t c = 0; c < windows->channels.size() && c < next->channels.size(); c++)
+				std::swap(next->channels[c], windows->channels[c]);
 		}
+		retiredWindows.store(windows);
+		windows = next;
 	}
 
-	// Are we waiting on the next trigger?
-	if (bufferIndex >= BUFFER_SIZE) {
-		// Trigger immediately if external but nothing plugged in, or in Lissajous mode
-		if (lissajous) {
-			bufferIndex = 0;
-			frameIndex = 0;
-			return;
-		}
-
-		// Reset the Schmitt trigger so we don't trigger immediately if the input is high
-		if (frameIndex == 0) {
-			resetTrigger.reset();
-		}
-		frameIndex++;
-
-		// Must go below 0.1V to trigger
-		// resetTrigger.setThresholds(params[TRIG_PARAM].getValue() - 0.1, params[TRIG_PARAM].getValue());
-		float gate = inputs[X_INPUT].getVoltage();
+	// Window length at control rate
+	if (controlDivider.process()) {
+		float seconds = DISPLAY_INTERVAL * powf(2.0, params[TIME_PARAM].getValue());
+		windowSamples = (uint32_t)clamp((float)std::round(seconds * args.sampleRate), 1.f, (float)windows->maxWindow);
+	}
 
-		// Reset if triggered
-		float holdTime = 0.1;
-		if (resetTrigger.process(gate) || (frameIndex >= args.sampleRate * holdTime)) {
-			bufferIndex = 0; frameIndex = 0; return;
-		}
+	int channels = std::max(1, inputs[X_INPUT].getChannels());
+	int capacity = (int)windows->channels.size();
+	if (channels > capacity) {
+		if (neededChannels.load(std::memory_order_relaxed) < channels)
+			neededChannels.store(channels);
+		channels = capacity;
+	}
+	for (int o = 0; o < NUM_OUTPUTS; o++)
+		outputs[o].setChannels(channels);
+
+	for (int c = 0; c < channels; c++) {
+		SlidingWindow &w = windows->channels[c];
+		w.push(inputs[X_INPUT].getVoltage(c), windowSamples);
+		float vmin = w.min();
+		float vmax = w.max();
+		outputs[MIN_OUTPUT].setVoltage(vmin, c);
+		outputs[MAX_OUTPUT].setVoltage(vmax, c);
+		outputs[PP_OUTPUT].setVoltage(vmax - vmin, c);
+		outputs[RMS_OUTPUT].setVoltage(w.rms(windowSamples), c);
+	}
 
-		// Reset if we've waited too long
-		if (frameIndex >= args.sampleRate * holdTime) {
-			bufferIndex = 0; frameIndex = 0; return;
-		}
+	if (++displayIndex >= DISPLAY_INTERVAL) {
+		displayIndex = 0;
+		MinMaxStats &stats = frames.back().x;
+		SlidingWindow &w = windows->channels[0];
+		stats.vmin = w.min();
+		stats.vmax = w.max();
+		stats.vpp = stats.vmax - stats.vmin;
+		stats.vrms = w.rms(windowSamples);
+		frames.publish();
 	}
 }
 
 
 struct MinMaxDisplay : LightWidget {
 	MinMax *module;
-	int frame = 0;
-
-	struct Stats {
-		float vrms, vpp, vmin = 0, vmax = 0;
-		void calculate(float *values) {
-			vrms = 0.0;
-			vmax = -INFINITY;
-			vmin = INFINITY;
-			for (int i = 0; i < BUFFER_SIZE; i++) {
-				float v = values[i];
-				vrms += v*v;
-				vmax = fmaxf(vmax, v);
-				vmin = fminf(vmin, v);
-			}
-			vrms = sqrtf(vrms / BUFFER_SIZE);
-			vpp = vmax - vmin;
-		}
-	};
-	Stats statsX, statsY;
+	MinMaxStats statsX;
 
 	MinMaxDisplay() {
 	}
 
-	void drawStats(const DrawArgs &args, Vec pos, const char *title, Stats *stats) {
+	void step() override {
+		if (module)
+			module->collectRetiredWindows();
+		LightWidget::step();
+	}
+
+	void drawStats(const DrawArgs &args, Vec pos, const char *title, MinMaxStats *stats) {
 		nvgFillColor(args.vg, nvgRGBA(0xff, 0xff, 0xff, 0x80));
 		char text[128];
 		snprintf(text, sizeof(text), "%5.2f", stats->vmin);
@@ -143,19 +361,15 @@ struct MinMaxDisplay : LightWidget {
 
 		if(layer == 1){
 
-			// Calculate and draw stats
-			if (++frame >= 4) {
-				frame = 0;
-				statsX.calculate(module->bufferX);
-				statsY.calculate(module->bufferY);
+			// Take the latest published stats
+			if (module->frames.update()) {
+				statsX = module->frames.front().x;
 			}
 			drawStats(args, Vec(0, 20), "X", &statsX);
 		}
 		Widget::drawLayer(args, layer);
 	}
 };
-
-
 struct MinMaxWidget : ModuleWidget { 
 	MinMaxWidget(MinMax *module); 
 };
@@ -209,6 +423,16 @@ MinMaxWidget::MinMaxWidget(MinMax *module) {
 
 	addParam(createParam<SmallWhiteKnob>(Vec(32, 209), module, MinMax::TIME_PARAM));
 	addInput(createInput<PJ301MPort>(Vec(33, 275), module, MinMax::X_INPUT));
+
+	const char *outNames[] = {"Min", "Max", "P-P", "RMS"};
+	for (int i = 0; i < MinMax::NUM_OUTPUTS; i++) {
+		float x = 4 + i * 22.5;
+		CenteredLabel* const outLabel = new CenteredLabel(10);
+		outLabel->box.pos = Vec((x + 7.5) / 2, 155);
+		outLabel->text = outNames[i];
+		addChild(outLabel);
+		addOutput(createOutput<TinyPJ301MPort>(Vec(x, 315), module, i));
+	}
 }
 
 Model *modelMinMax = createModel<MinMax, MinMaxWidget>("MinMax");
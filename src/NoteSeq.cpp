@@ -1,6 +1,7 @@
 #include <string.h>
 #include <algorithm>
 #include "JWModules.hpp"
+#include "BitGrid.hpp"
 
 #define ROWS 32
 #define COLS 32
@@ -130,10 +131,15 @@ struct NoteSeq : Module,QuantizeUtils {
 	bool eocOn = false; 
 	bool hitEnd = false;
 	bool resetMode = false;
-	bool *cells = new bool[CELLS];
-	bool *newCells = new bool[CELLS];
+	BitGrid<COLS, ROWS> cells;
+	LifeRule lifeRule;
+	bool lifeWrap = false;
+	bool lifeReseedOnCycle = false;
+	LifeCycleDetector lifeCycles;
+	int lifePeriod = 0;
 	ColNotes *colNotesCache = new ColNotes[COLS];
 	ColNotes *colNotesCache2 = new ColNotes[COLS];
+	RowVoltageCache rowVolts;
 	dsp::SchmittTrigger clockTrig, resetTrig, clearTrig;
 	dsp::SchmittTrigger rndTrig, shiftUpTrig, shiftDownTrig, shiftChaosTrig;
 	dsp::SchmittTrigger rotateRightTrig, rotateLeftTrig, flipHorizTrig, flipVertTrig;
@@ -218,8 +224,6 @@ struct NoteSeq : Module,QuantizeUtils {
 	}
 
 	~NoteSeq() {
-		delete [] cells;
-		delete [] newCells;
 		delete [] colNotesCache;
 		delete [] colNotesCache2;
 	}
@@ -233,6 +237,7 @@ struct NoteSeq : Module,QuantizeUtils {
 		resetMode = true;
 		clearCells();
 		lifeCounter = 0;
+		lifeRuleChanged();
 	}
 
 	void onSampleRateChange() override {
@@ -245,10 +250,13 @@ struct NoteSeq : Module,QuantizeUtils {
 		
 		json_t *cellsJ = json_array();
 		for (int i = 0; i < CELLS; i++) {
-			json_t *cellJ = json_integer((int) cells[i]);
+			json_t *cellJ = json_integer((int) cells.get(xFromI(i), yFromI(i)));
 			json_array_append_new(cellsJ, cellJ);
 		}
 		json_object_set_new(rootJ, "cells", cellsJ);
+		json_object_set_new(rootJ, "lifeRule", json_string(lifeRule.toString().c_str()));
+		json_object_set_new(rootJ, "lifeWrap", json_boolean(lifeWrap));
+		json_object_set_new(rootJ, "lifeReseedOnCycle", json_boolean(lifeReseedOnCycle));
 
 		// gateMode
 		json_t *gateModeJ = json_integer((int) gateMode);
@@ -257,10 +265,12 @@ struct NoteSeq : Module,QuantizeUtils {
 		// gate pulse length
 		json_object_set_new(rootJ, "gatePulseLenSec", json_real(gatePulseLenSec));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *channelsJ = json_object_get(rootJ, "channels");
 		if (channelsJ){
 			channels = json_integer_value(channelsJ);
@@ -273,10 +283,21 @@ struct NoteSeq : Module,QuantizeUtils {
 			for (int i = 0; i < CELLS; i++) {
 				json_t *cellJ = json_array_get(cellsJ, i);
 				if (cellJ)
-					cells[i] = json_integer_value(cellJ);
+					cells.set(xFromI(i), yFromI(i), json_integer_value(cellJ));
 			}
 		}
 
+		json_t *lifeRuleJ = json_object_get(rootJ, "lifeRule");
+		if (lifeRuleJ && json_is_string(lifeRuleJ))
+			LifeRule::parse(json_string_value(lifeRuleJ), lifeRule);
+		json_t *lifeWrapJ = json_object_get(rootJ, "lifeWrap");
+		if (lifeWrapJ)
+			lifeWrap = json_boolean_value(lifeWrapJ);
+		json_t *lifeReseedOnCycleJ = json_object_get(rootJ, "lifeReseedOnCycle");
+		if (lifeReseedOnCycleJ)
+			lifeReseedOnCycle = json_boolean_value(lifeReseedOnCycleJ);
+		lifeRuleChanged();
+
 		// gateMode
 		json_t *gateModeJ = json_object_get(rootJ, "gateMode");
 		if (gateModeJ)
@@ -329,13 +350,14 @@ struct NoteSeq : Module,QuantizeUtils {
 		}
 
 		bool pulse = gatePulse.process(1.0 / args.sampleRate);
+		updateRowVolts();
 		// ////////////////////////////////////////////// POLY OUTPUTS //////////////////////////////////////////////
 		
 		int *polyYVals = getYValsFromBottomAtSeqPos(params[INCLUDE_INACTIVE_PARAM].getValue());
 		//OLD POLY OUTPUTS
 		for(int i=0;i<POLY;i++){ //param # starts from bottom
 			bool hasVal = polyYVals[i] > -1;
-			bool cellActive = hasVal && cells[iFromXY(seqPos, ROWS - polyYVals[i] - 1)];
+			bool cellActive = hasVal && cells.get(seqPos, ROWS - polyYVals[i] - 1);
 			if(cellActive){ 
 				float volts = closestVoltageForRow(polyYVals[i]);
 				outputs[VOCT_MAIN_OUTPUT + i].setVoltage(volts);
@@ -349,7 +371,7 @@ struct NoteSeq : Module,QuantizeUtils {
 		//ONLY NEW MAIN POLY OUTPUT
 		for(int i=0;i<channels;i++){
 			bool hasVal = polyYVals[i] > -1;
-			bool cellActive = hasVal && cells[iFromXY(seqPos, ROWS - polyYVals[i] - 1)];
+			bool cellActive = hasVal && cells.get(seqPos, ROWS - polyYVals[i] - 1);
 			if(cellActive){ 
 				float volts = closestVoltageForRow(polyYVals[i]);
 				outputs[POLY_VOCT_OUTPUT].setVoltage(volts, i);
@@ -430,16 +452,12 @@ struct NoteSeq : Module,QuantizeUtils {
 		cache[seqPos].includeInactive = includeInactive;
 		for(int i=0;i<COLS;i++){ cache[seqPos].vals[i] = -1; }
 
+		// Rows finalLow-1 to finalHigh-1 counted from the bottom, lowest first
+		uint32_t rows = includeInactive ? cells.COL_MASK : cells.columnFromBottom(seqPos);
+		rows &= (cells.COL_MASK >> (ROWS - finalHigh)) & ~((1u << (finalLow - 1)) - 1);
 		int valIdx = 0;
-		for(int i=CELLS-1;i>=0;i--){
-			int x = xFromI(i);
-			if(x == seqPos && (cells[i] || includeInactive)){
-				int y = yFromI(i);
-				int yFromBottom = ROWS - 1 - y;
-				if(yFromBottom <= finalHigh-1 && yFromBottom >= finalLow-1){
-					cache[seqPos].vals[valIdx++] = yFromBottom;
-				}
-			}
+		for(; rows; rows &= rows - 1){
+			cache[seqPos].vals[valIdx++] = lowestBit(rows);
 		}
 		return cache[seqPos].vals;
 	}
@@ -460,15 +478,6 @@ struct NoteSeq : Module,QuantizeUtils {
 		}
 	}
 
-	void swapCells() {
-		std::swap(cells, newCells);
-		gridChanged();
-
-		for(int i=0;i<CELLS;i++){
-			newCells[i] = false;
-		}
-	}
-
 	int getFinalHighestNote1to32(){
 		int inputOffset = inputs[HIGHEST_NOTE_INPUT].isConnected() ? int(rescalefjw(inputs[HIGHEST_NOTE_INPUT].getVoltage(), -5, 5, -17, 17)) : 0;
 		return clampijw(params[HIGHEST_NOTE_PARAM].getValue() + inputOffset, 1, 32);
@@ -479,7 +488,7 @@ struct NoteSeq : Module,QuantizeUtils {
 		return clampijw(params[LOWEST_NOTE_PARAM].getValue() + inputOffset, 1, 32);
 	}
 
-	float closestVoltageForRow(int cellYFromBottom){
+	void updateRowVolts(){
 		int octaveInputOffset = inputs[OCTAVE_INPUT].isConnected() ? int(inputs[OCTAVE_INPUT].getVoltage()) : 0;
 		int octave = clampijw(params[OCTAVE_KNOB_PARAM].getValue() + octaveInputOffset, -5.0, 7.0);
 
@@ -489,7 +498,11 @@ struct NoteSeq : Module,QuantizeUtils {
 		int scaleInputOffset = inputs[SCALE_INPUT].isConnected() ? rescalefjw(inputs[SCALE_INPUT].getVoltage(), 0, 10, 0, QuantizeUtils::NUM_SCALES-1) : 0;
 		int scale = clampijw(params[SCALE_KNOB_PARAM].getValue() + scaleInputOffset, 0, QuantizeUtils::NUM_SCALES-1);
 
-		return closestVoltageInScale(octave + (cellYFromBottom * 0.0833), rootNote, scale);
+		rowVolts.update(this, octave, rootNote, scale);
+	}
+
+	float closestVoltageForRow(int cellYFromBottom){
+		return rowVolts.voltsForRow(cellYFromBottom);
 	}
 
 	void clockStep(){
@@ -586,91 +599,58 @@ struct NoteSeq : Module,QuantizeUtils {
 	}
 
 	void rotateCells(RotateDirection dir){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				switch(dir){
-					case DIR_RIGHT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(y, COLS - x - 1)];
-						break;
-					case DIR_LEFT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(COLS - y - 1, x)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
+		cells.rotateSquares(dir == DIR_RIGHT);
+		gridChanged();
 	}
 
 	void flipCells(FlipDirection dir){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				switch(dir){
-					case DIR_HORIZ:
-						newCells[iFromXY(x, y)] = cells[iFromXY(COLS - 1 - x, y)];
-						break;
-					case DIR_VERT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, ROWS - 1 - y)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
+		if(dir == DIR_HORIZ) cells.flipHoriz();
+		else cells.flipVert();
+		gridChanged();
 	}
 
 	void shiftCells(ShiftDirection dir){
 		int inputOffset = inputs[SHIFT_AMT_INPUT].isConnected() ? rescalefjw(inputs[SHIFT_AMT_INPUT].getVoltage(), -5, 5, -32, 32) : 0;
 		int amount = clampijw(params[SHIFT_AMT_KNOB_PARAM].getValue() + inputOffset, -32, 32);
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				int newX = 0, newY = 0;
-				switch(dir){
-					case DIR_UP:
-						//if at top, start from bottom up
-						newY = (y + amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-					case DIR_DOWN:
-						//if at bottom, start from top down
-						newY = (y - amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-					case DIR_CHAOS:
+		switch(dir){
+			case DIR_UP:
+				cells.rotateRows(amount);
+				break;
+			case DIR_DOWN:
+				cells.rotateRows(-amount);
+				break;
+			case DIR_CHAOS:{
+				// Two draws for every cell, on or off, so seeded patches scatter the same way as before
+				BitGrid<COLS, ROWS> shifted;
+				for(int x=0; x < COLS; x++){
+					for(int y=0; y < ROWS; y++){
 						bool rndX = random::uniform() < 0.5;
-						newX = (x - amount * (rndX?1:-1)) % COLS;
+						int newX = (x - amount * (rndX?1:-1)) % COLS;
 						if(newX < 0) newX = COLS + newX;
 
 						bool rndY = random::uniform() < 0.5;
-						newY = (y - amount * (rndY?1:-1)) % ROWS;
+						int newY = (y - amount * (rndY?1:-1)) % ROWS;
 						if(newY < 0) newY = ROWS + newY;
-						if(cells[iFromXY(x, y)]){
-							newCells[iFromXY(newX, newY)] = cells[iFromXY(x, y)];
+						if(cells.get(x, y)){
+							shifted.set(newX, newY, true);
 						}
-						break;
+					}
 				}
-
+				cells = shifted;
+				break;
 			}
 		}
-		swapCells();
+		gridChanged();
 	}
 
 	void clearCells() {
-		for(int i=0;i<CELLS;i++){
-			cells[i] = false;
-			newCells[i] = false;
-		}
+		cells.clear();
 		gridChanged();
 	}
 
 	void repeatFirst16StepsAcross() {
 		for (int x = 16; x < COLS; x++) {
-			int srcX = x % 16;
-			for (int y = 0; y < ROWS; y++) {
-				cells[iFromXY(x, y)] = cells[iFromXY(srcX, y)];
-			}
+			cells.cols[x] = cells.cols[x % 16];
 		}
 		gridChanged();
 	}
@@ -801,33 +781,22 @@ struct NoteSeq : Module,QuantizeUtils {
 	}
 
 	void stepLife(){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				int cellIdx = iFromXY(x, y);
-				int neighbors = getNeighborCount(x,y);
-				newCells[cellIdx] = cells[cellIdx];
-				if(neighbors<2 || neighbors>3) {
-					newCells[cellIdx] = false;
-				} else if (neighbors==3 && !cells[cellIdx]) {
-					newCells[cellIdx] = true;
-				}
-			}
+		if(lifeCycles.empty()){
+			lifeCycles.add(cells.hash());
 		}
-		swapCells();
-	}
-	
-	int getNeighborCount(int x, int y){
-		int result = 0;
-		for(int i=-1; i<=1; i++){
-			for(int j=-1; j<=1; j++){
-				int newX = x + i;
-				int newY = y + j;
-				if(newX==x && newY==y)continue;
-				if(newX>=0 && newY>=0 && newX<COLS && newY<ROWS && 
-					cells[iFromXY(newX, newY)]) result++;
-			}
+		cells.stepLife(lifeRule, lifeWrap);
+		gridChanged();
+		lifePeriod = lifeCycles.add(cells.hash());
+		if(lifePeriod > 0 && lifeReseedOnCycle){
+			randomizeCells();
+			lifeRuleChanged();
 		}
-		return result;
+	}
+
+	// States seen under another rule say nothing about where this one goes
+	void lifeRuleChanged(){
+		lifeCycles.reset();
+		lifePeriod = 0;
 	}
   
 	void setCellOnByDisplayPos(float displayX, float displayY, bool on){
@@ -837,7 +806,7 @@ struct NoteSeq : Module,QuantizeUtils {
 	void setCellOn(int cellX, int cellY, bool on){
 		if(cellX >= 0 && cellX < COLS && 
 		   cellY >=0 && cellY < ROWS){
-			cells[iFromXY(cellX, cellY)] = on;
+			cells.set(cellX, cellY, on);
 			colNotesCache[cellX].valid = false;
 			colNotesCache2[cellX].valid = false;
 		}
@@ -848,7 +817,7 @@ struct NoteSeq : Module,QuantizeUtils {
 	}
 
 	bool isCellOn(int cellX, int cellY){
-		return cells[iFromXY(cellX, cellY)];
+		return cellX >= 0 && cellX < COLS && cellY >= 0 && cellY < ROWS && cells.get(cellX, cellY);
 	}
 
 	int iFromXY(int cellX, int cellY){
@@ -928,10 +897,9 @@ struct NoteSeqDisplay : LightWidget {
 
 			//cells
 			nvgFillColor(args.vg, nvgRGB(25, 150, 252)); //blue
-			for(int i=0;i<CELLS;i++){
-				if(module->cells[i]){
-					int x = module->xFromI(i);
-					int y = module->yFromI(i);
+			for(int x=0;x<COLS;x++){
+				for(uint32_t col = module->cells.column(x); col; col &= col - 1){
+					int y = lowestBit(col);
 					nvgBeginPath(args.vg);
 					nvgRect(args.vg, x * HW, y * HW, HW, HW);
 					nvgFill(args.vg);
@@ -1252,6 +1220,22 @@ void NoteSeqWidget::appendContextMenu(Menu *menu) {
 	}
 	gateSlider->box.size.x = 175.0f;
 	menu->addChild(gateSlider);
+
+	LifeRuleItem *lifeRuleItem = new LifeRuleItem();
+	lifeRuleItem->text = "Life Rule";
+	lifeRuleItem->rightText = noteSeq->lifeRule.toString() + (noteSeq->lifeWrap ? " Torus" : "") + " " + RIGHT_ARROW;
+	lifeRuleItem->rule = &noteSeq->lifeRule;
+	lifeRuleItem->wrap = &noteSeq->lifeWrap;
+	lifeRuleItem->reseedOnCycle = &noteSeq->lifeReseedOnCycle;
+	lifeRuleItem->period = &noteSeq->lifePeriod;
+	lifeRuleItem->changed = [noteSeq]() { noteSeq->lifeRuleChanged(); };
+	menu->addChild(lifeRuleItem);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = noteSeq;
+	menu->addChild(userScalesItem);
 }
 
 Model *modelNoteSeq = createModel<NoteSeq, NoteSeqWidget>("NoteSeq");
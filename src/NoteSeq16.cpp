@@ -1,6 +1,8 @@
 #include <string.h>
 #include <algorithm>
+#include <atomic>
 #include "JWModules.hpp"
+#include "BitGridJson.hpp"
 
 #define ROWS 16
 #define COLS 256
@@ -87,10 +89,12 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	bool eocOn = false; 
 	bool hitEnd = false;
 	bool followPlayhead = false;
-	bool *cells = new bool[CELLS];
-	bool *newCells = new bool[CELLS];
+	BitGrid<COLS, ROWS> cells;
+	// Bumped on every edit so the display knows when to redraw its cached grid
+	std::atomic<uint32_t> gridVersion{0};
 	ColNotes *colNotesCache = new ColNotes[COLS];
 	ColNotes *colNotesCache2 = new ColNotes[COLS];
+	RowVoltageCache rowVolts;
 	int maxLength = 16; // clamp sequence length to one of {16,32,64,128,256}; default 16 for backwards compatibility
 	dsp::SchmittTrigger clockTrig, resetTrig, clearTrig;
 	dsp::SchmittTrigger rndTrig, shiftUpTrig, shiftDownTrig;
@@ -144,8 +148,6 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	}
 
 	~NoteSeq16() {
-		delete [] cells;
-		delete [] newCells;
 		delete [] colNotesCache;
 		delete [] colNotesCache2;
 	}
@@ -170,12 +172,10 @@ struct NoteSeq16 : Module,QuantizeUtils {
 		json_object_set_new(rootJ, "maxLength", json_integer(maxLength));
 		json_object_set_new(rootJ, "lengthKnob", json_real(params[LENGTH_KNOB_PARAM].getValue()));
 		
-		json_t *cellsJ = json_array();
-		for (int i = 0; i < CELLS; i++) {
-			json_t *cellJ = json_integer((int) cells[i]);
-			json_array_append_new(cellsJ, cellJ);
-		}
-		json_object_set_new(rootJ, "cells", cellsJ);
+		// Base64 of BitGrid::pack(). Patches from before version 1 have a "cells" array instead.
+		std::vector<uint8_t> packed = cells.pack();
+		json_object_set_new(rootJ, "cellsPackedVersion", json_integer(1));
+		json_object_set_new(rootJ, "cellsPacked", json_string(string::toBase64(packed.data(), packed.size()).c_str()));
 		
 		// gateMode
 		json_t *gateModeJ = json_integer((int) gateMode);
@@ -187,10 +187,12 @@ struct NoteSeq16 : Module,QuantizeUtils {
 		// follow playhead
 		json_object_set_new(rootJ, "followPlayhead", json_boolean(followPlayhead));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *channelsJ = json_object_get(rootJ, "channels");
 		if (channelsJ){
 			channels = json_integer_value(channelsJ);
@@ -225,36 +227,24 @@ struct NoteSeq16 : Module,QuantizeUtils {
 			params[LENGTH_KNOB_PARAM].setValue(savedLen);
 		}
 
+		json_t *cellsPackedVersionJ = json_object_get(rootJ, "cellsPackedVersion");
+		json_t *cellsPackedJ = json_object_get(rootJ, "cellsPacked");
 		json_t *cellsJ = json_object_get(rootJ, "cells");
-		if (cellsJ && json_is_array(cellsJ)) {
-			// Clear current grid
-			for (int i = 0; i < CELLS; i++) {
-				cells[i] = false;
-			}
-			size_t arrLen = json_array_size(cellsJ);
-			if (arrLen == (size_t)CELLS) {
-				// Current format (16 x 256), row-major by COLS stride
-				for (int i = 0; i < CELLS; i++) {
-					json_t *cellJ = json_array_get(cellsJ, i);
-					if (cellJ)
-						cells[i] = !!json_integer_value(cellJ);
-				}
+		if (cellsPackedJ && json_is_string(cellsPackedJ) && json_integer_value(cellsPackedVersionJ) == 1) {
+			std::vector<uint8_t> packed;
+			try {
+				packed = string::fromBase64(json_string_value(cellsPackedJ));
 			}
-			else if (arrLen % ROWS == 0) {
-				// Legacy formats with fewer columns, e.g. 16x16. Map row-major (stride = oldCols) into current grid.
-				int oldCols = (int)(arrLen / ROWS);
-				oldCols = std::max(0, std::min(oldCols, COLS));
-				for (int y = 0; y < ROWS; y++) {
-					for (int x = 0; x < oldCols; x++) {
-						int iOld = y * oldCols + x;
-						json_t *cellJ = json_array_get(cellsJ, iOld);
-						if (!cellJ) continue;
-						bool on = !!json_integer_value(cellJ);
-						cells[iFromXY(x, y)] = on;
-					}
-				}
+			catch (Exception &e) {
+				// not base64; the empty data fails to unpack below
 			}
-			// else: unknown shape; leave cleared
+			if (!cells.unpack(packed.data(), packed.size()))
+				cells.clear();
+			gridChanged();
+		}
+		else if (cellsJ && json_is_array(cellsJ)) {
+			bitGridFromCellsArray(cellsJ, cells);
+			gridChanged();
 		}
 
 		// gateMode
@@ -304,12 +294,13 @@ struct NoteSeq16 : Module,QuantizeUtils {
 		}
 
 		bool pulse = gatePulse.process(1.0 / args.sampleRate);
+		updateRowVolts();
 		// ////////////////////////////////////////////// POLY OUTPUTS //////////////////////////////////////////////
 		
 		int *polyYVals = getYValsFromBottomAtSeqPos(params[INCLUDE_INACTIVE_PARAM].getValue());
 		for(int i=0;i<channels;i++){ //param # starts from bottom
 			bool hasVal = polyYVals[i] > -1;
-			bool cellActive = hasVal && cells[iFromXY(seqPos, ROWS - polyYVals[i] - 1)];
+			bool cellActive = hasVal && cells.get(seqPos, ROWS - polyYVals[i] - 1);
 			if(cellActive){ 
 				float volts = closestVoltageForRow(polyYVals[i]);
 				outputs[POLY_VOCT_OUTPUT].setVoltage(volts, i);
@@ -339,16 +330,12 @@ struct NoteSeq16 : Module,QuantizeUtils {
 		// vals has ROWS slots; clear only that many to avoid overflow
 		for(int i=0;i<ROWS;i++){ cache[seqPos].vals[i] = -1; }
 
+		// Rows finalLow-1 to finalHigh-1 counted from the bottom, lowest first
+		uint32_t rows = includeInactive ? cells.COL_MASK : cells.columnFromBottom(seqPos);
+		rows &= (cells.COL_MASK >> (ROWS - finalHigh)) & ~((1u << (finalLow - 1)) - 1);
 		int valIdx = 0;
-		for(int i=CELLS-1;i>=0;i--){
-			int x = xFromI(i);
-			if(x == seqPos && (cells[i] || includeInactive)){
-				int y = yFromI(i);
-				int yFromBottom = ROWS - 1 - y;
-				if(yFromBottom <= finalHigh-1 && yFromBottom >= finalLow-1){
-					cache[seqPos].vals[valIdx++] = yFromBottom;
-				}
-			}
+		for(; rows; rows &= rows - 1){
+			cache[seqPos].vals[valIdx++] = lowestBit(rows);
 		}
 		return cache[seqPos].vals;
 	}
@@ -367,6 +354,7 @@ struct NoteSeq16 : Module,QuantizeUtils {
 			colNotesCache[x].valid = false;
 			colNotesCache2[x].valid = false;
 		}
+		gridVersion++;
 	}
 
 	int getFinalHighestNote1to16(){
@@ -377,11 +365,15 @@ struct NoteSeq16 : Module,QuantizeUtils {
 		return 1;
 	}
 
-	float closestVoltageForRow(int cellYFromBottom){
+	void updateRowVolts(){
 		int octave = params[OCTAVE_KNOB_PARAM].getValue();
 		int rootNote = params[NOTE_KNOB_PARAM].getValue();
 		int scale = params[SCALE_KNOB_PARAM].getValue();
-		return closestVoltageInScale(octave + (cellYFromBottom * 0.0833), rootNote, scale);
+		rowVolts.update(this, octave, rootNote, scale);
+	}
+
+	float closestVoltageForRow(int cellYFromBottom){
+		return rowVolts.voltsForRow(cellYFromBottom);
 	}
 
 	void clockStep(){
@@ -477,18 +469,13 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	}
 
 	void clearCells() {
-		for(int i=0;i<CELLS;i++){
-			cells[i] = false;
-		}
+		cells.clear();
 		gridChanged();
 	}
 
 	void repeatFirst16StepsAcross() {
 		for (int x = 16; x < COLS; x++) {
-			int srcX = x % 16;
-			for (int y = 0; y < ROWS; y++) {
-				cells[iFromXY(x, y)] = cells[iFromXY(srcX, y)];
-			}
+			cells.cols[x] = cells.cols[x % 16];
 		}
 		gridChanged();
 	}
@@ -498,90 +485,22 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	// Rotate each 16x16 square across the entire grid (ignore length/start).
 	// Direction is clockwise (DIR_RIGHT) or counter-clockwise (DIR_LEFT).
 	void rotateSquaresAcross(RotateDirection dir){
-		// Copy current state to newCells as baseline
-		for(int i=0;i<CELLS;i++){
-			newCells[i] = cells[i];
-		}
-		// Iterate over all 16-column blocks across the grid
-		for(int blockStart = 0; blockStart + 15 < COLS; blockStart += 16){
-			// Clear destination block region before writing rotation
-			for(int y=0; y<ROWS; y++){
-				for(int x=0; x<16; x++){
-					newCells[iFromXY(blockStart + x, y)] = false;
-				}
-			}
-			// Apply rotation mapping within 16x16 block
-			for(int y=0; y<ROWS; y++){
-				for(int x=0; x<16; x++){
-					bool on = cells[iFromXY(blockStart + x, y)];
-					int newX = blockStart + x;
-					int newY = y;
-					if(dir == DIR_RIGHT){
-						newX = blockStart + (15 - y);
-						newY = x;
-					}
-					else { // DIR_LEFT
-						newX = blockStart + y;
-						newY = 15 - x;
-					}
-					newCells[iFromXY(newX, newY)] = on;
-				}
-			}
-		}
-		// Commit changes
-		swapCells();
+		cells.rotateSquares(dir == DIR_RIGHT);
+		gridChanged();
 	}
 
 	void flipCells(FlipDirection dir){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				switch(dir){
-					case DIR_HORIZ:
-						newCells[iFromXY(x, y)] = cells[iFromXY(COLS - 1 - x, y)];
-						break;
-					case DIR_VERT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, ROWS - 1 - y)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
+		if(dir == DIR_HORIZ) cells.flipHoriz();
+		else cells.flipVert();
+		gridChanged();
 	}
 
 	void shiftCells(ShiftDirection dir){
 		int amount = 1;
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				int newY = 0;
-				switch(dir){
-					case DIR_UP:
-						//if at top, start from bottom up
-						newY = (y + amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-					case DIR_DOWN:
-						//if at bottom, start from top down
-						newY = (y - amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
-	}
-
-	void swapCells() {
-		std::swap(cells, newCells);
+		cells.rotateRows(dir == DIR_UP ? amount : -amount);
 		gridChanged();
-
-		for(int i=0;i<CELLS;i++){
-			newCells[i] = false;
-		}
 	}
+
 	void randomizeCells() {
 		clearCells();
 		float rndAmt = params[RND_AMT_KNOB_PARAM].getValue();
@@ -672,9 +591,10 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	void setCellOn(int cellX, int cellY, bool on){
 		if(cellX >= 0 && cellX < COLS && 
 		   cellY >=0 && cellY < ROWS){
-			cells[iFromXY(cellX, cellY)] = on;
+			cells.set(cellX, cellY, on);
 			colNotesCache[cellX].valid = false;
 			colNotesCache2[cellX].valid = false;
+			gridVersion++;
 		}
 	}
 
@@ -683,7 +603,7 @@ struct NoteSeq16 : Module,QuantizeUtils {
 	}
 
 	bool isCellOn(int cellX, int cellY){
-		return cells[iFromXY(cellX, cellY)];
+		return cellX >= 0 && cellX < COLS && cellY >= 0 && cellY < ROWS && cells.get(cellX, cellY);
 	}
 
 	int iFromXY(int cellX, int cellY){
@@ -707,8 +627,36 @@ struct NoteSeq16Display : LightWidget {
 	bool hovered = false;
 	bool scrollDragging = false;
 	float dragThumbOffset = 0.0f;
+#ifndef METAMODULE
+	// Cached static grid for CACHE_COLS columns from cacheCol0, redrawn when the grid changes
+	static const int CACHE_COLS = 64;
+	NVGLUframebuffer *fb = NULL;
+	int fbWidth = 0;
+	int fbHeight = 0;
+	int cacheCol0 = -1;
+	uint32_t cacheVersion = 0;
+	int cacheRootNote = -1;
+#endif
 	NoteSeq16Display(){}
 
+#ifndef METAMODULE
+	~NoteSeq16Display() {
+		deleteFramebuffer();
+	}
+
+	void onContextDestroy(const ContextDestroyEvent &e) override {
+		deleteFramebuffer();
+		LightWidget::onContextDestroy(e);
+	}
+
+	void deleteFramebuffer() {
+		if (fb) {
+			nvgluDeleteFramebuffer(fb);
+			fb = NULL;
+		}
+	}
+#endif
+
 	void onButton(const event::Button &e) override {
 		if (e.action == GLFW_PRESS && e.button == GLFW_MOUSE_BUTTON_LEFT) {
 			e.consume(this);
@@ -780,6 +728,117 @@ struct NoteSeq16Display : LightWidget {
 		e.consume(this);
 	}
 
+	// Grid lines, white key rows and cells for columns col0 to col1, in content coordinates
+	void drawGrid(NVGcontext *vg, int col0, int col1) {
+		float x0 = col0 * HW;
+		float w = (col1 - col0) * HW;
+		float gridH = ROWS * HW;
+
+		//highlight white keys
+		int rootNote = module == NULL ? 0 : module->params[NoteSeq16::NOTE_KNOB_PARAM].getValue();
+		nvgFillColor(vg, nvgRGB(40, 40, 40));
+		for(int i=0;i<ROWS;i++){
+			if(!isBlackKey(ROWS-1-i+rootNote)){
+				nvgBeginPath(vg);
+				nvgRect(vg, x0, i*HW, w, HW);
+				nvgFill(vg);
+			}
+		}
+
+		//grid
+		nvgStrokeColor(vg, nvgRGB(60, 70, 73));
+		for(int i=col0;i<=col1;i++){
+			nvgStrokeWidth(vg, (i % 4 == 0) ? 2 : 1);
+			nvgBeginPath(vg);
+			nvgMoveTo(vg, i * HW, 0);
+			nvgLineTo(vg, i * HW, gridH);
+			nvgStroke(vg);
+		}
+		nvgStrokeWidth(vg, 1);
+		for(int i=0;i<ROWS+1;i++){
+			nvgBeginPath(vg);
+			nvgMoveTo(vg, x0, i * HW);
+			nvgLineTo(vg, x0 + w, i * HW);
+			nvgStroke(vg);
+		}
+
+		// blue division lines every 16 columns for visual grouping
+		nvgStrokeColor(vg, nvgRGB(25, 150, 252));
+		nvgStrokeWidth(vg, 2);
+		for (int i = (col0 + 15) / 16 * 16; i <= col1; i += 16) {
+			nvgBeginPath(vg);
+			nvgMoveTo(vg, i * HW, 0);
+			nvgLineTo(vg, i * HW, box.size.y);
+			nvgStroke(vg);
+		}
+
+		if(module == NULL) return;
+
+		//cells, one path for all of them
+		nvgFillColor(vg, nvgRGB(255, 151, 9));//orange
+		nvgBeginPath(vg);
+		for(int x=col0;x<col1;x++){
+			for(uint32_t col = module->cells.column(x); col; col &= col - 1){
+				nvgRect(vg, x * HW, lowestBit(col) * HW, HW, HW);
+			}
+		}
+		nvgFill(vg);
+	}
+
+#ifndef METAMODULE
+	// Draws the grid around the visible columns into the cache if it is out of date, then
+	// blits the visible part. Following the playhead only redraws when the view leaves the
+	// cached columns. False if there is no framebuffer to draw into.
+	bool drawCachedGrid(const DrawArgs &args, int firstCol, int lastCol) {
+		float scale = getAbsoluteZoom() * APP->window->pixelRatio;
+		int width = (int)ceilf(CACHE_COLS * HW * scale);
+		int height = (int)ceilf(box.size.y * scale);
+		if (width <= 0 || height <= 0)
+			return false;
+		if (!fb || width != fbWidth || height != fbHeight) {
+			deleteFramebuffer();
+			fb = nvgluCreateFramebuffer(args.vg, width, height, 0);
+			if (!fb)
+				return false;
+			fbWidth = width;
+			fbHeight = height;
+			cacheCol0 = -1;
+		}
+
+		if (cacheCol0 < 0 || firstCol < cacheCol0 || lastCol > cacheCol0 + CACHE_COLS) {
+			// Keep a page of columns either side of the view
+			cacheCol0 = clampijw(firstCol / 16 * 16 - 16, 0, COLS - CACHE_COLS);
+			cacheVersion = module->gridVersion - 1;
+		}
+		int rootNote = module->params[NoteSeq16::NOTE_KNOB_PARAM].getValue();
+		uint32_t version = module->gridVersion;
+		if (version != cacheVersion || rootNote != cacheRootNote) {
+			NVGcontext *fbVg = APP->window->fbVg;
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			nvgluBindFramebuffer(fb);
+			glViewport(0, 0, width, height);
+			glClearColor(0.0, 0.0, 0.0, 0.0);
+			glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			nvgBeginFrame(fbVg, CACHE_COLS * HW, box.size.y, scale);
+			nvgTranslate(fbVg, -cacheCol0 * HW, 0);
+			drawGrid(fbVg, cacheCol0, cacheCol0 + CACHE_COLS);
+			nvgEndFrame(fbVg);
+			nvgluBindFramebuffer(args.fb);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			cacheVersion = version;
+			cacheRootNote = rootNote;
+		}
+
+		float x = cacheCol0 * HW - scrollX;
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+		nvgFillPaint(args.vg, nvgImagePattern(args.vg, x, 0, CACHE_COLS * HW, box.size.y, 0, fb->image, 1.0));
+		nvgFill(args.vg);
+		return true;
+	}
+#endif
+
 	void drawLayer(const DrawArgs &args, int layer) override {
 		// Clip to viewport
 		nvgSave(args.vg);
@@ -792,17 +851,6 @@ struct NoteSeq16Display : LightWidget {
 		nvgFill(args.vg);
 
 		if(layer == 1){
-			//highlight white keys
-			int rootNote = module == NULL ? 0 : module->params[NoteSeq16::NOTE_KNOB_PARAM].getValue();
-			for(int i=0;i<ROWS;i++){
-				if(!isBlackKey(ROWS-1-i+rootNote)){
-					nvgFillColor(args.vg, nvgRGB(40, 40, 40));
-					nvgBeginPath(args.vg);
-					nvgRect(args.vg, 0, i*HW, box.size.x, HW);
-					nvgFill(args.vg);
-				}
-			}
-
 			// auto-follow playhead: smoothly center within viewport to avoid jumping
 			if (module && module->followPlayhead) {
 				float posX = (module->resetMode ? module->getSeqStart() : module->seqPos) * HW;
@@ -819,81 +867,54 @@ struct NoteSeq16Display : LightWidget {
 				}
 			}
 
-			// translate and draw the scrolling grid content
-			nvgSave(args.vg);
-			nvgTranslate(args.vg, -scrollX, 0);
+			// Only the columns in view are drawn
+			int firstCol = clampijw((int)(scrollX / HW), 0, COLS);
+			int lastCol = clampijw((int)ceilf((scrollX + box.size.x) / HW), 0, COLS);
+			bool cached = false;
+#ifndef METAMODULE
+			cached = module && drawCachedGrid(args, firstCol, lastCol);
+#endif
+			if (!cached) {
+				nvgSave(args.vg);
+				nvgTranslate(args.vg, -scrollX, 0);
+				drawGrid(args.vg, firstCol, lastCol);
+				nvgRestore(args.vg);
+			}
+
+			if (module) {
+				// translate and draw the playhead and sequence bounds over the grid
+				nvgSave(args.vg);
+				nvgTranslate(args.vg, -scrollX, 0);
+				float gridH = ROWS * HW;
+				nvgStrokeWidth(args.vg, 2);
 
-			float gridH = ROWS * HW;
-			//grid
-			nvgStrokeColor(args.vg, nvgRGB(60, 70, 73));
-			for(int i=0;i<COLS+1;i++){
-				nvgStrokeWidth(args.vg, (i % 4 == 0) ? 2 : 1);
+				//seq start line
+				float startX = module->getSeqStart() * HW;
+				nvgStrokeColor(args.vg, nvgRGB(25, 150, 252));//blue
 				nvgBeginPath(args.vg);
-				nvgMoveTo(args.vg, i * HW, 0);
-				nvgLineTo(args.vg, i * HW, gridH);
+				nvgMoveTo(args.vg, startX, 0);
+				nvgLineTo(args.vg, startX, gridH);
 				nvgStroke(args.vg);
-			}
-			for(int i=0;i<ROWS+1;i++){
-				// nvgStrokeWidth(args.vg, (i % 4 == 0) ? 2 : 1);
-				nvgStrokeWidth(args.vg, 1);
+
+				//seq length line
+				float endX = (module->getSeqEnd() + 1) * HW;
+				nvgStrokeColor(args.vg, nvgRGB(255, 243, 9));//yellow
 				nvgBeginPath(args.vg);
-				nvgMoveTo(args.vg, 0, i * HW);
-				nvgLineTo(args.vg, COLS * HW, i * HW);
+				nvgMoveTo(args.vg, endX, 0);
+				nvgLineTo(args.vg, endX, gridH);
 				nvgStroke(args.vg);
-			}
 
-			// blue division lines every 16 columns for visual grouping
-			nvgStrokeColor(args.vg, nvgRGB(25, 150, 252));
-			nvgStrokeWidth(args.vg, 2);
-			for (int i = 0; i <= COLS; i += 16) {
+				//seq pos
+				int pos = module->resetMode ? module->getSeqStart() : module->seqPos;
+				nvgStrokeColor(args.vg, nvgRGB(255, 255, 255));
 				nvgBeginPath(args.vg);
-				nvgMoveTo(args.vg, i * HW, 0);
-				nvgLineTo(args.vg, i * HW, box.size.y);
+				nvgRect(args.vg, pos * HW, 0, HW, gridH);
 				nvgStroke(args.vg);
-			}
 
-			if(module == NULL) return;
-
-			//cells
-			nvgFillColor(args.vg, nvgRGB(255, 151, 9));//orange
-			for(int i=0;i<CELLS;i++){
-				if(module->cells[i]){
-					int x = module->xFromI(i);
-					int y = module->yFromI(i);
-					nvgBeginPath(args.vg);
-					nvgRect(args.vg, x * HW, y * HW, HW, HW);
-					nvgFill(args.vg);
-				}
+				// restore transform so overlay scrollbar stays fixed
+				nvgRestore(args.vg);
 			}
 
-			nvgStrokeWidth(args.vg, 2);
-
-			//seq start line
-			float startX = module->getSeqStart() * HW;
-			nvgStrokeColor(args.vg, nvgRGB(25, 150, 252));//blue
-			nvgBeginPath(args.vg);
-			nvgMoveTo(args.vg, startX, 0);
-			nvgLineTo(args.vg, startX, gridH);
-			nvgStroke(args.vg);
-
-			//seq length line
-			float endX = (module->getSeqEnd() + 1) * HW;
-			nvgStrokeColor(args.vg, nvgRGB(255, 243, 9));//yellow
-			nvgBeginPath(args.vg);
-			nvgMoveTo(args.vg, endX, 0);
-			nvgLineTo(args.vg, endX, gridH);
-			nvgStroke(args.vg);
-
-			//seq pos
-			int pos = module->resetMode ? module->getSeqStart() : module->seqPos;
-			nvgStrokeColor(args.vg, nvgRGB(255, 255, 255));
-			nvgBeginPath(args.vg);
-			nvgRect(args.vg, pos * HW, 0, HW, gridH);
-			nvgStroke(args.vg);
-
-			// restore transform so overlay scrollbar stays fixed
-			nvgRestore(args.vg);
-
 			// Draw overlay scrollbar at bottom
 			float trackH = 6.0f;
 			float sbTop = box.size.y - trackH;
@@ -1243,6 +1264,12 @@ void NoteSeq16Widget::appendContextMenu(Menu *menu) {
 	}
 	gateSlider->box.size.x = 175.0f;
 	menu->addChild(gateSlider);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = noteSeq16;
+	menu->addChild(userScalesItem);
 }
 
 
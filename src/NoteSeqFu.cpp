@@ -1,6 +1,7 @@
 #include <string.h>
 #include <algorithm>
 #include "JWModules.hpp"
+#include "BitGrid.hpp"
 
 #define ROWS 32
 #define COLS 32
@@ -127,10 +128,16 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	float rndFloat0to1AtClockStep = random::uniform();
 	bool resetMode = false;
 	bool *hitEnd = new bool[4];
-	bool *cells = new bool[CELLS];
-	bool *newCells = new bool[CELLS];
+	BitGrid<COLS, ROWS> cells;
+	LifeRule lifeRule;
+	bool lifeWrap = false;
+	bool lifeReseedOnCycle = false;
+	LifeCycleDetector lifeCycles;
+	int lifePeriod = 0;
 	ColNotes *colNotesCache = new ColNotes[COLS];
 	ColNotes *colNotesCache2 = new ColNotes[COLS];
+	// One per playhead, each has its own octave and semitone knobs
+	RowVoltageCache playHeadRowVolts[4];
 	dsp::SchmittTrigger clockTrig, resetTrig, clearTrig;
 	dsp::SchmittTrigger rndTrig, shiftUpTrig, shiftDownTrig, shiftChaosTrig;
 	dsp::SchmittTrigger rotateRightTrig, rotateLeftTrig, flipHorizTrig, flipVertTrig;
@@ -209,8 +216,6 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	}
 
 	~NoteSeqFu() {
-		delete [] cells;
-		delete [] newCells;
 		delete [] colNotesCache;
 		delete [] colNotesCache2;
 		delete [] playHeads;
@@ -226,6 +231,7 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		resetMode = true;
 		clearCells();
 		lifeCounter = 0;
+		lifeRuleChanged();
 	}
 
 	void onSampleRateChange() override {
@@ -238,10 +244,13 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		
 		json_t *cellsJ = json_array();
 		for (int i = 0; i < CELLS; i++) {
-			json_t *cellJ = json_integer((int) cells[i]);
+			json_t *cellJ = json_integer((int) cells.get(xFromI(i), yFromI(i)));
 			json_array_append_new(cellsJ, cellJ);
 		}
 		json_object_set_new(rootJ, "cells", cellsJ);
+		json_object_set_new(rootJ, "lifeRule", json_string(lifeRule.toString().c_str()));
+		json_object_set_new(rootJ, "lifeWrap", json_boolean(lifeWrap));
+		json_object_set_new(rootJ, "lifeReseedOnCycle", json_boolean(lifeReseedOnCycle));
 		
 		// gateMode
 		json_t *gateModeJ = json_integer((int) gateMode);
@@ -250,10 +259,12 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		// gate pulse length
 		json_object_set_new(rootJ, "gatePulseLenSec", json_real(gatePulseLenSec));
 
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *channelsJ = json_object_get(rootJ, "channels");
 		if (channelsJ){
 			channels = json_integer_value(channelsJ);
@@ -266,10 +277,21 @@ struct NoteSeqFu : Module,QuantizeUtils {
 			for (int i = 0; i < CELLS; i++) {
 				json_t *cellJ = json_array_get(cellsJ, i);
 				if (cellJ)
-					cells[i] = json_integer_value(cellJ);
+					cells.set(xFromI(i), yFromI(i), json_integer_value(cellJ));
 			}
 		}
 
+		json_t *lifeRuleJ = json_object_get(rootJ, "lifeRule");
+		if (lifeRuleJ && json_is_string(lifeRuleJ))
+			LifeRule::parse(json_string_value(lifeRuleJ), lifeRule);
+		json_t *lifeWrapJ = json_object_get(rootJ, "lifeWrap");
+		if (lifeWrapJ)
+			lifeWrap = json_boolean_value(lifeWrapJ);
+		json_t *lifeReseedOnCycleJ = json_object_get(rootJ, "lifeReseedOnCycle");
+		if (lifeReseedOnCycleJ)
+			lifeReseedOnCycle = json_boolean_value(lifeReseedOnCycleJ);
+		lifeRuleChanged();
+
 		// gateMode
 		json_t *gateModeJ = json_object_get(rootJ, "gateMode");
 		if (gateModeJ)
@@ -331,9 +353,10 @@ struct NoteSeqFu : Module,QuantizeUtils {
 				bool pulse = (mainPulse && params[REPEATS_PARAM].getValue()) || (playHeads[p].gatePulse.process(1.0 / args.sampleRate));
 				int seqPos = playHeads[p].seqPos;
 				int *polyYVals = getYValsFromBottomAtSeqPos(params[INCLUDE_INACTIVE_PARAM].getValue(), seqPos);
+				updateRowVolts(p);
 				for(int i=0;i<channels;i++){
 					bool hasVal = polyYVals[i] > -1;
-					bool cellActive = hasVal && cells[iFromXY(seqPos, ROWS - polyYVals[i] - 1)];
+					bool cellActive = hasVal && cells.get(seqPos, ROWS - polyYVals[i] - 1);
 					if(cellActive){ 
 						float volts = closestVoltageForRow(polyYVals[i], p);
 						outputs[POLY_VOCT_OUTPUT + p].setVoltage(volts, i);
@@ -381,16 +404,12 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		cache[seqPos].includeInactive = includeInactive;
 		for(int i=0;i<COLS;i++){ cache[seqPos].vals[i] = -1; }
 
+		// Rows finalLow-1 to finalHigh-1 counted from the bottom, lowest first
+		uint32_t rows = includeInactive ? cells.COL_MASK : cells.columnFromBottom(seqPos);
+		rows &= (cells.COL_MASK >> (ROWS - finalHigh)) & ~((1u << (finalLow - 1)) - 1);
 		int valIdx = 0;
-		for(int i=CELLS-1;i>=0;i--){
-			int x = xFromI(i);
-			if(x == seqPos && (cells[i] || includeInactive)){
-				int y = yFromI(i);
-				int yFromBottom = ROWS - 1 - y;
-				if(yFromBottom <= finalHigh-1 && yFromBottom >= finalLow-1){
-					cache[seqPos].vals[valIdx++] = yFromBottom;
-				}
-			}
+		for(; rows; rows &= rows - 1){
+			cache[seqPos].vals[valIdx++] = lowestBit(rows);
 		}
 		return cache[seqPos].vals;
 	}
@@ -411,15 +430,6 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		}
 	}
 
-	void swapCells() {
-		std::swap(cells, newCells);
-		gridChanged();
-
-		for(int i=0;i<CELLS;i++){
-			newCells[i] = false;
-		}
-	}
-
 	int getFinalHighestNote1to32(){
 		int inputOffset = inputs[HIGHEST_NOTE_INPUT].isConnected() ? int(rescalefjw(inputs[HIGHEST_NOTE_INPUT].getVoltage(), -5, 5, -17, 17)) : 0;
 		return clampijw(params[HIGHEST_NOTE_PARAM].getValue() + inputOffset, 1, 32);
@@ -430,7 +440,7 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		return clampijw(params[LOWEST_NOTE_PARAM].getValue() + inputOffset, 1, 32);
 	}
 
-	float closestVoltageForRow(int cellYFromBottom, int playHeadIdx){
+	void updateRowVolts(int playHeadIdx){
 		int octave = clampijw(params[OCTAVE_KNOB_PARAM + playHeadIdx].getValue(), -5.0, 7.0);
 		int semi = clampijw(params[SEMI_KNOB_PARAM + playHeadIdx].getValue(), -11.0, 11.0);
 
@@ -440,7 +450,11 @@ struct NoteSeqFu : Module,QuantizeUtils {
 		int scaleInputOffset = inputs[SCALE_INPUT].isConnected() ? rescalefjw(inputs[SCALE_INPUT].getVoltage(), 0, 10, 0, QuantizeUtils::NUM_SCALES-1) : 0;
 		int scale = clampijw(params[SCALE_KNOB_PARAM].getValue() + scaleInputOffset, 0, QuantizeUtils::NUM_SCALES-1);
 
-		return closestVoltageInScale(octave + (semi * 0.0833) + (cellYFromBottom * 0.0833), rootNote, scale);
+		playHeadRowVolts[playHeadIdx].update(this, octave + (semi * 0.0833), rootNote, scale);
+	}
+
+	float closestVoltageForRow(int cellYFromBottom, int playHeadIdx){
+		return playHeadRowVolts[playHeadIdx].voltsForRow(cellYFromBottom);
 	}
 
 	void clockStep(){
@@ -552,91 +566,58 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	}
 
 	void rotateCells(RotateDirection dir){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				switch(dir){
-					case DIR_RIGHT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(y, COLS - x - 1)];
-						break;
-					case DIR_LEFT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(COLS - y - 1, x)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
+		cells.rotateSquares(dir == DIR_RIGHT);
+		gridChanged();
 	}
 
 	void flipCells(FlipDirection dir){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				switch(dir){
-					case DIR_HORIZ:
-						newCells[iFromXY(x, y)] = cells[iFromXY(COLS - 1 - x, y)];
-						break;
-					case DIR_VERT:
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, ROWS - 1 - y)];
-						break;
-				}
-
-			}
-		}
-		swapCells();
+		if(dir == DIR_HORIZ) cells.flipHoriz();
+		else cells.flipVert();
+		gridChanged();
 	}
 
 	void shiftCells(ShiftDirection dir){
 		int inputOffset = inputs[SHIFT_AMT_INPUT].isConnected() ? rescalefjw(inputs[SHIFT_AMT_INPUT].getVoltage(), -5, 5, -32, 32) : 0;
 		int amount = clampijw(params[SHIFT_AMT_KNOB_PARAM].getValue() + inputOffset, -32, 32);
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				int newX = 0, newY = 0;
-				switch(dir){
-					case DIR_UP:
-						//if at top, start from bottom up
-						newY = (y + amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-					case DIR_DOWN:
-						//if at bottom, start from top down
-						newY = (y - amount) % ROWS;
-						if(newY < 0) newY = ROWS + newY;
-						newCells[iFromXY(x, y)] = cells[iFromXY(x, newY)];
-						break;
-					case DIR_CHAOS:
+		switch(dir){
+			case DIR_UP:
+				cells.rotateRows(amount);
+				break;
+			case DIR_DOWN:
+				cells.rotateRows(-amount);
+				break;
+			case DIR_CHAOS:{
+				// Two draws for every cell, on or off, so seeded patches scatter the same way as before
+				BitGrid<COLS, ROWS> shifted;
+				for(int x=0; x < COLS; x++){
+					for(int y=0; y < ROWS; y++){
 						bool rndX = random::uniform() < 0.5;
-						newX = (x - amount * (rndX?1:-1)) % COLS;
+						int newX = (x - amount * (rndX?1:-1)) % COLS;
 						if(newX < 0) newX = COLS + newX;
 
 						bool rndY = random::uniform() < 0.5;
-						newY = (y - amount * (rndY?1:-1)) % ROWS;
+						int newY = (y - amount * (rndY?1:-1)) % ROWS;
 						if(newY < 0) newY = ROWS + newY;
-						if(cells[iFromXY(x, y)]){
-							newCells[iFromXY(newX, newY)] = cells[iFromXY(x, y)];
+						if(cells.get(x, y)){
+							shifted.set(newX, newY, true);
 						}
-						break;
+					}
 				}
-
+				cells = shifted;
+				break;
 			}
 		}
-		swapCells();
+		gridChanged();
 	}
 
 	void clearCells() {
-		for(int i=0;i<CELLS;i++){
-			cells[i] = false;
-			newCells[i] = false;
-		}
+		cells.clear();
 		gridChanged();
 	}
 
 	void repeatFirst16StepsAcross() {
 		for (int x = 16; x < COLS; x++) {
-			int srcX = x % 16;
-			for (int y = 0; y < ROWS; y++) {
-				cells[iFromXY(x, y)] = cells[iFromXY(srcX, y)];
-			}
+			cells.cols[x] = cells.cols[x % 16];
 		}
 		gridChanged();
 	}
@@ -767,33 +748,22 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	}
 
 	void stepLife(){
-		for(int x=0; x < COLS; x++){
-			for(int y=0; y < ROWS; y++){
-				int cellIdx = iFromXY(x, y);
-				int neighbors = getNeighborCount(x,y);
-				newCells[cellIdx] = cells[cellIdx];
-				if(neighbors<2 || neighbors>3) {
-					newCells[cellIdx] = false;
-				} else if (neighbors==3 && !cells[cellIdx]) {
-					newCells[cellIdx] = true;
-				}
-			}
+		if(lifeCycles.empty()){
+			lifeCycles.add(cells.hash());
 		}
-		swapCells();
-	}
-	
-	int getNeighborCount(int x, int y){
-		int result = 0;
-		for(int i=-1; i<=1; i++){
-			for(int j=-1; j<=1; j++){
-				int newX = x + i;
-				int newY = y + j;
-				if(newX==x && newY==y)continue;
-				if(newX>=0 && newY>=0 && newX<COLS && newY<ROWS && 
-					cells[iFromXY(newX, newY)]) result++;
-			}
+		cells.stepLife(lifeRule, lifeWrap);
+		gridChanged();
+		lifePeriod = lifeCycles.add(cells.hash());
+		if(lifePeriod > 0 && lifeReseedOnCycle){
+			randomizeCells();
+			lifeRuleChanged();
 		}
-		return result;
+	}
+
+	// States seen under another rule say nothing about where this one goes
+	void lifeRuleChanged(){
+		lifeCycles.reset();
+		lifePeriod = 0;
 	}
   
 	void setCellOnByDisplayPos(float displayX, float displayY, bool on){
@@ -803,7 +773,7 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	void setCellOn(int cellX, int cellY, bool on){
 		if(cellX >= 0 && cellX < COLS && 
 		   cellY >=0 && cellY < ROWS){
-			cells[iFromXY(cellX, cellY)] = on;
+			cells.set(cellX, cellY, on);
 			colNotesCache[cellX].valid = false;
 			colNotesCache2[cellX].valid = false;
 		}
@@ -814,7 +784,7 @@ struct NoteSeqFu : Module,QuantizeUtils {
 	}
 
 	bool isCellOn(int cellX, int cellY){
-		return cells[iFromXY(cellX, cellY)];
+		return cellX >= 0 && cellX < COLS && cellY >= 0 && cellY < ROWS && cells.get(cellX, cellY);
 	}
 
 	int iFromXY(int cellX, int cellY){
@@ -921,10 +891,9 @@ struct NoteSeqFuDisplay : LightWidget {
 
 			//cells
 			nvgFillColor(args.vg, nvgRGB(25, 150, 252)); //blue
-			for(int i=0;i<CELLS;i++){
-				if(module->cells[i]){
-					int x = module->xFromI(i);
-					int y = module->yFromI(i);
+			for(int x=0;x<COLS;x++){
+				for(uint32_t col = module->cells.column(x); col; col &= col - 1){
+					int y = lowestBit(col);
 					nvgBeginPath(args.vg);
 					nvgRect(args.vg, x * HW, y * HW, HW, HW);
 					nvgFill(args.vg);
@@ -1224,6 +1193,22 @@ void NoteSeqFuWidget::appendContextMenu(Menu *menu) {
 	}
 	gateSlider->box.size.x = 175.0f;
 	menu->addChild(gateSlider);
+
+	LifeRuleItem *lifeRuleItem = new LifeRuleItem();
+	lifeRuleItem->text = "Life Rule";
+	lifeRuleItem->rightText = noteSeqFu->lifeRule.toString() + (noteSeqFu->lifeWrap ? " Torus" : "") + " " + RIGHT_ARROW;
+	lifeRuleItem->rule = &noteSeqFu->lifeRule;
+	lifeRuleItem->wrap = &noteSeqFu->lifeWrap;
+	lifeRuleItem->reseedOnCycle = &noteSeqFu->lifeReseedOnCycle;
+	lifeRuleItem->period = &noteSeqFu->lifePeriod;
+	lifeRuleItem->changed = [noteSeqFu]() { noteSeqFu->lifeRuleChanged(); };
+	menu->addChild(lifeRuleItem);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = noteSeqFu;
+	menu->addChild(userScalesItem);
 }
 
 Model *modelNoteSeqFu = createModel<NoteSeqFu, NoteSeqFuWidget>("NoteSeqFu");
@@ -1,41 +1,15 @@
 #include "rack.hpp"
-#include <iterator> // for std::begin, std::end
+#include "ScalaScales.hpp"
+#include "ScaleTables.hpp"
+#include <cstdint>
 #include <algorithm>
 
 struct QuantizeUtils {
 
 	bool inputsOverride = false;
 
-
-	//copied & fixed these scales http://www.grantmuller.com/MidiReference/doc/midiReference/ScaleReference.html
-	//more scales http://lawriecape.co.uk/theblog/index.php/archives/881
-	int SCALE_AEOLIAN        [8] = {0, 2, 3, 5, 7, 8, 10, 12};
-	int SCALE_BLUES          [7] = {0, 3, 5, 6, 7, 10, 12}; //FIXED!
-	int SCALE_CHROMATIC      [13]= {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
-	int SCALE_DIATONIC_MINOR [8] = {0, 2, 3, 5, 7, 8, 10, 12};
-	int SCALE_DORIAN         [8] = {0, 2, 3, 5, 7, 9, 10, 12};
-	int SCALE_HARMONIC_MINOR [8] = {0, 2, 3, 5, 7, 8, 11, 12};
-	int SCALE_INDIAN         [8] = {0, 1, 1, 4, 5, 8, 10, 12};
-	int SCALE_LOCRIAN        [8] = {0, 1, 3, 5, 6, 8, 10, 12};
-	int SCALE_LYDIAN         [8] = {0, 2, 4, 6, 7, 9, 11, 12};
-	int SCALE_MAJOR          [8] = {0, 2, 4, 5, 7, 9, 11, 12};
-	int SCALE_MELODIC_MINOR  [10] = {0, 2, 3, 5, 7, 8, 9, 10, 11, 12};
-	int SCALE_MINOR          [8] = {0, 2, 3, 5, 7, 8, 10, 12};
-	int SCALE_MIXOLYDIAN     [8] = {0, 2, 4, 5, 7, 9, 10, 12};
-	int SCALE_NATURAL_MINOR  [8] = {0, 2, 3, 5, 7, 8, 10, 12};
-	int SCALE_PENTATONIC     [6] = {0, 2, 4, 7, 9, 12};
-	int SCALE_PENTATONIC_MINOR [6] = {0, 3, 5, 7, 10, 12};
-	int SCALE_WHOLE_TONE     [7] = {0, 2, 4, 6, 8, 10, 12};
-	int SCALE_DIMINISHED     [9] = {0, 2, 3, 5, 6, 8, 9, 11, 12};
-	int SCALE_HARMONIC_MAJOR [8] = {0, 2, 4, 5, 7, 8, 11, 12};
-	int SCALE_DOUBLE_HARMONIC[8] = {0, 1, 4, 5, 7, 8, 11, 12};
-	int SCALE_MAJOR_BEBOP    [9] = {0, 2, 4, 5, 7, 8, 9, 11, 12};
-	int SCALE_MINOR_BEBOP    [9] = {0, 2, 3, 5, 7, 8, 9, 10, 12};
-	int SCALE_PHRYGIAN_DOMINANT [8] = {0, 1, 4, 5, 7, 8, 10, 12};
-	int SCALE_HUNGARIAN_MINOR [8] = {0, 2, 3, 6, 7, 8, 11, 12};
-	int SCALE_ALTERED        [8] = {0, 1, 3, 4, 6, 8, 10, 12};
-	int SCALE_PHRYGIAN       [8] = {0, 1, 3, 5, 7, 8, 10, 12};
-	int SCALE_TURKISH        [8] = {0, 1, 3, 5, 7, 10, 11, 12};
+	// Scala scales the user put in place of built-in ones
+	UserScaleSlots userScales;
 
 	enum NoteEnum {
 		NOTE_C, 
@@ -87,79 +61,36 @@ struct QuantizeUtils {
 		NUM_SCALES
 	};
 
-	// long printIter = 0;
+	static_assert(LENGTHOF(SCALE_MASKS) == NUM_SCALES, "SCALE_MASKS must follow ScaleEnum");
+	static_assert(NUM_SCALES <= USER_SCALE_SLOTS, "every scale needs a user scale slot");
+
+	const UserScale *userScale(int scale) const {
+		return userScales.get(scale);
+	}
+
 	float closestVoltageInScale(float voltsIn, int rootNote, int currScale, bool noneIsChromatic=false) {
+		if (const UserScale *user = userScale(currScale)) {
+			return user->quantize(voltsIn, rootNote);
+		}
 		if(!noneIsChromatic && (currScale == NONE || currScale == NONE2)){
 			return voltsIn;
 		}
 
-		int *curScaleArr;
-		int notesInScale = 0;
-		switch(currScale){
-			case AEOLIAN:        curScaleArr = SCALE_AEOLIAN;       notesInScale=LENGTHOF(SCALE_AEOLIAN); break;
-			case BLUES:          curScaleArr = SCALE_BLUES;         notesInScale=LENGTHOF(SCALE_BLUES); break;
-			case CHROMATIC:      curScaleArr = SCALE_CHROMATIC;     notesInScale=LENGTHOF(SCALE_CHROMATIC); break;
-			case DIATONIC_MINOR: curScaleArr = SCALE_DIATONIC_MINOR;notesInScale=LENGTHOF(SCALE_DIATONIC_MINOR); break;
-			case DORIAN:         curScaleArr = SCALE_DORIAN;        notesInScale=LENGTHOF(SCALE_DORIAN); break;
-			case HARMONIC_MINOR: curScaleArr = SCALE_HARMONIC_MINOR;notesInScale=LENGTHOF(SCALE_HARMONIC_MINOR); break;
-			case INDIAN:         curScaleArr = SCALE_INDIAN;        notesInScale=LENGTHOF(SCALE_INDIAN); break;
-			case LOCRIAN:        curScaleArr = SCALE_LOCRIAN;       notesInScale=LENGTHOF(SCALE_LOCRIAN); break;
-			case LYDIAN:         curScaleArr = SCALE_LYDIAN;        notesInScale=LENGTHOF(SCALE_LYDIAN); break;
-			case MAJOR:          curScaleArr = SCALE_MAJOR;         notesInScale=LENGTHOF(SCALE_MAJOR); break;
-			case MELODIC_MINOR:  curScaleArr = SCALE_MELODIC_MINOR; notesInScale=LENGTHOF(SCALE_MELODIC_MINOR); break;
-			case MINOR:          curScaleArr = SCALE_MINOR;         notesInScale=LENGTHOF(SCALE_MINOR); break;
-			case MIXOLYDIAN:     curScaleArr = SCALE_MIXOLYDIAN;    notesInScale=LENGTHOF(SCALE_MIXOLYDIAN); break;
-			case NATURAL_MINOR:  curScaleArr = SCALE_NATURAL_MINOR; notesInScale=LENGTHOF(SCALE_NATURAL_MINOR); break;
-			case PENTATONIC:     curScaleArr = SCALE_PENTATONIC;    notesInScale=LENGTHOF(SCALE_PENTATONIC); break;
-			case PHRYGIAN:       curScaleArr = SCALE_PHRYGIAN;      notesInScale=LENGTHOF(SCALE_PHRYGIAN); break;
-			case TURKISH:        curScaleArr = SCALE_TURKISH;       notesInScale=LENGTHOF(SCALE_TURKISH); break;
-			case NONE:           curScaleArr = SCALE_CHROMATIC;     notesInScale=LENGTHOF(SCALE_CHROMATIC); break;
-			case NONE2:           curScaleArr = SCALE_CHROMATIC;     notesInScale=LENGTHOF(SCALE_CHROMATIC); break;
-			case PENTATONIC_MINOR: curScaleArr = SCALE_PENTATONIC_MINOR; notesInScale=LENGTHOF(SCALE_PENTATONIC_MINOR); break;
-			case WHOLE_TONE:     curScaleArr = SCALE_WHOLE_TONE;    notesInScale=LENGTHOF(SCALE_WHOLE_TONE); break;
-			case DIMINISHED:     curScaleArr = SCALE_DIMINISHED;    notesInScale=LENGTHOF(SCALE_DIMINISHED); break;
-			case HARMONIC_MAJOR: curScaleArr = SCALE_HARMONIC_MAJOR;notesInScale=LENGTHOF(SCALE_HARMONIC_MAJOR); break;
-			case DOUBLE_HARMONIC:curScaleArr = SCALE_DOUBLE_HARMONIC;notesInScale=LENGTHOF(SCALE_DOUBLE_HARMONIC); break;
-			case MAJOR_BEBOP:    curScaleArr = SCALE_MAJOR_BEBOP;   notesInScale=LENGTHOF(SCALE_MAJOR_BEBOP); break;
-			case MINOR_BEBOP:    curScaleArr = SCALE_MINOR_BEBOP;   notesInScale=LENGTHOF(SCALE_MINOR_BEBOP); break;
-			case PHRYGIAN_DOMINANT: curScaleArr = SCALE_PHRYGIAN_DOMINANT; notesInScale=LENGTHOF(SCALE_PHRYGIAN_DOMINANT); break;
-			case HUNGARIAN_MINOR:curScaleArr = SCALE_HUNGARIAN_MINOR;notesInScale=LENGTHOF(SCALE_HUNGARIAN_MINOR); break;
-			case ALTERED:        curScaleArr = SCALE_ALTERED;       notesInScale=LENGTHOF(SCALE_ALTERED); break;
-		}
-
 		//C1 == -2.00, C2 == -1.00, C3 == 0.00, C4 == 1.00
 		//B1 == -1.08, B2 == -0.08, B3 == 0.92, B4 == 1.92
-		float closestVal = 10.0;
-		float closestDist = 10.0;
-		float scaleNoteInVolts = 0;
-		float distAway = 0;
-		// Quantize in root-relative space so repeated quantization is stable.
-		float rootVolts = rootNote / 12.0f;
-		float voltsRootRelative = voltsIn - rootVolts;
-		int octaveInVolts = int(floorf(voltsRootRelative));
-		float voltMinusOct = voltsRootRelative - octaveInVolts;
-		for (int i=0; i < notesInScale; i++) {
-			scaleNoteInVolts = curScaleArr[i] / 12.0;
-			distAway = fabs(voltMinusOct - scaleNoteInVolts);
-			if(distAway < closestDist){
-				closestVal = scaleNoteInVolts;
-				closestDist = distAway;
-			}
-
-			// if(printIter%100000==0){
-			// 	printf("i:%i, rootNote:%i, voltsIn:%f, octaveInVolts:%i, closestVal:%f, closestDist:%f\n", 
-			// 	        i,    rootNote,    voltsIn,    octaveInVolts,    closestVal,    closestDist);
-			// 	printIter = 0;
-			// }
+		return nearestInScale(voltsIn, rootNote, currScale);
+	}
+
+	// Four channels at once, always quantizing (NONE is chromatic). Same results as the scalar
+	// version lane for lane for finite inputs.
+	rack::simd::float_4 closestVoltageInScale(rack::simd::float_4 voltsIn, int rootNote, int currScale) {
+		if (const UserScale *user = userScale(currScale)) {
+			rack::simd::float_4 voltsOut;
+			for (int i = 0; i < 4; i++)
+				voltsOut[i] = user->quantize(voltsIn[i], rootNote);
+			return voltsOut;
 		}
-		// printIter++;
-		float voltsOut = octaveInVolts + rootVolts + closestVal;
-		// if(printIter%100000==0){
-		// 	printf("voltsIn:%f, voltsOut:%f, closestVal:%f\n", 
-		// 			voltsIn,    voltsOut,    closestVal);
-		// 	printIter = 0;
-		// }
-		return voltsOut;
+		return nearestInScale4(voltsIn, rootNote, currScale);
 	}
 
 	std::string noteName(int note) {
@@ -181,6 +112,13 @@ struct QuantizeUtils {
 	}
 
 	std::string scaleName(int scale) {
+		if (scale >= 0 && scale < NUM_SCALES) {
+			if (const UserScale *user = userScale(scale)) return user->name;
+		}
+		return builtInScaleName(scale);
+	}
+
+	std::string builtInScaleName(int scale) {
 		switch(scale){
 			case AEOLIAN:        return "Aeolian";
 			case BLUES:          return "Blues";
@@ -214,4 +152,41 @@ struct QuantizeUtils {
 			default: return "";
 		}
 	}
-};
\ No newline at end of file
+};
+// Quantized voltage of each row of a note grid. A row is quantized the first time it's asked
+// for and then only again after the octave, root, scale or user scale changes, so a sequencer
+// holding its notes between clocks does no quantizing at all.
+struct RowVoltageCache {
+	static const int MAX_ROWS = 32;
+
+	// Once per sample, before voltsForRow. baseVolts is the voltage of the bottom row.
+	void update(QuantizeUtils *quantizeUtils, double baseVolts, int rootNote, int scale) {
+		const UserScale *userScale = quantizeUtils->userScale(scale);
+		if (baseVolts != this->baseVolts || rootNote != this->rootNote || scale != this->scale || userScale != this->userScale) {
+			this->quantizeUtils = quantizeUtils;
+			this->baseVolts = baseVolts;
+			this->rootNote = rootNote;
+			this->scale = scale;
+			this->userScale = userScale;
+			valid = 0;
+		}
+	}
+
+	float voltsForRow(int row) {
+		uint32_t bit = 1u << row;
+		if (!(valid & bit)) {
+			volts[row] = quantizeUtils->closestVoltageInScale(baseVolts + (row * 0.0833), rootNote, scale);
+			valid |= bit;
+		}
+		return volts[row];
+	}
+
+private:
+	QuantizeUtils *quantizeUtils = nullptr;
+	double baseVolts = 0.0;
+	int rootNote = -1;
+	int scale = -1; // never a real scale, so the first update fills everything in
+	const UserScale *userScale = nullptr;
+	uint32_t valid = 0;
+	float volts[MAX_ROWS];
+};
@@ -16,6 +16,7 @@ struct Quantizer : Module, QuantizeUtils {
 	};
 	enum OutputIds {
 		VOLT_OUTPUT,
+		CHANGE_OUTPUT,
 		NUM_OUTPUTS
 	};
 	enum LightIds {
@@ -26,6 +27,16 @@ struct Quantizer : Module, QuantizeUtils {
 	int rootNote = 0;
 	int octaveShift = 0;
 
+	// Last input and output of each group of four channels. A group whose inputs and settings
+	// have not changed keeps its output without quantizing again.
+	simd::float_4 lastIn[PORT_MAX_CHANNELS / 4];
+	simd::float_4 lastOut[PORT_MAX_CHANNELS / 4];
+	dsp::PulseGenerator changePulse[PORT_MAX_CHANNELS];
+	int lastRootNote = -1;
+	int lastScale = -1;
+	int lastOctaveShift = 0;
+	const UserScale *lastUserScale = nullptr;
+
 	Quantizer() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(ROOT_NOTE_PARAM, 0.0, QuantizeUtils::NUM_NOTES-1, QuantizeUtils::NOTE_C, "Root Note");
@@ -36,7 +47,12 @@ struct Quantizer : Module, QuantizeUtils {
 		configInput(VOLT_INPUT, "Voltage");
 		configInput(OCTAVE_INPUT, "Octave");
 		configOutput(VOLT_OUTPUT, "Quantized");
+		configOutput(CHANGE_OUTPUT, "Note changed trigger");
 		configBypass(VOLT_INPUT, VOLT_OUTPUT);
+		for (int g = 0; g < PORT_MAX_CHANNELS / 4; g++) {
+			// NAN so the first pass quantizes everything without reporting a change
+			lastIn[g] = lastOut[g] = NAN;
+		}
 	}
 
 	void process(const ProcessArgs &args) override;
@@ -44,10 +60,12 @@ struct Quantizer : Module, QuantizeUtils {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_object_set_new(rootJ, "inputsOverride", json_boolean(inputsOverride));
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
 		json_t *inputsOverrideJ = json_object_get(rootJ, "inputsOverride");
 		if (inputsOverrideJ){ inputsOverride = json_is_true(inputsOverrideJ); }
 	}
@@ -70,6 +88,7 @@ void Quantizer::process(const ProcessArgs &args) {
 	} else {
 		scale = params[SCALE_PARAM].getValue() + inputScale;
 	}
+	scale = clampijw(scale, 0, QuantizeUtils::NUM_SCALES-1);
 
 	int inputOctaveShift = clampfjw(inputs[OCTAVE_INPUT].getVoltage(), -5, 5);
 	if(inputs[OCTAVE_INPUT].isConnected() && inputsOverride){
@@ -78,12 +97,37 @@ void Quantizer::process(const ProcessArgs &args) {
 		octaveShift = params[OCTAVE_PARAM].getValue() + inputOctaveShift;
 	}
 	
+	// A Scala scale finishing loading into the current slot counts as a scale change
+	const UserScale *user = userScale(scale);
+	bool settingsChanged = rootNote != lastRootNote || scale != lastScale || octaveShift != lastOctaveShift || user != lastUserScale;
+	lastUserScale = user;
+	lastRootNote = rootNote;
+	lastScale = scale;
+	lastOctaveShift = octaveShift;
+
 	int channels = inputs[VOLT_INPUT].getChannels();
-	for (int c = 0; c < channels; c++) {
-		float volts = closestVoltageInScale(inputs[VOLT_INPUT].getVoltage(c), rootNote, scale, true);
-		outputs[VOLT_OUTPUT].setVoltage(volts + octaveShift, c);
+	for (int c = 0; c < channels; c += 4) {
+		int g = c / 4;
+		simd::float_4 in = inputs[VOLT_INPUT].getVoltageSimd<simd::float_4>(c);
+		if (settingsChanged || simd::movemask(in == lastIn[g]) != 0xF) {
+			simd::float_4 out = closestVoltageInScale(in, rootNote, scale) + (float)octaveShift;
+			// A lane that had no note yet (NAN) does not trigger
+			int changed = simd::movemask((out != lastOut[g]) & (lastOut[g] == lastOut[g]));
+			for (int i = 0; i < 4; i++) {
+				if (changed & (1 << i)) changePulse[c + i].trigger(1e-3f);
+			}
+			lastIn[g] = in;
+			lastOut[g] = out;
+		}
+		outputs[VOLT_OUTPUT].setVoltageSimd(lastOut[g], c);
+		simd::float_4 change;
+		for (int i = 0; i < 4; i++) {
+			change[i] = changePulse[c + i].process(args.sampleTime) ? 10.f : 0.f;
+		}
+		outputs[CHANGE_OUTPUT].setVoltageSimd(change, c);
 	}
 	outputs[VOLT_OUTPUT].setChannels(channels);
+	outputs[CHANGE_OUTPUT].setChannels(channels);
 }
 
 struct QuantizerWidget : ModuleWidget {
@@ -154,6 +198,12 @@ QuantizerWidget::QuantizerWidget(Quantizer *module) {
 
 	addInput(createInput<TinyPJ301MPort>(Vec(10, 290), module, Quantizer::VOLT_INPUT));
 	addOutput(createOutput<TinyPJ301MPort>(Vec(35, 290), module, Quantizer::VOLT_OUTPUT));
+
+	CenteredLabel* const changeLabel = new CenteredLabel(10);
+	changeLabel->box.pos = Vec(11, 168);
+	changeLabel->text = "Chg";
+	addChild(changeLabel);
+	addOutput(createOutput<TinyPJ301MPort>(Vec(35, 326), module, Quantizer::CHANGE_OUTPUT));
 }
 
 void QuantizerWidget::appendContextMenu(Menu *menu) {
@@ -165,5 +215,11 @@ void QuantizerWidget::appendContextMenu(Menu *menu) {
 	inputsOverrideItem->text = "Inputs Override Knobs";
 	inputsOverrideItem->quantizeUtils = quantizer;
 	menu->addChild(inputsOverrideItem);
+
+	UserScalesItem *userScalesItem = new UserScalesItem();
+	userScalesItem->text = "User Scales (Scala)";
+	userScalesItem->rightText = RIGHT_ARROW;
+	userScalesItem->quantizeUtils = quantizer;
+	menu->addChild(userScalesItem);
 }
 Model *modelQuantizer = createModel<Quantizer, QuantizerWidget>("Quantizer");
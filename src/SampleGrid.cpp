@@ -1,32 +1,62 @@
 #include "JWModules.hpp"
+#include "SamplePool.hpp"
+#include "SampleWorker.hpp"
+#include "SampleIndex.hpp"
+#include "WavWriter.hpp"
 #include <vector>
 #include <string>
 #include <fstream>
 #include <cstdint>
 #include <cstdlib>
 #include <algorithm>
-#include <unordered_map>
 #include <cmath>
 #include <cstring>
+#include <memory>
 #include "osdialog.h"
 #include "system.hpp"
-#include <dirent.h>
 #include <sys/stat.h>
-#ifdef _WIN32
-#include <windows.h>
-#endif
 #ifdef METAMODULE_BUILTIN
 #include "../../../metamodule-plugin-sdk/core-interface/filesystem/async_filebrowser.hh"
 #endif
 
-struct PendingRandomSamplesLock {
-	rack::SharedMutex &mutex;
-	explicit PendingRandomSamplesLock(rack::SharedMutex &m) : mutex(m) {
-		mutex.lock();
-	}
-	~PendingRandomSamplesLock() {
-		mutex.unlock();
-	}
+// UI thread -> engine
+struct SampleGridCommand {
+	enum Type { NONE, CLEAR_CELL };
+	Type type = NONE;
+	int cell = 0;
+};
+
+// UI thread or engine -> worker
+struct SampleGridJob {
+	enum Type { NONE, LOAD_PATH, LOAD_RANDOM_CELL, LOAD_RANDOM_ALL, SPLIT_PATH, DISPOSE, SAVE_CELLS };
+	Type type = NONE;
+	int cell = 0;
+	std::string path; // SAVE_CELLS: the patch storage directory
+	SampleChannel channel; // DISPOSE: audio the engine let go of, freed on the worker
+	uint32_t ticket = 0; // SAVE_CELLS: stored in savesDone once written
+};
+
+// Worker -> engine: a decoded cell ready to swap in
+struct SampleGridCellLoad {
+	int cell = -1;
+	SampleChannel channel;
+	std::string path;
+	int sampleRate = 0;
+	bool isSlice = false;
+	float sliceStartFrac = 0.f;
+	float sliceEndFrac = 1.f;
+};
+
+// Engine -> worker: the cells as they are now. The worker saves and outlines its copy, so
+// nothing but the engine ever touches cellSamples.
+struct SampleGridCells {
+	SampleChannel channels[16];
+	int sampleRates[16] = {};
+};
+
+// Worker -> UI: each cell's outline in playback order. Never changes once published.
+struct SampleGridWaveforms {
+	WaveOverview cells[16];
 };
 
 struct SampleGrid : Module {
@@ -141,8 +171,8 @@ struct SampleGrid : Module {
 	double playbackStep = 1.0; // bufferRate / hostRate
 	double playbackStartPos = 0.0; // position where current playback started
 
-	// Per-cell sample storage (mono for display)
-	std::vector<float> cellSamples[16];
+	// Per-cell sample storage (mono views into the shared sample pool)
+	SampleChannel cellSamples[16];
 	std::string cellSamplePath[16];
 	int cellSampleRate[16] = {0};
 	// Per-cell normalized start positions (0..1)
@@ -154,34 +184,39 @@ struct SampleGrid : Module {
 	float cellSliceStartFrac[16] = { 0.f };
 	float cellSliceEndFrac[16] = { 1.f };
 
-	// Selected directory for random sample loading
+	// Selected directory for random sample loading, shared by the UI and worker threads
 	std::string sampleDir;
+	std::mutex sampleDirMutex;
+	std::atomic<bool> hasSampleDir{false};
+	// Random picks: look in subfolders too, and skip files longer than this (0 = any length)
+	std::atomic<bool> includeSubfolders{false};
+	std::atomic<float> maxRandomLengthSec{0.f};
 
 	// Track whether we loaded audio from patch storage so JSON path loading can be skipped
 	bool loadedFromPatchStorage = false;
 
-	// UI-requested actions (performed on audio thread in process())
-	bool reqShuffleSamples = false;
-	bool reqReverseRandom = false;
-	bool reqRandomizeMutes = false;
-	bool reqSplitSampleInteractive = false;
-	bool reqRandomSamplesInteractive = false;
-	bool reqRandomSamplesFromDir = false;
-	rack::SharedMutex pendingRandomSamplesMutex;
-	bool pendingRandomSamplesReady = false;
-	bool pendingRandomCellValid[16] = {false};
-	std::vector<float> pendingRandomCellSamples[16];
-	std::string pendingRandomCellPath[16];
-	int pendingRandomCellRate[16] = {0};
-	// Per-cell UI requests to avoid UI-thread mutation races
-	bool reqClearCell[16] = {false};
-	bool reqLoadRandomCell[16] = {false};
-	bool reqLoadCellFromPath[16] = {false};
-	std::string pendingCellPath[16];
+	// Engine -> UI requests for actions that need a dialog
+	std::atomic<bool> reqSplitSampleInteractive{false};
+	std::atomic<bool> reqRandomSamplesInteractive{false};
+
+	// All disk I/O and decoding happens on the worker; the engine only swaps in ready buffers
+	SpscQueue<SampleGridCommand, 32> uiCommands;
+	SpscQueue<SampleGridJob, 32> uiJobs;
+	SpscQueue<SampleGridJob, 64> engineJobs;
+	SpscQueue<SampleGridCellLoad, 64> loadedCells;
+	SpscQueue<SampleGridCells, 4> publishedCells;
+	// Set whenever cellSamples change, until the worker has been sent a copy
+	bool cellsChanged = true;
+	SampleGridCells workerCells; // worker only
+	// Written by the worker, read by the UI; both go through std::atomic_load/atomic_store
+	std::shared_ptr<const SampleGridWaveforms> waveforms;
+	std::atomic<uint32_t> savesRequested{0};
+	std::atomic<uint32_t> savesDone{0};
+	SampleWorker worker;
 
 	// Built-in MetaModule builds cannot use desktop file I/O or dialogs.
 #if defined(METAMODULE_BUILTIN)
-	static bool writeMonoWav(const std::string &, const std::vector<float> &, int) { return false; }
+	static bool writeMonoWav(const std::string &, const SampleChannel &, int) { return false; }
 
 	void onAdd(const AddEvent& e) override {
 		Module::onAdd(e);
@@ -192,16 +227,7 @@ struct SampleGrid : Module {
 		Module::onSave(e);
 	}
 
-	bool collectWavsInDir(const std::string &, std::vector<std::string> &) {
-		return false;
-	}
-
-	bool loadRandomSamplesFromDir(const std::string &) {
-		return false;
-	}
-
-	bool prepareRandomSamplesFromDir(const std::string &) {
-		return false;
+	void saveCellsJob(const std::string &) {
 	}
 
 	void setSampleDirHandler(char *path) {
@@ -222,14 +248,8 @@ struct SampleGrid : Module {
 	void pickRandomWavPath(int) {
 	}
 
-	static bool loadWavMonoToBuffer(const std::string &, std::vector<float> &monoOut, int &sRateOut) {
-		monoOut.clear();
-		sRateOut = 0;
-		return false;
-	}
-
-	bool loadSplitSampleAcrossCells(const std::string &) {
-		return false;
+	static std::shared_ptr<const SampleBuffer> loadWavMono(const std::string &) {
+		return nullptr;
 	}
 
 	void loadSplitSampleInteractiveHandler(char *path) {
@@ -239,9 +259,6 @@ struct SampleGrid : Module {
 	void loadSplitSampleInteractive() {
 	}
 
-	void applyPendingRandomSamples() {
-	}
-
 	void shuffleSamples() {
 	}
 
@@ -253,45 +270,19 @@ struct SampleGrid : Module {
 	}
 #else
 	// Write a mono PCM16 WAV file
-	static bool writeMonoWav(const std::string &path, const std::vector<float> &mono, int sRate) {
+	static bool writeMonoWav(const std::string &path, const SampleChannel &mono, int sRate) {
 		if (mono.empty()) return false;
-		uint16_t numChannels = 1;
-		uint16_t bitsPerSample = 16;
-		uint32_t sampleRate = (sRate > 0) ? (uint32_t)sRate : 44100u;
-		uint16_t bytesPerSample = bitsPerSample / 8; // 2
-		uint16_t blockAlign = numChannels * bytesPerSample; // 2
-		uint32_t byteRate = sampleRate * blockAlign;
-		uint32_t dataSize = (uint32_t)(mono.size() * blockAlign);
-		std::ofstream out(path, std::ios::binary);
-		if (!out.good()) return false;
-		auto wU32 = [&](uint32_t v){ char b[4]; b[0]=(char)(v & 0xFF); b[1]=(char)((v>>8)&0xFF); b[2]=(char)((v>>16)&0xFF); b[3]=(char)((v>>24)&0xFF); out.write(b,4); };
-		auto wU16 = [&](uint16_t v){ char b[2]; b[0]=(char)(v & 0xFF); b[1]=(char)((v>>8)&0xFF); out.write(b,2); };
-		// RIFF
-		out.write("RIFF", 4);
-		wU32(36u + dataSize);
-		out.write("WAVE", 4);
-		// fmt
-		out.write("fmt ", 4);
-		wU32(16u);
-		wU16(1u); // PCM
-		wU16(numChannels);
-		wU32(sampleRate);
-		wU32(byteRate);
-		wU16(blockAlign);
-		wU16(bitsPerSample);
-		// data
-		out.write("data", 4);
-		wU32(dataSize);
-		for (size_t i = 0; i < mono.size(); ++i) {
-			float f = std::max(-1.f, std::min(1.f, mono[i]));
-			int s = (int)std::lround(f * 32767.0f);
-			if (s < -32768) s = -32768; if (s > 32767) s = 32767;
-			wU16((uint16_t)(s & 0xFFFF));
+		WavFile out;
+		if (!out.open(path, 1, (sRate > 0) ? sRate : 44100, WavFile::PCM16)) return false;
+		// Cells may be reversed slices, so copy out in playback order a chunk at a time
+		float chunk[1024];
+		for (size_t i = 0; i < mono.size();) {
+			size_t n = std::min(mono.size() - i, (size_t)1024);
+			for (size_t k = 0; k < n; ++k) chunk[k] = mono[i + k];
+			out.write(chunk, n);
+			i += n;
 		}
-		out.flush();
-		bool ok = out.good();
-		out.close();
-		return ok;
+		return out.close();
 	}
 
 	void onAdd(const AddEvent& e) override {
@@ -308,151 +299,45 @@ struct SampleGrid : Module {
 			}
 			if (loadedCount > 0) loadedFromPatchStorage = true;
 		}
+		publishCells();
 	}
 
+	// The worker writes the files from its copy of the cells. The patch is archived as soon as
+	// this returns, so wait for it.
 	void onSave(const SaveEvent& e) override {
 		Module::onSave(e);
 		std::string dir = createPatchStorageDirectory();
 		if (dir.empty()) return;
+		SampleGridJob job;
+		job.type = SampleGridJob::SAVE_CELLS;
+		job.path = dir;
+		job.ticket = ++savesRequested;
+		uint32_t ticket = job.ticket;
+		if (!uiJobs.push(std::move(job))) return;
+		worker.wake();
+		for (int ms = 0; ms < 10000 && savesDone.load() != ticket; ++ms) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	// Worker thread
+	void saveCellsJob(const std::string &dir) {
 		for (int i = 0; i < 16; ++i) {
 			char name[32]; snprintf(name, sizeof(name), "cell_%02d.wav", i);
 			std::string p = rack::system::join(dir, std::string(name));
-			if (cellSamples[i].empty()) {
+			if (workerCells.channels[i].empty()) {
 				// Ensure unloaded cells don't reload: remove any existing patch-storage file
 				rack::system::remove(p);
 			}
 			else {
-				int sr = (cellSampleRate[i] > 0) ? cellSampleRate[i] : 44100;
-				writeMonoWav(p, cellSamples[i], sr);
-			}
-		}
-	}
-
-	// Collect all WAV file paths in a directory (case-insensitive .wav)
-	bool collectWavsInDir(const std::string &dir, std::vector<std::string> &wavs) {
-		wavs.clear();
-#ifdef _WIN32
-		std::string pattern = dir;
-		if (!pattern.empty()) {
-			char last = pattern.back();
-			if (last != '/' && last != '\\') pattern += '\\';
-		}
-		pattern += "*.wav";
-		WIN32_FIND_DATAA ffd; HANDLE hFind = FindFirstFileA(pattern.c_str(), &ffd);
-		if (hFind == INVALID_HANDLE_VALUE) return false;
-		do {
-			if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
-			std::string name = ffd.cFileName;
-			std::string full = dir;
-			char last = full.empty() ? '\\' : full.back();
-			if (last != '/' && last != '\\') full += '\\';
-			full += name; wavs.push_back(full);
-		} while (FindNextFileA(hFind, &ffd));
-		FindClose(hFind);
-#else
-		DIR *dp = opendir(dir.c_str()); if (!dp) return false;
-		struct dirent *de;
-		while ((de = readdir(dp)) != nullptr) {
-			if (de->d_name[0] == '.') continue;
-			std::string name = de->d_name;
-			std::string full = dir + "/" + name;
-			bool isFile = false;
-#ifdef DT_REG
-			if (de->d_type == DT_REG) isFile = true;
-			else
-#endif
-			{
-				struct stat st; if (stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) isFile = true;
-			}
-			if (!isFile) continue;
-			size_t dot = name.find_last_of('.');
-			if (dot != std::string::npos) {
-				std::string ext = name.substr(dot);
-				std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-				if (ext == ".wav") wavs.push_back(full);
-			}
-		}
-		closedir(dp);
-#endif
-		return !wavs.empty();
-	}
-
-	// Load up to 16 random wavs from directory; returns true if at least one loaded
-	bool loadRandomSamplesFromDir(const std::string &dir) {
-		std::vector<std::string> wavs; if (!collectWavsInDir(dir, wavs)) return false;
-		for (int i = 0; i < 16; ++i) {
-			if (wavs.empty()) break;
-			size_t idx = (size_t)std::floor(random::uniform() * wavs.size());
-			loadCellSample(i, wavs[idx]);
-		}
-		return true;
-	}
-
-	// UI-thread loader: read/decode random samples, then stage for audio-thread swap.
-	bool prepareRandomSamplesFromDir(const std::string &dir) {
-		std::vector<std::string> wavs;
-		if (!collectWavsInDir(dir, wavs)) return false;
-
-		std::vector<float> stagedSamples[16];
-		std::string stagedPaths[16];
-		int stagedRates[16] = {0};
-		bool stagedValid[16] = {false};
-		bool anyLoaded = false;
-
-		for (int i = 0; i < 16; ++i) {
-			if (wavs.empty()) break;
-			size_t idx = (size_t)std::floor(random::uniform() * wavs.size());
-			const std::string &p = wavs[idx];
-			std::vector<float> mono;
-			int sRate = 0;
-			if (loadWavMonoToBuffer(p, mono, sRate)) {
-				stagedSamples[i] = std::move(mono);
-				stagedPaths[i] = p;
-				stagedRates[i] = sRate;
-				stagedValid[i] = true;
-				anyLoaded = true;
+				int sr = (workerCells.sampleRates[i] > 0) ? workerCells.sampleRates[i] : 44100;
+				writeMonoWav(p, workerCells.channels[i], sr);
 			}
 		}
-
-		if (!anyLoaded) return false;
-
-		PendingRandomSamplesLock lock(pendingRandomSamplesMutex);
-		for (int i = 0; i < 16; ++i) {
-			pendingRandomCellValid[i] = stagedValid[i];
-			if (stagedValid[i]) {
-				pendingRandomCellSamples[i] = std::move(stagedSamples[i]);
-				pendingRandomCellPath[i] = stagedPaths[i];
-				pendingRandomCellRate[i] = stagedRates[i];
-			}
-		}
-		pendingRandomSamplesReady = true;
-		return true;
-	}
-
-	// Audio-thread apply: only move preloaded buffers, no disk I/O.
-	void applyPendingRandomSamples() {
-		if (!pendingRandomSamplesReady) return;
-		PendingRandomSamplesLock lock(pendingRandomSamplesMutex);
-		if (!pendingRandomSamplesReady) return;
-
-		for (int i = 0; i < 16; ++i) {
-			if (!pendingRandomCellValid[i]) continue;
-			cellSamples[i] = std::move(pendingRandomCellSamples[i]);
-			cellSamplePath[i] = std::move(pendingRandomCellPath[i]);
-			cellSampleRate[i] = pendingRandomCellRate[i];
-			cellIsSlice[i] = false;
-			cellSliceStartFrac[i] = 0.f;
-			cellSliceEndFrac[i] = 1.f;
-			cellReversed[i] = false;
-			pendingRandomCellValid[i] = false;
-			pendingRandomCellRate[i] = 0;
-		}
-
-		pendingRandomSamplesReady = false;
 	}
 
 	void setSampleDirHandler(char *path) {
-		std::string dir = sampleDir;
+		std::string dir = getSampleDir();
 		if (!path) return;
 		std::string p = path; free(path);
 		struct stat st; if (stat(p.c_str(), &st) == 0) {
@@ -461,17 +346,17 @@ struct SampleGrid : Module {
 				size_t q = p.find_last_of("/\\"); dir = (q == std::string::npos) ? std::string(".") : p.substr(0, q);
 			}
 		}
-		if (!dir.empty()) { sampleDir = dir; }
+		if (!dir.empty()) { setSampleDir(dir); }
 	}
 	
 	void prepareRandomSamplesFromDirHandler(char *path) {
 		setSampleDirHandler(path);
-		prepareRandomSamplesFromDir(sampleDir);
+		postUiJob(SampleGridJob::LOAD_RANDOM_ALL);
 	}
 	
 	// Interactive: set dir if needed, then load random samples
 	void loadRandomSamplesInteractive(bool calledFromContextMenu) {
-		std::string dir = sampleDir;
+		std::string dir = getSampleDir();
 		// always raise the dialog box if called from context menu.
 		if (calledFromContextMenu || dir.empty()) {
 #if defined(METAMODULE_BUILTIN)
@@ -485,22 +370,18 @@ struct SampleGrid : Module {
 			}
 #endif
 		} else {
-			prepareRandomSamplesFromDir(dir); 
+			postUiJob(SampleGridJob::LOAD_RANDOM_ALL);
 		}
 	}
 
 	void pickRandomWavPathHandler(int idx, char * path) {
 		setSampleDirHandler(path);
-		std::string dir = sampleDir;
-		std::vector<std::string> wavs; if (!collectWavsInDir(dir, wavs)) return;
-		size_t idx_picked = (size_t)std::floor(random::uniform() * wavs.size());
-		std::string outPath = wavs[idx_picked];
-		loadCellSample(idx, outPath);
+		postUiJob(SampleGridJob::LOAD_RANDOM_CELL, idx);
 	}
 	
 	// Pick a single random WAV path from sampleDir, prompting to choose a directory if unset
 	void pickRandomWavPath(int idx) {
-		std::string dir = sampleDir;
+		std::string dir = getSampleDir();
 		if (dir.empty()) {
 #if defined(METAMODULE_BUILTIN)
 			async_osdialog_file(OSDIALOG_OPEN, NULL, NULL, NULL, [this, idx](char *path) {
@@ -513,10 +394,7 @@ struct SampleGrid : Module {
 			}
 #endif	
 		} else {
-			std::vector<std::string> wavs; if (!collectWavsInDir(dir, wavs)) return;
-			size_t idx_picked = (size_t)std::floor(random::uniform() * wavs.size());
-			std::string outPath = wavs[idx_picked];
-			loadCellSample(idx, outPath);
+			postUiJob(SampleGridJob::LOAD_RANDOM_CELL, idx);
 		}
 		return;
 	}
@@ -527,115 +405,15 @@ struct SampleGrid : Module {
 		return;
 	}
 
-	// Load full mono WAV buffer (like loadCellSample but returning buffer and rate)
-	static bool loadWavMonoToBuffer(const std::string &path, std::vector<float> &monoOut, int &sRateOut) {
-		monoOut.clear(); sRateOut = 0;
-		std::ifstream in(path, std::ios::binary);
-		if (!in.good()) return false;
-		char riff[4]; in.read(riff, 4);
-		if (in.gcount() != 4 || std::string(riff, 4) != "RIFF") return false;
-		(void)readU32(in);
-		char wave[4]; in.read(wave, 4);
-		if (in.gcount() != 4 || std::string(wave, 4) != "WAVE") return false;
-		uint16_t audioFormat = 1; // 1=PCM, 3=FLOAT
-		uint16_t numChannels = 1;
-		uint32_t sRate = 44100;
-		uint16_t bitsPerSample = 16;
-		uint32_t dataSize = 0;
-		std::streampos dataPos = 0;
-		while (in.good() && !in.eof()) {
-			char id[4]; in.read(id, 4); if (in.gcount() != 4) break;
-			uint32_t chunkSize = readU32(in);
-			std::string cid(id, 4);
-			if (cid == "fmt ") {
-				std::streampos start = in.tellg();
-				audioFormat = readU16(in);
-				numChannels = readU16(in);
-				sRate = readU32(in);
-				(void)readU32(in);
-				(void)readU16(in);
-				bitsPerSample = readU16(in);
-				in.seekg(start + (std::streamoff)chunkSize);
-			}
-			else if (cid == "data") {
-				dataPos = in.tellg();
-				dataSize = chunkSize;
-				in.seekg((std::streamoff)dataPos + (std::streamoff)dataSize);
-			}
-			else {
-				in.seekg((std::streamoff)in.tellg() + (std::streamoff)chunkSize);
-			}
-		}
-		if (dataSize == 0 || dataPos == 0) return false;
-		in.clear(); in.seekg(dataPos);
-		std::vector<float> mono; mono.reserve(dataSize / (bitsPerSample/8));
-		if (audioFormat == 1 && bitsPerSample == 16) {
-			const size_t frames = dataSize / (numChannels * 2);
-			for (size_t i = 0; i < frames; ++i) {
-				if (numChannels == 1) { int16_t s16 = (int16_t)readU16(in); mono.push_back((float)s16 / 32768.f); }
-				else { int16_t l16 = (int16_t)readU16(in); int16_t r16 = (int16_t)readU16(in); mono.push_back(((float)l16 + (float)r16) / (2.f * 32768.f)); for (int ch = 2; ch < (int)numChannels; ++ch) { (void)readU16(in); } }
-			}
-		}
-		else if (audioFormat == 1 && bitsPerSample == 24) {
-			const size_t frames = dataSize / (numChannels * 3);
-			for (size_t i = 0; i < frames; ++i) {
-				auto read24 = [&in]() { uint8_t b[3]; in.read((char*)b, 3); int32_t v = (int32_t)(b[0] | (b[1] << 8) | (b[2] << 16)); if (v & 0x800000) v |= 0xFF000000; return (float)v / 8388608.f; };
-				if (numChannels == 1) { mono.push_back(read24()); }
-				else { float vl = read24(); float vr = read24(); mono.push_back(0.5f * (vl + vr)); for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read24(); } }
-			}
-		}
-		else if (audioFormat == 1 && bitsPerSample == 32) {
-			const size_t frames = dataSize / (numChannels * 4);
-			for (size_t i = 0; i < frames; ++i) {
-				auto read32 = [&in]() { uint32_t u = readU32(in); int32_t s = (int32_t)u; return (float)s / 2147483648.f; };
-				if (numChannels == 1) { mono.push_back(read32()); }
-				else { float vl = read32(); float vr = read32(); mono.push_back(0.5f * (vl + vr)); for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read32(); } }
-			}
-		}
-		else if (audioFormat == 3 && bitsPerSample == 32) {
-			const size_t frames = dataSize / (numChannels * 4);
-			for (size_t i = 0; i < frames; ++i) {
-				auto readf = [&in]() { float sf; in.read((char*)&sf, 4); return sf; };
-				if (numChannels == 1) { mono.push_back(readf()); }
-				else { float vl = readf(); float vr = readf(); mono.push_back(0.5f * (vl + vr)); for (int ch = 2; ch < (int)numChannels; ++ch) { (void)readf(); } }
-			}
-		}
-		else { return false; }
-		if (mono.empty()) return false;
-		float maxAbs = 0.f; for (float v : mono) maxAbs = std::max(maxAbs, std::abs(v));
-		if (maxAbs > 0.f) { float g = 1.f / maxAbs; for (float &v : mono) v *= g; }
-		monoOut = std::move(mono);
-		sRateOut = (int)sRate;
-		return true;
-	}
-
-	bool loadSplitSampleAcrossCells(const std::string &path) {
-		std::vector<float> mono; int sRate = 0;
-		if (!loadWavMonoToBuffer(path, mono, sRate)) return false;
-		if (mono.empty()) return false;
-		size_t N = mono.size();
-		size_t sliceLen = std::max((size_t)1, N / (size_t)16);
-		for (int i = 0; i < 16; ++i) {
-			size_t start = (size_t)i * sliceLen;
-			size_t end = (i == 15) ? N : std::min(start + sliceLen, N);
-			if (start >= N) { cellSamples[i].clear(); cellSampleRate[i] = sRate; cellSamplePath[i] = path; continue; }
-			std::vector<float> slice; slice.reserve(end - start);
-			for (size_t k = start; k < end; ++k) slice.push_back(mono[k]);
-			cellSamples[i] = std::move(slice);
-			cellSampleRate[i] = sRate;
-			cellSamplePath[i] = path;
-			cellIsSlice[i] = true;
-			cellSliceStartFrac[i] = N > 0 ? (float)((double)start / (double)N) : 0.f;
-			cellSliceEndFrac[i] = N > 0 ? (float)((double)end / (double)N) : 1.f;
-			cellReversed[i] = false;
-		}
-		return true;
+	// Full mono WAV buffer from the plugin-wide pool, shared with other instances
+	static std::shared_ptr<const SampleBuffer> loadWavMono(const std::string &path) {
+		return SamplePool::instance().acquire(path, SamplePool::MONO_MIX);
 	}
 
 	void loadSplitSampleInteractiveHandler(char *path) {
 		if (!path) return; 
 		std::string p = path; free(path);
-		loadSplitSampleAcrossCells(p);
+		postUiJob(SampleGridJob::SPLIT_PATH, 0, p);
 		return;
 	}
 	
@@ -644,172 +422,50 @@ struct SampleGrid : Module {
 		osdialog_filters *filters = osdialog_filters_parse("WAV:wav");
 		async_osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters, [this, filters](char *path) {
 			loadSplitSampleInteractiveHandler(path);
-			o!defined(METAMODULE_BUILTIN)(path) {
+			osdialog_filters_free(filters);
+		});
+#else
+		osdialog_filters *filters = osdialog_filters_parse("WAV:wav");
+		char *path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+		osdialog_filters_free(filters);
+		if (path) {
 			loadSplitSampleInteractiveHandler(path);
 		}
 #endif
 	}
 
+	// In-place Fisher-Yates over the cells; swaps only, so nothing allocates on the audio thread
 	void shuffleSamples() {
-		int n = 16;
-		std::vector<int> order(n);
-		for (int i = 0; i < n; ++i) order[i] = i;
-		for (int i = n - 1; i > 0; --i) {
+		cellsChanged = true;
+		for (int i = 15; i > 0; --i) {
 			int j = (int)std::floor(random::uniform() * (i + 1));
-			std::swap(order[i], order[j]);
-		}
-		std::vector<float> tmpSamples[16];
-		std::string tmpPaths[16];
-		int tmpRates[16];
-		bool tmpIsSlice[16];
-		float tmpSliceStart[16];
-		float tmpSliceEnd[16];
-		bool tmpRev[16];
-		for (int i = 0; i < n; ++i) {
-			tmpSamples[i] = cellSamples[order[i]];
-			tmpPaths[i] = cellSamplePath[order[i]];
-			tmpRates[i] = cellSampleRate[order[i]];
-			tmpIsSlice[i] = cellIsSlice[order[i]];
-			tmpSliceStart[i] = cellSliceStartFrac[order[i]];
-			tmpSliceEnd[i] = cellSliceEndFrac[order[i]];
-			tmpRev[i] = cellReversed[order[i]];
-		}
-		for (int i = 0; i < n; ++i) {
-			cellSamples[i] = std::move(tmpSamples[i]);
-			cellSamplePath[i] = std::move(tmpPaths[i]);
-			cellSampleRate[i] = tmpRates[i];
-			cellIsSlice[i] = tmpIsSlice[i];
-			cellSliceStartFrac[i] = tmpSliceStart[i];
-			cellSliceEndFrac[i] = tmpSliceEnd[i];
-			cellReversed[i] = tmpRev[i];
+			std::swap(cellSamples[i], cellSamples[j]);
+			std::swap(cellSamplePath[i], cellSamplePath[j]);
+			std::swap(cellSampleRate[i], cellSampleRate[j]);
+			std::swap(cellIsSlice[i], cellIsSlice[j]);
+			std::swap(cellSliceStartFrac[i], cellSliceStartFrac[j]);
+			std::swap(cellSliceEndFrac[i], cellSliceEndFrac[j]);
+			std::swap(cellReversed[i], cellReversed[j]);
 		}
 	}
 
 	void randomReverseSamples() {
+		cellsChanged = true;
 		for (int i = 0; i < 16; ++i) {
 			if (cellSamples[i].empty()) continue;
 			bool newRev = random::uniform() > 0.5f;
-			if (newRev != cellReversed[i]) {
-				std::reverse(cellSamples[i].begin(), cellSamples[i].end());
-			}
+			cellSamples[i].setReversed(newRev);
 			cellReversed[i] = newRev;
 		}
 	}
 
-	// Minimal WAV loader for per-cell samples (mono: stereo averaged)
-	static uint32_t readU32(std::ifstream &in) {
-		uint8_t b[4];
-		in.read((char*)b, 4);
-		return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
-	}
-	static uint16_t readU16(std::ifstream &in) {
-		uint8_t b[2];
-		in.read((char*)b, 2);
-		return (uint16_t)b[0] | ((uint16_t)b[1] << 8);
-	}
-
+	// Load a per-cell sample (mono: stereo averaged)
 	bool loadCellSample(int idx, const std::string &path) {
 		if (idx < 0 || idx >= 16) return false;
-		std::ifstream in(path, std::ios::binary);
-		if (!in.good()) return false;
-		char riff[4]; in.read(riff, 4);
-		if (in.gcount() != 4 || std::string(riff, 4) != "RIFF") return false;
-		(void)readU32(in);
-		char wave[4]; in.read(wave, 4);
-		if (in.gcount() != 4 || std::string(wave, 4) != "WAVE") return false;
-		uint16_t audioFormat = 1; // 1=PCM, 3=FLOAT
-		uint16_t numChannels = 1;
-		uint32_t sRate = 44100;
-		uint16_t bitsPerSample = 16;
-		uint32_t dataSize = 0;
-		std::streampos dataPos = 0;
-		while (in.good() && !in.eof()) {
-			char id[4]; in.read(id, 4); if (in.gcount() != 4) break;
-			uint32_t chunkSize = readU32(in);
-			std::string cid(id, 4);
-			if (cid == "fmt ") {
-				std::streampos start = in.tellg();
-				audioFormat = readU16(in);
-				numChannels = readU16(in);
-				sRate = readU32(in);
-				(void)readU32(in);
-				(void)readU16(in);
-				bitsPerSample = readU16(in);
-				in.seekg(start + (std::streamoff)chunkSize);
-			}
-			else if (cid == "data") {
-				dataPos = in.tellg();
-				dataSize = chunkSize;
-				in.seekg((std::streamoff)dataPos + (std::streamoff)dataSize);
-			}
-			else {
-				in.seekg((std::streamoff)in.tellg() + (std::streamoff)chunkSize);
-			}
-		}
-		if (dataSize == 0 || dataPos == 0) return false;
-		in.clear(); in.seekg(dataPos);
-		std::vector<float> mono; mono.reserve(dataSize / (bitsPerSample/8));
-		if (audioFormat == 1 && bitsPerSample == 16) {
-			const size_t frames = dataSize / (numChannels * 2);
-			for (size_t i = 0; i < frames; ++i) {
-				if (numChannels == 1) {
-					int16_t s16 = (int16_t)readU16(in);
-					mono.push_back((float)s16 / 32768.f);
-				}
-				else {
-					int16_t l16 = (int16_t)readU16(in);
-					int16_t r16 = (int16_t)readU16(in);
-					mono.push_back(((float)l16 + (float)r16) / (2.f * 32768.f));
-					for (int ch = 2; ch < (int)numChannels; ++ch) { (void)readU16(in); }
-				}
-			}
-		}
-		else if (audioFormat == 1 && bitsPerSample == 24) {
-			const size_t frames = dataSize / (numChannels * 3);
-			for (size_t i = 0; i < frames; ++i) {
-				auto read24 = [&in]() {
-					uint8_t b[3]; in.read((char*)b, 3);
-					int32_t v = (int32_t)(b[0] | (b[1] << 8) | (b[2] << 16));
-					if (v & 0x800000) v |= 0xFF000000;
-					return (float)v / 8388608.f;
-				};
-				if (numChannels == 1) { mono.push_back(read24()); }
-				else {
-					float vl = read24(); float vr = read24(); mono.push_back(0.5f * (vl + vr));
-					for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read24(); }
-				}
-			}
-		}
-		else if (audioFormat == 1 && bitsPerSample == 32) {
-			const size_t frames = dataSize / (numChannels * 4);
-			for (size_t i = 0; i < frames; ++i) {
-				auto read32 = [&in]() {
-					uint32_t u = readU32(in); int32_t s = (int32_t)u; return (float)s / 2147483648.f;
-				};
-				if (numChannels == 1) { mono.push_back(read32()); }
-				else {
-					float vl = read32(); float vr = read32(); mono.push_back(0.5f * (vl + vr));
-					for (int ch = 2; ch < (int)numChannels; ++ch) { (void)read32(); }
-				}
-			}
-		}
-		else if (audioFormat == 3 && bitsPerSample == 32) {
-			const size_t frames = dataSize / (numChannels * 4);
-			for (size_t i = 0; i < frames; ++i) {
-				auto readf = [&in]() { float sf; in.read((char*)&sf, 4); return sf; };
-				if (numChannels == 1) { mono.push_back(readf()); }
-				else {
-					float vl = readf(); float vr = readf(); mono.push_back(0.5f * (vl + vr));
-					for (int ch = 2; ch < (int)numChannels; ++ch) { (void)readf(); }
-				}
-			}
-		}
-		else { return false; }
-		if (mono.empty()) return false;
-		// Normalize softly
-		float maxAbs = 0.f; for (float v : mono) maxAbs = std::max(maxAbs, std::abs(v));
-		if (maxAbs > 0.f) { float g = 1.f / maxAbs; for (float &v : mono) v *= g; }
-		cellSamples[idx] = std::move(mono);
+		std::shared_ptr<const SampleBuffer> mono = loadWavMono(path);
+		if (!mono) return false;
+		int sRate = mono->sampleRate;
+		cellSamples[idx] = SampleChannel(mono);
 		cellSampleRate[idx] = (int)sRate;
 		cellSamplePath[idx] = path;
 		cellIsSlice[idx] = false;
@@ -820,6 +476,217 @@ struct SampleGrid : Module {
 	}
 #endif
 
+	std::string getSampleDir() {
+		std::lock_guard<std::mutex> lock(sampleDirMutex);
+		return sampleDir;
+	}
+
+	void setSampleDir(const std::string &dir) {
+		{
+			std::lock_guard<std::mutex> lock(sampleDirMutex);
+			sampleDir = dir;
+		}
+		hasSampleDir = !dir.empty();
+	}
+
+	// Engine, or the UI thread while the engine is locked (patch load, reset). The copies only
+	// bump reference counts; if the queue is full the engine tries again next sample.
+	void publishCells() {
+		SampleGridCells cells;
+		for (int i = 0; i < 16; ++i) {
+			cells.channels[i] = cellSamples[i];
+			cells.sampleRates[i] = cellSampleRate[i];
+		}
+		if (publishedCells.push(std::move(cells))) cellsChanged = false;
+	}
+
+	// UI thread
+	std::shared_ptr<const SampleGridWaveforms> getWaveforms() const {
+		return std::atomic_load(&waveforms);
+	}
+
+	// UI thread: hand disk work to the worker
+	void postUiJob(SampleGridJob::Type type, int cell = 0, const std::string &path = "") {
+		SampleGridJob job;
+		job.type = type;
+		job.cell = cell;
+		job.path = path;
+		if (uiJobs.push(std::move(job))) worker.wake();
+	}
+
+	// UI thread: actions that only touch engine state are applied at the next process()
+	void postUiCommand(SampleGridCommand::Type type, int cell) {
+		SampleGridCommand cmd;
+		cmd.type = type;
+		cmd.cell = cell;
+		uiCommands.push(std::move(cmd));
+	}
+
+	// Audio thread: the worker picks this up on its next poll
+	void postEngineJob(SampleGridJob::Type type) {
+		SampleGridJob job;
+		job.type = type;
+		engineJobs.push(std::move(job));
+	}
+
+	// Audio thread: pass a cell's audio and path to the worker so they are freed off the audio thread
+	void disposeCell(int idx) {
+		SampleGridJob job;
+		job.type = SampleGridJob::DISPOSE;
+		job.channel = std::move(cellSamples[idx]);
+		std::swap(job.path, cellSamplePath[idx]);
+		engineJobs.push(std::move(job)); // if full, job is released here as a last resort
+	}
+
+	////////// worker thread //////////
+
+	bool decodeCell(int idx, const std::string &path, SampleGridCellLoad &out) {
+		std::shared_ptr<const SampleBuffer> mono = loadWavMono(path);
+		if (!mono) return false;
+		out.cell = idx;
+		out.channel = SampleChannel(mono);
+		out.path = path;
+		out.sampleRate = mono->sampleRate;
+		return true;
+	}
+
+	void loadPathJob(int idx, const std::string &path) {
+		SampleGridCellLoad load;
+		if (decodeCell(idx, path, load)) loadedCells.push(std::move(load));
+	}
+
+	// Cached listing of the sample directory; rescanned only when it changes on disk
+	std::shared_ptr<const SampleDirIndex> sampleDirIndex() {
+		return SampleIndex::instance().get(getSampleDir(), includeSubfolders);
+	}
+
+	void loadRandomCellJob(int idx) {
+		std::shared_ptr<const SampleDirIndex> index = sampleDirIndex();
+		if (!index) return;
+		const SampleIndexEntry *picked = SampleIndex::instance().pickRandom(index, maxRandomLengthSec);
+		if (picked) loadPathJob(idx, picked->path);
+	}
+
+	// Decode all 16 before handing any over so the engine swaps the whole set in one block
+	void loadRandomAllJob() {
+		std::shared_ptr<const SampleDirIndex> index = sampleDirIndex();
+		if (!index) return;
+		SampleGridCellLoad loads[16];
+		for (int i = 0; i < 16; ++i) {
+			const SampleIndexEntry *picked = SampleIndex::instance().pickRandom(index, maxRandomLengthSec);
+			if (picked) decodeCell(i, picked->path, loads[i]);
+		}
+		for (int i = 0; i < 16; ++i) {
+			if (loads[i].cell >= 0) loadedCells.push(std::move(loads[i]));
+		}
+	}
+
+	// All 16 slices are views into the one decoded buffer
+	void splitPathJob(const std::string &path) {
+		std::shared_ptr<const SampleBuffer> buf = loadWavMono(path);
+		if (!buf) return;
+		SampleChannel mono(buf);
+		if (mono.empty()) return;
+		size_t N = mono.size();
+		size_t sliceLen = std::max((size_t)1, N / (size_t)16);
+		for (int i = 0; i < 16; ++i) {
+			size_t start = std::min((size_t)i * sliceLen, N);
+			size_t end = (i == 15) ? N : std::min(start + sliceLen, N);
+			SampleGridCellLoad load;
+			load.cell = i;
+			load.channel = mono.slice(start, end);
+			load.path = path;
+			load.sampleRate = buf->sampleRate;
+			load.isSlice = true;
+			load.sliceStartFrac = (float)((double)start / (double)N);
+			load.sliceEndFrac = (float)((double)end / (double)N);
+			loadedCells.push(std::move(load));
+		}
+	}
+
+	void runJob(SampleGridJob &job) {
+		switch (job.type) {
+			case SampleGridJob::LOAD_PATH: loadPathJob(job.cell, job.path); break;
+			case SampleGridJob::LOAD_RANDOM_CELL: loadRandomCellJob(job.cell); break;
+			case SampleGridJob::LOAD_RANDOM_ALL: loadRandomAllJob(); break;
+			case SampleGridJob::SPLIT_PATH: splitPathJob(job.path); break;
+			case SampleGridJob::DISPOSE: job.channel.clear(); job.path.clear(); break;
+			case SampleGridJob::SAVE_CELLS: saveCellsJob(job.path); savesDone = job.ticket; break;
+			default: break;
+		}
+	}
+
+	// Takes the latest cells from the engine and publishes their outlines. Cells that were only
+	// moved (shuffle) keep the outline they had.
+	void updateWorkerCells() {
+		SampleGridCells cells, next;
+		if (!publishedCells.pop(cells)) return;
+		while (publishedCells.pop(next)) cells = std::move(next);
+		std::shared_ptr<const SampleGridWaveforms> previous = std::atomic_load(&waveforms);
+		std::shared_ptr<SampleGridWaveforms> outlines = std::make_shared<SampleGridWaveforms>();
+		for (int i = 0; i < 16; ++i) {
+			int same = -1;
+			for (int j = 0; previous && j < 16 && same < 0; ++j) {
+				if (cells.channels[i].sameAudio(workerCells.channels[j])) same = j;
+			}
+			if (same >= 0) outlines->cells[i] = previous->cells[same];
+			else outlines->cells[i].build(cells.channels[i]);
+		}
+		// The cells replaced here are released on this thread
+		std::swap(workerCells, cells);
+		std::atomic_store(&waveforms, std::shared_ptr<const SampleGridWaveforms>(outlines));
+	}
+
+	void workerStep() {
+		random::init(); // the RNG is thread-local; no-op once seeded
+		updateWorkerCells();
+		SampleGridJob job;
+		while (uiJobs.pop(job)) runJob(job);
+		while (engineJobs.pop(job)) runJob(job);
+	}
+
+	////////// audio thread //////////
+
+	void applyUiCommands() {
+		SampleGridCommand cmd;
+		while (uiCommands.pop(cmd)) {
+			if (cmd.type != SampleGridCommand::CLEAR_CELL || cmd.cell < 0 || cmd.cell >= 16) continue;
+			int i = cmd.cell;
+			disposeCell(i);
+			cellSampleRate[i] = 0;
+			cellStartFrac[i] = 0.f;
+			cellIsSlice[i] = false;
+			cellSliceStartFrac[i] = 0.f;
+			cellSliceEndFrac[i] = 1.f;
+			cellReversed[i] = false;
+			if (playingCell == i) playingCell = -1;
+			cellsChanged = true;
+		}
+	}
+
+	void applyLoadedCells() {
+		SampleGridCellLoad load;
+		while (loadedCells.pop(load)) {
+			int i = load.cell;
+			if (i < 0 || i >= 16) continue;
+			std::swap(cellSamples[i], load.channel);
+			std::swap(cellSamplePath[i], load.path);
+			cellSampleRate[i] = load.sampleRate;
+			cellIsSlice[i] = load.isSlice;
+			cellSliceStartFrac[i] = load.sliceStartFrac;
+			cellSliceEndFrac[i] = load.sliceEndFrac;
+			cellReversed[i] = false;
+			if (playingCell == i) playbackPos = playbackStartPos = 0.0;
+			cellsChanged = true;
+			// The previous audio now sits in load; send it back to be freed
+			SampleGridJob job;
+			job.type = SampleGridJob::DISPOSE;
+			job.channel = std::move(load.channel);
+			std::swap(job.path, load.path);
+			engineJobs.push(std::move(job));
+		}
+	}
+
 	SampleGrid() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(RUN_PARAM, 0.0, 1.0, 0.0, "Run");
@@ -864,6 +731,12 @@ struct SampleGrid : Module {
 			cellReversed[i] = false;
 		}
 		playingCell = -1;
+
+		worker.start([this]() { workerStep(); });
+	}
+
+	~SampleGrid() {
+		worker.stop();
 	}
 
 	void process(const ProcessArgs &args) override;
@@ -932,7 +805,9 @@ struct SampleGrid : Module {
 		json_object_set_new(rootJ, "cellReversed", revJ);
 
 		// Selected directory for random samples
-		json_object_set_new(rootJ, "sampleDir", json_string(sampleDir.c_str()));
+		json_object_set_new(rootJ, "sampleDir", json_string(getSampleDir().c_str()));
+		json_object_set_new(rootJ, "includeSubfolders", json_boolean(includeSubfolders));
+		json_object_set_new(rootJ, "maxRandomLengthSec", json_real(maxRandomLengthSec));
 
 		// snake state (not critical to persist; omit for simplicity)
 
@@ -1027,56 +902,36 @@ struct SampleGrid : Module {
 		// If we already loaded from patch storage in onAdd(), skip loading from external paths to let patch storage win.
 		json_t *pathsJ = json_object_get(rootJ, "cellSamplePaths");
 		if (!loadedFromPatchStorage && pathsJ && json_is_array(pathsJ)) {
-			std::unordered_map<std::string, std::pair<std::vector<float>, int>> wavMonoCache;
 			for (int i = 0; i < 16; ++i) {
 				json_t *sJ = json_array_get(pathsJ, i);
 				std::string p = (sJ && json_is_string(sJ)) ? std::string(json_string_value(sJ)) : std::string();
 				cellSamplePath[i].clear();
 				cellSamples[i].clear();
 				cellSampleRate[i] = 0;
-				cellIsSlice[i] = cellIsSlice[i]; // keep as loaded
 				if (!p.empty()) {
 					cellSamplePath[i] = p;
+					bool rev = cellReversed[i]; // loadCellSample() resets the flag
 					if (cellIsSlice[i]) {
-						// Cache full mono buffer per path
-						auto it = wavMonoCache.find(p);
-						if (it == wavMonoCache.end()) {
-							std::vector<float> mono; int sRate = 0;
-							if (loadWavMonoToBuffer(p, mono, sRate)) {
-								wavMonoCache.emplace(p, std::make_pair(std::move(mono), sRate));
-							}
-						}
-						it = wavMonoCache.find(p);
-						if (it != wavMonoCache.end()) {
-							const std::vector<float> &mono = it->second.first;
-							int sRate = it->second.second;
+						// Slices of one file share the pooled buffer, so it is decoded only once
+						std::shared_ptr<const SampleBuffer> buf = loadWavMono(p);
+						if (buf) {
+							SampleChannel mono(buf);
 							size_t N = mono.size();
 							size_t start = (size_t) std::floor((double)cellSliceStartFrac[i] * (double)N);
 							size_t end = (size_t) std::floor((double)cellSliceEndFrac[i] * (double)N);
-							if (end > N) end = N;
-							if (start > end) start = end;
-							std::vector<float> slice;
-							if (start < end) { slice.assign(mono.begin() + start, mono.begin() + end); }
-							cellSamples[i] = std::move(slice);
-							cellSampleRate[i] = sRate;
-							if (cellReversed[i] && !cellSamples[i].empty()) {
-								std::reverse(cellSamples[i].begin(), cellSamples[i].end());
-							}
+							cellSamples[i] = mono.slice(start, end);
+							cellSampleRate[i] = buf->sampleRate;
 						}
 						else {
 							// Fallback: load whole sample
 							loadCellSample(i, p);
-							if (cellReversed[i] && !cellSamples[i].empty()) {
-								std::reverse(cellSamples[i].begin(), cellSamples[i].end());
-							}
 						}
 					}
 					else {
 						loadCellSample(i, p);
-						if (cellReversed[i] && !cellSamples[i].empty()) {
-							std::reverse(cellSamples[i].begin(), cellSamples[i].end());
-						}
 					}
+					cellReversed[i] = rev;
+					cellSamples[i].setReversed(rev);
 				}
 			}
 		}
@@ -1096,9 +951,14 @@ struct SampleGrid : Module {
 
 		// Selected directory
 		json_t *dirJ = json_object_get(rootJ, "sampleDir");
-		if (dirJ && json_is_string(dirJ)) sampleDir = json_string_value(dirJ);
+		if (dirJ && json_is_string(dirJ)) setSampleDir(json_string_value(dirJ));
+		json_t *subfoldersJ = json_object_get(rootJ, "includeSubfolders");
+		if (subfoldersJ) includeSubfolders = json_is_true(subfoldersJ);
+		json_t *maxLenJ = json_object_get(rootJ, "maxRandomLengthSec");
+		if (maxLenJ) maxRandomLengthSec = std::max(0.f, (float) json_number_value(maxLenJ));
 
 		// ignore legacy auto-wrap keys if present
+		publishCells();
 	}
 
 	void onReset(const ResetEvent& e) override {
@@ -1121,9 +981,10 @@ struct SampleGrid : Module {
 			cellReversed[i] = false;
 		}
 		playingCell = -1;
+		publishCells();
 
 		// reset the sample directory
-		sampleDir.clear();
+		setSampleDir("");
 	}
 
 	void onRandomize() override {
@@ -1267,91 +1128,40 @@ void SampleGrid::process(const ProcessArgs &args) {
 
 	// Bottom control trigger inputs
 	if (rndSamplesInTrigger.process(inputs[RND_SAMPLES_INPUT].getVoltage())) {
-		// Avoid UI dialogs and disk I/O from audio thread; queue UI-side loading.
-		if (!sampleDir.empty()) {
-			reqRandomSamplesFromDir = true;
+		// Never open dialogs from the audio thread; without a directory the trigger is ignored
+		if (hasSampleDir) {
+			postEngineJob(SampleGridJob::LOAD_RANDOM_ALL);
 		}
 	}
 	// Button params as triggers
 	if (rndSamplesParamTrigger.process(params[RND_SAMPLES_PARAM].getValue())) {
-		if (!sampleDir.empty()) {
-			reqRandomSamplesFromDir = true;
+		if (hasSampleDir) {
+			postEngineJob(SampleGridJob::LOAD_RANDOM_ALL);
 		} else {
 			reqRandomSamplesInteractive = true;
 		}
 	}
-	if (shuffleSamplesParamTrigger.process(params[SHUFFLE_SAMPLES_PARAM].getValue())) {
-		reqShuffleSamples = true;
-	}
-	if (reverseRandomParamTrigger.process(params[REVERSE_RANDOM_PARAM].getValue())) {
-		reqReverseRandom = true;
-	}
-	if (rndMutesParamTrigger.process(params[RND_MUTES_PARAM].getValue())) {
-		reqRandomizeMutes = true;
-	}
 	if (splitSampleParamTrigger.process(params[SPLIT_SAMPLE_PARAM].getValue())) {
 		reqSplitSampleInteractive = true;
 	}
-
-	// Apply preloaded random-sample buffers prepared on the UI thread.
-	applyPendingRandomSamples();
-
-	// Apply any UI-requested operations on the audio thread to avoid races
-	if (reqShuffleSamples) {
-		reqShuffleSamples = false;
-		shuffleSamples();
-	}
-	if (reqReverseRandom) {
-		reqReverseRandom = false;
-		randomReverseSamples();
-	}
-	if (reqRandomizeMutes) {
-		reqRandomizeMutes = false;
-		randomizeGateStates();
-	}
-	if (shuffleInTrigger.process(inputs[SHUFFLE_INPUT].getVoltage())) {
+	if (shuffleInTrigger.process(inputs[SHUFFLE_INPUT].getVoltage()) |
+		shuffleSamplesParamTrigger.process(params[SHUFFLE_SAMPLES_PARAM].getValue())) {
 		shuffleSamples();
 	}
-	if (reverseRandomInTrigger.process(inputs[REVERSE_RND_INPUT].getVoltage())) {
+	if (reverseRandomInTrigger.process(inputs[REVERSE_RND_INPUT].getVoltage()) |
+		reverseRandomParamTrigger.process(params[REVERSE_RANDOM_PARAM].getValue())) {
 		randomReverseSamples();
 	}
-	if (rndMutesInTrigger.process(inputs[RND_MUTES_INPUT].getVoltage())) {
+	if (rndMutesInTrigger.process(inputs[RND_MUTES_INPUT].getVoltage()) |
+		rndMutesParamTrigger.process(params[RND_MUTES_PARAM].getValue())) {
 		randomizeGateStates();
 	}
-	// Apply per-cell UI requests safely on audio thread
-	for (int i = 0; i < 16; ++i) {
-		if (reqClearCell[i]) {
-			reqClearCell[i] = false;
-			cellSamples[i].clear();
-			cellSamplePath[i].clear();
-			cellSampleRate[i] = 0;
-			cellStartFrac[i] = 0.f;
-			cellIsSlice[i] = false;
-			cellSliceStartFrac[i] = 0.f;
-			cellSliceEndFrac[i] = 1.f;
-			cellReversed[i] = false;
-			if (playingCell == i) playingCell = -1;
-		}
-		if (reqLoadCellFromPath[i]) {
-			std::string p = pendingCellPath[i];
-			pendingCellPath[i].clear();
-			reqLoadCellFromPath[i] = false;
-			if (!p.empty()) {
-				loadCellSample(i, p);
-			}
-		}
-		if (reqLoadRandomCell[i]) {
-			reqLoadRandomCell[i] = false;
-			// Only operate if a sample directory is set; never open dialogs here
-			if (!sampleDir.empty()) {
-				std::vector<std::string> wavs;
-				if (collectWavsInDir(sampleDir, wavs) && !wavs.empty()) {
-					size_t idx = (size_t)std::floor(random::uniform() * wavs.size());
-					loadCellSample(i, wavs[idx]);
-				}
-			}
-		}
-	}
+
+	// Swap in whatever the UI and worker have queued since the last sample
+	applyUiCommands();
+	applyLoadedCells();
+	if (cellsChanged) publishCells();
+
 	if (nextStep) {
 		if(resetMode){
 			resetMode = false;
@@ -1474,12 +1284,11 @@ struct SampleGridWidget : ModuleWidget {
 };
 
 void replaceSampleHandler(SampleGrid *module, int cell, char *path){
-	if (path) { std::string p = path; free(path); module->pendingCellPath[cell] = p; module->reqLoadCellFromPath[cell] = true; }
+	if (path) { std::string p = path; free(path); module->postUiJob(SampleGridJob::LOAD_PATH, cell, p); }
 }
 
 void randomLoadHandler(SampleGrid *module, int cell, char *path) {
-	if (path) { std::string p = path; free(path); module->pendingCellPath[cell] = p; module->reqLoadCellFromPath[cell] = true; }
-	module->reqLoadRandomCell[cell] = true;
+	replaceSampleHandler(module, cell, path);
 }
 
 SampleGridWidget::SampleGridWidget(SampleGrid *module) {
@@ -1539,7 +1348,7 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 						Vec m = e.pos;
 						// Dice click: random sample for this cell
 						if (m.x >= diceRx && m.x <= diceRx + d && m.y >= diceRy && m.y <= diceRy + d) {
-							if (module->sampleDir.empty()) {
+							if (!module->hasSampleDir) {
 #if defined(METAMODULE_BUILTIN)
 								osdialog_filters *filters = osdialog_filters_parse("WAV:wav");
 								async_osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters, [this, filters](char *path) {
@@ -1555,14 +1364,14 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 								}
 #endif
 							} else {
-								module->reqLoadRandomCell[cell] = true;
+								module->postUiJob(SampleGridJob::LOAD_RANDOM_CELL, cell);
 							}
 							e.consume(this);
 							return;
 						}
 						// X click: unload (clear) this cell's sample
 						if (m.x >= xRx && m.x <= xRx + d && m.y >= xRy && m.y <= xRy + d) {
-							module->reqClearCell[cell] = true;
+							module->postUiCommand(SampleGridCommand::CLEAR_CELL, cell);
 							e.consume(this);
 							return;
 						}
@@ -1586,8 +1395,8 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 							return;
 						}
 						// Default: open file dialog to load a specific WAV
-						const auto &buf = module->cellSamples[cell];
-						if (!buf.empty()) {
+						std::shared_ptr<const SampleGridWaveforms> outlines = module->getWaveforms();
+						if (outlines && outlines->cells[cell].frames > 0) {
 							float x = e.pos.x; float wCell = box.size.x;
 							float frac = wCell > 0.f ? std::max(0.f, std::min(1.f, x / wCell)) : 0.f;
 							module->cellStartFrac[cell] = frac;
@@ -1673,8 +1482,9 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 					// Waveform rendering
 					const int ci = cell;
 					if (ci < 0 || ci >= 16) return;
-					std::vector<float> buf = module->cellSamples[ci];
-					if (buf.empty()) {
+					std::shared_ptr<const SampleGridWaveforms> outlines = module->getWaveforms();
+					const WaveOverview *outline = outlines ? &outlines->cells[ci] : nullptr;
+					if (!outline || outline->frames == 0) {
 						nvgFontSize(vg, 10.f); nvgTextAlign(vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
 						nvgFillColor(vg, nvgRGBA(180,180,180,160)); nvgText(vg, w*0.5f, h*0.5f, "load", nullptr);
 						return;
@@ -1682,20 +1492,13 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 					nvgBeginPath(vg);
 					nvgStrokeColor(vg, nvgRGB(25,150,252));
 					nvgStrokeWidth(vg, 1.0f);
-					const size_t N = buf.size();
+					const size_t N = outline->frames;
 					const size_t wpx = (size_t)std::max(1.0f, std::floor(w));
-					const size_t bucket = std::max<size_t>(1, (size_t)std::floor((double)N / (double)std::max<size_t>(1, wpx)));
 					for (size_t xpix = 0; xpix < wpx; ++xpix) {
 						size_t i0 = (size_t)std::floor((double)xpix * (double)N / (double)wpx);
-						if (i0 >= N) i0 = N - 1;
-						size_t iEnd = std::min(N, i0 + bucket);
-						float minV = 1.f, maxV = -1.f;
-						for (size_t i = i0; i < iEnd; ++i) {
-							float v = buf[i];
-							if (v < -10.f) v = -10.f; if (v > 10.f) v = 10.f; // guard extreme ranges
-							minV = std::min(minV, v);
-							maxV = std::max(maxV, v);
-						}
+						size_t iEnd = (size_t)std::floor((double)(xpix + 1) * (double)N / (double)wpx);
+						float minV, maxV;
+						outline->range(i0, iEnd, minV, maxV);
 						// Clamp to visible [-1,1] range for drawing, ensure at least a hairline
 						minV = std::max(-1.f, std::min(1.f, minV));
 						maxV = std::max(-1.f, std::min(1.f, maxV));
@@ -1751,7 +1554,7 @@ SampleGridWidget::SampleGridWidget(SampleGrid *module) {
 						// X icon top-right (unload sample)
 						nvgBeginPath(vg);
 						nvgRoundedRect(vg, xRx, xRy, d, d, 2.f);
-						nvgFillColor(vg, module && module->cellSamples[cell].empty() ? nvgRGBA(200,200,200,140) : nvgRGBA(245,245,245,200));
+						nvgFillColor(vg, outline->frames == 0 ? nvgRGBA(200,200,200,140) : nvgRGBA(245,245,245,200));
 						nvgFill(vg);
 						nvgStrokeColor(vg, nvgRGBA(120,120,120,180)); nvgStrokeWidth(vg, 1.f); nvgStroke(vg);
 						nvgBeginPath(vg);
@@ -1878,6 +1681,29 @@ struct SampleGridPatternModeItem : MenuItem {
 };
 
 // Submenu wrapper for pattern mode options
+struct SampleGridMaxLengthItem : MenuItem {
+	SampleGrid *sampleGrid = nullptr;
+	float seconds = 0.f;
+	void onAction(const event::Action &e) override { sampleGrid->maxRandomLengthSec = seconds; }
+	void step() override { rightText = (sampleGrid->maxRandomLengthSec == seconds) ? "✔" : ""; MenuItem::step(); }
+};
+
+struct SampleGridMaxLengthSubMenuItem : MenuItem {
+	SampleGrid *sampleGrid = nullptr;
+	Menu *createChildMenu() override {
+		Menu *submenu = new Menu;
+		const float lengths[] = { 0.f, 0.5f, 1.f, 2.f, 5.f, 10.f, 30.f };
+		for (float len : lengths) {
+			auto *item = new SampleGridMaxLengthItem();
+			item->text = (len == 0.f) ? "Any" : string::f("%g s", len);
+			item->sampleGrid = sampleGrid;
+			item->seconds = len;
+			submenu->addChild(item);
+		}
+		return submenu;
+	}
+};
+
 struct SampleGridPatternSubMenuItem : MenuItem {
 	SampleGrid *sampleGrid = nullptr;
 	Menu *createChildMenu() override {
@@ -2086,7 +1912,8 @@ void SampleGridWidget::appendContextMenu(Menu *menu) {
 	struct SampleGridDirLabel : MenuLabel {
 		SampleGrid *sampleGrid;
 		void step() override {
-			text = sampleGrid && !sampleGrid->sampleDir.empty() ? ("Current: " + sampleGrid->sampleDir) : "Current: (not set)";
+			std::string dir = sampleGrid ? sampleGrid->getSampleDir() : "";
+			text = !dir.empty() ? ("Current: " + dir) : "Current: (not set)";
 			MenuLabel::step();
 		}
 	};
@@ -2105,6 +1932,25 @@ void SampleGridWidget::appendContextMenu(Menu *menu) {
 	changeDirItem->text = "Change Directory…";
 	changeDirItem->sampleGrid = sampleGrid;
 	menu->addChild(changeDirItem);
+
+	struct SampleGridSubfoldersItem : MenuItem {
+		SampleGrid *sampleGrid;
+		void onAction(const event::Action &e) override { sampleGrid->includeSubfolders = !sampleGrid->includeSubfolders; }
+		void step() override { rightText = (sampleGrid->includeSubfolders) ? "✔" : ""; MenuItem::step(); }
+	};
+	SampleGridSubfoldersItem *subfoldersItem = new SampleGridSubfoldersItem();
+	subfoldersItem->text = "Include Subfolders";
+	subfoldersItem->sampleGrid = sampleGrid;
+	menu->addChild(subfoldersItem);
+
+	SampleGridMaxLengthSubMenuItem *maxLengthSub = new SampleGridMaxLengthSubMenuItem();
+	maxLengthSub->text = "Max Random Sample Length";
+	maxLengthSub->rightText = RIGHT_ARROW;
+	maxLengthSub->sampleGrid = sampleGrid;
+	menu->addChild(maxLengthSub);
+
+	menu->addChild(new MenuSeparator());
+	menu->addChild(new SamplePoolMemoryLabel());
 }
 
 Model *modelSampleGrid = createModel<SampleGrid, SampleGridWidget>("SampleGrid");
@@ -2113,21 +1959,12 @@ void SampleGridWidget::step() {
 	ModuleWidget::step();
 	SampleGrid *m = dynamic_cast<SampleGrid*>(module);
 	if (!m) return;
-	if (m->reqRandomSamplesFromDir) {
-		m->reqRandomSamplesFromDir = false;
-		if (!m->sampleDir.empty()) {
-			m->prepareRandomSamplesFromDir(m->sampleDir);
-		}
-		m->params[SampleGrid::RND_SAMPLES_PARAM].setValue(0.f);
-	}
 	// Handle interactive actions requested by process() via flags
-	if (m->reqRandomSamplesInteractive) {
-		m->reqRandomSamplesInteractive = false;
+	if (m->reqRandomSamplesInteractive.exchange(false)) {
 		m->loadRandomSamplesInteractive(false);
 		m->params[SampleGrid::RND_SAMPLES_PARAM].setValue(0.f);
 	}
-	if (m->reqSplitSampleInteractive) {
-		m->reqSplitSampleInteractive = false;
+	if (m->reqSplitSampleInteractive.exchange(false)) {
 		m->loadSplitSampleInteractive();
 		m->params[SampleGrid::SPLIT_SAMPLE_PARAM].setValue(0.f);
 	}
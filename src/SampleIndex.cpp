@@ -0,0 +1,310 @@
+#include "SampleIndex.hpp"
+#include "SamplePool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+static const int MAX_SCAN_DEPTH = 8;
+static const size_t MAX_SAVED_INDEXES = 32;
+
+SampleIndex &SampleIndex::instance() {
+	static SampleIndex index;
+	return index;
+}
+
+const SampleIndexEntry *SampleDirIndex::pickRandom(float maxDurationSec, const std::string &exclude) const {
+	// Entries are sorted by duration, so the filter is a binary search
+	size_t n = entries.size();
+	if (maxDurationSec > 0.f) {
+		auto end = std::upper_bound(entries.begin(), entries.end(), maxDurationSec,
+			[](float d, const SampleIndexEntry &e) { return d < e.durationSec; });
+		n = (size_t)(end - entries.begin());
+	}
+	if (n == 0) return nullptr;
+	size_t idx = std::min(n - 1, (size_t)std::floor(random::uniform() * n));
+	if (n > 1 && !exclude.empty()) {
+		int guard = 8;
+		while (guard-- > 0 && entries[idx].path == exclude) {
+			idx = std::min(n - 1, (size_t)std::floor(random::uniform() * n));
+		}
+	}
+	return &entries[idx];
+}
+
+static bool statPath(const std::string &path, int64_t &mtime, int64_t &size, bool &isDir) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+	mtime = (int64_t)st.st_mtime;
+	size = (int64_t)st.st_size;
+	isDir = S_ISDIR(st.st_mode);
+	return true;
+}
+
+static bool hasWavExtension(const std::string &name) {
+	size_t dot = name.find_last_of('.');
+	if (dot == std::string::npos) return false;
+	std::string ext = name.substr(dot);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".wav";
+}
+
+// Names in dir, skipping hidden entries and "." / ".."
+static bool listDir(const std::string &dir, std::vector<std::string> &names) {
+#ifdef _WIN32
+	std::string pattern = dir;
+	if (!pattern.empty()) {
+		char last = pattern.back();
+		if (last != '/' && last != '\\') pattern += '\\';
+	}
+	pattern += "*";
+	WIN32_FIND_DATAA ffd;
+	HANDLE hFind = FindFirstFileA(pattern.c_str(), &ffd);
+	if (hFind == INVALID_HANDLE_VALUE) return false;
+	do {
+		if (ffd.cFileName[0] == '.') continue;
+		names.push_back(ffd.cFileName);
+	} while (FindNextFileA(hFind, &ffd));
+	FindClose(hFind);
+#else
+	DIR *dp = opendir(dir.c_str());
+	if (!dp) return false;
+	struct dirent *de;
+	while ((de = readdir(dp)) != nullptr) {
+		if (de->d_name[0] == '.') continue;
+		names.push_back(de->d_name);
+	}
+	closedir(dp);
+#endif
+	return true;
+}
+
+static std::string joinPath(const std::string &dir, const std::string &name) {
+	if (dir.empty()) return name;
+	char last = dir.back();
+#ifdef _WIN32
+	if (last != '/' && last != '\\') return dir + "\\" + name;
+#else
+	if (last != '/') return dir + "/" + name;
+#endif
+	return dir + name;
+}
+
+static bool readEntry(const std::string &path, SampleIndexEntry &e) {
+	FILE *in = fopen(path.c_str(), "rb");
+	if (!in) return false;
+	WavInfo info;
+	bool ok = readWavInfo(in, info);
+	fclose(in);
+	if (!ok || info.numFrames() == 0) return false;
+	e.durationSec = info.durationSec();
+	e.sampleRate = (int)info.sampleRate;
+	e.channels = info.numChannels;
+	e.bitsPerSample = info.bitsPerSample;
+	e.isFloat = info.audioFormat == 3;
+	return true;
+}
+
+static bool scanDir(const std::string &dir, bool recursive, int depth,
+		const std::map<std::string, const SampleIndexEntry*> &previous, SampleDirIndex &out) {
+	int64_t mtime = 0, size = 0;
+	bool isDir = false;
+	if (!statPath(dir, mtime, size, isDir) || !isDir) return false;
+	std::vector<std::string> names;
+	if (!listDir(dir, names)) return false;
+	out.dirMtimes[dir] = mtime;
+	for (const std::string &name : names) {
+		std::string full = joinPath(dir, name);
+		if (!statPath(full, mtime, size, isDir)) continue;
+		if (isDir) {
+			if (recursive && depth < MAX_SCAN_DEPTH) scanDir(full, recursive, depth + 1, previous, out);
+			continue;
+		}
+		if (!hasWavExtension(name)) continue;
+		SampleIndexEntry e;
+		auto it = previous.find(full);
+		if (it != previous.end() && it->second->mtime == mtime && it->second->size == size) {
+			e = *it->second;
+		}
+		else {
+			e.path = full;
+			e.mtime = mtime;
+			e.size = size;
+			if (!readEntry(full, e)) continue;
+		}
+		out.entries.push_back(e);
+	}
+	return true;
+}
+
+static bool isStale(const SampleDirIndex &index) {
+	for (const auto &d : index.dirMtimes) {
+		int64_t mtime = 0, size = 0;
+		bool isDir = false;
+		if (!statPath(d.first, mtime, size, isDir) || !isDir || mtime != d.second) return true;
+	}
+	return index.dirMtimes.empty();
+}
+
+std::shared_ptr<const SampleDirIndex> SampleIndex::get(const std::string &dir, bool recursive, bool rescan) {
+	if (dir.empty()) return nullptr;
+	std::string key = dir + (recursive ? "|r" : "|");
+	std::shared_ptr<const SampleDirIndex> current;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loadLocked();
+		Slot &slot = slots[key];
+		slot.lastUse = ++useCounter;
+		current = slot.index;
+	}
+	if (current && !rescan && !isStale(*current)) return current;
+
+	// Rescan outside the lock; unchanged files keep their parsed headers
+	std::map<std::string, const SampleIndexEntry*> previous;
+	if (current) {
+		for (const SampleIndexEntry &e : current->entries) previous[e.path] = &e;
+	}
+	auto fresh = std::make_shared<SampleDirIndex>();
+	fresh->dir = dir;
+	fresh->recursive = recursive;
+	if (!scanDir(dir, recursive, 0, previous, *fresh)) return nullptr;
+	std::stable_sort(fresh->entries.begin(), fresh->entries.end(),
+		[](const SampleIndexEntry &a, const SampleIndexEntry &b) { return a.durationSec < b.durationSec; });
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slots[key].index = fresh;
+		// Forget the least recently used directories
+		while (slots.size() > MAX_SAVED_INDEXES) {
+			auto oldest = slots.begin();
+			for (auto it = slots.begin(); it != slots.end(); ++it) {
+				if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+			}
+			slots.erase(oldest);
+		}
+	}
+	save();
+	return fresh;
+}
+
+static bool isCurrent(const SampleIndexEntry &e) {
+	int64_t mtime = 0, size = 0;
+	bool isDir = false;
+	return statPath(e.path, mtime, size, isDir) && !isDir && mtime == e.mtime && size == e.size;
+}
+
+const SampleIndexEntry *SampleIndex::pickRandom(std::shared_ptr<const SampleDirIndex> &index,
+		float maxDurationSec, const std::string &exclude) {
+	if (!index) return nullptr;
+	const SampleIndexEntry *picked = index->pickRandom(maxDurationSec, exclude);
+	if (!picked || isCurrent(*picked)) return picked;
+	// The rescan reads the headers of every file that changed, not just this one
+	std::shared_ptr<const SampleDirIndex> fresh = get(index->dir, index->recursive, true);
+	if (!fresh) return nullptr;
+	index = fresh;
+	return index->pickRandom(maxDurationSec, exclude);
+}
+
+////////////////////////////////////////////// PERSISTENCE //////////////////////////////////////////////
+
+static std::string indexFilePath() {
+	return asset::user("JW-Modules/sample-index.json");
+}
+
+void SampleIndex::loadLocked() {
+	if (loaded) return;
+	loaded = true;
+	json_error_t error;
+	json_t *rootJ = json_load_file(indexFilePath().c_str(), 0, &error);
+	if (!rootJ) return;
+	json_t *indexesJ = json_object_get(rootJ, "indexes");
+	size_t i;
+	json_t *indexJ;
+	json_array_foreach(indexesJ, i, indexJ) {
+		auto index = std::make_shared<SampleDirIndex>();
+		json_t *dirJ = json_object_get(indexJ, "dir");
+		if (!dirJ || !json_is_string(dirJ)) continue;
+		index->dir = json_string_value(dirJ);
+		index->recursive = json_is_true(json_object_get(indexJ, "recursive"));
+		size_t j;
+		json_t *dJ;
+		json_array_foreach(json_object_get(indexJ, "dirs"), j, dJ) {
+			json_t *pathJ = json_object_get(dJ, "path");
+			if (!pathJ || !json_is_string(pathJ)) continue;
+			index->dirMtimes[json_string_value(pathJ)] = (int64_t)json_integer_value(json_object_get(dJ, "mtime"));
+		}
+		json_t *eJ;
+		json_array_foreach(json_object_get(indexJ, "entries"), j, eJ) {
+			json_t *pathJ = json_object_get(eJ, "path");
+			if (!pathJ || !json_is_string(pathJ)) continue;
+			SampleIndexEntry e;
+			e.path = json_string_value(pathJ);
+			e.mtime = (int64_t)json_integer_value(json_object_get(eJ, "mtime"));
+			e.size = (int64_t)json_integer_value(json_object_get(eJ, "size"));
+			e.durationSec = (float)json_number_value(json_object_get(eJ, "duration"));
+			e.sampleRate = (int)json_integer_value(json_object_get(eJ, "rate"));
+			e.channels = (int)json_integer_value(json_object_get(eJ, "channels"));
+			e.bitsPerSample = (int)json_integer_value(json_object_get(eJ, "bits"));
+			e.isFloat = json_is_true(json_object_get(eJ, "float"));
+			index->entries.push_back(e);
+		}
+		std::stable_sort(index->entries.begin(), index->entries.end(),
+			[](const SampleIndexEntry &a, const SampleIndexEntry &b) { return a.durationSec < b.durationSec; });
+		std::string key = index->dir + (index->recursive ? "|r" : "|");
+		slots[key].index = index;
+	}
+	json_decref(rootJ);
+}
+
+void SampleIndex::save() {
+	// Two workers may refresh different directories at once; the later snapshot must win
+	std::lock_guard<std::mutex> fileLock(fileMutex);
+	std::vector<std::shared_ptr<const SampleDirIndex>> indexes;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &slot : slots) {
+			if (slot.second.index) indexes.push_back(slot.second.index);
+		}
+	}
+	json_t *rootJ = json_object();
+	json_object_set_new(rootJ, "version", json_integer(1));
+	json_t *indexesJ = json_array();
+	for (auto &index : indexes) {
+		json_t *indexJ = json_object();
+		json_object_set_new(indexJ, "dir", json_string(index->dir.c_str()));
+		json_object_set_new(indexJ, "recursive", json_boolean(index->recursive));
+		json_t *dirsJ = json_array();
+		for (const auto &d : index->dirMtimes) {
+			json_t *dJ = json_object();
+			json_object_set_new(dJ, "path", json_string(d.first.c_str()));
+			json_object_set_new(dJ, "mtime", json_integer((json_int_t)d.second));
+			json_array_append_new(dirsJ, dJ);
+		}
+		json_object_set_new(indexJ, "dirs", dirsJ);
+		json_t *entriesJ = json_array();
+		for (const SampleIndexEntry &e : index->entries) {
+			json_t *eJ = json_object();
+			json_object_set_new(eJ, "path", json_string(e.path.c_str()));
+			json_object_set_new(eJ, "mtime", json_integer((json_int_t)e.mtime));
+			json_object_set_new(eJ, "size", json_integer((json_int_t)e.size));
+			json_object_set_new(eJ, "duration", json_real(e.durationSec));
+			json_object_set_new(eJ, "rate", json_integer(e.sampleRate));
+			json_object_set_new(eJ, "channels", json_integer(e.channels));
+			json_object_set_new(eJ, "bits", json_integer(e.bitsPerSample));
+			json_object_set_new(eJ, "float", json_boolean(e.isFloat));
+			json_array_append_new(entriesJ, eJ);
+		}
+		json_object_set_new(indexJ, "entries", entriesJ);
+		json_array_append_new(indexesJ, indexJ);
+	}
+	json_object_set_new(rootJ, "indexes", indexesJ);
+
+	std::string path = indexFilePath();
+	system::createDirectories(system::getDirectory(path));
+	json_dump_file(rootJ, path.c_str(), JSON_COMPACT);
+	json_decref(rootJ);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "rack.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace rack;
+
+////////////////////////////////////////////// SAMPLE INDEX //////////////////////////////////////////////
+
+// Header-only facts about one WAV file
+struct SampleIndexEntry {
+	std::string path;
+	int64_t mtime = 0;
+	int64_t size = 0;
+	float durationSec = 0.f;
+	int sampleRate = 0;
+	int channels = 0;
+	int bitsPerSample = 0;
+	bool isFloat = false;
+};
+
+// Immutable snapshot of the decodable WAVs under one directory, sorted by duration
+struct SampleDirIndex {
+	std::string dir;
+	bool recursive = false;
+	std::vector<SampleIndexEntry> entries;
+	// Every directory that was scanned and its mtime, so staleness is a handful of stat() calls
+	std::map<std::string, int64_t> dirMtimes;
+
+	// Random entry no longer than maxDurationSec (0 for any length). Skips exclude when there
+	// is anything else to pick. Returns null when nothing matches.
+	const SampleIndexEntry *pickRandom(float maxDurationSec = 0.f, const std::string &exclude = "") const;
+};
+
+// Process-wide cache of directory listings for random sample loading. Listings are kept in
+// the user folder between sessions and rescanned only when a directory's mtime changes;
+// rescans reuse the header info of files whose size and mtime did not change.
+struct SampleIndex {
+	static SampleIndex &instance();
+
+	// Returns the listing for dir, scanning or refreshing it first if needed (always with
+	// rescan). This touches the disk, so call it from a worker thread. Returns null if the
+	// directory cannot be read.
+	std::shared_ptr<const SampleDirIndex> get(const std::string &dir, bool recursive = false, bool rescan = false);
+	// SampleDirIndex::pickRandom, but the picked file's size and mtime are checked first. A file
+	// rewritten in place doesn't change its directory's mtime, so if they differ the listing is
+	// rescanned, index replaced with the new one and the pick repeated. Worker thread only.
+	const SampleIndexEntry *pickRandom(std::shared_ptr<const SampleDirIndex> &index,
+		float maxDurationSec = 0.f, const std::string &exclude = "");
+
+private:
+	struct Slot {
+		std::shared_ptr<const SampleDirIndex> index;
+		uint64_t lastUse = 0;
+	};
+	std::mutex mutex;
+	std::mutex fileMutex;
+	std::map<std::string, Slot> slots;
+	uint64_t useCounter = 0;
+	bool loaded = false;
+
+	void loadLocked();
+	void save();
+};
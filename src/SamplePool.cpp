@@ -0,0 +1,261 @@
+#include "SamplePool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+SamplePool &SamplePool::instance() {
+	static SamplePool pool;
+	return pool;
+}
+
+static std::string poolKey(const std::string &path, SamplePool::Layout layout) {
+	std::string canonical = rack::system::getCanonical(path);
+	if (canonical.empty()) canonical = path;
+	long long mtime = 0;
+	struct stat st;
+	if (stat(canonical.c_str(), &st) == 0) mtime = (long long)st.st_mtime;
+	return canonical + "|" + std::to_string(mtime) + "|" + std::to_string((int)layout);
+}
+
+std::shared_ptr<const SampleBuffer> SamplePool::acquire(const std::string &path, Layout layout, std::string *error) {
+	std::string key = poolKey(path, layout);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			if (auto buf = it->second.lock()) return buf;
+		}
+	}
+
+	// Decode outside the lock so other instances can keep hitting the cache meanwhile
+	auto decoded = std::make_shared<SampleBuffer>();
+	if (!decodeWavFile(path, layout, *decoded, error)) return nullptr;
+	std::shared_ptr<const SampleBuffer> buf = decoded;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	purgeExpired();
+	auto &slot = entries[key];
+	if (auto existing = slot.lock()) return existing; // another thread won the race
+	slot = buf;
+	return buf;
+}
+
+void SamplePool::purgeExpired() {
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (it->second.expired()) it = entries.erase(it);
+		else ++it;
+	}
+}
+
+size_t SamplePool::totalBytes() {
+	size_t total = 0;
+	std::vector<std::shared_ptr<const SampleBuffer>> live;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : entries) {
+			if (auto buf = entry.second.lock()) live.push_back(buf);
+		}
+	}
+	// Drop our references outside the lock in case we are the last owner
+	for (auto &buf : live) total += buf->bytes();
+	return total;
+}
+
+size_t SamplePool::numFiles() {
+	std::lock_guard<std::mutex> lock(mutex);
+	purgeExpired();
+	return entries.size();
+}
+
+std::string SamplePool::memoryLabel() {
+	size_t bytes = totalBytes();
+	size_t files = numFiles();
+	char buf[64];
+	snprintf(buf, sizeof(buf), "Shared samples: %.1f MB in %d file%s",
+		(double)bytes / 1048576.0, (int)files, files == 1 ? "" : "s");
+	return std::string(buf);
+}
+
+////////////////////////////////////////////// WAV DECODING //////////////////////////////////////////////
+
+static uint32_t readU32(FILE *in) {
+	uint8_t b[4];
+	if (fread(b, 1, 4, in) != 4) return 0;
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void setError(std::string *error, const char *msg) {
+	if (error) *error = msg;
+}
+
+// 64-bit file offsets, so RF64 files past 2 GB (and 4 GB on Windows, where long is 32 bits) parse
+static int seekTo(FILE *in, int64_t pos, int whence = SEEK_SET) {
+#if defined(_WIN32)
+	return _fseeki64(in, pos, whence);
+#else
+	return fseeko(in, (off_t)pos, whence);
+#endif
+}
+
+static int64_t tellPos(FILE *in) {
+#if defined(_WIN32)
+	return _ftelli64(in);
+#else
+	return (int64_t)ftello(in);
+#endif
+}
+
+bool readWavInfo(FILE *in, WavInfo &info, std::string *error) {
+	char riff[4];
+	seekTo(in, 0);
+	if (fread(riff, 1, 4, in) != 4 || (memcmp(riff, "RIFF", 4) != 0 && memcmp(riff, "RF64", 4) != 0)) {
+		setError(error, "Not a WAV/RIFF file");
+		return false;
+	}
+	// RF64 keeps the real data size in a ds64 chunk and sets the 32-bit field to 0xFFFFFFFF
+	const bool rf64 = memcmp(riff, "RF64", 4) == 0;
+	uint64_t ds64DataSize = 0;
+	(void)readU32(in); // file size
+	char wave[4];
+	if (fread(wave, 1, 4, in) != 4 || memcmp(wave, "WAVE", 4) != 0) {
+		setError(error, "Missing WAVE header");
+		return false;
+	}
+
+	info = WavInfo();
+	bool haveFmt = false;
+	seekTo(in, 0, SEEK_END);
+	const int64_t fileSize = tellPos(in);
+	seekTo(in, 12);
+
+	// Safely parse chunks - avoid infinite loops on malformed files
+	while (tellPos(in) + 8 <= fileSize) {
+		char id[4];
+		if (fread(id, 1, 4, in) != 4) break;
+		uint64_t chunkSize = readU32(in);
+		const int64_t currentPos = tellPos(in);
+		if (currentPos < 0) break;
+		if (rf64 && chunkSize == 0xFFFFFFFFull && memcmp(id, "data", 4) == 0) chunkSize = ds64DataSize;
+		if (chunkSize > (uint64_t)(fileSize - currentPos)) {
+			// Truncated data chunks are common from crashed recorders; keep what is there
+			if (memcmp(id, "data", 4) == 0) chunkSize = (uint64_t)(fileSize - currentPos);
+			else break;
+		}
+		if (rf64 && memcmp(id, "ds64", 4) == 0 && chunkSize >= 16) {
+			uint8_t ds[16];
+			if (fread(ds, 1, 16, in) == 16) {
+				for (int i = 0; i < 8; ++i) ds64DataSize |= (uint64_t)ds[8 + i] << (8 * i);
+			}
+		}
+		else if (memcmp(id, "fmt ", 4) == 0) {
+			uint8_t fmt[16];
+			if (chunkSize >= 16 && fread(fmt, 1, 16, in) == 16) {
+				haveFmt = true;
+				info.audioFormat = (uint16_t)(fmt[0] | (fmt[1] << 8));
+				info.numChannels = (uint16_t)(fmt[2] | (fmt[3] << 8));
+				info.sampleRate = (uint32_t)fmt[4] | ((uint32_t)fmt[5] << 8) | ((uint32_t)fmt[6] << 16) | ((uint32_t)fmt[7] << 24);
+				info.bitsPerSample = (uint16_t)(fmt[14] | (fmt[15] << 8));
+			}
+		}
+		else if (memcmp(id, "data", 4) == 0) {
+			info.dataPos = currentPos;
+			info.dataSize = chunkSize;
+			// Nothing after the audio matters once the format is known
+			if (haveFmt) break;
+		}
+		// Chunks are word-aligned
+		if (seekTo(in, currentPos + (int64_t)chunkSize + (int64_t)(chunkSize & 1)) != 0) break;
+	}
+
+	if (info.dataSize == 0 || info.dataPos == 0) {
+		setError(error, "No data chunk");
+		return false;
+	}
+	if (!info.isSupported()) {
+		setError(error, "Unsupported WAV format");
+		return false;
+	}
+	return true;
+}
+
+// Supports PCM16/24/32 and Float32 with any channel count. STEREO keeps the first two
+// channels (mono files leave right empty); MONO_MIX averages the first two.
+bool decodeWavFile(const std::string &path, SamplePool::Layout layout, SampleBuffer &out, std::string *error) {
+	FILE *in = fopen(path.c_str(), "rb");
+	if (!in) { setError(error, "Could not open file"); return false; }
+
+	WavInfo info;
+	if (!readWavInfo(in, info, error)) {
+		fclose(in);
+		return false;
+	}
+	const uint16_t numChannels = info.numChannels;
+	const uint16_t bitsPerSample = info.bitsPerSample;
+	const size_t dataSize = (size_t)info.dataSize;
+	const bool flt = info.audioFormat == 3;
+
+	// Read the whole data chunk in one go and convert from memory
+	std::vector<uint8_t> raw(dataSize);
+	seekTo(in, info.dataPos);
+	size_t got = fread(raw.data(), 1, dataSize, in);
+	fclose(in);
+
+	const size_t bytesPerSample = bitsPerSample / 8;
+	const size_t frameBytes = bytesPerSample * numChannels;
+	const size_t frames = got / frameBytes;
+	if (frames == 0) { setError(error, "No audio frames"); return false; }
+
+	auto sampleAt = [&](size_t frame, int ch) -> float {
+		const uint8_t *p = raw.data() + frame * frameBytes + (size_t)ch * bytesPerSample;
+		if (flt) {
+			float f;
+			memcpy(&f, p, 4);
+			return f;
+		}
+		if (bitsPerSample == 16) {
+			return (float)(int16_t)(p[0] | (p[1] << 8)) / 32768.f;
+		}
+		if (bitsPerSample == 24) {
+			int32_t v = (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16));
+			if (v & 0x800000) v |= 0xFF000000; // sign-extend
+			return (float)v / 8388608.f;
+		}
+		uint32_t u = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+		return (float)(int32_t)u / 2147483648.f;
+	};
+
+	out.left.clear();
+	out.right.clear();
+	out.left.resize(frames);
+	float maxAbs = 0.f;
+	if (layout == SamplePool::MONO_MIX) {
+		for (size_t i = 0; i < frames; ++i) {
+			float v = (numChannels == 1) ? sampleAt(i, 0) : 0.5f * (sampleAt(i, 0) + sampleAt(i, 1));
+			out.left[i] = v;
+			maxAbs = std::max(maxAbs, std::abs(v));
+		}
+	}
+	else {
+		if (numChannels > 1) out.right.resize(frames);
+		for (size_t i = 0; i < frames; ++i) {
+			float l = sampleAt(i, 0);
+			out.left[i] = l;
+			maxAbs = std::max(maxAbs, std::abs(l));
+			if (numChannels > 1) {
+				float r = sampleAt(i, 1);
+				out.right[i] = r;
+				maxAbs = std::max(maxAbs, std::abs(r));
+			}
+		}
+	}
+	// Normalize softly to avoid clipping
+	if (maxAbs > 0.f) {
+		float gain = 1.f / maxAbs;
+		for (float &v : out.left) v *= gain;
+		for (float &v : out.right) v *= gain;
+	}
+	out.sampleRate = (int)info.sampleRate;
+	return true;
+}
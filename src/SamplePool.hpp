@@ -0,0 +1,288 @@
+#pragma once
+#include "rack.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace rack;
+
+////////////////////////////////////////////// SAMPLE POOL //////////////////////////////////////////////
+
+// Decoded WAV audio. Once handed out by the pool it is never written again.
+struct SampleBuffer {
+	std::vector<float> left;
+	std::vector<float> right; // empty when the file is mono (readers alias left)
+	int sampleRate = 44100;
+
+	size_t bytes() const {
+		return (left.capacity() + right.capacity()) * sizeof(float);
+	}
+};
+
+// One channel of audio as seen by a module. It either aliases a pooled SampleBuffer
+// (optionally as a slice and/or reversed) or owns its samples. Anything that writes
+// detaches into an owned copy first, so pooled audio is never modified.
+struct SampleChannel {
+	SampleChannel() {}
+
+	SampleChannel(const std::shared_ptr<const SampleBuffer> &buf, bool rightChannel = false) {
+		if (!buf) return;
+		const std::vector<float> &v = (rightChannel && !buf->right.empty()) ? buf->right : buf->left;
+		shared = std::shared_ptr<const std::vector<float>>(buf, &v);
+		len = v.size();
+		sync();
+	}
+
+	SampleChannel(const SampleChannel &) = default;
+	SampleChannel &operator=(const SampleChannel &) = default;
+
+	// Moves leave the source empty so it never points at storage it no longer holds
+	SampleChannel(SampleChannel &&o) {
+		*this = std::move(o);
+	}
+
+	SampleChannel &operator=(SampleChannel &&o) {
+		if (this == &o) return *this;
+		shared = std::move(o.shared);
+		owned = std::move(o.owned);
+		data = o.data;
+		offset = o.offset;
+		len = o.len;
+		reversed = o.reversed;
+		o.data = nullptr;
+		o.offset = 0;
+		o.len = 0;
+		o.reversed = false;
+		return *this;
+	}
+
+	SampleChannel &operator=(std::vector<float> &&v) {
+		shared.reset();
+		owned = std::make_shared<std::vector<float>>(std::move(v));
+		offset = 0;
+		reversed = false;
+		sync();
+		return *this;
+	}
+
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	bool isReversed() const { return reversed; }
+	// True while this channel aliases pooled audio that other instances may also be reading
+	bool isShared() const { return (bool) shared; }
+
+	float operator[](size_t i) const {
+		return data[reversed ? len - 1 - i : i];
+	}
+
+	// View of [start, end) in playback order, sharing the same storage
+	SampleChannel slice(size_t start, size_t end) const {
+		SampleChannel s = *this;
+		end = std::min(end, len);
+		start = std::min(start, end);
+		s.offset = reversed ? offset + (len - end) : offset + start;
+		s.len = end - start;
+		s.data = data ? data - offset + s.offset : nullptr;
+		return s;
+	}
+
+	void setReversed(bool r) { reversed = r; }
+
+	// Same samples in the same direction, e.g. a cell that was only moved to another slot
+	bool sameAudio(const SampleChannel &o) const {
+		return data == o.data && len == o.len && reversed == o.reversed;
+	}
+
+	void clear() {
+		shared.reset();
+		owned.reset();
+		offset = 0;
+		reversed = false;
+		sync();
+	}
+
+	void reserve(size_t n) {
+		edit().reserve(n);
+		sync();
+	}
+
+	void push_back(float v) {
+		edit().push_back(v);
+		sync();
+	}
+
+	void assign(size_t n, float v) {
+		*this = std::vector<float>(n, v);
+	}
+
+	// Owned, contiguous, forward-ordered samples ready for writing. Call sync() after
+	// resizing the returned vector.
+	std::vector<float> &edit() {
+		if (shared || !owned || owned.use_count() > 1 || offset != 0 || reversed || len != owned->size()) {
+			auto copy = std::make_shared<std::vector<float>>();
+			copy->reserve(len);
+			for (size_t i = 0; i < len; ++i) copy->push_back((*this)[i]);
+			shared.reset();
+			owned = copy;
+			offset = 0;
+			reversed = false;
+			sync();
+		}
+		return *owned;
+	}
+
+	void sync() {
+		if (owned) {
+			len = owned->size();
+			data = owned->data();
+		}
+		else if (shared) {
+			data = shared->data() + offset;
+		}
+		else {
+			len = 0;
+			data = nullptr;
+		}
+	}
+
+private:
+	std::shared_ptr<const std::vector<float>> shared;
+	std::shared_ptr<std::vector<float>> owned;
+	const float *data = nullptr;
+	size_t offset = 0;
+	size_t len = 0;
+	bool reversed = false;
+};
+
+// Min/max outline of one channel for drawing, at most COLUMNS columns. Each column covers a
+// power-of-two run of frames, so a recording can be outlined a frame at a time: when the
+// columns run out, neighbours merge and each column covers twice as many frames. Fixed size,
+// so the engine can keep one and hand copies to the UI without allocating.
+struct WaveOverview {
+	static const int COLUMNS = 512;
+	float minV[COLUMNS];
+	float maxV[COLUMNS];
+	int columns = 0;
+	size_t frames = 0;
+	size_t span = 1; // frames per column
+
+	void clear() {
+		columns = 0;
+		frames = 0;
+		span = 1;
+	}
+
+	void add(float v) {
+		if (frames == (size_t)columns * span) {
+			if (columns == COLUMNS) {
+				for (int c = 0; c < COLUMNS / 2; c++) {
+					minV[c] = std::min(minV[2 * c], minV[2 * c + 1]);
+					maxV[c] = std::max(maxV[2 * c], maxV[2 * c + 1]);
+				}
+				columns = COLUMNS / 2;
+				span *= 2;
+			}
+			minV[columns] = v;
+			maxV[columns] = v;
+			columns++;
+		}
+		else {
+			minV[columns - 1] = std::min(minV[columns - 1], v);
+			maxV[columns - 1] = std::max(maxV[columns - 1], v);
+		}
+		frames++;
+	}
+
+	// Not for the audio thread on long buffers
+	void build(const SampleChannel &ch) {
+		clear();
+		for (size_t i = 0; i < ch.size(); i++) add(ch[i]);
+	}
+
+	// Follows a constant added to every sample (e.g. DC removed after recording)
+	void offset(float d) {
+		for (int c = 0; c < columns; c++) {
+			minV[c] += d;
+			maxV[c] += d;
+		}
+	}
+
+	// Min and max of frames [begin, end), widened to whole columns
+	void range(size_t begin, size_t end, float &lo, float &hi) const {
+		if (columns == 0) { lo = hi = 0.f; return; }
+		int c0 = (int)std::min(begin / span, (size_t)columns - 1);
+		int c1 = (int)std::min((std::max(end, begin + 1) - 1) / span, (size_t)columns - 1);
+		lo = minV[c0];
+		hi = maxV[c0];
+		for (int c = c0 + 1; c <= c1; c++) {
+			lo = std::min(lo, minV[c]);
+			hi = std::max(hi, maxV[c]);
+		}
+	}
+};
+
+// Process-wide cache of decoded WAV files keyed by canonical path, modification time and
+// layout. Entries are held weakly: the memory is released when the last module lets go.
+struct SamplePool {
+	enum Layout {
+		STEREO,   // left/right normalized together (Grains)
+		MONO_MIX, // channels averaged and normalized (SampleGrid)
+		NUM_LAYOUTS
+	};
+
+	static SamplePool &instance();
+
+	// Returns the decoded file, decoding it if no live instance is holding it. On failure
+	// returns null and, if given, fills error with a short status message.
+	std::shared_ptr<const SampleBuffer> acquire(const std::string &path, Layout layout, std::string *error = nullptr);
+
+	size_t totalBytes();
+	size_t numFiles();
+	std::string memoryLabel();
+
+private:
+	std::mutex mutex;
+	std::map<std::string, std::weak_ptr<const SampleBuffer>> entries;
+
+	void purgeExpired();
+};
+
+// Format facts from a WAV header, enough to size or decode the data chunk
+struct WavInfo {
+	uint16_t audioFormat = 1; // 1=PCM, 3=FLOAT
+	uint16_t numChannels = 1;
+	uint32_t sampleRate = 44100;
+	uint16_t bitsPerSample = 16;
+	int64_t dataPos = 0;
+	uint64_t dataSize = 0;
+
+	// PCM16/24/32 or Float32, the formats decodeWavFile() reads
+	bool isSupported() const {
+		bool pcm = audioFormat == 1 && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32);
+		bool flt = audioFormat == 3 && bitsPerSample == 32;
+		return (pcm || flt) && numChannels > 0;
+	}
+	size_t numFrames() const {
+		size_t frameBytes = (size_t)(bitsPerSample / 8) * numChannels;
+		return frameBytes ? (size_t)(dataSize / frameBytes) : 0;
+	}
+	float durationSec() const {
+		return sampleRate ? (float)((double)numFrames() / (double)sampleRate) : 0.f;
+	}
+};
+
+// Walks the RIFF (or RF64) chunks without reading any audio. Leaves the file position unspecified.
+bool readWavInfo(FILE *in, WavInfo &info, std::string *error = nullptr);
+bool decodeWavFile(const std::string &path, SamplePool::Layout layout, SampleBuffer &out, std::string *error = nullptr);
+
+struct SamplePoolMemoryLabel : MenuLabel {
+	void step() override {
+		text = SamplePool::instance().memoryLabel();
+		MenuLabel::step();
+	}
+};
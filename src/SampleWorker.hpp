@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+////////////////////////////////////////////// REALTIME MESSAGING //////////////////////////////////////////////
+
+// Bounded single-producer/single-consumer queue. push() and pop() never lock or allocate.
+// Popped slots are reset on the consumer side, so memory a message owned (strings, sample
+// buffers) is released by the consumer and never handed back to the producer's thread.
+template <typename T, size_t CAPACITY>
+struct SpscQueue {
+	// Producer only. Returns false (leaving item untouched) when the queue is full.
+	bool push(T &&item) {
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t next = (h + 1) % (CAPACITY + 1);
+		if (next == tail.load(std::memory_order_acquire)) return false;
+		slots[h] = std::move(item);
+		head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Returns false when the queue is empty.
+	bool pop(T &item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false;
+		item = std::move(slots[t]);
+		slots[t].~T();
+		new (&slots[t]) T();
+		tail.store((t + 1) % (CAPACITY + 1), std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+	}
+
+private:
+	T slots[CAPACITY + 1];
+	std::atomic<size_t> head{0};
+	std::atomic<size_t> tail{0};
+};
+
+// Background thread for a module's blocking work (disk I/O, decoding, freeing buffers).
+// The module drains its queues in the work callback. The UI thread may wake() the worker
+// immediately; the audio thread must not, so the worker also polls every few milliseconds.
+struct SampleWorker {
+	~SampleWorker() {
+		stop();
+	}
+
+	void start(std::function<void()> work) {
+		stop();
+		running = true;
+		thread = std::thread([this, work]() {
+			while (running) {
+				work();
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait_for(lock, std::chrono::milliseconds(5), [this]() { return woken || !running; });
+				woken = false;
+			}
+		});
+	}
+
+	void stop() {
+		if (!thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		cv.notify_one();
+		thread.join();
+	}
+
+	// UI thread only
+	void wake() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			woken = true;
+		}
+		cv.notify_one();
+	}
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::atomic<bool> running{false};
+	bool woken = false;
+};
@@ -0,0 +1,388 @@
+#include "ScalaScales.hpp"
+#include "osdialog.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static const int MAX_USER_SCALE_NOTES = 4096;
+// C4, the pitch of 0 V
+static const double ZERO_VOLT_FREQ = 261.6255653;
+
+static int floorDiv(int a, int b) {
+	int q = a / b;
+	return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+double ScalaTuning::degreeCents(int degree) const {
+	int n = notes();
+	int periods = floorDiv(degree, n);
+	return periods * period() + cents[degree - periods * n];
+}
+
+////////////////////////////////////////////// PARSING //////////////////////////////////////////////
+
+static void setError(std::string *error, const std::string &msg) {
+	if (error) *error = msg;
+}
+
+// Next line that is not a '!' comment, without its line ending
+static bool nextLine(const std::string &text, size_t &pos, std::string &line) {
+	while (pos < text.size()) {
+		size_t end = text.find('\n', pos);
+		if (end == std::string::npos) end = text.size();
+		line = text.substr(pos, end - pos);
+		pos = end + 1;
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (!line.empty() && line[0] == '!') continue;
+		return true;
+	}
+	return false;
+}
+
+// First whitespace separated token; Scala ignores anything after it
+static std::string firstToken(const std::string &line) {
+	size_t start = line.find_first_not_of(" \t");
+	if (start == std::string::npos) return "";
+	size_t end = line.find_first_of(" \t", start);
+	return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+static bool parseNumber(const std::string &s, double &value) {
+	if (s.empty()) return false;
+	char *end = nullptr;
+	value = strtod(s.c_str(), &end);
+	return end == s.c_str() + s.size() && std::isfinite(value);
+}
+
+static bool parseInt(const std::string &s, int &value) {
+	double d;
+	if (!parseNumber(s, d) || d != std::floor(d)) return false;
+	value = (int)d;
+	return true;
+}
+
+// A pitch is cents when it has a period, otherwise a ratio "a/b" or a whole number "a"
+static bool parsePitch(const std::string &token, double &cents) {
+	if (token.find('.') != std::string::npos)
+		return parseNumber(token, cents);
+	size_t slash = token.find('/');
+	double num, den = 1.0;
+	if (!parseNumber(token.substr(0, slash), num)) return false;
+	if (slash != std::string::npos && !parseNumber(token.substr(slash + 1), den)) return false;
+	if (num <= 0.0 || den <= 0.0) return false;
+	cents = 1200.0 * std::log2(num / den);
+	return true;
+}
+
+bool parseScalaScale(const std::string &text, ScalaTuning &out, std::string *error) {
+	size_t pos = 0;
+	std::string line;
+	if (!nextLine(text, pos, out.description)) { setError(error, "Empty scale file"); return false; }
+	int count = 0;
+	if (!nextLine(text, pos, line) || !parseInt(firstToken(line), count)) { setError(error, "Missing note count"); return false; }
+	if (count < 1 || count > MAX_USER_SCALE_NOTES) { setError(error, "Unsupported note count"); return false; }
+	out.cents.assign(1, 0.0);
+	while ((int)out.cents.size() <= count && nextLine(text, pos, line)) {
+		std::string token = firstToken(line);
+		if (token.empty()) continue;
+		double cents;
+		if (!parsePitch(token, cents)) { setError(error, "Bad pitch: " + token); return false; }
+		out.cents.push_back(cents);
+	}
+	if ((int)out.cents.size() <= count) { setError(error, "Fewer pitches than the note count"); return false; }
+	if (out.period() <= 0.0) { setError(error, "The last pitch must be above 1/1"); return false; }
+	return true;
+}
+
+bool parseScalaKeyboardMap(const std::string &text, ScalaKeyboardMap &out, std::string *error) {
+	size_t pos = 0;
+	std::string line;
+	std::vector<std::string> values;
+	while (nextLine(text, pos, line)) {
+		std::string token = firstToken(line);
+		if (!token.empty()) values.push_back(token);
+	}
+	if (values.size() < 7) { setError(error, "Keyboard mapping header is incomplete"); return false; }
+	bool ok = parseInt(values[0], out.size) && parseInt(values[1], out.firstNote) && parseInt(values[2], out.lastNote)
+		&& parseInt(values[3], out.middleNote) && parseInt(values[4], out.referenceNote)
+		&& parseNumber(values[5], out.referenceFreq) && parseInt(values[6], out.octaveDegree);
+	if (!ok || out.size < 0 || out.size > MAX_USER_SCALE_NOTES || out.referenceFreq <= 0.0) {
+		setError(error, "Bad keyboard mapping header");
+		return false;
+	}
+	// Keys past the listed entries are unmapped
+	out.map.assign(out.size, -1);
+	for (int i = 0; i < out.size && 7 + i < (int)values.size(); i++) {
+		const std::string &v = values[7 + i];
+		if (v == "x" || v == "X") continue;
+		if (!parseInt(v, out.map[i])) { setError(error, "Bad mapping entry: " + v); return false; }
+	}
+	return true;
+}
+
+////////////////////////////////////////////// COMPILING //////////////////////////////////////////////
+
+bool UserScale::compile(const ScalaTuning &tuning, const ScalaKeyboardMap *kbm, std::string *error) {
+	// Cents above the middle note of every playable pitch in one period, and of the reference key
+	std::vector<double> cents;
+	double periodCents = tuning.period();
+	double referenceCents = 0.0;
+	if (!kbm || kbm->size == 0) {
+		for (int d = 0; d < tuning.notes(); d++)
+			cents.push_back(tuning.degreeCents(d));
+		if (kbm) referenceCents = tuning.degreeCents(kbm->referenceNote - kbm->middleNote);
+	}
+	else {
+		periodCents = tuning.degreeCents(kbm->octaveDegree);
+		for (int degree : kbm->map) {
+			if (degree >= 0) cents.push_back(tuning.degreeCents(degree));
+		}
+		int key = kbm->referenceNote - kbm->middleNote;
+		int periods = floorDiv(key, kbm->size);
+		int degree = kbm->map[key - periods * kbm->size];
+		// An unmapped reference key has no pitch of its own; fall back to 12-EDO spacing
+		referenceCents = periods * periodCents + (degree >= 0 ? tuning.degreeCents(degree) : 100.0 * (key - periods * kbm->size));
+	}
+	if (cents.empty()) { setError(error, "No keys are mapped"); return false; }
+	if (periodCents <= 0.0) { setError(error, "The formal octave must be above 1/1"); return false; }
+
+	period = (float)(periodCents / 1200.0);
+	offset = kbm ? (float)(std::log2(kbm->referenceFreq / ZERO_VOLT_FREQ) - referenceCents / 1200.0) : 0.f;
+
+	std::vector<float> volts;
+	for (double c : cents) {
+		double v = std::fmod(c, periodCents);
+		if (v < 0.0) v += periodCents;
+		volts.push_back((float)(v / 1200.0));
+	}
+	std::sort(volts.begin(), volts.end());
+	volts.erase(std::unique(volts.begin(), volts.end(), [](float a, float b) { return b - a < 1e-6f; }), volts.end());
+
+	pitches.clear();
+	pitches.push_back(volts.back() - period);
+	pitches.insert(pitches.end(), volts.begin(), volts.end());
+	pitches.push_back(volts.front() + period);
+	bounds.resize(pitches.size());
+	for (size_t i = 0; i + 1 < pitches.size(); i++)
+		bounds[i] = (pitches[i] + pitches[i + 1]) / 2.f;
+	bounds.back() = INFINITY;
+
+	// A few buckets per pitch keeps the forward scan to a step or two
+	size_t count = 16;
+	while (count < 4 * volts.size()) count <<= 1;
+	buckets.resize(count);
+	bucketsPerVolt = count / period;
+	size_t i = 0;
+	for (size_t b = 0; b < count; b++) {
+		float start = b / bucketsPerVolt;
+		while (start >= bounds[i]) i++;
+		buckets[b] = (uint16_t)i;
+	}
+	return true;
+}
+
+////////////////////////////////////////////// LIBRARY //////////////////////////////////////////////
+
+ScalaLibrary &ScalaLibrary::instance() {
+	static ScalaLibrary library;
+	return library;
+}
+
+ScalaLibrary::~ScalaLibrary() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	cv.notify_one();
+	if (thread.joinable()) thread.join();
+}
+
+void ScalaLibrary::assign(UserScaleSlots *slots, int slot, const std::string &scl, const std::string &kbm) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		subscribers.insert(slots);
+		slots->attached = true;
+		slots->sclPaths[slot] = scl;
+		slots->kbmPaths[slot] = scl.empty() ? "" : kbm;
+		slots->errors[slot].clear();
+		slots->pending[slot] = !scl.empty();
+		if (scl.empty()) {
+			slots->scales[slot].store(nullptr, std::memory_order_release);
+			return;
+		}
+		jobs.push_back({scl, slots->kbmPaths[slot]});
+		if (!running) {
+			running = true;
+			thread = std::thread([this]() { run(); });
+		}
+	}
+	cv.notify_one();
+}
+
+void ScalaLibrary::detach(UserScaleSlots *slots) {
+	std::lock_guard<std::mutex> lock(mutex);
+	subscribers.erase(slots);
+}
+
+std::string ScalaLibrary::status(UserScaleSlots *slots, int slot) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return slots->pending[slot] ? "Loading..." : slots->errors[slot];
+}
+
+static int64_t fileMtime(const std::string &path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return -1;
+	return (int64_t)st.st_mtime;
+}
+
+static bool readTextFile(const std::string &path, std::string &text) {
+	FILE *in = fopen(path.c_str(), "rb");
+	if (!in) return false;
+	char buf[4096];
+	size_t n;
+	text.clear();
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0) text.append(buf, n);
+	fclose(in);
+	return true;
+}
+
+void ScalaLibrary::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running) {
+		if (jobs.empty()) {
+			cv.wait(lock);
+			continue;
+		}
+		Job job = jobs.front();
+		jobs.pop_front();
+		lock.unlock();
+		Compiled compiled = load(job);
+		lock.lock();
+		publish(job, compiled);
+	}
+}
+
+// Library thread, without the lock except to look at and fill the cache
+ScalaLibrary::Compiled ScalaLibrary::load(const Job &job) {
+	Compiled compiled;
+	compiled.sclMtime = fileMtime(job.scl);
+	compiled.kbmMtime = job.kbm.empty() ? 0 : fileMtime(job.kbm);
+	if (compiled.sclMtime < 0 || compiled.kbmMtime < 0) {
+		compiled.error = "File not found";
+		return compiled;
+	}
+	const std::string key = job.scl + "|" + job.kbm;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = cache.find(key);
+		if (it != cache.end() && it->second.sclMtime == compiled.sclMtime && it->second.kbmMtime == compiled.kbmMtime)
+			return it->second;
+	}
+
+	std::string text;
+	ScalaTuning tuning;
+	ScalaKeyboardMap kbm;
+	std::unique_ptr<UserScale> scale(new UserScale());
+	if (!readTextFile(job.scl, text)) compiled.error = "Could not read scale";
+	else if (!parseScalaScale(text, tuning, &compiled.error)) {}
+	else if (!job.kbm.empty() && !readTextFile(job.kbm, text)) compiled.error = "Could not read keyboard mapping";
+	else if (!job.kbm.empty() && !parseScalaKeyboardMap(text, kbm, &compiled.error)) {}
+	else if (scale->compile(tuning, job.kbm.empty() ? nullptr : &kbm, &compiled.error)) {
+		scale->name = system::getStem(job.scl);
+		compiled.scale = scale.get();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (compiled.scale) scales.push_back(std::move(scale));
+	cache[key] = compiled;
+	return compiled;
+}
+
+// Library thread, locked: hands the result to every slot still asking for these files
+void ScalaLibrary::publish(const Job &job, const Compiled &compiled) {
+	for (UserScaleSlots *slots : subscribers) {
+		for (int i = 0; i < USER_SCALE_SLOTS; i++) {
+			if (!slots->pending[i] || slots->sclPaths[i] != job.scl || slots->kbmPaths[i] != job.kbm) continue;
+			slots->pending[i] = false;
+			slots->errors[i] = compiled.error;
+			slots->scales[i].store(compiled.scale, std::memory_order_release);
+		}
+	}
+}
+
+////////////////////////////////////////////// SLOTS //////////////////////////////////////////////
+
+UserScaleSlots::~UserScaleSlots() {
+	if (attached) ScalaLibrary::instance().detach(this);
+}
+
+void UserScaleSlots::assign(int slot, const std::string &scl, const std::string &kbm) {
+	if (slot < 0 || slot >= USER_SCALE_SLOTS) return;
+	ScalaLibrary::instance().assign(this, slot, scl, kbm);
+}
+
+std::string UserScaleSlots::status(int slot) {
+	if (!attached) return "";
+	return ScalaLibrary::instance().status(this, slot);
+}
+
+json_t *UserScaleSlots::toJson() const {
+	json_t *userScalesJ = json_array();
+	for (int i = 0; i < USER_SCALE_SLOTS; i++) {
+		if (sclPaths[i].empty()) continue;
+		json_t *slotJ = json_object();
+		json_object_set_new(slotJ, "slot", json_integer(i));
+		json_object_set_new(slotJ, "scl", json_string(sclPaths[i].c_str()));
+		if (!kbmPaths[i].empty())
+			json_object_set_new(slotJ, "kbm", json_string(kbmPaths[i].c_str()));
+		json_array_append_new(userScalesJ, slotJ);
+	}
+	return userScalesJ;
+}
+
+// Slots missing from userScalesJ (or all of them when it is null) go back to the built-in scales
+void UserScaleSlots::fromJson(json_t *userScalesJ) {
+	std::string scl[USER_SCALE_SLOTS], kbm[USER_SCALE_SLOTS];
+	size_t i;
+	json_t *slotJ;
+	json_array_foreach(userScalesJ, i, slotJ) {
+		int slot = (int)json_integer_value(json_object_get(slotJ, "slot"));
+		json_t *sclJ = json_object_get(slotJ, "scl");
+		json_t *kbmJ = json_object_get(slotJ, "kbm");
+		if (slot < 0 || slot >= USER_SCALE_SLOTS || !json_is_string(sclJ)) continue;
+		scl[slot] = json_string_value(sclJ);
+		if (json_is_string(kbmJ)) kbm[slot] = json_string_value(kbmJ);
+	}
+	for (int s = 0; s < USER_SCALE_SLOTS; s++) {
+		if (scl[s] != sclPaths[s] || kbm[s] != kbmPaths[s])
+			assign(s, scl[s], kbm[s]);
+	}
+}
+
+////////////////////////////////////////////// FILE DIALOG //////////////////////////////////////////////
+
+void pickScalaFile(bool keyboardMap, std::function<void(const std::string &path)> done) {
+	const char *filterSpec = keyboardMap ? "Scala keyboard mapping:kbm" : "Scala scale:scl";
+#if defined(METAMODULE_BUILTIN)
+	osdialog_filters *filters = osdialog_filters_parse(filterSpec);
+	async_osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters, [filters, done](char *path) {
+		if (path) {
+			std::string p = path;
+			free(path);
+			done(p);
+		}
+		osdialog_filters_free(filters);
+	});
+#else
+	osdialog_filters *filters = osdialog_filters_parse(filterSpec);
+	char *path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+	osdialog_filters_free(filters);
+	if (path) {
+		std::string p = path;
+		free(path);
+		done(p);
+	}
+#endif
+}
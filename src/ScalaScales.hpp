@@ -0,0 +1,164 @@
+#pragma once
+#include "rack.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rack;
+
+////////////////////////////////////////////// SCALA SCALES //////////////////////////////////////////////
+
+// Room for every built-in scale; QuantizeUtils checks that NUM_SCALES fits
+#define USER_SCALE_SLOTS 32
+
+// Pitches of a Scala .scl file. cents[0] is the implied 1/1; the last entry is the period
+// the scale repeats at (1200 for octave scales, 1901.96 for Bohlen-Pierce and so on).
+struct ScalaTuning {
+	std::string description;
+	std::vector<double> cents;
+
+	int notes() const { return (int)cents.size() - 1; }
+	double period() const { return cents.back(); }
+	// Any degree, including negative ones and ones past the period
+	double degreeCents(int degree) const;
+};
+
+// A Scala .kbm keyboard mapping. Only the parts that make sense for V/oct are used: which
+// degrees are playable, the formal octave they repeat at and where the reference pitch sits.
+// The MIDI note range is ignored.
+struct ScalaKeyboardMap {
+	int size = 0; // 0 for a linear mapping
+	int firstNote = 0;
+	int lastNote = 127;
+	int middleNote = 60;
+	int referenceNote = 69;
+	double referenceFreq = 440.0;
+	int octaveDegree = 0;
+	std::vector<int> map; // scale degree per key, -1 where the key is unmapped ('x')
+};
+
+bool parseScalaScale(const std::string &text, ScalaTuning &out, std::string *error = nullptr);
+bool parseScalaKeyboardMap(const std::string &text, ScalaKeyboardMap &out, std::string *error = nullptr);
+
+// A Scala scale compiled for quantizing. The pitches of one period are sorted with a neighbour
+// from each side, and a bucket index over the period points each input at its first candidate,
+// so a 72 note scale costs about the same to quantize as a 7 note one. Never changes once built.
+struct UserScale {
+	std::string name;
+	// Volts after which the pitches repeat (1 V for octave scales)
+	float period = 1.f;
+	// Volts of the keyboard map's middle note relative to C4, before the root knob
+	float offset = 0.f;
+
+	bool compile(const ScalaTuning &tuning, const ScalaKeyboardMap *kbm, std::string *error = nullptr);
+
+	float quantize(float voltsIn, int rootNote) const {
+		float base = offset + rootNote / 12.0f;
+		float rel = voltsIn - base;
+		float periods = floorf(rel / period);
+		float frac = rel - periods * period;
+		int bucket = std::max(0, std::min((int)(frac * bucketsPerVolt), (int)buckets.size() - 1));
+		int i = buckets[bucket];
+		// bounds ends in +INFINITY; a NaN input stops at the first candidate
+		while (frac >= bounds[i]) i++;
+		return base + periods * period + pitches[i];
+	}
+
+	int size() const { return (int)pitches.size() - 2; }
+
+private:
+	// Ascending pitches of one period in volts, led by the last pitch of the period below and
+	// ended by the first pitch of the period above
+	std::vector<float> pitches;
+	// bounds[i] is halfway between pitches[i] and pitches[i + 1]
+	std::vector<float> bounds;
+	std::vector<uint16_t> buckets;
+	float bucketsPerVolt = 1.f;
+};
+
+// The Scala scales a module has put in place of built-in ones, one per scale slot. Slots
+// without a user scale quantize to the built-in scale as before.
+struct UserScaleSlots {
+	// Read by the engine. Scales are owned by the ScalaLibrary and outlive every module.
+	std::atomic<const UserScale*> scales[USER_SCALE_SLOTS];
+
+	UserScaleSlots() {
+		for (int i = 0; i < USER_SCALE_SLOTS; i++)
+			scales[i].store(nullptr);
+	}
+	~UserScaleSlots();
+
+	const UserScale *get(int slot) const {
+		return scales[slot].load(std::memory_order_acquire);
+	}
+
+	// UI thread. Loads in the background; the slot keeps its previous scale until then.
+	// An empty scl path clears the slot.
+	void assign(int slot, const std::string &scl, const std::string &kbm = "");
+	const std::string &sclPath(int slot) const { return sclPaths[slot]; }
+	const std::string &kbmPath(int slot) const { return kbmPaths[slot]; }
+	// UI thread: "Loading...", the load error or empty
+	std::string status(int slot);
+
+	json_t *toJson() const;
+	void fromJson(json_t *userScalesJ);
+
+private:
+	friend struct ScalaLibrary;
+	// Written on the UI thread under the library mutex, read by the library thread under it
+	std::string sclPaths[USER_SCALE_SLOTS];
+	std::string kbmPaths[USER_SCALE_SLOTS];
+	// Written by the library thread under the library mutex
+	std::string errors[USER_SCALE_SLOTS];
+	bool pending[USER_SCALE_SLOTS] = {};
+	bool attached = false;
+};
+
+// Process-wide loader and cache for Scala files. Files are read, parsed and compiled on one
+// background thread, and each file pair is compiled only once per modification time however
+// many modules use it. Compiled scales are kept until exit so the engine never sees one freed.
+struct ScalaLibrary {
+	static ScalaLibrary &instance();
+	~ScalaLibrary();
+
+	void assign(UserScaleSlots *slots, int slot, const std::string &scl, const std::string &kbm);
+	void detach(UserScaleSlots *slots);
+	std::string status(UserScaleSlots *slots, int slot);
+
+private:
+	struct Job {
+		std::string scl, kbm;
+	};
+	struct Compiled {
+		int64_t sclMtime = 0, kbmMtime = 0;
+		const UserScale *scale = nullptr;
+		std::string error;
+	};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::thread thread;
+	bool running = false;
+	std::deque<Job> jobs;
+	std::set<UserScaleSlots*> subscribers;
+	std::map<std::string, Compiled> cache;
+	std::vector<std::unique_ptr<UserScale>> scales;
+
+	void run();
+	Compiled load(const Job &job);
+	void publish(const Job &job, const Compiled &compiled);
+};
+
+// UI thread: file dialog for a .scl (or .kbm) file; calls done with the chosen path
+void pickScalaFile(bool keyboardMap, std::function<void(const std::string &path)> done);
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Built-in scale tables, free of any Rack dependency so tests/ can check them on their own
+
+// 12-bit pitch-class set, bit n set when the scale has the note n semitones above the root
+constexpr uint16_t pitchClasses() { return 0; }
+template <typename... Notes>
+constexpr uint16_t pitchClasses(int note, Notes... rest) {
+	return (uint16_t)((1 << (note % 12)) | pitchClasses(rest...));
+}
+
+//copied & fixed these scales http://www.grantmuller.com/MidiReference/doc/midiReference/ScaleReference.html
+//more scales http://lawriecape.co.uk/theblog/index.php/archives/881
+
+// Indexed by QuantizeUtils::ScaleEnum. Every scale has its root, so the root an octave up
+// is always a candidate too.
+static constexpr uint16_t SCALE_MASKS[] = {
+	pitchClasses(0, 2, 3, 5, 7, 8, 10),          // AEOLIAN
+	pitchClasses(0, 3, 5, 6, 7, 10),             // BLUES //FIXED!
+	pitchClasses(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11), // CHROMATIC
+	pitchClasses(0, 2, 3, 5, 7, 8, 10),          // DIATONIC_MINOR
+	pitchClasses(0, 2, 3, 5, 7, 9, 10),          // DORIAN
+	pitchClasses(0, 2, 3, 5, 7, 8, 11),          // HARMONIC_MINOR
+	pitchClasses(0, 1, 4, 5, 8, 10),             // INDIAN
+	pitchClasses(0, 1, 3, 5, 6, 8, 10),          // LOCRIAN
+	pitchClasses(0, 2, 4, 6, 7, 9, 11),          // LYDIAN
+	pitchClasses(0, 2, 4, 5, 7, 9, 11),          // MAJOR
+	pitchClasses(0, 2, 3, 5, 7, 8, 9, 10, 11),   // MELODIC_MINOR
+	pitchClasses(0, 2, 3, 5, 7, 8, 10),          // MINOR
+	pitchClasses(0, 2, 4, 5, 7, 9, 10),          // MIXOLYDIAN
+	pitchClasses(0, 2, 3, 5, 7, 8, 10),          // NATURAL_MINOR
+	pitchClasses(0, 2, 4, 7, 9),                 // PENTATONIC
+	pitchClasses(0, 1, 3, 5, 7, 8, 10),          // PHRYGIAN
+	pitchClasses(0, 1, 3, 5, 7, 10, 11),         // TURKISH
+	pitchClasses(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11), // NONE (chromatic when asked to quantize)
+	pitchClasses(0, 3, 5, 7, 10),                // PENTATONIC_MINOR
+	pitchClasses(0, 2, 4, 6, 8, 10),             // WHOLE_TONE
+	pitchClasses(0, 2, 3, 5, 6, 8, 9, 11),       // DIMINISHED
+	pitchClasses(0, 2, 4, 5, 7, 8, 11),          // HARMONIC_MAJOR
+	pitchClasses(0, 1, 4, 5, 7, 8, 11),          // DOUBLE_HARMONIC
+	pitchClasses(0, 2, 4, 5, 7, 8, 9, 11),       // MAJOR_BEBOP
+	pitchClasses(0, 2, 3, 5, 7, 8, 9, 10),       // MINOR_BEBOP
+	pitchClasses(0, 1, 4, 5, 7, 8, 10),          // PHRYGIAN_DOMINANT
+	pitchClasses(0, 2, 3, 6, 7, 8, 11),          // HUNGARIAN_MINOR
+	pitchClasses(0, 1, 3, 4, 6, 8, 10),          // ALTERED
+	pitchClasses(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11), // NONE2
+};
+
+// The nearest scale note only changes halfway between two semitones, so an octave splits into
+// 24 slots of a quarter tone, each with one nearest note
+#define QUANTIZE_SLOTS 24
+
+// Distance in eighth tones from a semitone to the middle of a slot
+constexpr int slotDistance(int semitone, int slot) {
+	return 4 * semitone > 2 * slot + 1 ? 4 * semitone - (2 * slot + 1) : (2 * slot + 1) - 4 * semitone;
+}
+
+// Nearest note of mask to the middle of slot, searching up from semitone, 0 to 12 (the root an
+// octave up). Lower notes win ties, though no slot middle is ever halfway between two notes.
+constexpr int nearestSemitone(uint16_t mask, int slot, int semitone = 1, int best = 0) {
+	return semitone > 12 ? best :
+		nearestSemitone(mask, slot, semitone + 1,
+			((mask >> (semitone % 12)) & 1) && slotDistance(semitone, slot) < slotDistance(best, slot) ? semitone : best);
+}
+
+constexpr float nearestVolts(int scale, int slot) {
+	return (float)(nearestSemitone(SCALE_MASKS[scale], slot) / 12.0);
+}
+
+#define QUANTIZE_ROW(s) { \
+	nearestVolts(s, 0),  nearestVolts(s, 1),  nearestVolts(s, 2),  nearestVolts(s, 3),  \
+	nearestVolts(s, 4),  nearestVolts(s, 5),  nearestVolts(s, 6),  nearestVolts(s, 7),  \
+	nearestVolts(s, 8),  nearestVolts(s, 9),  nearestVolts(s, 10), nearestVolts(s, 11), \
+	nearestVolts(s, 12), nearestVolts(s, 13), nearestVolts(s, 14), nearestVolts(s, 15), \
+	nearestVolts(s, 16), nearestVolts(s, 17), nearestVolts(s, 18), nearestVolts(s, 19), \
+	nearestVolts(s, 20), nearestVolts(s, 21), nearestVolts(s, 22), nearestVolts(s, 23) }
+
+// Volts above the root of the nearest scale note for each slot, built at compile time
+static constexpr float SCALE_NEAREST_VOLTS[][QUANTIZE_SLOTS] = {
+	QUANTIZE_ROW(0),  QUANTIZE_ROW(1),  QUANTIZE_ROW(2),  QUANTIZE_ROW(3),  QUANTIZE_ROW(4),
+	QUANTIZE_ROW(5),  QUANTIZE_ROW(6),  QUANTIZE_ROW(7),  QUANTIZE_ROW(8),  QUANTIZE_ROW(9),
+	QUANTIZE_ROW(10), QUANTIZE_ROW(11), QUANTIZE_ROW(12), QUANTIZE_ROW(13), QUANTIZE_ROW(14),
+	QUANTIZE_ROW(15), QUANTIZE_ROW(16), QUANTIZE_ROW(17), QUANTIZE_ROW(18), QUANTIZE_ROW(19),
+	QUANTIZE_ROW(20), QUANTIZE_ROW(21), QUANTIZE_ROW(22), QUANTIZE_ROW(23), QUANTIZE_ROW(24),
+	QUANTIZE_ROW(25), QUANTIZE_ROW(26), QUANTIZE_ROW(27), QUANTIZE_ROW(28),
+};
+
+#undef QUANTIZE_ROW
+
+// Quantizes to built-in scale `scale` (a QuantizeUtils::ScaleEnum) in root-relative space, so
+// repeated quantization is stable
+inline float nearestInScale(float voltsIn, int rootNote, int scale) {
+	float rootVolts = rootNote / 12.0f;
+	float voltsRootRelative = voltsIn - rootVolts;
+	int octaveInVolts = int(floorf(voltsRootRelative));
+	float voltMinusOct = voltsRootRelative - octaveInVolts;
+	// Clamped so a NaN or out of range input can never index outside the table
+	int slot = std::max(0, std::min(int(voltMinusOct * QUANTIZE_SLOTS), QUANTIZE_SLOTS - 1));
+	return octaveInVolts + rootVolts + SCALE_NEAREST_VOLTS[scale][slot];
+}
+
+// Four channels at once, V being a four-lane float vector such as rack::simd::float_4 with a
+// floor() found by argument lookup. Same results as nearestInScale lane for lane for finite
+// inputs; only the table lookups are done one lane at a time.
+template <typename V>
+inline V nearestInScale4(V voltsIn, int rootNote, int scale) {
+	float rootVolts = rootNote / 12.0f;
+	V voltsRootRelative = voltsIn - rootVolts;
+	V octaveInVolts = floor(voltsRootRelative);
+	V slots = (voltsRootRelative - octaveInVolts) * (float)QUANTIZE_SLOTS;
+	V closestVal;
+	for (int i = 0; i < 4; i++) {
+		int slot = std::max(0, std::min(int(slots[i]), QUANTIZE_SLOTS - 1));
+		closestVal[i] = SCALE_NEAREST_VOLTS[scale][slot];
+	}
+	return octaveInVolts + rootVolts + closestVal;
+}
@@ -1,12 +1,75 @@
 #include <string.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include "JWModules.hpp"
+#include "ClockPredictor.hpp"
+#include "Trigs128Cells.hpp"
+
+// Life generations worked out ahead of the Life clock, enough for the x16 rate
+#define LIFE_AHEAD 16
+
+// Undo data for grid edits: variable sized entries in one fixed block of memory. Adding an entry
+// that does not fit drops the oldest ones, so an undo step can outlive its data; find() then
+// fails and the step does nothing. Nothing is allocated after construction.
+struct EditJournal {
+	static const size_t CAPACITY = 256 * 1024;
+	static const int MAX_ENTRIES = 256;
+
+	struct Entry {
+		uint32_t id;
+		size_t offset;
+		size_t size;
+	};
+
+	std::vector<uint8_t> bytes;
+	Entry entries[MAX_ENTRIES];
+	int first = 0;
+	int count = 0;
+	size_t head = 0;
+	uint32_t nextId = 1;
+
+	EditJournal() : bytes(CAPACITY) {}
 
-#define GRID_ROWS 16
-#define GRID_COLS 32
-#define GRID_CELLS (GRID_ROWS * GRID_COLS)
+	// Returns the new entry's id, or 0 when the data is larger than the whole journal
+	uint32_t add(const uint8_t *data, size_t size) {
+		if (size == 0 || size > CAPACITY) return 0;
+		if (head + size > CAPACITY) head = 0;
+		while (count > 0 && (count == MAX_ENTRIES || overlapsEntry(head, size))) {
+			first = (first + 1) % MAX_ENTRIES;
+			count--;
+		}
+		Entry &entry = entries[(first + count) % MAX_ENTRIES];
+		entry.id = nextId++;
+		entry.offset = head;
+		entry.size = size;
+		count++;
+		memcpy(bytes.data() + head, data, size);
+		head += size;
+		return entry.id;
+	}
+
+	bool find(uint32_t id, const uint8_t **data, size_t *size) const {
+		for (int n = 0; n < count; n++) {
+			const Entry &entry = entries[(first + n) % MAX_ENTRIES];
+			if (entry.id == id) {
+				*data = bytes.data() + entry.offset;
+				*size = entry.size;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool overlapsEntry(size_t offset, size_t size) const {
+		for (int n = 0; n < count; n++) {
+			const Entry &entry = entries[(first + n) % MAX_ENTRIES];
+			if (offset < entry.offset + entry.size && entry.offset < offset + size) return true;
+		}
+		return false;
+	}
+};
 
 struct Trigs128 : Module, QuantizeUtils {
 	struct CvRangeSpec {
@@ -18,16 +81,7 @@ struct Trigs128 : Module, QuantizeUtils {
 		CvRangeSpec(float min, float max, const char *label) : min(min), max(max), label(label) {}
 	};
 
-	struct CellProps {
-		bool active = false;
-		float pitch = 0.0f;  // 0..10V domain (scaled by Range)
-		int octave = 0;      // -4..4
-		float cv = 0.0f;     // -10..10V
-		float cv2 = 0.0f;    // -10..10V
-		float probability = 1.0f;
-		int division = 1;    // 1..16
-		int ratchets = 1;    // 1..8
-	};
+	typedef TrigsCellProps CellProps;
 
 	enum ParamIds {
 		MANUAL_CLOCK_BTN_PARAM,
@@ -144,7 +198,11 @@ struct Trigs128 : Module, QuantizeUtils {
 		NUM_GRID_SHADE_MODES
 	};
 
-	std::array<CellProps, GRID_CELLS> cells;
+	TrigsHotCells hot;
+	TrigsColdCells cold;
+	// Cells that may look different since the display last drew them: bit x of row y's word.
+	// Set by whatever writes the cells, taken by the display to redraw just those.
+	std::atomic<uint32_t> dirtyRows[GRID_ROWS];
 	int selectedX = 0;
 	int selectedY = 0;
 	bool selectedDirty = true;
@@ -154,7 +212,9 @@ struct Trigs128 : Module, QuantizeUtils {
 	std::array<std::array<int, GRID_CELLS>, 4> cellVisitCounter{};
 	bool goingForward[4] = {true, true, true, true};
 	int ratchetsRemaining[4] = {0, 0, 0, 0};
-	int ratchetInterval[4] = {1, 1, 1, 1};
+	int ratchetCount[4] = {1, 1, 1, 1};
+	// Samples between ratchets; ratchet k fires k * ratchetInterval samples after the clock
+	float ratchetInterval[4] = {1.f, 1.f, 1.f, 1.f};
 	int nextRatchetSample[4] = {0, 0, 0, 0};
 	float lastVoct[4] = {0.f, 0.f, 0.f, 0.f};
 	float lastCv[4] = {0.f, 0.f, 0.f, 0.f};
@@ -174,10 +234,15 @@ struct Trigs128 : Module, QuantizeUtils {
 	dsp::PulseGenerator gatePulse[4];
 	dsp::PulseGenerator eocPulse[4];
 	dsp::PulseGenerator lifeStoppedPulse;
+	// Buttons and the selected cell's knobs are read every controlDivision samples
+	dsp::ClockDivider controlDivider;
+	int controlDivision = 32;
 
 	float gatePulseLenSec = 0.005f;
 	int samplesSinceClock[4] = {0, 0, 0, 0};
-	int lastStepSamples[4] = {4410, 4410, 4410, 4410};
+	// False until the first clock edge, before which samplesSinceClock is not an interval
+	bool clockStarted[4] = {false, false, false, false};
+	ClockPredictor clockPredictors[4];
 	int uniformTrackLength = GRID_COLS * 4;
 	float minProbability = 0.f;
 	bool polyphonicFirstRowOutputs = false;
@@ -187,13 +252,42 @@ struct Trigs128 : Module, QuantizeUtils {
 	int lifeRateMode = LIFE_RATE_X1;
 	int lifeClockCounter = 0;
 	bool lifeStationaryLatched = false;
-	std::array<bool, GRID_CELLS> lifePrevActive{};
-	bool lifePrevActiveValid = false;
-	std::array<CellProps, GRID_COLS * 4> trackClipboard{};
+	LifeRule lifeRule;
+	bool lifeWrap = false;
+	bool lifeReseedOnCycle = false;
+	LifeCycleDetector lifeCycles;
+	int lifePeriod = 0;
+	// The generations after lifeAheadBase, one more worked out per control tick, so a Life
+	// clock only copies in finished grids however high the rate. Generation n + 1 is at
+	// lifeAhead[(lifeAheadFirst + n) % LIFE_AHEAD]. Any edit or rule change leaves the base
+	// or rule different from the grid's, and the queue starts over.
+	BitGrid<GRID_COLS, GRID_ROWS> lifeAhead[LIFE_AHEAD];
+	uint64_t lifeAheadHash[LIFE_AHEAD] = {};
+	BitGrid<GRID_COLS, GRID_ROWS> lifeAheadBase;
+	LifeRule lifeAheadRule;
+	bool lifeAheadWrap = false;
+	int lifeAheadFirst = 0;
+	int lifeAheadCount = 0;
+	TrigsTrackCells trackClipboard;
 	bool trackClipboardValid = false;
 	CellProps cellClipboard{};
 	bool cellClipboardValid = false;
 
+	// Undo for edits made from the panel, grid and menu. The engine or UI thread brackets each
+	// edit with beginCellEdit/endCellEdit and does nothing more. Once per frame the UI thread
+	// compares the cells with a copy taken the frame before and journals the cells that changed,
+	// so comparing and storing never happen on the engine thread. Life and trigger inputs are
+	// not bracketed and their changes are taken into the copy without an undo step.
+	std::atomic<uint32_t> cellEditsStarted{0};
+	std::atomic<uint32_t> cellEditsDone{0};
+	std::atomic<const char*> cellEditName{nullptr};
+	// UI thread only
+	uint32_t cellEditsRecorded = 0;
+	CellProps cellEditCopies[2][GRID_CELLS];
+	int cellEditCopy = 0;
+	std::vector<uint8_t> cellEditScratch;
+	EditJournal cellEditJournal;
+
 	Trigs128() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(MANUAL_CLOCK_BTN_PARAM, 0.f, 1.f, 0.f, "Manual Clock Tick");
@@ -268,8 +362,153 @@ struct Trigs128 : Module, QuantizeUtils {
 		}
 		configOutput(LIFE_STOPPED_OUTPUT, "Game of Life Stopped");
 
+		initCellParams(0, GRID_CELLS);
+		markAllCellsDirty();
+		for (int i = 0; i < GRID_CELLS; i++) {
+			cellEditCopies[cellEditCopy][i] = getCell(i);
+		}
+		cellEditScratch.resize(GRID_CELLS * CELL_EDIT_MAX_BYTES);
 		refreshCvParamRanges();
 		pushSelectedCellToParams();
+		controlDivider.setDivision(controlDivision);
+	}
+
+	void beginCellEdit() {
+		cellEditsStarted++;
+	}
+
+	// name is shown in Rack's Undo/Redo menu and must be a string literal
+	void endCellEdit(const char *name) {
+		cellEditName = name;
+		cellEditsDone++;
+	}
+
+	// A changed cell is journaled as its index, a byte with a bit per changed property and the
+	// old then new value of each changed property
+	enum CellEditBits {
+		CELL_EDIT_ACTIVE = 1 << 0,
+		CELL_EDIT_PITCH = 1 << 1,
+		CELL_EDIT_OCTAVE = 1 << 2,
+		CELL_EDIT_CV = 1 << 3,
+		CELL_EDIT_CV2 = 1 << 4,
+		CELL_EDIT_PROBABILITY = 1 << 5,
+		CELL_EDIT_DIVISION = 1 << 6,
+		CELL_EDIT_RATCHETS = 1 << 7
+	};
+	static const size_t CELL_EDIT_MAX_BYTES = 2 + 1 + 2 * (1 + 4 + 1 + 4 + 4 + 4 + 1 + 1);
+
+	template <typename T>
+	static void putEditValue(uint8_t *&out, T value) {
+		memcpy(out, &value, sizeof(T));
+		out += sizeof(T);
+	}
+
+	template <typename T>
+	static T getEditValue(const uint8_t *&in) {
+		T value;
+		memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return value;
+	}
+
+	template <typename T>
+	static void putEditPair(uint8_t *&out, uint8_t &bits, uint8_t bit, T before, T after) {
+		if (before == after) return;
+		bits |= bit;
+		putEditValue(out, before);
+		putEditValue(out, after);
+	}
+
+	template <typename T>
+	static void getEditPair(const uint8_t *&in, uint8_t bits, uint8_t bit, bool redo, T &value) {
+		if (!(bits & bit)) return;
+		T before = getEditValue<T>(in);
+		T after = getEditValue<T>(in);
+		value = redo ? after : before;
+	}
+
+	// UI thread, once per frame. Returns the journal id of a finished edit and sets name, or
+	// returns 0. Skips the frame while an edit is running so the copy stays as it was before it.
+	uint32_t recordCellEdit(const char **name) {
+		uint32_t started = cellEditsStarted;
+		if (started != cellEditsDone) return 0;
+		CellProps *before = cellEditCopies[cellEditCopy];
+		CellProps *after = cellEditCopies[1 - cellEditCopy];
+		for (int i = 0; i < GRID_CELLS; i++) {
+			after[i] = getCell(i);
+		}
+		if (cellEditsStarted != started) return 0;
+		cellEditCopy = 1 - cellEditCopy;
+		if (started == cellEditsRecorded) return 0;
+		cellEditsRecorded = started;
+
+		uint8_t *out = cellEditScratch.data();
+		for (int i = 0; i < GRID_CELLS; i++) {
+			const CellProps &a = before[i];
+			const CellProps &b = after[i];
+			uint8_t *cellStart = out;
+			putEditValue<uint16_t>(out, i);
+			uint8_t &bits = *out++;
+			bits = 0;
+			putEditPair<uint8_t>(out, bits, CELL_EDIT_ACTIVE, a.active, b.active);
+			putEditPair<float>(out, bits, CELL_EDIT_PITCH, a.pitch, b.pitch);
+			putEditPair<int8_t>(out, bits, CELL_EDIT_OCTAVE, a.octave, b.octave);
+			putEditPair<float>(out, bits, CELL_EDIT_CV, a.cv, b.cv);
+			putEditPair<float>(out, bits, CELL_EDIT_CV2, a.cv2, b.cv2);
+			putEditPair<float>(out, bits, CELL_EDIT_PROBABILITY, a.probability, b.probability);
+			putEditPair<uint8_t>(out, bits, CELL_EDIT_DIVISION, a.division, b.division);
+			putEditPair<uint8_t>(out, bits, CELL_EDIT_RATCHETS, a.ratchets, b.ratchets);
+			if (!bits) out = cellStart;
+		}
+		*name = cellEditName;
+		return cellEditJournal.add(cellEditScratch.data(), out - cellEditScratch.data());
+	}
+
+	// UI thread. Does nothing once the journal has dropped the entry.
+	void applyCellEdit(uint32_t id, bool redo) {
+		const uint8_t *in;
+		size_t size;
+		if (!cellEditJournal.find(id, &in, &size)) return;
+		const uint8_t *end = in + size;
+		CellProps *copy = cellEditCopies[cellEditCopy];
+		invalidateLifeStationaryState();
+		while (in < end) {
+			int i = getEditValue<uint16_t>(in);
+			uint8_t bits = *in++;
+			CellProps c = getCell(i);
+			uint8_t active = c.active;
+			int8_t octave = c.octave;
+			uint8_t division = c.division;
+			uint8_t ratchets = c.ratchets;
+			getEditPair(in, bits, CELL_EDIT_ACTIVE, redo, active);
+			getEditPair(in, bits, CELL_EDIT_PITCH, redo, c.pitch);
+			getEditPair(in, bits, CELL_EDIT_OCTAVE, redo, octave);
+			getEditPair(in, bits, CELL_EDIT_CV, redo, c.cv);
+			getEditPair(in, bits, CELL_EDIT_CV2, redo, c.cv2);
+			getEditPair(in, bits, CELL_EDIT_PROBABILITY, redo, c.probability);
+			getEditPair(in, bits, CELL_EDIT_DIVISION, redo, division);
+			getEditPair(in, bits, CELL_EDIT_RATCHETS, redo, ratchets);
+			c.active = active;
+			c.octave = octave;
+			c.division = division;
+			c.ratchets = ratchets;
+			setCell(i, c);
+			// So the next frame does not take the undo for an edit of its own
+			copy[i] = c;
+		}
+		selectedDirty = true;
+	}
+
+	void onSampleRateChange() override {
+		// Measured clock periods are in samples
+		for (int ch = 0; ch < 4; ch++) {
+			clockPredictors[ch].reset();
+		}
+	}
+
+	void setControlDivision(int division) {
+		controlDivision = clampijw(division, 1, 256);
+		controlDivider.setDivision(controlDivision);
 	}
 
 	static CvRangeSpec getCvRangeSpec(int mode) {
@@ -337,7 +576,8 @@ struct Trigs128 : Module, QuantizeUtils {
 		}
 	}
 
-	float getGridShadeNorm(const CellProps &c) const {
+	float getGridShadeNorm(int i) const {
+		CellProps c = getCell(i);
 		switch (clampijw(gridShadeMode, 0, NUM_GRID_SHADE_MODES - 1)) {
 			case GS_PROBABILITY:
 				return clampfjw(c.probability, 0.f, 1.f);
@@ -364,7 +604,8 @@ struct Trigs128 : Module, QuantizeUtils {
 
 	void invalidateLifeStationaryState() {
 		lifeStationaryLatched = false;
-		lifePrevActiveValid = false;
+		lifeCycles.reset();
+		lifePeriod = 0;
 	}
 
 	static const char *getLifeRateLabel(int mode) {
@@ -430,18 +671,19 @@ struct Trigs128 : Module, QuantizeUtils {
 			resetMode[ch] = false;
 			goingForward[ch] = true;
 			ratchetsRemaining[ch] = 0;
-			ratchetInterval[ch] = 1;
+			ratchetCount[ch] = 1;
+			ratchetInterval[ch] = 1.f;
 			nextRatchetSample[ch] = 0;
 			gatePulse[ch].reset();
 			eocPulse[ch].reset();
 		}
 		for (int ch = 0; ch < 4; ch++) {
 			samplesSinceClock[ch] = 0;
-			lastStepSamples[ch] = 4410;
+			clockStarted[ch] = false;
+			clockPredictors[ch].reset();
 		}
 		lifeClockCounter = 0;
-		lifeStationaryLatched = false;
-		lifePrevActiveValid = false;
+		invalidateLifeStationaryState();
 		lifeStoppedPulse.reset();
 		clearGrid();
 		selectedX = 0;
@@ -463,18 +705,20 @@ struct Trigs128 : Module, QuantizeUtils {
 
 	void repeatTrackSelectedLengthToMax(int track) {
 		int t = clampijw(track, 0, 3);
-		int base = clampijw(uniformTrackLength, 1, GRID_COLS * 4);
-		std::array<CellProps, GRID_COLS * 4> repeated{};
-		for (int step = 0; step < GRID_COLS * 4; step++) {
-			int srcStep = step % base;
-			int srcCol = srcStep % GRID_COLS;
-			int srcRow = t * 4 + (srcStep / GRID_COLS);
-			repeated[step] = cells[iFromXY(srcCol, srcRow)];
-		}
-		for (int step = 0; step < GRID_COLS * 4; step++) {
-			int col = step % GRID_COLS;
-			int row = t * 4 + (step / GRID_COLS);
-			cells[iFromXY(col, row)] = repeated[step];
+		int base = clampijw(uniformTrackLength, 1, TRACK_STEPS);
+		int begin = t * TRACK_STEPS;
+		// In place: every step at or past base copies one before base, which is never written
+		for (int step = base; step < TRACK_STEPS; step++) {
+			int dst = begin + step;
+			int src = begin + step % base;
+			setCellActiveBit(dst, isCellActive(src));
+			hot.probability[dst] = hot.probability[src];
+			hot.division[dst] = hot.division[src];
+			hot.ratchets[dst] = hot.ratchets[src];
+			cold.pitch[dst] = cold.pitch[src];
+			cold.octave[dst] = cold.octave[src];
+			cold.cv[dst] = cold.cv[src];
+			cold.cv2[dst] = cold.cv2[src];
 		}
 		selectedDirty = true;
 	}
@@ -486,12 +730,7 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 
 	void copyTrackToClipboard(int track) {
-		int t = clampijw(track, 0, 3);
-		for (int step = 0; step < GRID_COLS * 4; step++) {
-			int col = step % GRID_COLS;
-			int row = t * 4 + (step / GRID_COLS);
-			trackClipboard[step] = cells[iFromXY(col, row)];
-		}
+		TrigsCells::copyTrack(hot, cold, clampijw(track, 0, 3), trackClipboard);
 		trackClipboardValid = true;
 	}
 
@@ -499,64 +738,83 @@ struct Trigs128 : Module, QuantizeUtils {
 		if (!trackClipboardValid) return;
 		invalidateLifeStationaryState();
 		int t = clampijw(track, 0, 3);
-		for (int step = 0; step < GRID_COLS * 4; step++) {
-			int col = step % GRID_COLS;
-			int row = t * 4 + (step / GRID_COLS);
-			cells[iFromXY(col, row)] = trackClipboard[step];
-		}
+		TrigsCells::pasteTrack(trackClipboard, t, hot, cold);
+		markCellsDirty(t * TRACK_STEPS, (t + 1) * TRACK_STEPS);
 		selectedDirty = true;
 	}
 
+	// Moves every step of a track amount steps later, wrapping around the end of the track
+	void rotateTrack(int track, int amount) {
+		int t = clampijw(track, 0, 3);
+		int shift = ((amount % TRACK_STEPS) + TRACK_STEPS) % TRACK_STEPS;
+		if (shift == 0) return;
+		invalidateLifeStationaryState();
+		TrigsCells::rotateTrack(hot, cold, t, shift);
+		markCellsDirty(t * TRACK_STEPS, (t + 1) * TRACK_STEPS);
+		selectedDirty = true;
+	}
+
+	std::vector<uint8_t> packCells(int &version) const {
+		return TrigsPackedCells::pack(hot, cold, version);
+	}
+
+	// Leaves the cells untouched unless data is a whole packed grid
+	bool unpackCells(const uint8_t *data, size_t len, int version) {
+		if (!TrigsPackedCells::unpack(data, len, version, hot, cold)) return false;
+		markAllCellsDirty();
+		return true;
+	}
+
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
-		json_t *cellsJ = json_array();
-		for (int i = 0; i < GRID_CELLS; i++) {
-			json_t *cellJ = json_object();
-			json_object_set_new(cellJ, "a", json_boolean(cells[i].active));
-			json_object_set_new(cellJ, "p", json_real(cells[i].pitch));
-			json_object_set_new(cellJ, "o", json_integer(cells[i].octave));
-			json_object_set_new(cellJ, "cv", json_real(cells[i].cv));
-			json_object_set_new(cellJ, "cv2", json_real(cells[i].cv2));
-			json_object_set_new(cellJ, "pr", json_real(cells[i].probability));
-			json_object_set_new(cellJ, "d", json_integer(cells[i].division));
-			json_object_set_new(cellJ, "r", json_integer(cells[i].ratchets));
-			json_array_append_new(cellsJ, cellJ);
-		}
-		json_object_set_new(rootJ, "cells", cellsJ);
+		// Base64 of packCells(). Patches from before version 1 have a "cells" array instead.
+		int cellsPackedVersion = TrigsPackedCells::VERSION;
+		std::vector<uint8_t> packed = packCells(cellsPackedVersion);
+		json_object_set_new(rootJ, "cellsPackedVersion", json_integer(cellsPackedVersion));
+		json_object_set_new(rootJ, "cellsPacked", json_string(string::toBase64(packed.data(), packed.size()).c_str()));
 		json_object_set_new(rootJ, "selectedX", json_integer(selectedX));
 		json_object_set_new(rootJ, "selectedY", json_integer(selectedY));
 		json_object_set_new(rootJ, "gatePulseLenSec", json_real(gatePulseLenSec));
 		json_object_set_new(rootJ, "uniformTrackLength", json_integer(uniformTrackLength));
 		json_object_set_new(rootJ, "minProbability", json_real(minProbability));
 		json_object_set_new(rootJ, "polyphonicFirstRowOutputs", json_boolean(polyphonicFirstRowOutputs));
+		json_object_set_new(rootJ, "controlDivision", json_integer(controlDivision));
 		json_object_set_new(rootJ, "cvRangeMode", json_integer(cvRangeMode));
 		json_object_set_new(rootJ, "cv2RangeMode", json_integer(cv2RangeMode));
 		json_object_set_new(rootJ, "gridShadeMode", json_integer(gridShadeMode));
 		json_object_set_new(rootJ, "lifeEnabled", json_boolean(params[LIFE_ON_SWITCH_PARAM].getValue() > 0.5f));
 		json_object_set_new(rootJ, "lifeRateMode", json_integer(lifeRateMode));
+		json_object_set_new(rootJ, "lifeRule", json_string(lifeRule.toString().c_str()));
+		json_object_set_new(rootJ, "lifeWrap", json_boolean(lifeWrap));
+		json_object_set_new(rootJ, "lifeReseedOnCycle", json_boolean(lifeReseedOnCycle));
+		json_object_set_new(rootJ, "userScales", userScales.toJson());
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		userScales.fromJson(json_object_get(rootJ, "userScales"));
+		json_t *cellsPackedVersionJ = json_object_get(rootJ, "cellsPackedVersion");
+		json_t *cellsPackedJ = json_object_get(rootJ, "cellsPacked");
 		json_t *cellsJ = json_object_get(rootJ, "cells");
-		if (cellsJ && json_is_array(cellsJ)) {
-			size_t n = std::min((size_t)GRID_CELLS, json_array_size(cellsJ));
-			for (size_t i = 0; i < n; i++) {
-				json_t *cellJ = json_array_get(cellsJ, i);
-				if (!cellJ || !json_is_object(cellJ)) continue;
-				cells[i].active = json_boolean_value(json_object_get(cellJ, "a"));
-				cells[i].pitch = clampfjw((float)json_number_value(json_object_get(cellJ, "p")), 0.f, 10.f);
-				cells[i].octave = clampijw((int)json_integer_value(json_object_get(cellJ, "o")), -4, 4);
-				json_t *cvJ = json_object_get(cellJ, "cv");
-				if (cvJ) cells[i].cv = clampfjw((float)json_number_value(cvJ), -10.f, 10.f);
-				json_t *cv2J = json_object_get(cellJ, "cv2");
-				if (cv2J) cells[i].cv2 = clampfjw((float)json_number_value(cv2J), -10.f, 10.f);
-				json_t *prJ = json_object_get(cellJ, "pr");
-				if (prJ) cells[i].probability = clampfjw((float)json_number_value(prJ), 0.f, 1.f);
-				cells[i].division = clampijw((int)json_integer_value(json_object_get(cellJ, "d")), 1, 16);
-				cells[i].ratchets = clampijw((int)json_integer_value(json_object_get(cellJ, "r")), 1, 8);
+		int cellsPackedVersion = json_integer_value(cellsPackedVersionJ);
+		if (cellsPackedJ && json_is_string(cellsPackedJ)
+				&& (cellsPackedVersion == TrigsPackedCells::VERSION || cellsPackedVersion == TrigsPackedCells::RAW_VERSION)) {
+			std::vector<uint8_t> packed;
+			try {
+				packed = string::fromBase64(json_string_value(cellsPackedJ));
+			}
+			catch (Exception &e) {
+				// not base64; the empty data fails to unpack below
+			}
+			if (!unpackCells(packed.data(), packed.size(), cellsPackedVersion)) {
+				hot.active.clear();
+				initCellParams(0, GRID_CELLS);
 			}
 		}
+		else if (cellsJ && json_is_array(cellsJ)) {
+			TrigsCells::readCellsArray(cellsJ, hot, cold);
+			markAllCellsDirty();
+		}
 		json_t *sxJ = json_object_get(rootJ, "selectedX");
 		json_t *syJ = json_object_get(rootJ, "selectedY");
 		if (sxJ) selectedX = clampijw((int)json_integer_value(sxJ), 0, GRID_COLS - 1);
@@ -569,6 +827,8 @@ struct Trigs128 : Module, QuantizeUtils {
 		if (minProbJ) minProbability = clampfjw((float)json_number_value(minProbJ), 0.f, 1.f);
 		json_t *polyJ = json_object_get(rootJ, "polyphonicFirstRowOutputs");
 		if (polyJ) polyphonicFirstRowOutputs = json_boolean_value(polyJ);
+		json_t *controlDivisionJ = json_object_get(rootJ, "controlDivision");
+		if (controlDivisionJ) setControlDivision((int)json_integer_value(controlDivisionJ));
 		json_t *cvRangeJ = json_object_get(rootJ, "cvRangeMode");
 		if (cvRangeJ) cvRangeMode = clampijw((int)json_integer_value(cvRangeJ), 0, NUM_CV_RANGE_MODES - 1);
 		json_t *cv2RangeJ = json_object_get(rootJ, "cv2RangeMode");
@@ -579,9 +839,14 @@ struct Trigs128 : Module, QuantizeUtils {
 		if (lifeEnabledJ) params[LIFE_ON_SWITCH_PARAM].setValue(json_boolean_value(lifeEnabledJ) ? 1.f : 0.f);
 		json_t *lifeRateModeJ = json_object_get(rootJ, "lifeRateMode");
 		if (lifeRateModeJ) lifeRateMode = clampijw((int)json_integer_value(lifeRateModeJ), 0, NUM_LIFE_RATE_MODES - 1);
+		json_t *lifeRuleJ = json_object_get(rootJ, "lifeRule");
+		if (lifeRuleJ && json_is_string(lifeRuleJ)) LifeRule::parse(json_string_value(lifeRuleJ), lifeRule);
+		json_t *lifeWrapJ = json_object_get(rootJ, "lifeWrap");
+		if (lifeWrapJ) lifeWrap = json_boolean_value(lifeWrapJ);
+		json_t *lifeReseedOnCycleJ = json_object_get(rootJ, "lifeReseedOnCycle");
+		if (lifeReseedOnCycleJ) lifeReseedOnCycle = json_boolean_value(lifeReseedOnCycleJ);
 		lifeClockCounter = 0;
-		lifeStationaryLatched = false;
-		lifePrevActiveValid = false;
+		invalidateLifeStationaryState();
 		lifeStoppedPulse.reset();
 		refreshCvParamRanges();
 		selectedDirty = true;
@@ -589,45 +854,91 @@ struct Trigs128 : Module, QuantizeUtils {
 
 	void clearGrid() {
 		invalidateLifeStationaryState();
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].active = false;
-			initCellParams(cells[i]);
-		}
+		hot.active.clear();
+		initCellParams(0, GRID_CELLS);
 		selectedDirty = true;
 	}
 
 	void clearTrack(int track) {
 		invalidateLifeStationaryState();
 		int t = clampijw(track, 0, 3);
-		int y0 = t * 4;
-		int y1 = y0 + 4;
-		for (int y = y0; y < y1; y++) {
-			for (int x = 0; x < GRID_COLS; x++) {
-				CellProps &c = cells[iFromXY(x, y)];
-				c.active = false;
-				initCellParams(c);
-			}
+		uint32_t rows = trackRowsMask(t);
+		for (int x = 0; x < GRID_COLS; x++) {
+			hot.active.cols[x] &= ~rows;
 		}
+		initCellParams(t * TRACK_STEPS, (t + 1) * TRACK_STEPS);
 		selectedDirty = true;
 	}
 
-	void initCellParams(CellProps &c) {
-		c.pitch = 0.f;
-		c.octave = 0;
-		c.cv = 0.f;
-		c.cv2 = 0.f;
-		c.probability = 1.f;
-		c.division = 1;
-		c.ratchets = 1;
+	static uint32_t trackRowsMask(int track) {
+		return 0xFu << (track * 4);
+	}
+
+	bool isCellActive(int i) const {
+		return hot.active.get(i % GRID_COLS, i / GRID_COLS);
+	}
+
+	void setCellActiveBit(int i, bool active) {
+		hot.active.set(i % GRID_COLS, i / GRID_COLS, active);
+		markCellDirty(i);
+	}
+
+	void markCellDirty(int i) {
+		dirtyRows[i / GRID_COLS].fetch_or(1u << (i % GRID_COLS));
+	}
+
+	void markCellsDirty(int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			markCellDirty(i);
+		}
+	}
+
+	void markAllCellsDirty() {
+		for (int y = 0; y < GRID_ROWS; y++) {
+			dirtyRows[y] = 0xFFFFFFFFu;
+		}
+	}
+
+	// Marks the cells Life turned on or off since before
+	void markActiveChanges(const BitGrid<GRID_COLS, GRID_ROWS> &before) {
+		for (int x = 0; x < GRID_COLS; x++) {
+			uint32_t changed = before.cols[x] ^ hot.active.cols[x];
+			while (changed) {
+				int y = lowestBit(changed);
+				changed &= changed - 1;
+				dirtyRows[y].fetch_or(1u << x);
+			}
+		}
+	}
+
+	CellProps getCell(int i) const {
+		return TrigsCells::get(hot, cold, i);
+	}
+
+	void setCell(int i, const CellProps &c) {
+		TrigsCells::set(hot, cold, i, c);
+		markCellDirty(i);
+	}
+
+	// Default parameters for cells begin to end; active bits are left alone
+	void initCellParams(int begin, int end) {
+		markCellsDirty(begin, end);
+		std::fill(cold.pitch + begin, cold.pitch + end, 0.f);
+		std::fill(cold.octave + begin, cold.octave + end, 0);
+		std::fill(cold.cv + begin, cold.cv + end, 0.f);
+		std::fill(cold.cv2 + begin, cold.cv2 + end, 0.f);
+		std::fill(hot.probability + begin, hot.probability + end, 1.f);
+		std::fill(hot.division + begin, hot.division + end, 1);
+		std::fill(hot.ratchets + begin, hot.ratchets + end, 1);
 	}
 
 	void setCellActive(int x, int y, bool active) {
 		x = clampijw(x, 0, GRID_COLS - 1);
 		y = clampijw(y, 0, GRID_ROWS - 1);
-		CellProps &c = cells[iFromXY(x, y)];
-		c.active = active;
+		int i = iFromXY(x, y);
+		setCellActiveBit(i, active);
 		if (!active) {
-			initCellParams(c);
+			initCellParams(i, i + 1);
 		}
 		if (x == selectedX && y == selectedY) {
 			selectedDirty = true;
@@ -635,29 +946,29 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 
 	void copySelectedCellToClipboard() {
-		cellClipboard = cells[iFromXY(selectedX, selectedY)];
+		cellClipboard = getCell(iFromXY(selectedX, selectedY));
 		cellClipboardValid = true;
 	}
 
 	void pasteClipboardToSelectedCell() {
 		if (!cellClipboardValid) return;
 		invalidateLifeStationaryState();
-		cells[iFromXY(selectedX, selectedY)] = cellClipboard;
+		setCell(iFromXY(selectedX, selectedY), cellClipboard);
 		selectedDirty = true;
 	}
 
+	void randomizeCell(int i, float rndAmt) {
+		CvRangeSpec cvSpec = getCvRangeSpec(cvRangeMode);
+		CvRangeSpec cv2Spec = getCvRangeSpec(cv2RangeMode);
+		TrigsCells::randomize(hot, cold, i, rndAmt, cvSpec.min, cvSpec.max, cv2Spec.min, cv2Spec.max, []() { return random::uniform(); });
+		markCellDirty(i);
+	}
+
 	void randomizeGrid() {
 		invalidateLifeStationaryState();
 		float rndAmt = clampfjw(params[RND_AMT_KNOB_PARAM].getValue(), 0.f, 1.f);
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].active = (random::uniform() < rndAmt);
-			cells[i].pitch = random::uniform() * 10.f;
-			cells[i].octave = (int)std::floor(random::uniform() * 9.f) - 4;
-			cells[i].cv = randomCvRangeValue(cvRangeMode);
-			cells[i].cv2 = randomCvRangeValue(cv2RangeMode);
-			cells[i].probability = random::uniform();
-			cells[i].division = (int)std::floor(random::uniform() * 16.f) + 1;
-			cells[i].ratchets = (int)std::floor(random::uniform() * 8.f) + 1;
+			randomizeCell(i, rndAmt);
 		}
 		selectedDirty = true;
 	}
@@ -665,71 +976,66 @@ struct Trigs128 : Module, QuantizeUtils {
 	void randomizeTrack(int track) {
 		invalidateLifeStationaryState();
 		int t = clampijw(track, 0, 3);
-		int y0 = t * 4;
-		int y1 = y0 + 4;
 		float rndAmt = clampfjw(params[RND_AMT_KNOB_PARAM].getValue(), 0.f, 1.f);
-		for (int y = y0; y < y1; y++) {
-			for (int x = 0; x < GRID_COLS; x++) {
-				CellProps &c = cells[iFromXY(x, y)];
-				c.active = (random::uniform() < rndAmt);
-				c.pitch = random::uniform() * 10.f;
-				c.octave = (int)std::floor(random::uniform() * 9.f) - 4;
-				c.cv = randomCvRangeValue(cvRangeMode);
-				c.cv2 = randomCvRangeValue(cv2RangeMode);
-				c.probability = random::uniform();
-				c.division = (int)std::floor(random::uniform() * 16.f) + 1;
-				c.ratchets = (int)std::floor(random::uniform() * 8.f) + 1;
-			}
+		for (int i = t * TRACK_STEPS; i < (t + 1) * TRACK_STEPS; i++) {
+			randomizeCell(i, rndAmt);
 		}
 		selectedDirty = true;
 	}
 
 	void randomizeCellPitchAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].pitch = random::uniform() * 10.f;
+			cold.pitch[i] = random::uniform() * 10.f;
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellOctaveAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].octave = (int)std::floor(random::uniform() * 9.f) - 4;
+			cold.octave[i] = (int)std::floor(random::uniform() * 9.f) - 4;
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellCvAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].cv = randomCvRangeValue(cvRangeMode);
+			cold.cv[i] = randomCvRangeValue(cvRangeMode);
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellCv2All() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].cv2 = randomCvRangeValue(cv2RangeMode);
+			cold.cv2[i] = randomCvRangeValue(cv2RangeMode);
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellProbAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].probability = random::uniform();
+			hot.probability[i] = random::uniform();
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellDivAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].division = (int)std::floor(random::uniform() * 16.f) + 1;
+			hot.division[i] = (int)std::floor(random::uniform() * 16.f) + 1;
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void randomizeCellRatchetAll() {
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].ratchets = (int)std::floor(random::uniform() * 8.f) + 1;
+			hot.ratchets[i] = (int)std::floor(random::uniform() * 8.f) + 1;
 		}
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
@@ -737,7 +1043,7 @@ struct Trigs128 : Module, QuantizeUtils {
 		invalidateLifeStationaryState();
 		float rndAmt = clampfjw(params[CELL_ACTIVE_RND_AMT_PARAM].getValue(), 0.f, 1.f);
 		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].active = (random::uniform() < rndAmt);
+			setCellActiveBit(i, random::uniform() < rndAmt);
 		}
 		selectedDirty = true;
 	}
@@ -745,69 +1051,67 @@ struct Trigs128 : Module, QuantizeUtils {
 	void randomizeCellActiveTrack(int track) {
 		invalidateLifeStationaryState();
 		int t = clampijw(track, 0, 3);
-		int y0 = t * 4;
-		int y1 = y0 + 4;
 		float rndAmt = clampfjw(params[CELL_ACTIVE_RND_AMT_PARAM].getValue(), 0.f, 1.f);
-		for (int y = y0; y < y1; y++) {
-			for (int x = 0; x < GRID_COLS; x++) {
-				cells[iFromXY(x, y)].active = (random::uniform() < rndAmt);
-			}
+		for (int i = t * TRACK_STEPS; i < (t + 1) * TRACK_STEPS; i++) {
+			setCellActiveBit(i, random::uniform() < rndAmt);
 		}
 		selectedDirty = true;
 	}
 
-	int getLifeNeighborCount(int x, int y) const {
-		int result = 0;
-		for (int dx = -1; dx <= 1; dx++) {
-			for (int dy = -1; dy <= 1; dy++) {
-				if (dx == 0 && dy == 0) {
-					continue;
-				}
-				int nx = x + dx;
-				int ny = y + dy;
-				if (nx >= 0 && ny >= 0 && nx < GRID_COLS && ny < GRID_ROWS && cells[iFromXY(nx, ny)].active) {
-					result++;
-				}
-			}
+	bool lifeAheadMatches() const {
+		return lifeAheadBase == hot.active && lifeAheadRule == lifeRule && lifeAheadWrap == lifeWrap;
+	}
+
+	// Control rate: works out one more upcoming generation if the Life clock may need it
+	void precomputeLife() {
+		if (params[LIFE_ON_SWITCH_PARAM].getValue() < 0.5f) return;
+		if (!lifeAheadMatches()) {
+			lifeAheadBase = hot.active;
+			lifeAheadRule = lifeRule;
+			lifeAheadWrap = lifeWrap;
+			lifeAheadFirst = 0;
+			lifeAheadCount = 0;
 		}
-		return result;
+		int wanted = clampijw(getLifeClockMultiplier(), 1, LIFE_AHEAD);
+		if (lifeAheadCount >= wanted) return;
+		BitGrid<GRID_COLS, GRID_ROWS> next = lifeAheadCount > 0 ? lifeAhead[(lifeAheadFirst + lifeAheadCount - 1) % LIFE_AHEAD] : lifeAheadBase;
+		next.stepLife(lifeRule, lifeWrap);
+		int slot = (lifeAheadFirst + lifeAheadCount) % LIFE_AHEAD;
+		lifeAhead[slot] = next;
+		lifeAheadHash[slot] = next.hash();
+		lifeAheadCount++;
 	}
 
 	void stepLife() {
-		std::array<bool, GRID_CELLS> nextActive{};
-		bool changed = false;
-		bool repeatsPrevious = lifePrevActiveValid;
-		for (int x = 0; x < GRID_COLS; x++) {
-			for (int y = 0; y < GRID_ROWS; y++) {
-				int cellIndex = iFromXY(x, y);
-				int neighbors = getLifeNeighborCount(x, y);
-				bool isActive = cells[cellIndex].active;
-				nextActive[cellIndex] = isActive;
-				if (neighbors < 2 || neighbors > 3) {
-					nextActive[cellIndex] = false;
-				}
-				else if (neighbors == 3 && !isActive) {
-					nextActive[cellIndex] = true;
-				}
-			}
+		if (lifeCycles.empty()) {
+			lifeCycles.add(hot.active.hash());
+		}
+		BitGrid<GRID_COLS, GRID_ROWS> before = hot.active;
+		uint64_t hash;
+		if (lifeAheadCount > 0 && lifeAheadMatches()) {
+			hot.active = lifeAhead[lifeAheadFirst];
+			hash = lifeAheadHash[lifeAheadFirst];
+			lifeAheadBase = hot.active;
+			lifeAheadFirst = (lifeAheadFirst + 1) % LIFE_AHEAD;
+			lifeAheadCount--;
 		}
-		for (int i = 0; i < GRID_CELLS; i++) {
-			if (repeatsPrevious && nextActive[i] != lifePrevActive[i]) {
-				repeatsPrevious = false;
-			}
-			if (cells[i].active != nextActive[i]) {
-				changed = true;
-			}
-			lifePrevActive[i] = cells[i].active;
-			cells[i].active = nextActive[i];
-		}
-		lifePrevActiveValid = true;
-		if (changed) {
+		else {
+			// Clocked faster than the queue fills, or just edited
+			hot.active.stepLife(lifeRule, lifeWrap);
+			hash = hot.active.hash();
+		}
+		markActiveChanges(before);
+		// Still lifes, oscillators and gliders on a torus all come back to an earlier state
+		lifePeriod = lifeCycles.add(hash);
+		if (lifePeriod == 0) {
 			lifeStationaryLatched = false;
 		}
-		if ((!changed || repeatsPrevious) && !lifeStationaryLatched) {
+		else if (!lifeStationaryLatched) {
 			lifeStoppedPulse.trigger(gatePulseLenSec);
 			lifeStationaryLatched = true;
+			if (lifeReseedOnCycle) {
+				randomizeCellActiveAll();
+			}
 		}
 	}
 
@@ -833,51 +1137,44 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 
 	void initCellPitchAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].pitch = 0.f;
-		}
+		std::fill(cold.pitch, cold.pitch + GRID_CELLS, 0.f);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellOctaveAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].octave = 0;
-		}
+		std::fill(cold.octave, cold.octave + GRID_CELLS, 0);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellCvAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].cv = 0.f;
-		}
+		std::fill(cold.cv, cold.cv + GRID_CELLS, 0.f);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellCv2All() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].cv2 = 0.f;
-		}
+		std::fill(cold.cv2, cold.cv2 + GRID_CELLS, 0.f);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellProbAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].probability = 1.f;
-		}
+		std::fill(hot.probability, hot.probability + GRID_CELLS, 1.f);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellDivAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].division = 1;
-		}
+		std::fill(hot.division, hot.division + GRID_CELLS, 1);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
 	void initCellRatchetAll() {
-		for (int i = 0; i < GRID_CELLS; i++) {
-			cells[i].ratchets = 1;
-		}
+		std::fill(hot.ratchets, hot.ratchets + GRID_CELLS, 1);
+		markAllCellsDirty();
 		selectedDirty = true;
 	}
 
@@ -891,14 +1188,13 @@ struct Trigs128 : Module, QuantizeUtils {
 		selectedX = x;
 		selectedY = y;
 		if (toggle) {
-			CellProps &c = cells[iFromXY(x, y)];
-			setCellActive(x, y, !c.active);
+			setCellActive(x, y, !isCellActive(iFromXY(x, y)));
 		}
 		selectedDirty = true;
 	}
 
 	void pushSelectedCellToParams() {
-		CellProps &c = cells[iFromXY(selectedX, selectedY)];
+		CellProps c = getCell(iFromXY(selectedX, selectedY));
 		params[CELL_PITCH_PARAM].setValue(c.pitch);
 		params[CELL_OCTAVE_PARAM].setValue((float)c.octave);
 		params[CELL_CV_PARAM].setValue(clampCvRangeValue(c.cv, cvRangeMode));
@@ -909,7 +1205,8 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 
 	void syncParamsToSelectedCell() {
-		CellProps &c = cells[iFromXY(selectedX, selectedY)];
+		int i = iFromXY(selectedX, selectedY);
+		CellProps c = getCell(i);
 		c.pitch = clampfjw(params[CELL_PITCH_PARAM].getValue(), 0.f, 10.f);
 		c.octave = clampijw((int)std::round(params[CELL_OCTAVE_PARAM].getValue()), -4, 4);
 		c.cv = clampCvRangeValue(params[CELL_CV_PARAM].getValue(), cvRangeMode);
@@ -917,6 +1214,75 @@ struct Trigs128 : Module, QuantizeUtils {
 		c.probability = clampfjw(params[CELL_PROB_PARAM].getValue(), 0.f, 1.f);
 		c.division = clampijw((int)std::round(params[CELL_DIV_PARAM].getValue()), 1, 16);
 		c.ratchets = clampijw((int)std::round(params[CELL_RATCHET_PARAM].getValue()), 1, 8);
+		// Runs every control tick; only a knob that moved marks the cell for redrawing
+		if (c != getCell(i)) {
+			setCell(i, c);
+		}
+	}
+
+	// A new selection loads the cell knobs, otherwise the knobs are written to the selected cell
+	void syncSelectedCell() {
+		if (selectedDirty) {
+			pushSelectedCellToParams();
+			selectedDirty = false;
+		}
+		else {
+			syncParamsToSelectedCell();
+		}
+	}
+
+	// Buttons and cell knobs, which only change at UI speed
+	void processControls() {
+		syncSelectedCell();
+
+		for (int i = 0; i < 4; i++) {
+			if (clearBtnTrig[i].process(params[CLEAR1_BTN_PARAM + i].getValue())) {
+				beginCellEdit();
+				clearTrack(i);
+				endCellEdit("clear track");
+			}
+		}
+
+		bool refreshSelectedParamsNow = false;
+
+		if (cellRndTrig[0].process(params[CELL_PITCH_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellPitchAll(); endCellEdit("randomize pitch"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[1].process(params[CELL_OCTAVE_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellOctaveAll(); endCellEdit("randomize octave"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[2].process(params[CELL_CV_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellCvAll(); endCellEdit("randomize CV"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[3].process(params[CELL_CV2_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellCv2All(); endCellEdit("randomize CV2"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[4].process(params[CELL_PROB_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellProbAll(); endCellEdit("randomize probability"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[5].process(params[CELL_DIV_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellDivAll(); endCellEdit("randomize division"); refreshSelectedParamsNow = true; }
+		if (cellRndTrig[6].process(params[CELL_RATCHET_RND_BTN_PARAM].getValue())) { beginCellEdit(); randomizeCellRatchetAll(); endCellEdit("randomize ratchets"); refreshSelectedParamsNow = true; }
+		if (cellActiveRndTrig.process(params[CELL_ACTIVE_RND_BTN_PARAM].getValue())) {
+			beginCellEdit();
+			randomizeCellActiveAll();
+			endCellEdit("randomize gates");
+			refreshSelectedParamsNow = true;
+		}
+
+		if (cellInitTrig[0].process(params[CELL_PITCH_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellPitchAll(); endCellEdit("init pitch"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[1].process(params[CELL_OCTAVE_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellOctaveAll(); endCellEdit("init octave"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[2].process(params[CELL_CV_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellCvAll(); endCellEdit("init CV"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[3].process(params[CELL_CV2_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellCv2All(); endCellEdit("init CV2"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[4].process(params[CELL_PROB_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellProbAll(); endCellEdit("init probability"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[5].process(params[CELL_DIV_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellDivAll(); endCellEdit("init division"); refreshSelectedParamsNow = true; }
+		if (cellInitTrig[6].process(params[CELL_RATCHET_INIT_BTN_PARAM].getValue())) { beginCellEdit(); initCellRatchetAll(); endCellEdit("init ratchets"); refreshSelectedParamsNow = true; }
+
+		// With the input patched the buttons are read along with it every sample
+		if (!inputs[RND_TRIG_INPUT].isConnected()) {
+			for (int i = 0; i < 4; i++) {
+				if (rndTrig[i].process(params[RND1_TRIG_BTN_PARAM + i].getValue())) {
+					beginCellEdit();
+					randomizeTrack(i);
+					endCellEdit("randomize track");
+					refreshSelectedParamsNow = true;
+				}
+			}
+		}
+
+		if (refreshSelectedParamsNow) {
+			pushSelectedCellToParams();
+			selectedDirty = false;
+		}
 	}
 
 	float getTrackInputVoltage(int inputId, int track) {
@@ -962,7 +1328,6 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 
 	void advanceSeqPos(int ch) {
-					lifeStationaryLatched = false;
 		int maxLen = GRID_COLS * 4;
 		int seqStart = getSeqStart(ch);
 		int seqLen = getSeqLen(ch);
@@ -1016,15 +1381,15 @@ struct Trigs128 : Module, QuantizeUtils {
 		pos = clampijw(pos, seqStart, seqEnd);
 	}
 
-	float cellVoltage(const CellProps &c) {
+	float cellVoltage(int i) {
 		int globalOct = (int)params[GLOBAL_OCTAVE_KNOB_PARAM].getValue();
 		int rootNote = (int)params[NOTE_KNOB_PARAM].getValue();
 		int scale = (int)params[SCALE_KNOB_PARAM].getValue();
 		float rangeCtrl = clampfjw(params[VOCT_RANGE_KNOB_PARAM].getValue(), 0.f, 10.f);
 		// Map range control to musically useful spread: 1 semitone .. 10 octaves.
 		float totalMax = rescalefjw(rangeCtrl, 0.f, 10.f, 1.f / 12.f, 10.f);
-		float voltsScaled = rescalefjw(c.pitch, 0.f, 10.f, 0.f, totalMax);
-		return closestVoltageInScale((float)(c.octave + globalOct) + voltsScaled, rootNote, scale);
+		float voltsScaled = rescalefjw(cold.pitch[i], 0.f, 10.f, 0.f, totalMax);
+		return closestVoltageInScale((float)(cold.octave[i] + globalOct) + voltsScaled, rootNote, scale);
 	}
 
 	void process(const ProcessArgs &args) override {
@@ -1032,50 +1397,38 @@ struct Trigs128 : Module, QuantizeUtils {
 		float manualClockGate = 10.f * params[MANUAL_CLOCK_BTN_PARAM].getValue();
 		float manualResetGate = 10.f * params[MANUAL_RESET_BTN_PARAM].getValue();
 
-		if (selectedDirty) {
-			pushSelectedCellToParams();
-			selectedDirty = false;
+		if (controlDivider.process()) {
+			processControls();
+			precomputeLife();
 		}
-		syncParamsToSelectedCell();
 
+		// Trigger inputs stay sample accurate. Knob moves not yet written to the selected cell
+		// are synced first so refreshing the knobs afterwards doesn't undo them.
 		if (inputs[CLEAR_INPUT].isConnected()) {
 			int clearChannels = inputs[CLEAR_INPUT].getChannels();
 			if (clearChannels <= 1) {
 				if (clearInputTrig[0].process(inputs[CLEAR_INPUT].getVoltage())) {
+					syncSelectedCell();
 					clearGrid();
 				}
 			}
 			else {
 				for (int i = 0; i < 4; i++) {
 					if (clearInputTrig[i].process(getTrackInputVoltage(CLEAR_INPUT, i))) {
+						syncSelectedCell();
 						clearTrack(i);
 					}
 				}
 			}
 		}
-		for (int i = 0; i < 4; i++) {
-			if (clearBtnTrig[i].process(params[CLEAR1_BTN_PARAM + i].getValue())) {
-				clearTrack(i);
-			}
-		}
 
 		bool refreshSelectedParamsNow = false;
 
-		if (cellRndTrig[0].process(params[CELL_PITCH_RND_BTN_PARAM].getValue())) { randomizeCellPitchAll(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[1].process(params[CELL_OCTAVE_RND_BTN_PARAM].getValue())) { randomizeCellOctaveAll(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[2].process(params[CELL_CV_RND_BTN_PARAM].getValue())) { randomizeCellCvAll(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[3].process(params[CELL_CV2_RND_BTN_PARAM].getValue())) { randomizeCellCv2All(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[4].process(params[CELL_PROB_RND_BTN_PARAM].getValue())) { randomizeCellProbAll(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[5].process(params[CELL_DIV_RND_BTN_PARAM].getValue())) { randomizeCellDivAll(); refreshSelectedParamsNow = true; }
-		if (cellRndTrig[6].process(params[CELL_RATCHET_RND_BTN_PARAM].getValue())) { randomizeCellRatchetAll(); refreshSelectedParamsNow = true; }
-		if (cellActiveRndTrig.process(params[CELL_ACTIVE_RND_BTN_PARAM].getValue())) {
-			randomizeCellActiveAll();
-			refreshSelectedParamsNow = true;
-		}
 		if (inputs[CELL_ACTIVE_RND_INPUT].isConnected()) {
 			int rndChannels = inputs[CELL_ACTIVE_RND_INPUT].getChannels();
 			if (rndChannels <= 1) {
-				if (cellActiveRndTrig.process(inputs[CELL_ACTIVE_RND_INPUT].getVoltage())) {
+				if (cellActiveRndInputTrig[0].process(inputs[CELL_ACTIVE_RND_INPUT].getVoltage())) {
+					syncSelectedCell();
 					randomizeCellActiveAll();
 					refreshSelectedParamsNow = true;
 				}
@@ -1083,6 +1436,7 @@ struct Trigs128 : Module, QuantizeUtils {
 			else {
 				for (int i = 0; i < 4; i++) {
 					if (cellActiveRndInputTrig[i].process(getTrackInputVoltage(CELL_ACTIVE_RND_INPUT, i))) {
+						syncSelectedCell();
 						randomizeCellActiveTrack(i);
 						refreshSelectedParamsNow = true;
 					}
@@ -1090,27 +1444,14 @@ struct Trigs128 : Module, QuantizeUtils {
 			}
 		}
 
-		if (cellInitTrig[0].process(params[CELL_PITCH_INIT_BTN_PARAM].getValue())) { initCellPitchAll(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[1].process(params[CELL_OCTAVE_INIT_BTN_PARAM].getValue())) { initCellOctaveAll(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[2].process(params[CELL_CV_INIT_BTN_PARAM].getValue())) { initCellCvAll(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[3].process(params[CELL_CV2_INIT_BTN_PARAM].getValue())) { initCellCv2All(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[4].process(params[CELL_PROB_INIT_BTN_PARAM].getValue())) { initCellProbAll(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[5].process(params[CELL_DIV_INIT_BTN_PARAM].getValue())) { initCellDivAll(); refreshSelectedParamsNow = true; }
-		if (cellInitTrig[6].process(params[CELL_RATCHET_INIT_BTN_PARAM].getValue())) { initCellRatchetAll(); refreshSelectedParamsNow = true; }
-
-		if (refreshSelectedParamsNow) {
-			pushSelectedCellToParams();
-			selectedDirty = false;
-		}
-
-		for (int i = 0; i < 4; i++) {
-			float rndInput = 0.f;
-			if (inputs[RND_TRIG_INPUT].isConnected()) {
-				rndInput = getTrackInputVoltage(RND_TRIG_INPUT, i);
-			}
-			if (rndTrig[i].process(params[RND1_TRIG_BTN_PARAM + i].getValue() + rndInput)) {
-				randomizeTrack(i);
-				refreshSelectedParamsNow = true;
+		if (inputs[RND_TRIG_INPUT].isConnected()) {
+			for (int i = 0; i < 4; i++) {
+				float rndInput = getTrackInputVoltage(RND_TRIG_INPUT, i);
+				if (rndTrig[i].process(params[RND1_TRIG_BTN_PARAM + i].getValue() + rndInput)) {
+					syncSelectedCell();
+					randomizeTrack(i);
+					refreshSelectedParamsNow = true;
+				}
 			}
 		}
 
@@ -1157,6 +1498,9 @@ struct Trigs128 : Module, QuantizeUtils {
 			resetMode[i] = false;
 			goingForward[i] = true;
 			ratchetsRemaining[i] = 0;
+			// The gap from the last clock to the first one after a reset is not a clock interval;
+			// the predictor keeps its tempo
+			clockStarted[i] = false;
 			eocPulse[i].trigger(gatePulseLenSec);
 		}
 		if (globalReset) {
@@ -1172,9 +1516,10 @@ struct Trigs128 : Module, QuantizeUtils {
 			float trackClockIn = getTrackInputVoltage(CLOCK_INPUT, ch) + manualClockGate;
 			if (clockTrig[ch].process(trackClockIn)) {
 				clockEdge[ch] = true;
-				if (samplesSinceClock[ch] > 1) {
-					lastStepSamples[ch] = samplesSinceClock[ch];
+				if (clockStarted[ch] && samplesSinceClock[ch] > 1) {
+					clockPredictors[ch].addInterval((float)samplesSinceClock[ch]);
 				}
+				clockStarted[ch] = true;
 				samplesSinceClock[ch] = 0;
 				if (ch == 0) {
 					masterClockEdge = true;
@@ -1192,23 +1537,25 @@ struct Trigs128 : Module, QuantizeUtils {
 				int col = seqPos[ch] % GRID_COLS;
 				int row = ch * 4 + (seqPos[ch] / GRID_COLS);
 				int cellIndex = iFromXY(col, row);
-				CellProps &c = cells[cellIndex];
+				bool active = isCellActive(cellIndex);
 				stepCounter[ch]++;
 				ratchetsRemaining[ch] = 0;
-				if (c.active) {
+				if (active) {
 					cellVisitCounter[ch][cellIndex]++;
 				}
-				float effectiveProb = std::max(c.probability, minProbability);
-				if (c.active && (((cellVisitCounter[ch][cellIndex] - 1) % c.division) == 0) && random::uniform() <= effectiveProb) {
-					int ratchets = std::max(1, c.ratchets);
+				float effectiveProb = std::max(hot.probability[cellIndex], minProbability);
+				if (active && (((cellVisitCounter[ch][cellIndex] - 1) % hot.division[cellIndex]) == 0) && random::uniform() <= effectiveProb) {
+					int ratchets = std::max(1, (int)hot.ratchets[cellIndex]);
 					// Fire the first pulse immediately on this clock edge.
 					gatePulse[ch].trigger(gatePulseLenSec);
 					ratchetsRemaining[ch] = ratchets - 1;
-					ratchetInterval[ch] = std::max(1, lastStepSamples[ch] / ratchets);
-					nextRatchetSample[ch] = ratchetInterval[ch];
-					lastVoct[ch] = cellVoltage(c);
-					lastCv[ch] = clampCvRangeValue(c.cv, cvRangeMode);
-					lastCv2[ch] = clampCvRangeValue(c.cv2, cv2RangeMode);
+					ratchetCount[ch] = ratchets;
+					// Until the clock has been measured, space ratchets over a tenth of a second
+					ratchetInterval[ch] = clockPredictors[ch].next(0.1f * args.sampleRate) / ratchets;
+					nextRatchetSample[ch] = std::max(1, (int)std::round(ratchetInterval[ch]));
+					lastVoct[ch] = cellVoltage(cellIndex);
+					lastCv[ch] = clampCvRangeValue(cold.cv[cellIndex], cvRangeMode);
+					lastCv2[ch] = clampCvRangeValue(cold.cv2[cellIndex], cv2RangeMode);
 				}
 			}
 		}
@@ -1219,7 +1566,9 @@ struct Trigs128 : Module, QuantizeUtils {
 			while (ratchetsRemaining[ch] > 0 && samplesSinceClock[ch] >= nextRatchetSample[ch]) {
 				gatePulse[ch].trigger(gatePulseLenSec);
 				ratchetsRemaining[ch]--;
-				nextRatchetSample[ch] += ratchetInterval[ch];
+				// From the clock edge each time so rounding doesn't add up over the step
+				int fired = ratchetCount[ch] - ratchetsRemaining[ch];
+				nextRatchetSample[ch] = std::max(nextRatchetSample[ch] + 1, (int)std::round(fired * ratchetInterval[ch]));
 			}
 
 			gateOut[ch] = gatePulse[ch].process(1.0f / args.sampleRate) ? 10.f : 0.f;
@@ -1267,6 +1616,26 @@ struct Trigs128 : Module, QuantizeUtils {
 	}
 };
 
+// Undo step for one journaled grid edit
+struct Trigs128CellsAction : history::ModuleAction {
+	uint32_t journalId = 0;
+
+	void undo() override {
+		apply(false);
+	}
+
+	void redo() override {
+		apply(true);
+	}
+
+	void apply(bool redo) {
+		Trigs128 *module = dynamic_cast<Trigs128*>(APP->engine->getModule(moduleId));
+		if (module) {
+			module->applyCellEdit(journalId, redo);
+		}
+	}
+};
+
 struct Trigs128Display : LightWidget {
 	Trigs128 *module = nullptr;
 	Vec dragPos;
@@ -1276,6 +1645,33 @@ struct Trigs128Display : LightWidget {
 	std::chrono::steady_clock::time_point lastClickTime = std::chrono::steady_clock::time_point::min();
 	int lastClickX = -1;
 	int lastClickY = -1;
+#ifndef METAMODULE
+	// Cached cells and grid lines. Cells the module marks dirty are redrawn in place; the
+	// whole cache only when the shading changes or the cache is new.
+	NVGLUframebuffer *fb = NULL;
+	int fbWidth = 0;
+	int fbHeight = 0;
+	bool cacheValid = false;
+	int cacheShadeMode = -1;
+	int cacheCvRangeMode = -1;
+	int cacheCv2RangeMode = -1;
+
+	~Trigs128Display() {
+		deleteFramebuffer();
+	}
+
+	void onContextDestroy(const ContextDestroyEvent &e) override {
+		deleteFramebuffer();
+		LightWidget::onContextDestroy(e);
+	}
+
+	void deleteFramebuffer() {
+		if (fb) {
+			nvgluDeleteFramebuffer(fb);
+			fb = NULL;
+		}
+	}
+#endif
 
 	void onButton(const event::Button &e) override {
 		if (!module) return;
@@ -1288,9 +1684,10 @@ struct Trigs128Display : LightWidget {
 			bool shiftDown = (e.mods & GLFW_MOD_SHIFT) != 0;
 
 			if (shiftDown) {
+				// One undo step for the whole stroke, ended in onDragEnd
+				module->beginCellEdit();
 				shiftPainting = true;
-				auto &c = module->cells[module->iFromXY(x, y)];
-				shiftPaintState = !c.active;
+				shiftPaintState = !module->isCellActive(module->iFromXY(x, y));
 				module->setCellActive(x, y, shiftPaintState);
 				module->selectCell(x, y, false);
 				lastClickTime = std::chrono::steady_clock::time_point::min();
@@ -1305,7 +1702,14 @@ struct Trigs128Display : LightWidget {
 			double dt = std::chrono::duration<double>(now - lastClickTime).count();
 			bool isDoubleClick = (x == lastClickX && y == lastClickY && dt <= 0.3);
 			// Single click selects cell only; double click toggles active state.
-			module->selectCell(x, y, isDoubleClick);
+			if (isDoubleClick) {
+				module->beginCellEdit();
+				module->selectCell(x, y, true);
+				module->endCellEdit("toggle cell");
+			}
+			else {
+				module->selectCell(x, y, false);
+			}
 
 			lastClickTime = now;
 			lastClickX = x;
@@ -1313,6 +1717,20 @@ struct Trigs128Display : LightWidget {
 		}
 	}
 
+	void step() override {
+		LightWidget::step();
+		if (!module) return;
+		const char *name = nullptr;
+		uint32_t journalId = module->recordCellEdit(&name);
+		if (journalId) {
+			Trigs128CellsAction *action = new Trigs128CellsAction;
+			action->name = name ? name : "edit cells";
+			action->moduleId = module->id;
+			action->journalId = journalId;
+			APP->history->push(action);
+		}
+	}
+
 	void onDragMove(const event::DragMove &e) override {
 		if (!module || !dragging) return;
 		dragPos = dragPos.plus(e.mouseDelta.div(getAbsoluteZoom()));
@@ -1325,11 +1743,157 @@ struct Trigs128Display : LightWidget {
 	}
 
 	void onDragEnd(const event::DragEnd &e) override {
+		if (module && shiftPainting) {
+			module->endCellEdit("paint cells");
+		}
 		dragging = false;
 		shiftPainting = false;
 		LightWidget::onDragEnd(e);
 	}
 
+	// The cell at x, y over a black background, and the grid lines along its edges
+	void drawCell(NVGcontext *vg, int x, int y) {
+		static const NVGcolor trackColors[4] = {
+			nvgRGB(255, 151, 9),
+			nvgRGB(255, 243, 9),
+			nvgRGB(144, 26, 252),
+			nvgRGB(25, 150, 252)
+		};
+		float cw = box.size.x / GRID_COLS;
+		float ch = box.size.y / GRID_ROWS;
+		nvgFillColor(vg, nvgRGB(0, 0, 0));
+		nvgBeginPath(vg);
+		nvgRect(vg, x * cw, y * ch, cw, ch);
+		nvgFill(vg);
+		int i = module->iFromXY(x, y);
+		if (module->isCellActive(i)) {
+			NVGcolor color = trackColors[clampijw(y / 4, 0, 3)];
+			float shade = module->getGridShadeNorm(i);
+			color.a = clampfjw(0.35f + (shade * 0.65f), 0.f, 1.f);
+			nvgFillColor(vg, color);
+			nvgBeginPath(vg);
+			nvgRect(vg, x * cw, y * ch, cw, ch);
+			nvgFill(vg);
+		}
+	}
+
+	void drawGridLine(NVGcontext *vg, bool vertical, int n) {
+		float cw = box.size.x / GRID_COLS;
+		float ch = box.size.y / GRID_ROWS;
+		nvgStrokeColor(vg, nvgRGB(60, 70, 73));
+		nvgStrokeWidth(vg, (n % 4 == 0) ? 2.f : 1.f);
+		nvgBeginPath(vg);
+		if (vertical) {
+			nvgMoveTo(vg, n * cw, 0);
+			nvgLineTo(vg, n * cw, box.size.y);
+		}
+		else {
+			nvgMoveTo(vg, 0, n * ch);
+			nvgLineTo(vg, box.size.x, n * ch);
+		}
+		nvgStroke(vg);
+	}
+
+	void drawCells(NVGcontext *vg) {
+		for (int y = 0; y < GRID_ROWS; y++) {
+			for (int x = 0; x < GRID_COLS; x++) {
+				drawCell(vg, x, y);
+			}
+		}
+		for (int x = 1; x < GRID_COLS; x++) {
+			drawGridLine(vg, true, x);
+		}
+		for (int y = 1; y < GRID_ROWS; y++) {
+			drawGridLine(vg, false, y);
+		}
+	}
+
+	// Redraws only the dirty cells, each clipped to itself so its neighbours are left alone
+	void drawDirtyCells(NVGcontext *vg, const uint32_t *dirty) {
+		float cw = box.size.x / GRID_COLS;
+		float ch = box.size.y / GRID_ROWS;
+		for (int y = 0; y < GRID_ROWS; y++) {
+			for (uint32_t bits = dirty[y]; bits; bits &= bits - 1) {
+				int x = lowestBit(bits);
+				nvgSave(vg);
+				nvgScissor(vg, x * cw, y * ch, cw, ch);
+				drawCell(vg, x, y);
+				if (x > 0) drawGridLine(vg, true, x);
+				if (x + 1 < GRID_COLS) drawGridLine(vg, true, x + 1);
+				if (y > 0) drawGridLine(vg, false, y);
+				if (y + 1 < GRID_ROWS) drawGridLine(vg, false, y + 1);
+				nvgRestore(vg);
+			}
+		}
+	}
+
+#ifndef METAMODULE
+	// Brings the cache up to date with the module's dirty cells and blits it. False if there is
+	// no framebuffer to draw into.
+	bool drawCachedCells(const DrawArgs &args) {
+		float scale = getAbsoluteZoom() * APP->window->pixelRatio;
+		int width = (int)ceilf(box.size.x * scale);
+		int height = (int)ceilf(box.size.y * scale);
+		if (width <= 0 || height <= 0)
+			return false;
+		if (!fb || width != fbWidth || height != fbHeight) {
+			deleteFramebuffer();
+			fb = nvgluCreateFramebuffer(args.vg, width, height, 0);
+			if (!fb)
+				return false;
+			fbWidth = width;
+			fbHeight = height;
+			cacheValid = false;
+		}
+		if (module->gridShadeMode != cacheShadeMode || module->cvRangeMode != cacheCvRangeMode || module->cv2RangeMode != cacheCv2RangeMode) {
+			cacheShadeMode = module->gridShadeMode;
+			cacheCvRangeMode = module->cvRangeMode;
+			cacheCv2RangeMode = module->cv2RangeMode;
+			cacheValid = false;
+		}
+
+		uint32_t dirty[GRID_ROWS];
+		int dirtyCount = 0;
+		for (int y = 0; y < GRID_ROWS; y++) {
+			dirty[y] = module->dirtyRows[y].exchange(0);
+			dirtyCount += __builtin_popcount(dirty[y]);
+		}
+		// Past a quarter of the grid one full redraw is cheaper than clipping every cell
+		bool full = !cacheValid || dirtyCount > GRID_CELLS / 4;
+		if (full || dirtyCount > 0) {
+			NVGcontext *fbVg = APP->window->fbVg;
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			nvgluBindFramebuffer(fb);
+			glViewport(0, 0, width, height);
+			if (full) {
+				glClearColor(0.0, 0.0, 0.0, 0.0);
+				glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			}
+			else {
+				glClear(GL_STENCIL_BUFFER_BIT);
+			}
+			nvgBeginFrame(fbVg, box.size.x, box.size.y, scale);
+			if (full) {
+				drawCells(fbVg);
+			}
+			else {
+				drawDirtyCells(fbVg, dirty);
+			}
+			nvgEndFrame(fbVg);
+			nvgluBindFramebuffer(args.fb);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			cacheValid = true;
+		}
+
+		nvgBeginPath(args.vg);
+		nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+		nvgFillPaint(args.vg, nvgImagePattern(args.vg, 0, 0, box.size.x, box.size.y, 0, fb->image, 1.0));
+		nvgFill(args.vg);
+		return true;
+	}
+#endif
+
 	void drawLayer(const DrawArgs &args, int layer) override {
 		nvgFillColor(args.vg, nvgRGB(0, 0, 0));
 		nvgBeginPath(args.vg);
@@ -1339,46 +1903,16 @@ struct Trigs128Display : LightWidget {
 		if (layer == 1 && module) {
 			float cw = box.size.x / GRID_COLS;
 			float ch = box.size.y / GRID_ROWS;
-			NVGcolor trackColors[4] = {
-				nvgRGB(255, 151, 9),
-				nvgRGB(255, 243, 9),
-				nvgRGB(144, 26, 252),
-				nvgRGB(25, 150, 252)
-			};
-
-			for (int y = 0; y < GRID_ROWS; y++) {
-				for (int x = 0; x < GRID_COLS; x++) {
-					auto &c = module->cells[module->iFromXY(x, y)];
-					if (c.active) {
-						int track = clampijw(y / 4, 0, 3);
-						NVGcolor color = trackColors[track];
-						float shade = module->getGridShadeNorm(c);
-						color.a = clampfjw(0.35f + (shade * 0.65f), 0.f, 1.f);
-						nvgFillColor(args.vg, color);
-						nvgBeginPath(args.vg);
-						nvgRect(args.vg, x * cw, y * ch, cw, ch);
-						nvgFill(args.vg);
-					}
-				}
-			}
-
-			nvgStrokeColor(args.vg, nvgRGB(60, 70, 73));
-			for (int x = 1; x < GRID_COLS; x++) {
-				nvgStrokeWidth(args.vg, (x % 4 == 0) ? 2.f : 1.f);
-				nvgBeginPath(args.vg);
-				nvgMoveTo(args.vg, x * cw, 0);
-				nvgLineTo(args.vg, x * cw, box.size.y);
-				nvgStroke(args.vg);
-			}
-			for (int y = 1; y < GRID_ROWS; y++) {
-				nvgStrokeWidth(args.vg, (y % 4 == 0) ? 2.f : 1.f);
-				nvgBeginPath(args.vg);
-				nvgMoveTo(args.vg, 0, y * ch);
-				nvgLineTo(args.vg, box.size.x, y * ch);
-				nvgStroke(args.vg);
+			bool cached = false;
+#ifndef METAMODULE
+			cached = drawCachedCells(args);
+#endif
+			if (!cached) {
+				drawCells(args.vg);
 			}
 
-			// Draw per-track start/end-of-sequence markers (vertical white lines at step boundaries).
+			// Markers, playheads and the selection are drawn over the cells every frame.
+			// Per-track start/end-of-sequence markers (vertical white lines at step boundaries).
 			nvgStrokeColor(args.vg, nvgRGB(255, 255, 255));
 			nvgStrokeWidth(args.vg, 2.f);
 			for (int track = 0; track < 4; track++) {
@@ -1736,7 +2270,21 @@ struct Trigs128Widget : ModuleWidget {
 			int track = 0;
 			void onAction(const event::Action &e) override {
 				if (!module) return;
+				module->beginCellEdit();
 				module->repeatTrackSelectedLengthToMax(track);
+				module->endCellEdit("repeat track length");
+			}
+		};
+
+		struct RotateTrackItem : MenuItem {
+			Trigs128 *module = nullptr;
+			int track = 0;
+			int amount = 1;
+			void onAction(const event::Action &e) override {
+				if (!module) return;
+				module->beginCellEdit();
+				module->rotateTrack(track, amount);
+				module->endCellEdit("rotate track");
 			}
 		};
 
@@ -1754,7 +2302,9 @@ struct Trigs128Widget : ModuleWidget {
 			int track = 0;
 			void onAction(const event::Action &e) override {
 				if (!module) return;
+				module->beginCellEdit();
 				module->pasteClipboardToTrack(track);
+				module->endCellEdit("paste track");
 			}
 			void step() override {
 				disabled = !(module && module->trackClipboardValid);
@@ -1774,6 +2324,20 @@ struct Trigs128Widget : ModuleWidget {
 				repeatItem->text = "Repeat track length across all steps";
 				child->addChild(repeatItem);
 
+				RotateTrackItem *rotateLeftItem = new RotateTrackItem;
+				rotateLeftItem->module = module;
+				rotateLeftItem->track = track;
+				rotateLeftItem->amount = -1;
+				rotateLeftItem->text = "Rotate steps left";
+				child->addChild(rotateLeftItem);
+
+				RotateTrackItem *rotateRightItem = new RotateTrackItem;
+				rotateRightItem->module = module;
+				rotateRightItem->track = track;
+				rotateRightItem->amount = 1;
+				rotateRightItem->text = "Rotate steps right";
+				child->addChild(rotateRightItem);
+
 				CopyTrackItem *copyItem = new CopyTrackItem;
 				copyItem->module = module;
 				copyItem->track = track;
@@ -1806,7 +2370,9 @@ struct Trigs128Widget : ModuleWidget {
 			Trigs128 *module = nullptr;
 			void onAction(const event::Action &e) override {
 				if (!module) return;
+				module->beginCellEdit();
 				module->pasteClipboardToSelectedCell();
+				module->endCellEdit("paste cell");
 			}
 			void step() override {
 				disabled = !(module && module->cellClipboardValid);
@@ -1826,6 +2392,26 @@ struct Trigs128Widget : ModuleWidget {
 			}
 		};
 
+		struct ControlRateMenuItem : MenuItem {
+			Trigs128 *module = nullptr;
+			Menu *createChildMenu() override {
+				Menu *child = new Menu;
+				Trigs128 *m = module;
+				const int divisions[] = {1, 8, 16, 32, 64};
+				for (int division : divisions) {
+					std::string label = division == 1 ? "Every Sample" : string::f("Every %d Samples", division);
+					child->addChild(createMenuItem(label, CHECKMARK(m->controlDivision == division), [=]() {
+						m->setControlDivision(division);
+					}));
+				}
+				return child;
+			}
+			void step() override {
+				rightText = "▶";
+				MenuItem::step();
+			}
+		};
+
 		struct CvRangeChoiceItem : MenuItem {
 			Trigs128 *module = nullptr;
 			bool secondOutput = false;
@@ -1996,6 +2582,11 @@ struct Trigs128Widget : ModuleWidget {
 		pasteCellItem->text = "Paste Cell";
 		menu->addChild(pasteCellItem);
 
+		ControlRateMenuItem *controlRateItem = new ControlRateMenuItem;
+		controlRateItem->module = module;
+		controlRateItem->text = "Knob & Button Rate";
+		menu->addChild(controlRateItem);
+
 		PolyphonicFirstRowOutputsItem *polyphonicFirstRowOutputsItem = new PolyphonicFirstRowOutputsItem;
 		polyphonicFirstRowOutputsItem->module = module;
 		polyphonicFirstRowOutputsItem->text = "Polyphonic Outputs On First Row";
@@ -2025,6 +2616,16 @@ struct Trigs128Widget : ModuleWidget {
 		lifeRateSlider->box.size.x = 175.f;
 		menu->addChild(lifeRateSlider);
 
+		LifeRuleItem *lifeRuleItem = new LifeRuleItem;
+		lifeRuleItem->text = "Game of Life Rule";
+		lifeRuleItem->rightText = module->lifeRule.toString() + (module->lifeWrap ? " Torus" : "") + " " + RIGHT_ARROW;
+		lifeRuleItem->rule = &module->lifeRule;
+		lifeRuleItem->wrap = &module->lifeWrap;
+		lifeRuleItem->reseedOnCycle = &module->lifeReseedOnCycle;
+		lifeRuleItem->period = &module->lifePeriod;
+		lifeRuleItem->changed = [module]() { module->invalidateLifeStationaryState(); };
+		menu->addChild(lifeRuleItem);
+
 		MenuLabel *trackToolsLabel = new MenuLabel();
 		trackToolsLabel->text = "Track Actions";
 		menu->addChild(trackToolsLabel);
@@ -2037,6 +2638,12 @@ struct Trigs128Widget : ModuleWidget {
 			trackMenuItem->text = trackNames[t];
 			menu->addChild(trackMenuItem);
 		}
+
+		UserScalesItem *userScalesItem = new UserScalesItem();
+		userScalesItem->text = "User Scales (Scala)";
+		userScalesItem->rightText = RIGHT_ARROW;
+		userScalesItem->quantizeUtils = module;
+		menu->addChild(userScalesItem);
 	}
 };
 
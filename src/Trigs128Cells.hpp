@@ -0,0 +1,293 @@
+#pragma once
+#include "BitGrid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <jansson.h>
+#include <vector>
+
+////////////////////////////////////////////// TRIGS128 CELLS //////////////////////////////////////////////
+
+#define GRID_ROWS 16
+#define GRID_COLS 32
+#define GRID_CELLS (GRID_ROWS * GRID_COLS)
+#define TRACK_STEPS (GRID_COLS * 4)
+
+// Cells are stored an array per property, split by how often they are read. The hot block
+// is all a clock step reads to decide whether to fire; the cold block is only read when it
+// fires and while editing. Arrays are indexed by iFromXY, so track t is the contiguous run
+// of TRACK_STEPS cells from t * TRACK_STEPS, and its active bits are rows 4t to 4t + 3.
+struct TrigsHotCells {
+	BitGrid<GRID_COLS, GRID_ROWS> active;
+	float probability[GRID_CELLS];
+	uint8_t division[GRID_CELLS];
+	uint8_t ratchets[GRID_CELLS];
+};
+struct TrigsColdCells {
+	float pitch[GRID_CELLS];
+	int8_t octave[GRID_CELLS];
+	float cv[GRID_CELLS];
+	float cv2[GRID_CELLS];
+};
+
+// One cell's properties together, as the panel edits them and old patches saved them
+struct TrigsCellProps {
+	bool active = false;
+	float pitch = 0.0f;  // 0..10V domain (scaled by Range)
+	int octave = 0;      // -4..4
+	float cv = 0.0f;     // -10..10V
+	float cv2 = 0.0f;    // -10..10V
+	float probability = 1.0f;
+	int division = 1;    // 1..16
+	int ratchets = 1;    // 1..8
+
+	bool operator==(const TrigsCellProps &other) const {
+		return active == other.active && pitch == other.pitch && octave == other.octave && cv == other.cv && cv2 == other.cv2
+			&& probability == other.probability && division == other.division && ratchets == other.ratchets;
+	}
+	bool operator!=(const TrigsCellProps &other) const {
+		return !(*this == other);
+	}
+};
+
+// One track in the same layout, for the track clipboard
+struct TrigsTrackCells {
+	uint32_t active[GRID_COLS]; // the track's four rows in bits 0 to 3
+	float probability[TRACK_STEPS];
+	uint8_t division[TRACK_STEPS];
+	uint8_t ratchets[TRACK_STEPS];
+	float pitch[TRACK_STEPS];
+	int8_t octave[TRACK_STEPS];
+	float cv[TRACK_STEPS];
+	float cv2[TRACK_STEPS];
+};
+
+// Whole cells and whole tracks over the arrays. Only the cells change; marking them for the
+// display and dropping Life's history is up to the module.
+struct TrigsCells {
+	static TrigsCellProps get(const TrigsHotCells &hot, const TrigsColdCells &cold, int i) {
+		TrigsCellProps c;
+		c.active = hot.active.get(i % GRID_COLS, i / GRID_COLS);
+		c.pitch = cold.pitch[i];
+		c.octave = cold.octave[i];
+		c.cv = cold.cv[i];
+		c.cv2 = cold.cv2[i];
+		c.probability = hot.probability[i];
+		c.division = hot.division[i];
+		c.ratchets = hot.ratchets[i];
+		return c;
+	}
+
+	static void set(TrigsHotCells &hot, TrigsColdCells &cold, int i, const TrigsCellProps &c) {
+		hot.active.set(i % GRID_COLS, i / GRID_COLS, c.active);
+		cold.pitch[i] = c.pitch;
+		cold.octave[i] = (int8_t)c.octave;
+		cold.cv[i] = c.cv;
+		cold.cv2[i] = c.cv2;
+		hot.probability[i] = c.probability;
+		hot.division[i] = (uint8_t)c.division;
+		hot.ratchets[i] = (uint8_t)c.ratchets;
+	}
+
+	// Draws from uniform (0 to 1) in the same order as always, so a seeded randomize gives the
+	// same grid. CV and CV2 land in their ranges.
+	template <typename Uniform>
+	static void randomize(TrigsHotCells &hot, TrigsColdCells &cold, int i, float rndAmt,
+			float cvMin, float cvMax, float cv2Min, float cv2Max, Uniform uniform) {
+		hot.active.set(i % GRID_COLS, i / GRID_COLS, uniform() < rndAmt);
+		cold.pitch[i] = uniform() * 10.f;
+		cold.octave[i] = (int)std::floor(uniform() * 9.f) - 4;
+		cold.cv[i] = cvMin + uniform() * (cvMax - cvMin);
+		cold.cv2[i] = cv2Min + uniform() * (cv2Max - cv2Min);
+		hot.probability[i] = uniform();
+		hot.division[i] = (int)std::floor(uniform() * 16.f) + 1;
+		hot.ratchets[i] = (int)std::floor(uniform() * 8.f) + 1;
+	}
+
+	static void copyTrack(const TrigsHotCells &hot, const TrigsColdCells &cold, int track, TrigsTrackCells &out) {
+		int begin = track * TRACK_STEPS;
+		int end = begin + TRACK_STEPS;
+		for (int x = 0; x < GRID_COLS; x++) {
+			out.active[x] = (hot.active.cols[x] >> (track * 4)) & 0xF;
+		}
+		std::copy(hot.probability + begin, hot.probability + end, out.probability);
+		std::copy(hot.division + begin, hot.division + end, out.division);
+		std::copy(hot.ratchets + begin, hot.ratchets + end, out.ratchets);
+		std::copy(cold.pitch + begin, cold.pitch + end, out.pitch);
+		std::copy(cold.octave + begin, cold.octave + end, out.octave);
+		std::copy(cold.cv + begin, cold.cv + end, out.cv);
+		std::copy(cold.cv2 + begin, cold.cv2 + end, out.cv2);
+	}
+
+	static void pasteTrack(const TrigsTrackCells &in, int track, TrigsHotCells &hot, TrigsColdCells &cold) {
+		int begin = track * TRACK_STEPS;
+		uint32_t rows = 0xFu << (track * 4);
+		for (int x = 0; x < GRID_COLS; x++) {
+			hot.active.cols[x] = (hot.active.cols[x] & ~rows) | (in.active[x] << (track * 4));
+		}
+		std::copy(in.probability, in.probability + TRACK_STEPS, hot.probability + begin);
+		std::copy(in.division, in.division + TRACK_STEPS, hot.division + begin);
+		std::copy(in.ratchets, in.ratchets + TRACK_STEPS, hot.ratchets + begin);
+		std::copy(in.pitch, in.pitch + TRACK_STEPS, cold.pitch + begin);
+		std::copy(in.octave, in.octave + TRACK_STEPS, cold.octave + begin);
+		std::copy(in.cv, in.cv + TRACK_STEPS, cold.cv + begin);
+		std::copy(in.cv2, in.cv2 + TRACK_STEPS, cold.cv2 + begin);
+	}
+
+	// Moves every step of a track shift steps later (0 < shift < TRACK_STEPS), wrapping around
+	// the end of the track
+	static void rotateTrack(TrigsHotCells &hot, TrigsColdCells &cold, int track, int shift) {
+		int begin = track * TRACK_STEPS;
+		int mid = begin + TRACK_STEPS - shift;
+		int end = begin + TRACK_STEPS;
+		bool active[TRACK_STEPS];
+		for (int step = 0; step < TRACK_STEPS; step++) {
+			int i = begin + step;
+			active[step] = hot.active.get(i % GRID_COLS, i / GRID_COLS);
+		}
+		std::rotate(active, active + TRACK_STEPS - shift, active + TRACK_STEPS);
+		for (int step = 0; step < TRACK_STEPS; step++) {
+			int i = begin + step;
+			hot.active.set(i % GRID_COLS, i / GRID_COLS, active[step]);
+		}
+		std::rotate(hot.probability + begin, hot.probability + mid, hot.probability + end);
+		std::rotate(hot.division + begin, hot.division + mid, hot.division + end);
+		std::rotate(hot.ratchets + begin, hot.ratchets + mid, hot.ratchets + end);
+		std::rotate(cold.pitch + begin, cold.pitch + mid, cold.pitch + end);
+		std::rotate(cold.octave + begin, cold.octave + mid, cold.octave + end);
+		std::rotate(cold.cv + begin, cold.cv + mid, cold.cv + end);
+		std::rotate(cold.cv2 + begin, cold.cv2 + mid, cold.cv2 + end);
+	}
+
+	// The "cells" array of patches from before cellsPacked: one object per cell. Values are
+	// clamped; a cell without cv, cv2 or pr keeps what it had, as do cells past the array.
+	static void readCellsArray(json_t *cellsJ, TrigsHotCells &hot, TrigsColdCells &cold) {
+		size_t n = std::min((size_t)GRID_CELLS, json_array_size(cellsJ));
+		for (size_t i = 0; i < n; i++) {
+			json_t *cellJ = json_array_get(cellsJ, i);
+			if (!cellJ || !json_is_object(cellJ)) continue;
+			TrigsCellProps c = get(hot, cold, i);
+			c.active = json_boolean_value(json_object_get(cellJ, "a"));
+			c.pitch = clampf((float)json_number_value(json_object_get(cellJ, "p")), 0.f, 10.f);
+			c.octave = clampi((int)json_integer_value(json_object_get(cellJ, "o")), -4, 4);
+			json_t *cvJ = json_object_get(cellJ, "cv");
+			if (cvJ) c.cv = clampf((float)json_number_value(cvJ), -10.f, 10.f);
+			json_t *cv2J = json_object_get(cellJ, "cv2");
+			if (cv2J) c.cv2 = clampf((float)json_number_value(cv2J), -10.f, 10.f);
+			json_t *prJ = json_object_get(cellJ, "pr");
+			if (prJ) c.probability = clampf((float)json_number_value(prJ), 0.f, 1.f);
+			c.division = clampi((int)json_integer_value(json_object_get(cellJ, "d")), 1, 16);
+			c.ratchets = clampi((int)json_integer_value(json_object_get(cellJ, "r")), 1, 8);
+			set(hot, cold, i, c);
+		}
+	}
+
+private:
+	// Same as clampfjw/clampijw, which need the SDK
+	static float clampf(float x, float minimum, float maximum) {
+		return fminf(fmaxf(x, minimum), maximum);
+	}
+
+	static int clampi(int x, int minimum, int maximum) {
+		return std::max(minimum, std::min(x, maximum));
+	}
+};
+
+// Packed cells, version 1: one fixed-width little-endian array per property, in cell order,
+// run through packZeroRuns. Each value is stored as its difference from the cleared cell
+// (probability XORed with the bits of 1.0, division and ratchets less one), so untouched
+// cells are zero bytes and an empty or sparse grid packs to almost nothing. Version 2 is the
+// same arrays without packZeroRuns, which pack gives instead when that would not be smaller:
+// every isolated zero byte costs two, so a grid with all cells edited could grow.
+struct TrigsPackedCells {
+	static const int VERSION = 1;
+	static const int RAW_VERSION = 2;
+	static const size_t ACTIVE_BYTES = GRID_COLS * BitGrid<GRID_COLS, GRID_ROWS>::COL_BYTES;
+	static const size_t BYTES = ACTIVE_BYTES + GRID_CELLS * (4 + 1 + 4 + 4 + 4 + 1 + 1);
+
+	// Sets version to the one the data is in, VERSION or RAW_VERSION
+	static std::vector<uint8_t> pack(const TrigsHotCells &hot, const TrigsColdCells &cold, int &version) {
+		std::vector<uint8_t> raw(BYTES);
+		uint8_t *out = raw.data();
+		for (int x = 0; x < GRID_COLS; x++) {
+			for (int b = 0; b < BitGrid<GRID_COLS, GRID_ROWS>::COL_BYTES; b++) *out++ = (uint8_t)(hot.active.cols[x] >> (8 * b));
+		}
+		for (int i = 0; i < GRID_CELLS; i++, out += 4) putFloatLE(out, cold.pitch[i], 0);
+		for (int i = 0; i < GRID_CELLS; i++) *out++ = (uint8_t)cold.octave[i];
+		for (int i = 0; i < GRID_CELLS; i++, out += 4) putFloatLE(out, cold.cv[i], 0);
+		for (int i = 0; i < GRID_CELLS; i++, out += 4) putFloatLE(out, cold.cv2[i], 0);
+		for (int i = 0; i < GRID_CELLS; i++, out += 4) putFloatLE(out, hot.probability[i], floatBits(1.f));
+		for (int i = 0; i < GRID_CELLS; i++) *out++ = (uint8_t)(hot.division[i] - 1);
+		for (int i = 0; i < GRID_CELLS; i++) *out++ = (uint8_t)(hot.ratchets[i] - 1);
+		std::vector<uint8_t> packed;
+		packZeroRuns(raw.data(), raw.size(), packed);
+		if (packed.size() >= raw.size()) {
+			version = RAW_VERSION;
+			return raw;
+		}
+		version = VERSION;
+		return packed;
+	}
+
+	// Leaves the cells untouched unless data is a whole grid in the given version. Values are
+	// clamped like the JSON cells, and a value that is not a number loads as the cleared cell's.
+	static bool unpack(const uint8_t *data, size_t len, int version, TrigsHotCells &hot, TrigsColdCells &cold) {
+		std::vector<uint8_t> raw(BYTES);
+		if (version == RAW_VERSION) {
+			if (len != BYTES) return false;
+			std::copy(data, data + len, raw.begin());
+		}
+		else if (version != VERSION || !unpackZeroRuns(data, len, raw.data(), raw.size())) {
+			return false;
+		}
+		const uint8_t *in = raw.data();
+		for (int x = 0; x < GRID_COLS; x++) {
+			uint32_t col = 0;
+			for (int b = 0; b < BitGrid<GRID_COLS, GRID_ROWS>::COL_BYTES; b++) col |= (uint32_t)*in++ << (8 * b);
+			hot.active.cols[x] = col & BitGrid<GRID_COLS, GRID_ROWS>::COL_MASK;
+		}
+		for (int i = 0; i < GRID_CELLS; i++, in += 4) cold.pitch[i] = clampf(finiteOr(getFloatLE(in, 0), 0.f), 0.f, 10.f);
+		for (int i = 0; i < GRID_CELLS; i++) cold.octave[i] = clampi((int8_t)*in++, -4, 4);
+		for (int i = 0; i < GRID_CELLS; i++, in += 4) cold.cv[i] = clampf(finiteOr(getFloatLE(in, 0), 0.f), -10.f, 10.f);
+		for (int i = 0; i < GRID_CELLS; i++, in += 4) cold.cv2[i] = clampf(finiteOr(getFloatLE(in, 0), 0.f), -10.f, 10.f);
+		for (int i = 0; i < GRID_CELLS; i++, in += 4) hot.probability[i] = clampf(finiteOr(getFloatLE(in, floatBits(1.f)), 1.f), 0.f, 1.f);
+		for (int i = 0; i < GRID_CELLS; i++) hot.division[i] = clampi(*in++ + 1, 1, 16);
+		for (int i = 0; i < GRID_CELLS; i++) hot.ratchets[i] = clampi(*in++ + 1, 1, 8);
+		return true;
+	}
+
+private:
+	static void putFloatLE(uint8_t *out, float value, uint32_t base) {
+		uint32_t bits = floatBits(value) ^ base;
+		for (int b = 0; b < 4; b++) out[b] = (uint8_t)(bits >> (8 * b));
+	}
+
+	static float getFloatLE(const uint8_t *in, uint32_t base) {
+		uint32_t bits = 0;
+		for (int b = 0; b < 4; b++) bits |= (uint32_t)in[b] << (8 * b);
+		bits ^= base;
+		float value;
+		memcpy(&value, &bits, 4);
+		return value;
+	}
+
+	static uint32_t floatBits(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, 4);
+		return bits;
+	}
+
+	static float finiteOr(float value, float fallback) {
+		return std::isfinite(value) ? value : fallback;
+	}
+
+	// Same as clampfjw/clampijw, which need the SDK
+	static float clampf(float x, float minimum, float maximum) {
+		return fminf(fmaxf(x, minimum), maximum);
+	}
+
+	static int clampi(int x, int minimum, int maximum) {
+		return std::max(minimum, std::min(x, maximum));
+	}
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+
+////////////////////////////////////////////// TRIPLE BUFFER //////////////////////////////////////////////
+
+// Lock-free handoff of whole frames from one writer thread (the engine) to one reader thread
+// (the UI). The writer fills back() and publish()es it; the reader calls update() and reads
+// front(), which nobody writes until the reader's next update(). Neither side ever waits, and
+// the reader only ever sees complete frames, always the latest one published.
+template <typename T>
+struct TripleBuffer {
+	// Writer: the frame being filled
+	T &back() {
+		return slots[backIndex];
+	}
+
+	// Writer: hands back() to the reader and takes the spare slot to fill next. The new back()
+	// holds an older frame, so writers that build frames incrementally must start over.
+	void publish() {
+		backIndex = middle.exchange(backIndex | FRESH) & INDEX_MASK;
+	}
+
+	// Reader: takes the latest published frame if there is one. Returns true if front() changed.
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		frontIndex = middle.exchange(frontIndex) & INDEX_MASK;
+		return true;
+	}
+
+	// Reader: the latest frame taken by update()
+	const T &front() const {
+		return slots[frontIndex];
+	}
+
+	// Direct slot access, only before the buffer is shared between threads (e.g. to size them)
+	T &slot(int i) {
+		return slots[i];
+	}
+
+private:
+	static const int INDEX_MASK = 3;
+	static const int FRESH = 4;
+	T slots[3];
+	int backIndex = 0;
+	std::atomic<int> middle{1};
+	int frontIndex = 2;
+};
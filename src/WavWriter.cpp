@@ -0,0 +1,256 @@
+#include "WavWriter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static const uint64_t RIFF_MAX = 0xFFFFFFFFull;
+static const size_t DS64_BYTES = 28;
+
+static void putU16(uint8_t *p, uint16_t v) {
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)((v >> 8) & 0xFF);
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; ++i) p[i] = (uint8_t)((v >> (8 * i)) & 0xFF);
+}
+
+static void putU64(uint8_t *p, uint64_t v) {
+	for (int i = 0; i < 8; ++i) p[i] = (uint8_t)((v >> (8 * i)) & 0xFF);
+}
+
+static void setError(std::string *error, const char *msg) {
+	if (error) *error = msg;
+}
+
+bool WavFile::open(const std::string &path, int channels, int sampleRate, Format format, std::string *error) {
+	close();
+	if (channels <= 0 || sampleRate <= 0) { setError(error, "Invalid audio format"); return false; }
+	file = fopen(path.c_str(), "wb");
+	if (!file) { setError(error, "Could not write file"); return false; }
+	this->channels = channels;
+	this->sampleRate = sampleRate;
+	this->format = format;
+	frames = 0;
+	failed = false;
+	block.assign(BLOCK_BYTES, 0);
+	blockUsed = 0;
+	if (!writeHeader(false)) {
+		setError(error, "Write error");
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+// RIFF/RF64 header with a JUNK chunk holding the place of ds64:
+// RIFF size WAVE | JUNK/ds64 28 ... | fmt 16/18 ... | data size
+bool WavFile::writeHeader(bool final) {
+	const bool flt = format == FLOAT32;
+	const uint32_t fmtSize = flt ? 18 : 16;
+	const uint16_t blockAlign = (uint16_t)(channels * bytesPerSample());
+	const uint64_t dataBytes = frames * blockAlign;
+	const size_t headerBytes = 12 + 8 + DS64_BYTES + 8 + fmtSize + 8;
+	const uint64_t riffSize = headerBytes - 8 + dataBytes;
+	const bool rf64 = final && riffSize > RIFF_MAX;
+
+	uint8_t h[12 + 8 + DS64_BYTES + 8 + 18 + 8];
+	memset(h, 0, sizeof(h));
+	uint8_t *p = h;
+	memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+	putU32(p + 4, (uint32_t)std::min(riffSize, RIFF_MAX));
+	memcpy(p + 8, "WAVE", 4);
+	p += 12;
+	memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+	putU32(p + 4, (uint32_t)DS64_BYTES);
+	if (rf64) {
+		putU64(p + 8, riffSize);
+		putU64(p + 16, dataBytes);
+		putU64(p + 24, frames);
+		putU32(p + 32, 0); // no table entries
+	}
+	p += 8 + DS64_BYTES;
+	memcpy(p, "fmt ", 4);
+	putU32(p + 4, fmtSize);
+	putU16(p + 8, flt ? 3 : 1);
+	putU16(p + 10, (uint16_t)channels);
+	putU32(p + 12, (uint32_t)sampleRate);
+	putU32(p + 16, (uint32_t)sampleRate * blockAlign);
+	putU16(p + 20, blockAlign);
+	putU16(p + 22, (uint16_t)(bytesPerSample() * 8));
+	if (flt) putU16(p + 24, 0); // cbSize
+	p += 8 + fmtSize;
+	memcpy(p, "data", 4);
+	// Until the file is final, sizes past 4 GB are clamped; readers treat the data as truncated
+	putU32(p + 4, rf64 ? (uint32_t)RIFF_MAX : (uint32_t)std::min(dataBytes, RIFF_MAX));
+
+	if (fseek(file, 0, SEEK_SET) != 0) return false;
+	return fwrite(h, 1, headerBytes, file) == headerBytes;
+}
+
+bool WavFile::write(const float *interleaved, size_t n) {
+	if (!file) return false;
+	const size_t count = n * (size_t)channels;
+	const size_t bps = bytesPerSample();
+	for (size_t i = 0; i < count; ++i) {
+		if (blockUsed + bps > BLOCK_BYTES && !flushBlock()) return false;
+		uint8_t *p = &block[blockUsed];
+		if (format == FLOAT32) {
+			memcpy(p, &interleaved[i], 4);
+		}
+		else {
+			float f = std::max(-1.f, std::min(1.f, interleaved[i]));
+			int s = (int)std::lround(f * 32767.0f);
+			putU16(p, (uint16_t)(int16_t)s);
+		}
+		blockUsed += bps;
+	}
+	frames += n;
+	return !failed;
+}
+
+bool WavFile::flushBlock() {
+	if (blockUsed == 0) return !failed;
+	if (fwrite(block.data(), 1, blockUsed, file) != blockUsed) failed = true;
+	blockUsed = 0;
+	return !failed;
+}
+
+bool WavFile::updateHeader() {
+	if (!file) return false;
+	flushBlock();
+	if (!writeHeader(false)) failed = true;
+	if (fseek(file, 0, SEEK_END) != 0) failed = true;
+	fflush(file);
+	return !failed;
+}
+
+bool WavFile::close() {
+	if (!file) return false;
+	flushBlock();
+	if (!writeHeader(true)) failed = true;
+	if (fflush(file) != 0 || ferror(file)) failed = true;
+	fclose(file);
+	file = nullptr;
+	return !failed;
+}
+
+////////////////////////////////////////////// STREAMING //////////////////////////////////////////////
+
+void WavStreamWriter::prepare(int channels, size_t ringFrames) {
+	if (prepared) return;
+	this->channels = std::max(1, channels);
+	// Power-of-two ring so positions wrap with a mask
+	size_t want = std::max((size_t)1, ringFrames) * (size_t)this->channels;
+	size_t cap = 1;
+	while (cap < want) cap <<= 1;
+	ring.assign(cap, 0.f);
+	ringMask = cap - 1;
+	scratch.assign(WavFile::BLOCK_BYTES / sizeof(int16_t), 0.f);
+	writePos = 0;
+	readPos = 0;
+	prepared = true;
+}
+
+bool WavStreamWriter::start() {
+	if (!prepared || taking) return false;
+	// The last close() left the ring empty
+	written = 0;
+	dropped = 0;
+	taking = true;
+	accepting = true;
+	return true;
+}
+
+void WavStreamWriter::stop() {
+	accepting = false;
+}
+
+bool WavStreamWriter::open(const std::string &path, int sampleRate, WavFile::Format format, std::string *error) {
+	if (!taking || thread.joinable()) {
+		if (error) *error = "Not recording";
+		return false;
+	}
+	if (!file.open(path, channels, sampleRate, format, error)) return false;
+	running = true;
+	thread = std::thread([this]() { run(); });
+	return true;
+}
+
+bool WavStreamWriter::push(const float *interleaved, size_t frames) {
+	pushers++;
+	bool ok = false;
+	if (accepting) {
+		const size_t count = frames * (size_t)channels;
+		size_t w = writePos.load(std::memory_order_relaxed);
+		size_t r = readPos.load(std::memory_order_acquire);
+		if (ring.size() - (w - r) >= count) {
+			for (size_t i = 0; i < count; ++i) ring[(w + i) & ringMask] = interleaved[i];
+			writePos.store(w + count, std::memory_order_release);
+			ok = true;
+		}
+		else {
+			dropped += frames;
+		}
+	}
+	pushers--;
+	return ok;
+}
+
+// Writes whole frames from the ring while at least minFloats are waiting
+bool WavStreamWriter::drain(size_t minFloats) {
+	bool any = false;
+	const size_t chunk = scratch.size() - scratch.size() % (size_t)channels;
+	while (true) {
+		size_t r = readPos.load(std::memory_order_relaxed);
+		size_t avail = writePos.load(std::memory_order_acquire) - r;
+		if (avail == 0 || avail < minFloats) break;
+		size_t n = std::min(avail, chunk);
+		n -= n % (size_t)channels;
+		if (n == 0) break;
+		for (size_t i = 0; i < n; ++i) scratch[i] = ring[(r + i) & ringMask];
+		readPos.store(r + n, std::memory_order_release);
+		file.write(scratch.data(), n / (size_t)channels);
+		written += n / (size_t)channels;
+		any = true;
+	}
+	return any;
+}
+
+void WavStreamWriter::run() {
+	// Write only full blocks while recording; the remainder goes out on close
+	const size_t blockFloats = scratch.size() - scratch.size() % (size_t)channels;
+	auto lastHeader = std::chrono::steady_clock::now();
+	while (running) {
+		if (!drain(blockFloats)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastHeader > std::chrono::seconds(1)) {
+			file.updateHeader();
+			lastHeader = now;
+		}
+	}
+}
+
+bool WavStreamWriter::close() {
+	if (!taking) return false;
+	accepting = false;
+	// A push that saw accepting == true may still be copying
+	while (pushers > 0) std::this_thread::yield();
+	bool ok = false;
+	if (thread.joinable()) {
+		running = false;
+		thread.join();
+		drain(0);
+		ok = file.close();
+	}
+	else {
+		// Never opened: what the take pushed has nowhere to go
+		readPos.store(writePos.load(std::memory_order_acquire), std::memory_order_release);
+	}
+	taking = false;
+	return ok;
+}
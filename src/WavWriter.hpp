@@ -0,0 +1,104 @@
+#pragma once
+#include "rack.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rack;
+
+////////////////////////////////////////////// WAV WRITING //////////////////////////////////////////////
+
+// Block-buffered WAV file writer. Samples are converted into a fixed-size block and written
+// one block per fwrite. The header reserves room for an RF64 ds64 chunk, so a file that ends
+// up past 4 GB is finalized as RF64 instead of wrapping its size fields.
+struct WavFile {
+	enum Format { PCM16, FLOAT32 };
+	static const size_t BLOCK_BYTES = 64 * 1024;
+
+	~WavFile() {
+		close();
+	}
+
+	bool open(const std::string &path, int channels, int sampleRate, Format format = PCM16, std::string *error = nullptr);
+	// Interleaved frames, nominally -1..1 (PCM16 clamps)
+	bool write(const float *interleaved, size_t frames);
+	// Writes out the pending block and rewrites the size fields so a crash leaves a readable file
+	bool updateHeader();
+	// Finalizes the header. Returns false if anything failed to write.
+	bool close();
+
+	bool isOpen() const { return file != nullptr; }
+	uint64_t framesWritten() const { return frames; }
+
+private:
+	FILE *file = nullptr;
+	int channels = 0;
+	int sampleRate = 0;
+	Format format = PCM16;
+	uint64_t frames = 0;
+	bool failed = false;
+	std::vector<uint8_t> block;
+	size_t blockUsed = 0;
+
+	size_t bytesPerSample() const { return format == FLOAT32 ? 4 : 2; }
+	bool flushBlock();
+	bool writeHeader(bool final);
+};
+
+// Records from the audio thread straight to disk. push() copies frames into a lock-free ring;
+// a background thread drains it in fixed-size blocks, so memory stays bounded however long
+// the take runs. A take begins on the audio thread with start() and frames wait in the ring
+// until open() has the file ready, so nothing is lost while the file is being created.
+struct WavStreamWriter {
+	~WavStreamWriter() {
+		close();
+	}
+
+	// Not on the audio thread, once: sizes the ring. It has to hold the frames that arrive
+	// while the file is opened and while the disk stalls.
+	void prepare(int channels, size_t ringFrames);
+	bool isPrepared() const { return prepared; }
+	// Audio thread: begins a take. Returns false if the writer is not prepared or the previous
+	// take has not been closed yet.
+	bool start();
+	// Audio thread: ends the take; the frames already pushed are still written out by close()
+	void stop();
+	// Not on the audio thread: opens the file for the take begun by start() and starts the
+	// flush thread
+	bool open(const std::string &path, int sampleRate, WavFile::Format format = WavFile::PCM16, std::string *error = nullptr);
+	// Audio thread. Never blocks or allocates; returns false when there is no take, or when the
+	// ring is full, in which case the frames count as dropped.
+	bool push(const float *interleaved, size_t frames = 1);
+	// Not on the audio thread: ends the take, drains the ring and finalizes the file. A take
+	// that was never opened is discarded. Returns false if nothing was written or writing failed.
+	bool close();
+
+	bool isOpen() const { return thread.joinable(); }
+	uint64_t framesWritten() const { return written; }
+	// Frames refused during the current or last take
+	uint64_t droppedFrames() const { return dropped; }
+
+private:
+	WavFile file;
+	int channels = 1;
+	std::vector<float> ring;
+	size_t ringMask = 0;
+	std::atomic<size_t> writePos{0};
+	std::atomic<size_t> readPos{0};
+	std::vector<float> scratch;
+	std::atomic<bool> prepared{false};
+	// From start() until close() is done
+	std::atomic<bool> taking{false};
+	std::atomic<bool> accepting{false};
+	std::atomic<bool> running{false};
+	std::atomic<int> pushers{0};
+	std::atomic<uint64_t> written{0};
+	std::atomic<uint64_t> dropped{0};
+	std::thread thread;
+
+	void run();
+	bool drain(size_t minFloats);
+};
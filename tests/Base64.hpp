@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Same alphabet as rack::string::toBase64, which needs the SDK
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+inline std::string toBase64(const std::vector<uint8_t> &data) {
+	std::string out;
+	for (size_t i = 0; i < data.size(); i += 3) {
+		uint32_t v = (uint32_t)data[i] << 16;
+		if (i + 1 < data.size()) v |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < data.size()) v |= data[i + 2];
+		out += BASE64[(v >> 18) & 63];
+		out += BASE64[(v >> 12) & 63];
+		out += i + 1 < data.size() ? BASE64[(v >> 6) & 63] : '=';
+		out += i + 2 < data.size() ? BASE64[v & 63] : '=';
+	}
+	return out;
+}
+
+inline std::vector<uint8_t> fromBase64(const std::string &text) {
+	std::vector<uint8_t> out;
+	uint32_t v = 0;
+	int bits = 0;
+	for (char c : text) {
+		const char *p = strchr(BASE64, c);
+		if (c == '=' || !p || !c) break;
+		v = (v << 6) | (uint32_t)(p - BASE64);
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			out.push_back((uint8_t)(v >> bits));
+		}
+	}
+	return out;
+}
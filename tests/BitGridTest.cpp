@@ -0,0 +1,340 @@
+// BitGrid pack()/unpack(): round trips at every density and grid shape the modules use, and
+// rejection of anything that isn't a packed grid of the right size. Life steps for the preset
+// rules with and without wrap, and the transforms, against a cell by cell reference, then a
+// timing of both Life steps. LifeRule parsing. LifeCycleDetector against a plain map of when
+// each state was last seen.
+#include "BitGrid.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 20) { printf("FAIL line %d: ", __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+static std::mt19937 rng(1);
+
+template <int C, int R>
+static void randomize(BitGrid<C, R> &g, float density) {
+	std::uniform_real_distribution<float> u(0.f, 1.f);
+	for (int x = 0; x < C; x++)
+		for (int y = 0; y < R; y++)
+			g.set(x, y, u(rng) < density);
+}
+
+template <int C, int R>
+static void roundTrips(const char *name) {
+	const float densities[] = {0.f, 0.001f, 0.05f, 0.5f, 0.95f, 1.f};
+	size_t emptyBytes = 0, fullBytes = 0;
+	for (float density : densities) {
+		for (int i = 0; i < 200; i++) {
+			BitGrid<C, R> g, back;
+			randomize(g, density);
+			std::vector<uint8_t> packed = g.pack();
+			back.set(0, 0, true);
+			CHECK(back.unpack(packed.data(), packed.size()), "%s: unpack failed at density %g", name, density);
+			CHECK(back == g, "%s: round trip differs at density %g", name, density);
+			if (density == 0.f) emptyBytes = packed.size();
+			if (density == 1.f) fullBytes = packed.size();
+		}
+	}
+	// A zero run covers at most 255 bytes, so an empty grid packs to 2 bytes per 255
+	size_t rawBytes = C * BitGrid<C, R>::COL_BYTES;
+	CHECK(emptyBytes == 2 * ((rawBytes + 254) / 255), "%s: empty grid packed to %zu bytes", name, emptyBytes);
+	printf("%s: %zu raw bytes, empty packs to %zu, full to %zu\n", name, rawBytes, emptyBytes, fullBytes);
+}
+
+// unpack() has to fail and leave the grid as it was
+template <int C, int R>
+static void rejects(const char *name, const char *what, const std::vector<uint8_t> &data) {
+	BitGrid<C, R> g, before;
+	randomize(g, 0.3f);
+	before = g;
+	CHECK(!g.unpack(data.data(), data.size()), "%s: accepted %s", name, what);
+	CHECK(g == before, "%s: changed by %s", name, what);
+}
+
+template <int C, int R>
+static void rejections(const char *name) {
+	BitGrid<C, R> g;
+	randomize(g, 0.3f);
+	std::vector<uint8_t> good = g.pack();
+
+	rejects<C, R>(name, "no data", std::vector<uint8_t>());
+	std::vector<uint8_t> d = good;
+	d.pop_back();
+	rejects<C, R>(name, "a truncated stream", d);
+	d = good;
+	d.push_back(1);
+	rejects<C, R>(name, "a trailing byte", d);
+	d = good;
+	d.push_back(0);
+	rejects<C, R>(name, "a zero without a count", d);
+	d = good;
+	d.push_back(0);
+	d.push_back(0);
+	rejects<C, R>(name, "a zero run of length 0", d);
+	// Cut off in the middle of a run
+	BitGrid<C, R> empty;
+	d = empty.pack();
+	d.back()--;
+	rejects<C, R>(name, "an empty grid one byte short", d);
+	d = empty.pack();
+	d.back()++;
+	rejects<C, R>(name, "an empty grid one byte long", d);
+
+	// Random bytes and packed grids with a byte changed: either rejected, or a grid that packs
+	// and unpacks to itself with no bits outside the rows
+	int accepted = 0;
+	for (int i = 0; i < 20000; i++) {
+		std::vector<uint8_t> junk;
+		if (i % 2) {
+			junk.resize(rng() % (2 * good.size() + 2));
+			for (uint8_t &b : junk) b = (rng() % 3 == 0) ? 0 : (uint8_t)rng();
+		}
+		else {
+			junk = good;
+			junk[rng() % junk.size()] = (rng() % 3 == 0) ? 0 : (uint8_t)rng();
+		}
+		BitGrid<C, R> h, before;
+		randomize(h, 0.3f);
+		before = h;
+		if (!h.unpack(junk.data(), junk.size())) {
+			CHECK(h == before, "%s: failed unpack changed the grid", name);
+			continue;
+		}
+		accepted++;
+		for (int x = 0; x < C; x++)
+			CHECK((h.column(x) & ~BitGrid<C, R>::COL_MASK) == 0, "%s: bits outside the rows", name);
+		std::vector<uint8_t> again = h.pack();
+		BitGrid<C, R> back;
+		CHECK(back.unpack(again.data(), again.size()) && back == h, "%s: repacked junk differs", name);
+	}
+	printf("%s: rejections ok, %d of 20000 random streams were valid grids\n", name, accepted);
+}
+
+// One generation a cell at a time, the way the sequencers stepped Life before BitGrid
+template <int C, int R>
+static BitGrid<C, R> referenceLife(const BitGrid<C, R> &g, const LifeRule &rule, bool wrap) {
+	BitGrid<C, R> next;
+	for (int x = 0; x < C; x++) {
+		for (int y = 0; y < R; y++) {
+			int n = 0;
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					if (dx == 0 && dy == 0) continue;
+					int nx = x + dx, ny = y + dy;
+					if (wrap) {
+						nx = (nx + C) % C;
+						ny = (ny + R) % R;
+					}
+					else if (nx < 0 || nx >= C || ny < 0 || ny >= R) continue;
+					n += g.get(nx, ny);
+				}
+			}
+			bool on = g.get(x, y) ? (rule.survive >> n) & 1 : (rule.born >> n) & 1;
+			next.set(x, y, on);
+		}
+	}
+	return next;
+}
+
+template <int C, int R>
+static void lifeSteps(const char *name) {
+	const char *rules[] = {"B3/S23", "B36/S23", "B2/S", "B3678/S34678"};
+	const float densities[] = {0.05f, 0.3f, 0.5f, 0.8f};
+	for (const char *text : rules) {
+		LifeRule rule;
+		CHECK(LifeRule::parse(text, rule), "%s: %s did not parse", name, text);
+		for (int wrap = 0; wrap < 2; wrap++) {
+			for (float density : densities) {
+				BitGrid<C, R> g;
+				randomize(g, density);
+				// Several generations each, so the grids the rule itself makes get stepped too
+				for (int gen = 0; gen < 20; gen++) {
+					BitGrid<C, R> want = referenceLife(g, rule, wrap);
+					g.stepLife(rule, wrap);
+					if (g != want) {
+						CHECK(false, "%s: %s %s generation %d at density %g differs", name, text, wrap ? "wrapped" : "bounded", gen, density);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Each transform against where it should put every cell
+template <int C, int R>
+static void transforms(const char *name) {
+	for (int i = 0; i < 50; i++) {
+		BitGrid<C, R> g;
+		randomize(g, 0.4f);
+
+		BitGrid<C, R> h = g;
+		h.flipHoriz();
+		bool same = true;
+		for (int x = 0; x < C; x++)
+			for (int y = 0; y < R; y++)
+				same = same && h.get(x, y) == g.get(C - 1 - x, y);
+		CHECK(same, "%s: flipHoriz", name);
+
+		h = g;
+		h.flipVert();
+		same = true;
+		for (int x = 0; x < C; x++)
+			for (int y = 0; y < R; y++)
+				same = same && h.get(x, y) == g.get(x, R - 1 - y);
+		CHECK(same, "%s: flipVert", name);
+
+		for (int amount = -R - 1; amount <= R + 1; amount++) {
+			h = g;
+			h.rotateRows(amount);
+			same = true;
+			for (int x = 0; x < C; x++)
+				for (int y = 0; y < R; y++)
+					same = same && h.get(x, y) == g.get(x, (((y + amount) % R) + R) % R);
+			CHECK(same, "%s: rotateRows(%d)", name, amount);
+		}
+
+		// Squares of R columns turn on screen, row 0 at the top; columns past the last whole
+		// square stay put
+		for (int clockwise = 0; clockwise < 2; clockwise++) {
+			h = g;
+			h.rotateSquares(clockwise);
+			same = true;
+			for (int x = 0; x < C; x++) {
+				int start = x / R * R;
+				for (int y = 0; y < R; y++) {
+					bool want = g.get(x, y);
+					if (start + R <= C) {
+						int sx = x - start;
+						want = clockwise ? g.get(start + y, R - 1 - sx) : g.get(start + R - 1 - y, sx);
+					}
+					same = same && h.get(x, y) == want;
+				}
+			}
+			CHECK(same, "%s: rotateSquares(%s)", name, clockwise ? "clockwise" : "counterclockwise");
+		}
+	}
+}
+
+template <int C, int R>
+static void timeLife(const char *name) {
+	BitGrid<C, R> start;
+	randomize(start, 0.3f);
+	LifeRule rule;
+	volatile uint32_t sink = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		BitGrid<C, R> g = start;
+		int generations = 0;
+		auto begin = std::chrono::steady_clock::now();
+		double seconds = 0.0;
+		// Restart from the same grid every 100 generations so both time the same work
+		while (seconds < 0.2) {
+			g = start;
+			for (int i = 0; i < 100; i++) {
+				if (pass) g.stepLife(rule, true);
+				else g = referenceLife(g, rule, true);
+			}
+			generations += 100;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		}
+		sink = sink + g.cols[0];
+		printf("%s Life %s: %.0f generations per second\n", name, pass ? "bitboard " : "reference", generations / seconds);
+	}
+}
+
+template <int C, int R>
+static void run(const char *name) {
+	roundTrips<C, R>(name);
+	rejections<C, R>(name);
+	lifeSteps<C, R>(name);
+	transforms<C, R>(name);
+}
+
+static void ruleParsing() {
+	for (const LifeRulePreset &preset : LIFE_RULE_PRESETS) {
+		LifeRule rule;
+		CHECK(LifeRule::parse(preset.rule, rule), "preset %s did not parse", preset.name);
+		CHECK(rule.toString() == preset.rule, "preset %s reads back as %s", preset.name, rule.toString().c_str());
+	}
+	LifeRule rule;
+	CHECK(LifeRule::parse("s23/b36", rule) && rule.toString() == "B36/S23", "lower case S/B order");
+	CHECK(LifeRule::parse("23/3", rule) && rule.toString() == "B3/S23", "digits only, survive first");
+	CHECK(LifeRule::parse("B3 / S23", rule) && rule.toString() == "B3/S23", "spaces");
+	const char *malformed[] = {"", "23", "B3/S23/", "23/3/1", "B9/S23", "B3/S2x", "X3/S23", "B3/23", "B-3/S23"};
+	for (const char *text : malformed) {
+		LifeRule before;
+		LifeRule::parse("B2/S", before);
+		LifeRule out = before;
+		CHECK(!LifeRule::parse(text, out), "accepted \"%s\"", text);
+		CHECK(out == before, "\"%s\" changed the rule", text);
+	}
+}
+
+// Every state seen within HISTORY generations is found, however the hashes collide
+static void lifeCycles(const char *name, uint64_t (*hashOf)(int)) {
+	LifeCycleDetector detector;
+	std::map<uint64_t, uint32_t> lastSeen;
+	uint32_t generation = 0;
+	// A pool a bit larger than HISTORY gives periods on both sides of it
+	std::uniform_int_distribution<int> pick(0, LifeCycleDetector::HISTORY + 40);
+	for (int i = 0; i < 200000; i++) {
+		if (i == 100000) {
+			detector.reset();
+			lastSeen.clear();
+			generation = 0;
+		}
+		uint64_t hash = hashOf(pick(rng));
+		generation++;
+		auto it = lastSeen.find(hash);
+		int want = 0;
+		if (it != lastSeen.end() && generation - it->second <= (uint32_t)LifeCycleDetector::HISTORY) {
+			want = (int)(generation - it->second);
+		}
+		int got = detector.add(hash);
+		CHECK(got == want, "%s: generation %u found period %d, not %d", name, generation, got, want);
+		lastSeen[hash] = generation;
+	}
+}
+
+static uint64_t spreadHash(int k) {
+	return ((uint64_t)k + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+// All in the same home slot
+static uint64_t collidingHash(int k) {
+	return ((uint64_t)k + 1) << 9;
+}
+
+// Half of them sharing a slot
+static uint64_t mixedHash(int k) {
+	return k & 1 ? collidingHash(k) : spreadHash(k);
+}
+
+int main() {
+	run<256, 16>("NoteSeq16 256x16");
+	run<32, 32>("NoteSeq 32x32");
+	run<32, 16>("Trigs128 32x16");
+	run<7, 12>("7x12");
+
+	// Grids of another size never unpack
+	BitGrid<32, 32> big;
+	randomize(big, 0.5f);
+	std::vector<uint8_t> packed = big.pack();
+	BitGrid<32, 16> small;
+	CHECK(!small.unpack(packed.data(), packed.size()), "32x32 unpacked as 32x16");
+
+	ruleParsing();
+	timeLife<32, 32>("NoteSeq 32x32");
+	timeLife<256, 16>("NoteSeq16 256x16");
+
+	lifeCycles("spread hashes", spreadHash);
+	lifeCycles("colliding hashes", collidingHash);
+	lifeCycles("mixed hashes", mixedHash);
+
+	printf(failures ? "%d failures\n" : "ok\n", failures);
+	return failures ? 1 : 0;
+}
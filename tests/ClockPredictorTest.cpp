@@ -0,0 +1,115 @@
+// ClockPredictor against jittery, ramping and broken clocks: the prediction has to beat simply
+// reusing the last interval under jitter, follow ramps, shrug off a dropped clock or a stray
+// edge and take up a real tempo change within two clocks.
+#include "ClockPredictor.hpp"
+#include <cstdio>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 20) { printf("FAIL line %d: ", __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+static std::mt19937 rng(3);
+
+// A clock at `period` samples, each edge landing up to `jitter` samples early or late. Returns the
+// RMS error of the prediction and of reusing the last interval, in samples, over `clocks`
+// intervals after the first `settle`.
+static void jitterRun(float period, float jitter, float &predictedRms, float &lastRms) {
+	const int settle = 20, clocks = 2000;
+	std::uniform_real_distribution<float> u(-jitter, jitter);
+	ClockPredictor p;
+	float edge = 0.f, last = 0.f;
+	double predictedSq = 0.0, lastSq = 0.0;
+	for (int i = 0; i < settle + clocks; i++) {
+		float next = (i + 1) * period + u(rng);
+		float interval = std::round(next) - std::round(edge);
+		if (i >= settle) {
+			predictedSq += (p.next(0.f) - interval) * (p.next(0.f) - interval);
+			lastSq += (last - interval) * (last - interval);
+		}
+		p.addInterval(interval);
+		last = interval;
+		edge = next;
+	}
+	predictedRms = (float)std::sqrt(predictedSq / clocks);
+	lastRms = (float)std::sqrt(lastSq / clocks);
+}
+
+int main() {
+	// Nothing to go by yet
+	{
+		ClockPredictor p;
+		CHECK(!p.valid() && p.next(123.f) == 123.f, "fallback before the first interval");
+		p.addInterval(24000.f);
+		CHECK(p.valid() && p.next(123.f) == 24000.f, "first interval taken as is, got %g", p.next(0.f));
+	}
+
+	// Jitter: 120 BPM at 48 kHz with edges up to 0.1%, 1% and 5% of a clock off
+	const float jitters[] = {24.f, 240.f, 1200.f};
+	for (float jitter : jitters) {
+		float predictedRms, lastRms;
+		jitterRun(24000.f, jitter, predictedRms, lastRms);
+		printf("jitter +-%4.0f samples: predicted %7.1f samples RMS, last interval %7.1f\n", jitter, predictedRms, lastRms);
+		CHECK(predictedRms < 0.8f * lastRms, "jitter %g: prediction %g not better than last interval %g", jitter, predictedRms, lastRms);
+	}
+
+	// Tempo ramp from 120 to 240 BPM over 400 clocks: once moving, within 0.5% of each interval
+	{
+		ClockPredictor p;
+		float worst = 0.f;
+		for (int i = 0; i < 400; i++) {
+			float interval = 24000.f - 12000.f * i / 400.f;
+			if (i > 40) worst = std::fmax(worst, std::fabs(p.next(0.f) - interval) / interval);
+			p.addInterval(interval);
+		}
+		printf("ramp: worst prediction %.3f%% off\n", worst * 100.f);
+		CHECK(worst < 0.005f, "ramp: worst prediction %g%% off", worst * 100.f);
+	}
+
+	// One dropped clock (a double interval) and one doubled clock (two halves) are ignored
+	{
+		ClockPredictor p;
+		for (int i = 0; i < 20; i++) p.addInterval(24000.f);
+		p.addInterval(48000.f);
+		CHECK(std::fabs(p.next(0.f) - 24000.f) < 1.f, "dropped clock moved the prediction to %g", p.next(0.f));
+		p.addInterval(24000.f);
+		p.addInterval(12000.f);
+		CHECK(std::fabs(p.next(0.f) - 24000.f) < 1.f, "doubled clock moved the prediction to %g", p.next(0.f));
+		p.addInterval(12000.f);
+		CHECK(std::fabs(p.next(0.f) - 24000.f) < 1.f, "second half of a doubled clock moved the prediction to %g", p.next(0.f));
+		p.addInterval(24000.f);
+		CHECK(std::fabs(p.next(0.f) - 24000.f) < 1.f, "clock after a stray edge predicted %g", p.next(0.f));
+	}
+
+	// Doubling the tempo looks like a stray edge at first, and is taken up one clock later
+	{
+		ClockPredictor p;
+		for (int i = 0; i < 20; i++) p.addInterval(24000.f);
+		int clocks = 0;
+		while (std::fabs(p.next(0.f) - 12000.f) > 1.f && clocks < 10) {
+			p.addInterval(12000.f);
+			clocks++;
+		}
+		printf("tempo doubled: taken up after %d clocks\n", clocks);
+		CHECK(clocks == 3, "tempo doubling took %d clocks", clocks);
+	}
+
+	// A real change of tempo is taken up as soon as a second interval agrees
+	{
+		ClockPredictor p;
+		for (int i = 0; i < 20; i++) p.addInterval(24000.f);
+		p.addInterval(16000.f);
+		CHECK(std::fabs(p.next(0.f) - 24000.f) < 1.f, "first interval at the new tempo was not held back");
+		p.addInterval(16010.f);
+		CHECK(std::fabs(p.next(0.f) - 16005.f) < 1.f, "new tempo not taken up, predicting %g", p.next(0.f));
+		// Three misses that don't agree with each other: start over from the last
+		for (int i = 0; i < 20; i++) p.addInterval(24000.f);
+		p.addInterval(10000.f);
+		p.addInterval(40000.f);
+		p.addInterval(5000.f);
+		CHECK(std::fabs(p.next(0.f) - 5000.f) < 1.f, "three misses did not restart, predicting %g", p.next(0.f));
+	}
+
+	printf(failures ? "%d failures\n" : "ok\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// NoteSeq16 cells in patch JSON: the per-cell "cells" arrays of old patches, 256 columns wide
+// or from the narrower grids before, load through bitGridFromCellsArray as they were saved,
+// and any other length loads cleared. Then a timing of saving and loading a patch of 50
+// instances with the old arrays and with cellsPacked.
+#include "BitGridJson.hpp"
+#include "Base64.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 20) { printf("FAIL line %d: ", __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+typedef BitGrid<256, 16> Grid;
+
+static std::mt19937 rng(3);
+
+static void randomize(Grid &g, float density, int cols = 256) {
+	std::uniform_real_distribution<float> u(0.f, 1.f);
+	g.clear();
+	for (int x = 0; x < cols; x++)
+		for (int y = 0; y < 16; y++)
+			g.set(x, y, u(rng) < density);
+}
+
+// The array NoteSeq16 saved before cellsPacked, cols cells a row
+static json_t *oldCellsArray(const Grid &g, int cols) {
+	json_t *cellsJ = json_array();
+	for (int y = 0; y < 16; y++)
+		for (int x = 0; x < cols; x++)
+			json_array_append_new(cellsJ, json_integer(g.get(x, y)));
+	return cellsJ;
+}
+
+// Saved as a patch would be and read back
+static json_t *throughText(json_t *j) {
+	char *text = json_dumps(j, JSON_INDENT(2));
+	json_decref(j);
+	json_error_t error;
+	json_t *back = json_loads(text, 0, &error);
+	free(text);
+	return back;
+}
+
+static const int INSTANCES = 50;
+
+// Saves and loads a patch of INSTANCES NoteSeq16s the old way or the packed way
+static void timePatch(bool packed, float density) {
+	static Grid grids[INSTANCES], loaded[INSTANCES];
+	for (Grid &g : grids) randomize(g, density);
+	auto start = std::chrono::steady_clock::now();
+	json_t *modulesJ = json_array();
+	for (const Grid &g : grids) {
+		json_t *dataJ = json_object();
+		if (packed) {
+			json_object_set_new(dataJ, "cellsPackedVersion", json_integer(1));
+			json_object_set_new(dataJ, "cellsPacked", json_string(toBase64(g.pack()).c_str()));
+		}
+		else {
+			json_object_set_new(dataJ, "cells", oldCellsArray(g, 256));
+		}
+		json_t *moduleJ = json_object();
+		json_object_set_new(moduleJ, "data", dataJ);
+		json_array_append_new(modulesJ, moduleJ);
+	}
+	json_t *patchJ = json_object();
+	json_object_set_new(patchJ, "modules", modulesJ);
+	char *text = json_dumps(patchJ, JSON_INDENT(2));
+	json_decref(patchJ);
+	auto saved = std::chrono::steady_clock::now();
+
+	json_error_t error;
+	patchJ = json_loads(text, 0, &error);
+	modulesJ = json_object_get(patchJ, "modules");
+	for (int i = 0; i < INSTANCES; i++) {
+		json_t *dataJ = json_object_get(json_array_get(modulesJ, i), "data");
+		if (packed) {
+			std::vector<uint8_t> data = fromBase64(json_string_value(json_object_get(dataJ, "cellsPacked")));
+			if (!loaded[i].unpack(data.data(), data.size())) loaded[i].clear();
+		}
+		else {
+			bitGridFromCellsArray(json_object_get(dataJ, "cells"), loaded[i]);
+		}
+	}
+	json_decref(patchJ);
+	auto done = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < INSTANCES; i++)
+		CHECK(loaded[i] == grids[i], "%s patch instance %d differs after loading", packed ? "packed" : "old", i);
+	printf("%d instances at %2.0f%%, %s: %7zu bytes, save %6.2f ms, load %6.2f ms\n", INSTANCES, density * 100.f,
+		packed ? "cellsPacked" : "cells array", strlen(text),
+		std::chrono::duration<double, std::milli>(saved - start).count(),
+		std::chrono::duration<double, std::milli>(done - saved).count());
+	free(text);
+}
+
+int main() {
+	// Patches saved at 256 columns
+	const float densities[] = {0.f, 0.1f, 0.5f, 1.f};
+	for (float density : densities) {
+		for (int i = 0; i < 20; i++) {
+			Grid g, back;
+			randomize(g, density);
+			randomize(back, 0.5f);
+			json_t *cellsJ = throughText(oldCellsArray(g, 256));
+			bitGridFromCellsArray(cellsJ, back);
+			json_decref(cellsJ);
+			CHECK(back == g, "4096 cell array at density %g differs", density);
+		}
+	}
+
+	// Narrower grids fill the left; the rest is cleared
+	const int oldWidths[] = {16, 32, 64, 128};
+	for (int cols : oldWidths) {
+		Grid g, back;
+		randomize(g, 0.5f, cols);
+		randomize(back, 0.5f);
+		json_t *cellsJ = throughText(oldCellsArray(g, cols));
+		bitGridFromCellsArray(cellsJ, back);
+		json_decref(cellsJ);
+		CHECK(back == g, "%d column array differs", cols);
+	}
+
+	// Lengths that are not whole rows, and non-integer entries
+	const int badLengths[] = {0, 1, 15, 4095, 4097};
+	for (int len : badLengths) {
+		json_t *cellsJ = json_array();
+		for (int i = 0; i < len; i++) json_array_append_new(cellsJ, json_integer(1));
+		Grid back;
+		randomize(back, 0.5f);
+		bitGridFromCellsArray(cellsJ, back);
+		json_decref(cellsJ);
+		CHECK(back == Grid(), "%d cell array did not load cleared", len);
+	}
+	json_t *cellsJ = json_array();
+	for (int i = 0; i < 4096; i++) json_array_append_new(cellsJ, i == 5 ? json_integer(7) : json_string("1"));
+	Grid back;
+	bitGridFromCellsArray(cellsJ, back);
+	json_decref(cellsJ);
+	Grid want;
+	want.set(5, 0, true);
+	CHECK(back == want, "non-integer cells should load off, non-zero integers on");
+
+	const float patchDensities[] = {0.1f, 0.5f};
+	for (float density : patchDensities) {
+		timePatch(false, density);
+		timePatch(true, density);
+	}
+
+	printf(failures ? "%d failures\n" : "ok\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+// Built-in scale quantizing against the scan it replaced: every scale and root over -10..10 V,
+// then a timing of both. The four-lane version against the scalar one, then a timing of 16
+// channels through each.
+#include <cmath>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+// Stand-in for rack::simd::float_4, with SSE where the compiler has it like the plugin build
+struct Float4 {
+	typedef float Lanes __attribute__((vector_size(16)));
+	Lanes v;
+	Float4() {}
+	Float4(float x) : v{x, x, x, x} {}
+	Float4(Lanes v) : v(v) {}
+	float &operator[](int i) { return ((float *)&v)[i]; }
+	friend Float4 operator+(Float4 a, Float4 b) { return a.v + b.v; }
+	friend Float4 operator-(Float4 a, Float4 b) { return a.v - b.v; }
+	friend Float4 operator*(Float4 a, Float4 b) { return a.v * b.v; }
+	friend Float4 floor(Float4 a) {
+#ifdef __SSE4_1__
+		return (Lanes)_mm_floor_ps((__m128)a.v);
+#else
+		for (int i = 0; i < 4; i++) a[i] = floorf(a[i]);
+		return a;
+#endif
+	}
+};
+
+#include "ScaleTables.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// The scale arrays and scan QuantizeUtils used before the tables, in ScaleEnum order
+static const std::vector<std::vector<int>> OLD_SCALES = {
+	{0, 2, 3, 5, 7, 8, 10, 12},                      // AEOLIAN
+	{0, 3, 5, 6, 7, 10, 12},                         // BLUES
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},      // CHROMATIC
+	{0, 2, 3, 5, 7, 8, 10, 12},                      // DIATONIC_MINOR
+	{0, 2, 3, 5, 7, 9, 10, 12},                      // DORIAN
+	{0, 2, 3, 5, 7, 8, 11, 12},                      // HARMONIC_MINOR
+	{0, 1, 1, 4, 5, 8, 10, 12},                      // INDIAN
+	{0, 1, 3, 5, 6, 8, 10, 12},                      // LOCRIAN
+	{0, 2, 4, 6, 7, 9, 11, 12},                      // LYDIAN
+	{0, 2, 4, 5, 7, 9, 11, 12},                      // MAJOR
+	{0, 2, 3, 5, 7, 8, 9, 10, 11, 12},               // MELODIC_MINOR
+	{0, 2, 3, 5, 7, 8, 10, 12},                      // MINOR
+	{0, 2, 4, 5, 7, 9, 10, 12},                      // MIXOLYDIAN
+	{0, 2, 3, 5, 7, 8, 10, 12},                      // NATURAL_MINOR
+	{0, 2, 4, 7, 9, 12},                             // PENTATONIC
+	{0, 1, 3, 5, 7, 8, 10, 12},                      // PHRYGIAN
+	{0, 1, 3, 5, 7, 10, 11, 12},                     // TURKISH
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},      // NONE
+	{0, 3, 5, 7, 10, 12},                            // PENTATONIC_MINOR
+	{0, 2, 4, 6, 8, 10, 12},                         // WHOLE_TONE
+	{0, 2, 3, 5, 6, 8, 9, 11, 12},                   // DIMINISHED
+	{0, 2, 4, 5, 7, 8, 11, 12},                      // HARMONIC_MAJOR
+	{0, 1, 4, 5, 7, 8, 11, 12},                      // DOUBLE_HARMONIC
+	{0, 2, 4, 5, 7, 8, 9, 11, 12},                   // MAJOR_BEBOP
+	{0, 2, 3, 5, 7, 8, 9, 10, 12},                   // MINOR_BEBOP
+	{0, 1, 4, 5, 7, 8, 10, 12},                      // PHRYGIAN_DOMINANT
+	{0, 2, 3, 6, 7, 8, 11, 12},                      // HUNGARIAN_MINOR
+	{0, 1, 3, 4, 6, 8, 10, 12},                      // ALTERED
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},      // NONE2
+};
+
+static float oldNearestInScale(float voltsIn, int rootNote, int scale) {
+	const std::vector<int> &notes = OLD_SCALES[scale];
+	float closestVal = 10.0;
+	float closestDist = 10.0;
+	float rootVolts = rootNote / 12.0f;
+	float voltsRootRelative = voltsIn - rootVolts;
+	int octaveInVolts = int(floorf(voltsRootRelative));
+	float voltMinusOct = voltsRootRelative - octaveInVolts;
+	for (size_t i = 0; i < notes.size(); i++) {
+		float scaleNoteInVolts = notes[i] / 12.0;
+		float distAway = fabs(voltMinusOct - scaleNoteInVolts);
+		if (distAway < closestDist) {
+			closestVal = scaleNoteInVolts;
+			closestDist = distAway;
+		}
+	}
+	return octaveInVolts + rootVolts + closestVal;
+}
+
+static const int NUM_SCALES = (int)(sizeof(SCALE_MASKS) / sizeof(SCALE_MASKS[0]));
+static const int STEPS_PER_VOLT = 4096;
+
+int main() {
+	if ((int)OLD_SCALES.size() != NUM_SCALES) {
+		printf("FAIL: %d old scales for %d tables\n", (int)OLD_SCALES.size(), NUM_SCALES);
+		return 1;
+	}
+
+	// The two may only disagree where an input sits on the boundary between two notes, and
+	// then both answers have to be equally near
+	long checked = 0, ties = 0, failures = 0;
+	for (int scale = 0; scale < NUM_SCALES; scale++) {
+		for (int root = 0; root < 12; root++) {
+			for (int step = -10 * STEPS_PER_VOLT; step <= 10 * STEPS_PER_VOLT; step++) {
+				float v = (float)step / STEPS_PER_VOLT;
+				float want = oldNearestInScale(v, root, scale);
+				float got = nearestInScale(v, root, scale);
+				checked++;
+				if (got == want) continue;
+				if (fabsf(fabsf(v - got) - fabsf(v - want)) < 0.001f) {
+					ties++;
+					continue;
+				}
+				if (failures++ < 10)
+					printf("FAIL: scale %d root %d at %.6f V: %.6f, was %.6f\n", scale, root, v, got, want);
+			}
+		}
+	}
+	printf("%ld inputs, %ld on a boundary between two notes, %ld wrong\n", checked, ties, failures);
+
+	// Same sweep, timed
+	std::vector<float> inputs;
+	for (int step = -10 * STEPS_PER_VOLT; step <= 10 * STEPS_PER_VOLT; step++)
+		inputs.push_back((float)step / STEPS_PER_VOLT);
+	volatile float sink = 0.f;
+	for (int pass = 0; pass < 2; pass++) {
+		auto start = std::chrono::steady_clock::now();
+		float sum = 0.f;
+		for (int scale = 0; scale < NUM_SCALES; scale++) {
+			for (int root = 0; root < 12; root++) {
+				for (float v : inputs)
+					sum += pass ? nearestInScale(v, root, scale) : oldNearestInScale(v, root, scale);
+			}
+		}
+		sink = sink + sum;
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		printf("%s: %.1f ns per call\n", pass ? "tables" : "scan  ", ns / ((double)NUM_SCALES * 12 * inputs.size()));
+	}
+
+	// Four lanes have to give the scalar answer bit for bit for any finite input. NaN and the
+	// infinities only have to stay inside the table.
+	long laneFailures = 0;
+	std::vector<float> lanes(inputs);
+	const float junk[] = {NAN, INFINITY, -INFINITY, 1e9f, -1e9f, 123.456f, -0.f, 0.5f / QUANTIZE_SLOTS};
+	lanes.insert(lanes.end(), junk, junk + sizeof(junk) / sizeof(junk[0]));
+	while (lanes.size() % 4) lanes.push_back(0.f);
+	for (int scale = 0; scale < NUM_SCALES; scale++) {
+		for (int root = 0; root < 12; root++) {
+			for (size_t i = 0; i < lanes.size(); i += 4) {
+				Float4 in;
+				for (int k = 0; k < 4; k++) in[k] = lanes[i + k];
+				Float4 out = nearestInScale4(in, root, scale);
+				for (int k = 0; k < 4; k++) {
+					float want = nearestInScale(lanes[i + k], root, scale);
+					if (!std::isfinite(lanes[i + k]) || memcmp(&want, &out[k], 4) == 0) continue;
+					if (laneFailures++ < 10)
+						printf("FAIL: four lanes, scale %d root %d at %g V: %g, scalar %g\n", scale, root, lanes[i + k], out[k], want);
+				}
+			}
+		}
+	}
+	printf("four lanes: %ld of %ld wrong\n", laneFailures, (long)lanes.size() * NUM_SCALES * 12);
+	failures += laneFailures;
+
+	// A 16 channel Quantizer, every channel moving every sample
+	const int CHANNELS = 16;
+	const int SAMPLES = (int)inputs.size() / CHANNELS;
+	for (int pass = 0; pass < 2; pass++) {
+		auto start = std::chrono::steady_clock::now();
+		float sum = 0.f;
+		for (int scale = 0; scale < NUM_SCALES; scale++) {
+			for (int s = 0; s < SAMPLES; s++) {
+				const float *in = &inputs[s * CHANNELS];
+				if (pass) {
+					for (int c = 0; c < CHANNELS; c += 4) {
+						Float4 v;
+						for (int k = 0; k < 4; k++) v[k] = in[c + k];
+						v = nearestInScale4(v, 3, scale);
+						sum += v[0] + v[1] + v[2] + v[3];
+					}
+				}
+				else {
+					for (int c = 0; c < CHANNELS; c++)
+						sum += nearestInScale(in[c], 3, scale);
+				}
+			}
+		}
+		sink = sink + sum;
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		printf("16 channels %s: %.1f ns per sample\n", pass ? "four lanes" : "scalar    ", ns / ((double)NUM_SCALES * SAMPLES));
+	}
+	return failures ? 1 : 0;
+}
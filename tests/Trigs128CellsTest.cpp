@@ -0,0 +1,390 @@
+// Trigs128 packed cells: random grids round trip exactly, out of range values load clamped,
+// and mutated or random streams either fail with the cells untouched or load only values
+// the module can hold. Packed data is never longer than the raw records, and version 1 data
+// that grew still loads. Also the per-cell "cells" array of older patches, the track operations
+// and randomize on the split arrays against a plain array of cells, and a timing of saving and
+// loading a patch of 50 instances with the per-cell arrays and with cellsPacked.
+#include "Trigs128Cells.hpp"
+#include "Base64.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { if (failures++ < 20) { printf("FAIL line %d: ", __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while (0)
+
+static std::mt19937 rng(7);
+
+static float uniform(float lo, float hi) {
+	return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+// What initCellParams leaves
+static void clearCells(TrigsHotCells &hot, TrigsColdCells &cold) {
+	hot.active.clear();
+	for (int i = 0; i < GRID_CELLS; i++) {
+		hot.probability[i] = 1.f;
+		hot.division[i] = 1;
+		hot.ratchets[i] = 1;
+		cold.pitch[i] = 0.f;
+		cold.octave[i] = 0;
+		cold.cv[i] = 0.f;
+		cold.cv2[i] = 0.f;
+	}
+}
+
+// A fraction of the cells edited to random values in range
+static void randomCells(TrigsHotCells &hot, TrigsColdCells &cold, float edited) {
+	clearCells(hot, cold);
+	for (int i = 0; i < GRID_CELLS; i++) {
+		if (uniform(0.f, 1.f) >= edited) continue;
+		hot.active.set(i % GRID_COLS, i / GRID_COLS, rng() & 1);
+		hot.probability[i] = (rng() % 4 == 0) ? 0.f : uniform(0.f, 1.f);
+		hot.division[i] = 1 + rng() % 16;
+		hot.ratchets[i] = 1 + rng() % 8;
+		cold.pitch[i] = (rng() % 4 == 0) ? 10.f : uniform(0.f, 10.f);
+		cold.octave[i] = (int8_t)((int)(rng() % 9) - 4);
+		cold.cv[i] = uniform(-10.f, 10.f);
+		cold.cv2[i] = (rng() % 4 == 0) ? -0.f : uniform(-10.f, 10.f);
+	}
+}
+
+static bool sameBits(float a, float b) {
+	return memcmp(&a, &b, 4) == 0;
+}
+
+static bool sameCells(const TrigsHotCells &h1, const TrigsColdCells &c1, const TrigsHotCells &h2, const TrigsColdCells &c2) {
+	if (h1.active != h2.active) return false;
+	for (int i = 0; i < GRID_CELLS; i++) {
+		if (!sameBits(h1.probability[i], h2.probability[i]) || h1.division[i] != h2.division[i] || h1.ratchets[i] != h2.ratchets[i]) return false;
+		if (!sameBits(c1.pitch[i], c2.pitch[i]) || c1.octave[i] != c2.octave[i] || !sameBits(c1.cv[i], c2.cv[i]) || !sameBits(c1.cv2[i], c2.cv2[i])) return false;
+	}
+	return true;
+}
+
+static bool inRange(const TrigsHotCells &hot, const TrigsColdCells &cold) {
+	for (int x = 0; x < GRID_COLS; x++)
+		if (hot.active.column(x) & ~BitGrid<GRID_COLS, GRID_ROWS>::COL_MASK) return false;
+	for (int i = 0; i < GRID_CELLS; i++) {
+		if (!(hot.probability[i] >= 0.f && hot.probability[i] <= 1.f)) return false;
+		if (hot.division[i] < 1 || hot.division[i] > 16 || hot.ratchets[i] < 1 || hot.ratchets[i] > 8) return false;
+		if (!(cold.pitch[i] >= 0.f && cold.pitch[i] <= 10.f) || cold.octave[i] < -4 || cold.octave[i] > 4) return false;
+		if (!(cold.cv[i] >= -10.f && cold.cv[i] <= 10.f) || !(cold.cv2[i] >= -10.f && cold.cv2[i] <= 10.f)) return false;
+	}
+	return true;
+}
+
+// The "cells" array as patches saved it before cellsPacked, through text
+static json_t *cellsArrayText(const TrigsHotCells &hot, const TrigsColdCells &cold) {
+	json_t *cellsJ = json_array();
+	for (int i = 0; i < GRID_CELLS; i++) {
+		TrigsCellProps c = TrigsCells::get(hot, cold, i);
+		json_t *cellJ = json_object();
+		json_object_set_new(cellJ, "a", json_boolean(c.active));
+		json_object_set_new(cellJ, "p", json_real(c.pitch));
+		json_object_set_new(cellJ, "o", json_integer(c.octave));
+		json_object_set_new(cellJ, "cv", json_real(c.cv));
+		json_object_set_new(cellJ, "cv2", json_real(c.cv2));
+		json_object_set_new(cellJ, "pr", json_real(c.probability));
+		json_object_set_new(cellJ, "d", json_integer(c.division));
+		json_object_set_new(cellJ, "r", json_integer(c.ratchets));
+		json_array_append_new(cellsJ, cellJ);
+	}
+	char *text = json_dumps(cellsJ, JSON_COMPACT);
+	json_decref(cellsJ);
+	json_error_t error;
+	json_t *loadedJ = json_loads(text, 0, &error);
+	free(text);
+	return loadedJ;
+}
+
+static std::vector<TrigsCellProps> allCells(const TrigsHotCells &hot, const TrigsColdCells &cold) {
+	std::vector<TrigsCellProps> cells(GRID_CELLS);
+	for (int i = 0; i < GRID_CELLS; i++) cells[i] = TrigsCells::get(hot, cold, i);
+	return cells;
+}
+
+static int firstDifference(const std::vector<TrigsCellProps> &expected, const TrigsHotCells &hot, const TrigsColdCells &cold) {
+	for (int i = 0; i < GRID_CELLS; i++)
+		if (TrigsCells::get(hot, cold, i) != expected[i]) return i;
+	return -1;
+}
+
+static const int INSTANCES = 50;
+
+// Saves and loads a patch of INSTANCES Trigs128s the old way or the packed way
+static void timePatch(bool packed, float edited) {
+	static TrigsHotCells hots[INSTANCES], loadedHots[INSTANCES];
+	static TrigsColdCells colds[INSTANCES], loadedColds[INSTANCES];
+	for (int i = 0; i < INSTANCES; i++) {
+		randomCells(hots[i], colds[i], edited);
+		clearCells(loadedHots[i], loadedColds[i]);
+	}
+	auto start = std::chrono::steady_clock::now();
+	json_t *modulesJ = json_array();
+	for (int i = 0; i < INSTANCES; i++) {
+		json_t *dataJ = json_object();
+		if (packed) {
+			int version;
+			std::vector<uint8_t> data = TrigsPackedCells::pack(hots[i], colds[i], version);
+			json_object_set_new(dataJ, "cellsPackedVersion", json_integer(version));
+			json_object_set_new(dataJ, "cellsPacked", json_string(toBase64(data).c_str()));
+		}
+		else {
+			json_t *cellsJ = json_array();
+			for (int c = 0; c < GRID_CELLS; c++) {
+				TrigsCellProps cell = TrigsCells::get(hots[i], colds[i], c);
+				json_t *cellJ = json_object();
+				json_object_set_new(cellJ, "a", json_boolean(cell.active));
+				json_object_set_new(cellJ, "p", json_real(cell.pitch));
+				json_object_set_new(cellJ, "o", json_integer(cell.octave));
+				json_object_set_new(cellJ, "cv", json_real(cell.cv));
+				json_object_set_new(cellJ, "cv2", json_real(cell.cv2));
+				json_object_set_new(cellJ, "pr", json_real(cell.probability));
+				json_object_set_new(cellJ, "d", json_integer(cell.division));
+				json_object_set_new(cellJ, "r", json_integer(cell.ratchets));
+				json_array_append_new(cellsJ, cellJ);
+			}
+			json_object_set_new(dataJ, "cells", cellsJ);
+		}
+		json_t *moduleJ = json_object();
+		json_object_set_new(moduleJ, "data", dataJ);
+		json_array_append_new(modulesJ, moduleJ);
+	}
+	json_t *patchJ = json_object();
+	json_object_set_new(patchJ, "modules", modulesJ);
+	char *text = json_dumps(patchJ, JSON_INDENT(2));
+	json_decref(patchJ);
+	auto saved = std::chrono::steady_clock::now();
+
+	json_error_t error;
+	patchJ = json_loads(text, 0, &error);
+	modulesJ = json_object_get(patchJ, "modules");
+	for (int i = 0; i < INSTANCES; i++) {
+		json_t *dataJ = json_object_get(json_array_get(modulesJ, i), "data");
+		if (packed) {
+			std::vector<uint8_t> data = fromBase64(json_string_value(json_object_get(dataJ, "cellsPacked")));
+			int version = json_integer_value(json_object_get(dataJ, "cellsPackedVersion"));
+			if (!TrigsPackedCells::unpack(data.data(), data.size(), version, loadedHots[i], loadedColds[i]))
+				clearCells(loadedHots[i], loadedColds[i]);
+		}
+		else {
+			TrigsCells::readCellsArray(json_object_get(dataJ, "cells"), loadedHots[i], loadedColds[i]);
+		}
+	}
+	json_decref(patchJ);
+	auto done = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < INSTANCES; i++)
+		CHECK(sameCells(loadedHots[i], loadedColds[i], hots[i], colds[i]), "%s patch instance %d differs after loading", packed ? "packed" : "old", i);
+	printf("%d instances, %3.0f%% edited, %s: %8zu bytes, save %6.2f ms, load %6.2f ms\n", INSTANCES, edited * 100.f,
+		packed ? "cellsPacked" : "cells array", strlen(text),
+		std::chrono::duration<double, std::milli>(saved - start).count(),
+		std::chrono::duration<double, std::milli>(done - saved).count());
+	free(text);
+}
+
+static TrigsHotCells hot, hot2, hotBefore;
+static TrigsColdCells cold, cold2, coldBefore;
+
+int main() {
+	// Round trips. Data that zero runs would grow is saved raw, and the version 1 stream it
+	// would have been, as a patch from before version 2 could hold, loads the same cells.
+	const float edited[] = {0.f, 0.01f, 0.1f, 0.5f, 1.f};
+	for (float e : edited) {
+		size_t bytes = 0;
+		int raw = 0;
+		for (int i = 0; i < 200; i++) {
+			randomCells(hot, cold, e);
+			int version = 0;
+			std::vector<uint8_t> packed = TrigsPackedCells::pack(hot, cold, version);
+			CHECK(version == TrigsPackedCells::VERSION || version == TrigsPackedCells::RAW_VERSION, "version %d", version);
+			CHECK(packed.size() <= TrigsPackedCells::BYTES, "%zu bytes packed, %g edited", packed.size(), e);
+			randomCells(hot2, cold2, 0.5f);
+			CHECK(TrigsPackedCells::unpack(packed.data(), packed.size(), version, hot2, cold2), "unpack failed, %g edited", e);
+			CHECK(sameCells(hot, cold, hot2, cold2), "round trip differs, %g edited", e);
+			bytes = std::max(bytes, packed.size());
+			if (version != TrigsPackedCells::RAW_VERSION) continue;
+			raw++;
+			std::vector<uint8_t> grown;
+			packZeroRuns(packed.data(), packed.size(), grown);
+			CHECK(grown.size() >= packed.size(), "raw data that zero runs shrink, %g edited", e);
+			randomCells(hot2, cold2, 0.5f);
+			CHECK(TrigsPackedCells::unpack(grown.data(), grown.size(), TrigsPackedCells::VERSION, hot2, cold2)
+				&& sameCells(hot, cold, hot2, cold2), "version 1 data of %zu bytes differs, %g edited", grown.size(), e);
+		}
+		printf("%3.0f%% of cells edited: packs to at most %zu of %zu bytes, %d of 200 raw\n", e * 100.f, bytes, TrigsPackedCells::BYTES, raw);
+	}
+
+	// Values a patch could hold but the module can't: clamped, and not-a-number is the cleared value
+	clearCells(hot, cold);
+	hot.probability[0] = 2.f;
+	hot.probability[1] = NAN;
+	hot.division[2] = 40;
+	hot.ratchets[3] = 0;
+	cold.pitch[4] = -3.f;
+	cold.octave[5] = 9;
+	cold.cv[6] = INFINITY;
+	cold.cv2[7] = -25.f;
+	int version;
+	std::vector<uint8_t> packed = TrigsPackedCells::pack(hot, cold, version);
+	CHECK(TrigsPackedCells::unpack(packed.data(), packed.size(), version, hot2, cold2), "unpack of out of range cells failed");
+	CHECK(hot2.probability[0] == 1.f && hot2.probability[1] == 1.f, "probability %g %g", hot2.probability[0], hot2.probability[1]);
+	CHECK(hot2.division[2] == 16 && hot2.ratchets[3] == 8, "division %d ratchets %d", hot2.division[2], hot2.ratchets[3]);
+	CHECK(cold2.pitch[4] == 0.f && cold2.octave[5] == 4, "pitch %g octave %d", cold2.pitch[4], cold2.octave[5]);
+	CHECK(cold2.cv[6] == 0.f && cold2.cv2[7] == -10.f, "cv %g cv2 %g", cold2.cv[6], cold2.cv2[7]);
+
+	// Mutated and random streams, and versions that don't exist
+	int accepted = 0, rejected = 0;
+	for (int i = 0; i < 5000; i++) {
+		randomCells(hot, cold, (rng() % 2) ? 0.05f : (rng() % 2) ? 0.8f : 1.f);
+		std::vector<uint8_t> data = TrigsPackedCells::pack(hot, cold, version);
+		if (rng() % 8 == 0) version = (rng() % 2) ? TrigsPackedCells::VERSION : TrigsPackedCells::RAW_VERSION;
+		if (rng() % 16 == 0) version = (int)(rng() % 5) - 1;
+		switch (i % 4) {
+			case 0: data[rng() % data.size()] = (uint8_t)rng(); break;
+			case 1: data.resize(rng() % data.size()); break;
+			case 2: data.insert(data.begin() + rng() % data.size(), (uint8_t)rng()); break;
+			default:
+				data.resize(rng() % (2 * TrigsPackedCells::BYTES));
+				for (uint8_t &b : data) b = (rng() % 3 == 0) ? 0 : (uint8_t)rng();
+		}
+		randomCells(hotBefore, coldBefore, 0.3f);
+		hot2 = hotBefore;
+		cold2 = coldBefore;
+		if (!TrigsPackedCells::unpack(data.data(), data.size(), version, hot2, cold2)) {
+			rejected++;
+			CHECK(sameCells(hot2, cold2, hotBefore, coldBefore), "failed unpack changed the cells");
+			continue;
+		}
+		accepted++;
+		CHECK(inRange(hot2, cold2), "stream %d loaded values out of range", i);
+		std::vector<uint8_t> again = TrigsPackedCells::pack(hot2, cold2, version);
+		CHECK(TrigsPackedCells::unpack(again.data(), again.size(), version, hot, cold) && sameCells(hot, cold, hot2, cold2), "stream %d does not repack to itself", i);
+	}
+	printf("5000 mutated or random streams: %d loaded, %d rejected\n", accepted, rejected);
+
+	// Old per-cell arrays load every field
+	for (float e : edited) {
+		randomCells(hot, cold, e);
+		json_t *cellsJ = cellsArrayText(hot, cold);
+		CHECK(json_array_size(cellsJ) == GRID_CELLS, "cells array did not load");
+		randomCells(hot2, cold2, 0.5f);
+		TrigsCells::readCellsArray(cellsJ, hot2, cold2);
+		CHECK(sameCells(hot, cold, hot2, cold2), "per-cell array differs, %g edited", e);
+		json_decref(cellsJ);
+	}
+
+	// Out of range values clamp, missing cv, cv2 and pr keep what the cell had, and entries that
+	// aren't objects or are past the grid change nothing
+	{
+		std::string text = "["
+			"{\"a\": true, \"p\": 12.5, \"o\": 7, \"cv\": 11.0, \"cv2\": -30.0, \"pr\": 1.5, \"d\": 0, \"r\": 9},"
+			"{\"a\": false, \"p\": -1.0, \"o\": -6, \"cv\": -10.5, \"cv2\": 10.25, \"pr\": -0.5, \"d\": 17, \"r\": 0},"
+			"{\"a\": true, \"p\": 3.25, \"o\": 2, \"d\": 5, \"r\": 3},"
+			"{\"a\": true, \"p\": 4, \"o\": -3, \"cv\": 2, \"cv2\": -1.5, \"pr\": 0.25, \"d\": 16, \"r\": 8},"
+			"7,"
+			"{}";
+		for (int i = 6; i < GRID_CELLS + 2; i++) text += ",{\"a\": true, \"p\": 1, \"o\": 1, \"d\": 2, \"r\": 2}";
+		text += "]";
+		json_error_t error;
+		json_t *cellsJ = json_loads(text.c_str(), 0, &error);
+		CHECK(cellsJ, "hand written cells array did not parse: %s", error.text);
+		randomCells(hot, cold, 1.f);
+		std::vector<TrigsCellProps> expected = allCells(hot, cold);
+		TrigsCellProps c;
+		c.active = true; c.pitch = 10.f; c.octave = 4; c.cv = 10.f; c.cv2 = -10.f; c.probability = 1.f; c.division = 1; c.ratchets = 8;
+		expected[0] = c;
+		c.active = false; c.pitch = 0.f; c.octave = -4; c.cv = -10.f; c.cv2 = 10.f; c.probability = 0.f; c.division = 16; c.ratchets = 1;
+		expected[1] = c;
+		c = expected[2];
+		c.active = true; c.pitch = 3.25f; c.octave = 2; c.division = 5; c.ratchets = 3;
+		expected[2] = c;
+		c.active = true; c.pitch = 4.f; c.octave = -3; c.cv = 2.f; c.cv2 = -1.5f; c.probability = 0.25f; c.division = 16; c.ratchets = 8;
+		expected[3] = c;
+		// 4 is not an object; 5 is empty, so it reads as off, pitch and octave 0, division and ratchets 1
+		c = expected[5];
+		c.active = false; c.pitch = 0.f; c.octave = 0; c.division = 1; c.ratchets = 1;
+		expected[5] = c;
+		for (int i = 6; i < GRID_CELLS; i++) {
+			c = expected[i];
+			c.active = true; c.pitch = 1.f; c.octave = 1; c.division = 2; c.ratchets = 2;
+			expected[i] = c;
+		}
+		TrigsCells::readCellsArray(cellsJ, hot, cold);
+		int i = firstDifference(expected, hot, cold);
+		CHECK(i < 0, "hand written cells array: cell %d differs", i);
+		CHECK(inRange(hot, cold), "hand written cells array loaded values out of range");
+		json_decref(cellsJ);
+	}
+
+	// Track copy, paste and rotate against the same operations on a plain array of cells. Cells
+	// outside the track pasted or rotated stay as they were.
+	for (int i = 0; i < 200; i++) {
+		randomCells(hot, cold, 0.5f);
+		std::vector<TrigsCellProps> before = allCells(hot, cold);
+		int from = rng() % 4, to = rng() % 4;
+		TrigsTrackCells clipboard;
+		TrigsCells::copyTrack(hot, cold, from, clipboard);
+		if (rng() % 2) randomCells(hot, cold, 0.5f);  // the clipboard keeps its own copy
+		std::vector<TrigsCellProps> expected = allCells(hot, cold);
+		for (int step = 0; step < TRACK_STEPS; step++) expected[to * TRACK_STEPS + step] = before[from * TRACK_STEPS + step];
+		TrigsCells::pasteTrack(clipboard, to, hot, cold);
+		int cell = firstDifference(expected, hot, cold);
+		CHECK(cell < 0, "paste of track %d to %d: cell %d differs", from, to, cell);
+
+		int track = rng() % 4, shift = 1 + rng() % (TRACK_STEPS - 1);
+		before = allCells(hot, cold);
+		expected = before;
+		for (int step = 0; step < TRACK_STEPS; step++) expected[track * TRACK_STEPS + (step + shift) % TRACK_STEPS] = before[track * TRACK_STEPS + step];
+		TrigsCells::rotateTrack(hot, cold, track, shift);
+		cell = firstDifference(expected, hot, cold);
+		CHECK(cell < 0, "rotate of track %d by %d: cell %d differs", track, shift, cell);
+	}
+
+	// Randomize draws in the order it always has, with CV scaled the way rescalefjw did it, so a
+	// seeded randomize of a whole track gives the same cells as before the split arrays
+	for (int i = 0; i < 200; i++) {
+		randomCells(hot, cold, 0.5f);
+		std::vector<TrigsCellProps> expected = allCells(hot, cold);
+		int track = rng() % 4;
+		float rndAmt = uniform(0.f, 1.f);
+		const float ranges[][2] = {{0.f, 10.f}, {-5.f, 5.f}, {-10.f, 10.f}, {0.f, 1.f}};
+		const float *cvRange = ranges[rng() % 4];
+		const float *cv2Range = ranges[rng() % 4];
+		std::vector<float> draws(TRACK_STEPS * 8);
+		for (float &d : draws) d = (rng() % 16 == 0) ? 0.f : uniform(0.f, 1.f);
+		for (int step = 0; step < TRACK_STEPS; step++) {
+			const float *u = &draws[step * 8];
+			TrigsCellProps &c = expected[track * TRACK_STEPS + step];
+			c.active = u[0] < rndAmt;
+			c.pitch = u[1] * 10.f;
+			c.octave = (int)std::floor(u[2] * 9.f) - 4;
+			c.cv = cvRange[0] + (u[3] - 0.f) / (1.f - 0.f) * (cvRange[1] - cvRange[0]);
+			c.cv2 = cv2Range[0] + (u[4] - 0.f) / (1.f - 0.f) * (cv2Range[1] - cv2Range[0]);
+			c.probability = u[5];
+			c.division = (int)std::floor(u[6] * 16.f) + 1;
+			c.ratchets = (int)std::floor(u[7] * 8.f) + 1;
+		}
+		size_t next = 0;
+		for (int step = 0; step < TRACK_STEPS; step++) {
+			TrigsCells::randomize(hot, cold, track * TRACK_STEPS + step, rndAmt, cvRange[0], cvRange[1], cv2Range[0], cv2Range[1],
+				[&]() { return draws[next++]; });
+		}
+		CHECK(next == draws.size(), "randomize of a track drew %zu of %zu values", next, draws.size());
+		int cell = firstDifference(expected, hot, cold);
+		CHECK(cell < 0, "randomize of track %d: cell %d differs", track, cell);
+		CHECK(inRange(hot, cold), "randomize left values out of range");
+	}
+
+	for (float e : edited) {
+		timePatch(false, e);
+		timePatch(true, e);
+	}
+
+	printf(failures ? "%d failures\n" : "ok\n", failures);
+	return failures ? 1 : 0;
+}